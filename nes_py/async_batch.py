@@ -0,0 +1,139 @@
+"""A batch of NES environments that steps in the background.
+
+Example:
+    >>> batch = AsyncBatch(envs)
+    >>> batch.step_async(np.zeros(len(envs), dtype=np.uint8))
+    >>> screens, ram, results = batch.wait()
+    >>> while True:
+    ...     # start the next frame and run the policy on the last one
+    ...     batch.step_async(policy_actions)
+    ...     policy_actions = policy(screens)
+    ...     screens, ram, results = batch.wait()
+
+"""
+import ctypes
+import sys
+import numpy as np
+from .nes_env import _LIB
+from .nes_env import SCREEN_SHAPE_32_BIT
+
+
+class AsyncBatch(object):
+    """A batch of NES environments that steps on native worker threads."""
+
+    def __init__(self, envs):
+        """
+        Create a new batch of environments.
+
+        Args:
+            envs (iterable): the NESEnv instances to step, which must not be
+              stepped, reset, or closed while a step of the batch is pending
+
+        Returns:
+            None
+
+        """
+        self._batch = None
+        self.envs = list(envs)
+        if not self.envs:
+            raise ValueError('a batch needs at least one environment')
+        # two threads stepping the same emulator at once would corrupt it
+        if len({id(env._env) for env in self.envs}) != len(self.envs):
+            raise ValueError('a batch cannot step an environment twice')
+        emulators = (ctypes.c_void_p * len(self.envs))(*[env._env for env in self.envs])
+        self._batch = _LIB.CreateBatch(emulators, len(self.envs))
+        # setup views of the screens, RAM, and results of both buffers
+        self._outputs = [self._buffer_views(buffer) for buffer in range(2)]
+
+    def _buffer_views(self, buffer):
+        """
+        Setup NumPy views of the outputs in a buffer of the batch.
+
+        Args:
+            buffer (int): the index of the buffer
+
+        Returns:
+            tuple: the screens (N x height x width x 3), the RAM (N x 2048),
+            and the RAM program results (N, structured) of the buffer
+
+        """
+        num_envs = len(self.envs)
+        screens_type = ctypes.c_uint8 * (num_envs * int(np.prod(SCREEN_SHAPE_32_BIT)))
+        address = _LIB.BatchScreens(self._batch, buffer)
+        screens = np.frombuffer(screens_type.from_address(address), dtype=np.uint8)
+        screens = screens.reshape((num_envs,) + SCREEN_SHAPE_32_BIT)
+        # convert the 32-bit pixels to RGB like the screen buffer
+        if sys.byteorder == 'little':
+            screens = screens[..., ::-1]
+        screens = screens[..., 1:]
+        ram_type = ctypes.c_uint8 * (num_envs * 0x800)
+        address = _LIB.BatchMemory(self._batch, buffer)
+        ram = np.frombuffer(ram_type.from_address(address), dtype=np.uint8)
+        ram = ram.reshape(num_envs, 0x800)
+        results = _LIB.BatchResults(self._batch, buffer)
+        results = np.ctypeslib.as_array(results, shape=(num_envs,))
+        return screens, ram, results
+
+    def step_async(self, actions, frames=1):
+        """
+        Start a step of every environment in the background.
+
+        Args:
+            actions (iterable): the controller byte for each environment
+            frames (int): the number of frames to hold the actions for
+
+        Returns:
+            None
+
+        """
+        if self._batch is None:
+            raise ValueError('batch has already been closed.')
+        actions = np.ascontiguousarray(actions, dtype=np.uint8).ravel()
+        if len(actions) != len(self.envs):
+            raise ValueError('actions must have one value per environment')
+        if not _LIB.StepAsync(self._batch, actions.ctypes.data, frames):
+            raise ValueError('a step is already pending, call `wait` first')
+
+    def poll(self):
+        """Return True if no step is pending, i.e., `wait` will not block."""
+        if self._batch is None:
+            raise ValueError('batch has already been closed.')
+        return _LIB.Poll(self._batch)
+
+    def wait(self):
+        """
+        Wait for the pending step to finish.
+
+        The outputs are views of one of two native buffers that alternate
+        between steps, so they stay valid while the next step runs and are
+        overwritten by the step after it.
+
+        Returns:
+            tuple: the screens (N x height x width x 3), the RAM (N x 2048),
+            and the RAM program results (N, with 'reward', 'done', and 'info'
+            fields) of the environments after the last step
+
+        """
+        if self._batch is None:
+            raise ValueError('batch has already been closed.')
+        buffer = _LIB.Wait(self._batch)
+        if buffer < 0:
+            raise ValueError('no step has finished, call `step_async` first')
+        return self._outputs[buffer]
+
+    def close(self):
+        """Wait for the pending step and free the batch (not the environments)."""
+        if self._batch is None:
+            raise ValueError('batch has already been closed.')
+        _LIB.CloseBatch(self._batch)
+        self._batch = None
+        self._outputs = None
+
+    def __del__(self):
+        """Stop the worker threads of a batch that was never closed."""
+        if self._batch is not None:
+            self.close()
+
+
+# explicitly define the outward facing API of this module
+__all__ = [AsyncBatch.__name__]
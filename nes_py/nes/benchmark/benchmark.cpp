@@ -0,0 +1,421 @@
+//  Program:      nes-py
+//  File:         benchmark.cpp
+//  Description:  A benchmark suite for the hot paths of the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+//  Usage:
+//      nes_benchmark [--games DIR] [--frames N] [--output FILE]
+//                    [--baseline FILE] [--tolerance FRACTION] [ROM...]
+//
+//  Each ROM (by default every supported ROM in nes_py/tests/games) is run
+//  through the following benchmarks, each reporting the mean, percentiles,
+//  and maximum of its latency in microseconds:
+//
+//  - step:             full frames (PPU and CPU)
+//  - step_rewind:      full frames with a rewind capture after every frame
+//  - cpu_only:         frames of CPU cycles without the PPU
+//  - ppu_only:         frames of PPU cycles without the CPU
+//  - backup:           Emulator::backup
+//  - restore:          Emulator::restore
+//  - initialize_close: loading the ROM, resetting, and deleting the emulator
+//
+//  The results are written as JSON. With a baseline (an earlier output),
+//  the median of every benchmark is compared to the baseline and the exit
+//  status is 1 if any median is slower by more than the tolerance.
+//
+
+#include <dirent.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "emulator.hpp"
+
+using NES::Emulator;
+
+/// The clock to time benchmarks with
+typedef std::chrono::steady_clock Clock;
+
+/// The mapper numbers that the emulator supports
+static const int SUPPORTED_MAPPERS[] = {0, 1, 2, 3};
+
+/// The number of frames to run before measuring (to get past boot screens)
+static const int WARMUP_FRAMES = 120;
+
+/// Return the number of microseconds between two time points.
+static inline double microseconds(Clock::time_point start, Clock::time_point stop) {
+    return std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+/// Return the controller input for a frame of a benchmark. The input taps
+/// start periodically and otherwise holds right so games leave the title.
+static inline NES::NES_Byte input(int frame) {
+    return frame % 40 == 0 ? 0x08 : 0x80;
+}
+
+/// The summary statistics of a benchmark
+struct Summary {
+    /// the number of samples
+    std::size_t count;
+    /// the mean latency in microseconds
+    double mean;
+    /// the median latency in microseconds
+    double p50;
+    /// the 90th percentile latency in microseconds
+    double p90;
+    /// the 99th percentile latency in microseconds
+    double p99;
+    /// the maximal latency in microseconds
+    double max;
+};
+
+/// Return the summary statistics of latency samples.
+static Summary summarize(std::vector<double> samples) {
+    Summary summary = Summary();
+    if (samples.empty())
+        return summary;
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, static_cast<std::size_t>(p * samples.size()))];
+    };
+    summary.count = samples.size();
+    for (double sample : samples)
+        summary.mean += sample;
+    summary.mean /= samples.size();
+    summary.p50 = percentile(0.50);
+    summary.p90 = percentile(0.90);
+    summary.p99 = percentile(0.99);
+    summary.max = samples.back();
+    return summary;
+}
+
+/// Return true if the mapper of a ROM file is supported by the emulator.
+static bool is_supported(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char header[16];
+    if (!file.read(header, sizeof header) || std::strncmp(header, "NES\x1a", 4))
+        return false;
+    int mapper = ((header[6] >> 4) & 0xf) | (header[7] & 0xf0);
+    return std::find(
+        std::begin(SUPPORTED_MAPPERS),
+        std::end(SUPPORTED_MAPPERS),
+        mapper
+    ) != std::end(SUPPORTED_MAPPERS);
+}
+
+/// Return the supported ROMs in a directory in sorted order.
+static std::vector<std::string> find_roms(const std::string& directory) {
+    std::vector<std::string> roms;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return roms;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".nes") == 0)
+            if (is_supported(directory + "/" + name))
+                roms.push_back(directory + "/" + name);
+    }
+    closedir(dir);
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+/// Run the benchmarks for a ROM.
+///
+/// @param path the path to the ROM
+/// @param frames the number of frames (or iterations) per benchmark
+/// @return a map of benchmark names to summaries
+///
+static std::map<std::string, Summary> run_rom(const std::string& path, int frames) {
+    std::map<std::string, Summary> results;
+    std::vector<double> samples;
+    samples.reserve(frames);
+    Emulator emulator(path);
+    emulator.reset();
+    for (int frame = 0; frame < WARMUP_FRAMES; frame++) {
+        *emulator.get_controller(0) = input(frame);
+        emulator.step();
+    }
+    emulator.backup();
+    // full frames
+    for (int frame = 0; frame < frames; frame++) {
+        *emulator.get_controller(0) = input(frame);
+        auto start = Clock::now();
+        emulator.step();
+        samples.push_back(microseconds(start, Clock::now()));
+    }
+    results["step"] = summarize(samples);
+    // full frames with the state captured for rewinding after every frame
+    emulator.restore();
+    emulator.set_rewind(1, 64 << 20);
+    samples.clear();
+    for (int frame = 0; frame < frames; frame++) {
+        *emulator.get_controller(0) = input(frame);
+        auto start = Clock::now();
+        emulator.step();
+        samples.push_back(microseconds(start, Clock::now()));
+    }
+    emulator.set_rewind(0, 0);
+    results["step_rewind"] = summarize(samples);
+    // CPU cycles without the PPU; the PPU would raise the vertical blank
+    // NMI, so raise it at the end of each frame instead
+    emulator.restore();
+    samples.clear();
+    NES::CPU& cpu = emulator.get_cpu();
+    NES::MainBus& bus = emulator.get_bus();
+    for (int frame = 0; frame < frames; frame++) {
+        *emulator.get_controller(0) = input(frame);
+        auto start = Clock::now();
+        for (int cycle = 0; cycle < Emulator::CYCLES_PER_FRAME; cycle++)
+            cpu.cycle(bus);
+        cpu.interrupt(bus, NES::CPU::NMI_INTERRUPT);
+        samples.push_back(microseconds(start, Clock::now()));
+    }
+    results["cpu_only"] = summarize(samples);
+    // PPU cycles without the CPU (the registers stay as they were after the
+    // warm up, so rendering is on in any game that reached gameplay)
+    emulator.restore();
+    samples.clear();
+    NES::PPU& ppu = emulator.get_ppu();
+    NES::PictureBus& picture_bus = emulator.get_picture_bus();
+    for (int frame = 0; frame < frames; frame++) {
+        auto start = Clock::now();
+        for (int cycle = 0; cycle < 3 * Emulator::CYCLES_PER_FRAME; cycle++)
+            ppu.cycle(picture_bus);
+        samples.push_back(microseconds(start, Clock::now()));
+    }
+    results["ppu_only"] = summarize(samples);
+    // backup and restore
+    std::vector<double> restores;
+    samples.clear();
+    for (int iteration = 0; iteration < frames; iteration++) {
+        auto start = Clock::now();
+        emulator.backup();
+        auto middle = Clock::now();
+        emulator.restore();
+        auto stop = Clock::now();
+        samples.push_back(microseconds(start, middle));
+        restores.push_back(microseconds(middle, stop));
+    }
+    results["backup"] = summarize(samples);
+    results["restore"] = summarize(restores);
+    // initialize and close (fewer iterations, this reads the file each time)
+    samples.clear();
+    for (int iteration = 0; iteration < std::max(1, frames / 10); iteration++) {
+        auto start = Clock::now();
+        auto other = new Emulator(path);
+        other->reset();
+        delete other;
+        samples.push_back(microseconds(start, Clock::now()));
+    }
+    results["initialize_close"] = summarize(samples);
+    return results;
+}
+
+/// Return the file name of a path.
+static std::string basename(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+/// The results of a benchmark run (ROM -> benchmark -> statistic -> value)
+typedef std::map<std::string, std::map<std::string, std::map<std::string, double>>> Results;
+
+/// Write results as JSON.
+static void write_json(std::ostream& stream, const Results& results, int frames) {
+    stream << "{\n  \"version\": 1,\n  \"frames\": " << frames << ",\n  \"roms\": {";
+    const char* rom_separator = "\n";
+    for (const auto& rom : results) {
+        stream << rom_separator << "    \"" << rom.first << "\": {";
+        const char* benchmark_separator = "\n";
+        for (const auto& benchmark : rom.second) {
+            stream << benchmark_separator << "      \"" << benchmark.first << "\": {";
+            const char* separator = "";
+            for (const auto& statistic : benchmark.second) {
+                stream << separator << "\"" << statistic.first << "\": " << statistic.second;
+                separator = ", ";
+            }
+            stream << "}";
+            benchmark_separator = ",\n";
+        }
+        stream << "\n    }";
+        rom_separator = ",\n";
+    }
+    stream << "\n  }\n}\n";
+}
+
+/// A minimal parser for the JSON written by write_json (objects, strings,
+/// and numbers only).
+class JSONParser {
+ private:
+    /// the text to parse
+    std::string text;
+    /// the position of the next character
+    std::size_t position;
+
+    /// Skip whitespace and return the next character.
+    char peek() {
+        while (position < text.size() && std::isspace(text[position]))
+            position++;
+        return position < text.size() ? text[position] : '\0';
+    }
+
+    /// Consume an expected character.
+    void expect(char character) {
+        if (peek() != character)
+            throw std::runtime_error(std::string("expected '") + character + "' in baseline JSON");
+        position++;
+    }
+
+    /// Parse a string.
+    std::string parse_string() {
+        expect('"');
+        auto end = text.find('"', position);
+        if (end == std::string::npos)
+            throw std::runtime_error("unterminated string in baseline JSON");
+        std::string value = text.substr(position, end - position);
+        position = end + 1;
+        return value;
+    }
+
+ public:
+    /// Initialize a parser over a string of JSON.
+    explicit JSONParser(const std::string& text) : text(text), position(0) { }
+
+    /// Parse a value, storing every number under its path of keys joined
+    /// by '/' in a flat map.
+    void parse(const std::string& path, std::map<std::string, double>& values) {
+        if (peek() == '{') {
+            expect('{');
+            if (peek() == '}') { position++; return; }
+            while (true) {
+                std::string key = parse_string();
+                expect(':');
+                parse(path.empty() ? key : path + "/" + key, values);
+                if (peek() == ',') { position++; continue; }
+                expect('}');
+                return;
+            }
+        } else if (peek() == '"') {
+            parse_string();
+        } else {
+            char* end;
+            values[path] = std::strtod(text.c_str() + position, &end);
+            if (end == text.c_str() + position)
+                throw std::runtime_error("invalid number in baseline JSON");
+            position = end - text.c_str();
+        }
+    }
+};
+
+/// Compare results to a baseline and print every median that regressed.
+///
+/// @return the number of regressions
+///
+static int compare(const Results& results, const std::string& path, double tolerance) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("failed to open baseline " + path);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::map<std::string, double> baseline;
+    JSONParser(text.str()).parse("", baseline);
+    int regressions = 0;
+    for (const auto& rom : results) {
+        for (const auto& benchmark : rom.second) {
+            auto key = "roms/" + rom.first + "/" + benchmark.first + "/p50_us";
+            auto reference = baseline.find(key);
+            if (reference == baseline.end() || reference->second <= 0)
+                continue;
+            double value = benchmark.second.at("p50_us");
+            double change = value / reference->second - 1;
+            bool is_regression = change > tolerance;
+            regressions += is_regression;
+            std::fprintf(stderr, "%-40s %-18s %10.2f -> %10.2f us (%+6.1f%%)%s\n",
+                rom.first.c_str(),
+                benchmark.first.c_str(),
+                reference->second,
+                value,
+                100 * change,
+                is_regression ? "  REGRESSION" : ""
+            );
+        }
+    }
+    return regressions;
+}
+
+int main(int argc, char** argv) {
+    std::string games = "nes_py/tests/games";
+    std::string output;
+    std::string baseline;
+    double tolerance = 0.10;
+    int frames = 600;
+    std::vector<std::string> roms;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--games" && has_value) games = argv[++i];
+        else if (arg == "--frames" && has_value) frames = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--output" && has_value) output = argv[++i];
+        else if (arg == "--baseline" && has_value) baseline = argv[++i];
+        else if (arg == "--tolerance" && has_value) tolerance = std::atof(argv[++i]);
+        else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "usage: " << argv[0] << " [--games DIR] [--frames N] [--output FILE]"
+                << " [--baseline FILE] [--tolerance FRACTION] [ROM...]" << std::endl;
+            return 2;
+        } else {
+            roms.push_back(arg);
+        }
+    }
+    if (roms.empty())
+        roms = find_roms(games);
+    if (roms.empty()) {
+        std::cerr << "no supported ROMs found in " << games << std::endl;
+        return 2;
+    }
+    Results results;
+    for (const auto& rom : roms) {
+        if (!is_supported(rom)) {
+            std::cerr << "skipping unsupported ROM " << rom << std::endl;
+            continue;
+        }
+        std::cerr << "benchmarking " << rom << std::endl;
+        for (const auto& benchmark : run_rom(rom, frames)) {
+            const Summary& summary = benchmark.second;
+            results[basename(rom)][benchmark.first] = {
+                {"count", static_cast<double>(summary.count)},
+                {"mean_us", summary.mean},
+                {"p50_us", summary.p50},
+                {"p90_us", summary.p90},
+                {"p99_us", summary.p99},
+                {"max_us", summary.max},
+                {"per_second", summary.mean > 0 ? 1e6 / summary.mean : 0},
+            };
+        }
+    }
+    if (output.empty()) {
+        write_json(std::cout, results, frames);
+    } else {
+        std::ofstream file(output);
+        write_json(file, results, frames);
+    }
+    if (!baseline.empty()) {
+        try {
+            return compare(results, baseline, tolerance) ? 1 : 0;
+        } catch (const std::exception& error) {
+            std::cerr << error.what() << std::endl;
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+//  Program:      nes-py
+//  File:         async_batch.hpp
+//  Description:  A batch of emulators that step in the background
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef ASYNC_BATCH_HPP
+#define ASYNC_BATCH_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+#include "emulator.hpp"
+
+namespace NES {
+
+/// A batch of emulators that steps on a background thread while the caller
+/// does other work (i.e., runs a policy on the last observations). The
+/// outputs of each step are copied into one of two buffers in turn, so the
+/// outputs of step t can be read while step t + 1 writes the other buffer.
+class AsyncBatch {
+ private:
+    /// the emulators of the batch (not owned)
+    std::vector<Emulator*> emulators;
+    /// the thread that runs the steps of the batch
+    std::thread dispatcher;
+    /// the lock that guards the request and the flags
+    std::mutex lock;
+    /// the signal to the dispatcher that a step was requested (or it stops)
+    std::condition_variable step_requested;
+    /// the signal to the caller that a step finished
+    std::condition_variable step_finished;
+    /// the controller byte for each emulator of the requested step
+    std::vector<NES_Byte> actions;
+    /// the number of frames to run for the requested step
+    int frames;
+    /// whether a step was requested and has not finished
+    bool is_pending;
+    /// whether the dispatcher is shutting down
+    bool is_stopping;
+    /// the number of finished steps
+    int64_t num_steps;
+    /// the screens of the emulators after a step for each buffer
+    std::vector<NES_Pixel> screens[2];
+    /// the RAM of the emulators after a step for each buffer
+    std::vector<NES_Byte> ram[2];
+    /// the RAM program results of the emulators after a step for each buffer
+    std::vector<RAMProgramResult> results[2];
+
+    /// Run the requested step on every emulator and fill the next buffer.
+    void run_step();
+
+    /// The main loop of the dispatcher thread.
+    void dispatch();
+
+ public:
+    /// Initialize a new batch and start its dispatcher.
+    ///
+    /// @param emulators the emulators to step (the caller must not use them
+    /// or delete them while a step is pending)
+    ///
+    explicit AsyncBatch(const std::vector<Emulator*>& emulators);
+
+    /// Wait for a pending step and stop the dispatcher.
+    ~AsyncBatch();
+
+    /// Return the number of emulators in the batch.
+    inline int get_size() const { return emulators.size(); }
+
+    /// Start a step of every emulator in the background.
+    ///
+    /// @param actions the controller byte for port 0 of each emulator
+    /// @param frames the number of frames to hold the actions for
+    /// @return true if the step started, false if a step is already pending
+    ///
+    bool step(const NES_Byte* actions, int frames);
+
+    /// Return true if no step is pending (i.e., wait will not block).
+    bool poll();
+
+    /// Wait for the pending step (if any) to finish.
+    ///
+    /// @return the buffer with the outputs of the last finished step, or -1
+    /// if no step has finished yet
+    ///
+    int wait();
+
+    /// Return the screens of the emulators after a step.
+    ///
+    /// @param buffer the buffer index returned by wait
+    /// @return the WIDTH * HEIGHT pixels of each emulator, back to back
+    ///
+    inline NES_Pixel* get_screens(int buffer) { return screens[buffer].data(); }
+
+    /// Return the RAM of the emulators after a step.
+    ///
+    /// @param buffer the buffer index returned by wait
+    /// @return the 0x800 bytes of RAM of each emulator, back to back
+    ///
+    inline NES_Byte* get_ram(int buffer) { return ram[buffer].data(); }
+
+    /// Return the RAM program results of the emulators after a step.
+    ///
+    /// @param buffer the buffer index returned by wait
+    /// @return the result of each emulator's program (zeros for emulators
+    /// without a program)
+    ///
+    inline RAMProgramResult* get_results(int buffer) { return results[buffer].data(); }
+};
+
+}  // namespace NES
+
+#endif  // ASYNC_BATCH_HPP
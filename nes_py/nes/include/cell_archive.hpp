@@ -0,0 +1,193 @@
+//  Program:      nes-py
+//  File:         cell_archive.hpp
+//  Description:  An archive of the best state of each cell for Go-Explore
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef CELL_ARCHIVE_HPP
+#define CELL_ARCHIVE_HPP
+
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+class Emulator;
+
+/// The statistics of a cell of an archive (must match CellInfo in
+/// nes_env.py)
+struct CellInfo {
+    /// the key of the cell
+    NES_Hash key;
+    /// the best score of a trajectory that reached the cell
+    double score;
+    /// the length of the trajectory of the best score (in frames)
+    int64_t length;
+    /// the number of frames that ended in the cell
+    int64_t times_seen;
+    /// the number of times the cell was selected to explore from
+    int64_t times_chosen;
+    /// the number of selections since exploring from the cell found a cell
+    int64_t times_chosen_since_new;
+};
+
+/// An archive of cells for Go-Explore. After each frame the machine maps to
+/// a cell (the screen downscaled to blocks of mean luma quantized to a few
+/// levels and/or selected RAM bytes divided into buckets) and the archive
+/// keeps the state of the best trajectory (highest score, then fewest
+/// frames) to reach each cell. Exploration restarts from cells selected at
+/// random with a weight that favors cells that were seldom seen or chosen.
+/// States are stored as deltas from the first stored state.
+class CellArchive {
+ public:
+    /// A cell and the state of its best trajectory
+    struct Cell {
+        /// the statistics of the cell
+        CellInfo info;
+        /// the state as a delta from the base state
+        std::vector<NES_Byte> delta;
+        /// the screen as runs of equal pixels
+        std::vector<NES_Pixel> runs;
+    };
+
+ private:
+    /// the number of columns of blocks of the screen (0 for no screen)
+    int frame_width;
+    /// the number of rows of blocks of the screen
+    int frame_height;
+    /// the number of levels of the luma of a block
+    int frame_depth;
+    /// the addresses of the RAM bytes of a cell
+    std::vector<NES_Address> addresses;
+    /// the size of the buckets of each RAM byte
+    std::vector<NES_Byte> divisors;
+    /// the block column of each column of pixels
+    std::vector<int> block_columns;
+    /// the luma summed over each block of the screen
+    std::vector<uint32_t> block_sums;
+    /// the number of pixels in each block
+    std::vector<uint32_t> block_sizes;
+    /// the features of the current cell (before hashing)
+    std::vector<NES_Byte> features;
+    /// the cells by key
+    std::unordered_map<NES_Hash, Cell> cells;
+    /// the keys of the cells in order of discovery
+    std::vector<NES_Hash> keys;
+    /// the state that cell states are deltas from (empty until a cell)
+    std::vector<NES_Byte> base;
+    /// a scratch buffer for saving a state
+    std::vector<NES_Byte> state;
+    /// a scratch buffer for encoding a state as a delta
+    std::vector<NES_Byte> delta;
+    /// the cumulative weights of the cells for a selection
+    std::vector<double> weights;
+    /// the generator of random selections
+    std::mt19937_64 generator;
+    /// the score of the running trajectory
+    double score;
+    /// the length of the running trajectory in frames
+    int64_t length;
+    /// the key of the cell the running trajectory was restored from
+    NES_Hash source;
+    /// whether the running trajectory was restored from a cell
+    bool has_source;
+    /// the key of the cell of the last observed frame
+    NES_Hash current;
+
+    /// Map the current state of an emulator to its cell, count the visit,
+    /// and store the state if the running trajectory is its best.
+    void visit(Emulator& emulator);
+
+ public:
+    /// Initialize a new empty archive.
+    ///
+    /// @param frame_width the number of columns of blocks of the screen,
+    /// or 0 to leave the screen out of cells
+    /// @param frame_height the number of rows of blocks of the screen
+    /// @param frame_depth the number of levels of the luma of a block
+    /// @param addresses the addresses of the RAM bytes of a cell
+    /// @param divisors the size of the buckets of each RAM byte (i.e., 16
+    /// for a byte that only matters in steps of 16), one per address
+    /// @param num_addresses the number of RAM bytes of a cell
+    /// @param seed the seed of the generator of random selections
+    ///
+    CellArchive(
+        int frame_width,
+        int frame_height,
+        int frame_depth,
+        const NES_Address* addresses,
+        const NES_Byte* divisors,
+        int num_addresses,
+        uint64_t seed
+    );
+
+    /// Return the key of the cell of a RAM and screen.
+    ///
+    /// @param ram the RAM of the machine
+    /// @param screen the screen of the machine
+    /// @return the hash of the features of the cell
+    ///
+    NES_Hash get_key(const NES_Byte* ram, const NES_Pixel* screen);
+
+    /// Start a new trajectory (score 0, length 0) from the current state
+    /// of an emulator, i.e., after a reset.
+    ///
+    /// @param emulator the emulator of the archive
+    ///
+    void begin(Emulator& emulator);
+
+    /// Count a frame towards the running trajectory and visit its cell.
+    ///
+    /// @param emulator the emulator after the frame
+    /// @param reward the reward of the frame
+    ///
+    void observe(Emulator& emulator, double reward);
+
+    /// Select a random cell with weights that favor new cells.
+    ///
+    /// @return the selected cell, or nullptr if the archive is empty
+    ///
+    const Cell* select();
+
+    /// Return a cell of the archive.
+    ///
+    /// @param key the key of the cell
+    /// @return the cell, or nullptr if the key is not in the archive
+    ///
+    const Cell* find(NES_Hash key) const;
+
+    /// Load the state and screen of a cell into an emulator and continue
+    /// its trajectory from there.
+    ///
+    /// @param emulator the emulator of the archive
+    /// @param cell a cell of the archive
+    /// @param is_chosen whether to count the restore as a selection
+    ///
+    void restore(Emulator& emulator, const Cell& cell, bool is_chosen);
+
+    /// Return the number of cells in the archive.
+    inline std::size_t size() const { return keys.size(); }
+
+    /// Copy the statistics of the cells in order of discovery.
+    ///
+    /// @param output a buffer of size() cells
+    ///
+    void get_cells(CellInfo* output) const;
+
+    /// Return the key of the cell of the last observed frame.
+    inline NES_Hash get_current() const { return current; }
+
+    /// Return the score of the running trajectory.
+    inline double get_score() const { return score; }
+
+    /// Reseed the generator of random selections.
+    inline void seed(uint64_t seed) { generator.seed(seed); }
+};
+
+}  // namespace NES
+
+#endif  // CELL_ARCHIVE_HPP
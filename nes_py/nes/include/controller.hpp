@@ -9,6 +9,7 @@
 #define CONTROLLER_HPP
 
 #include "common.hpp"
+#include "state.hpp"
 
 namespace NES {
 
@@ -46,6 +47,16 @@ class Controller {
     /// @return a state from the controller
     ///
     NES_Byte read();
+
+    /// Visit the shift register of the controller. The buttons are an input
+    /// to the machine and are not part of the visited state.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    inline void visit_state(StateVisitor& visit) {
+        visit(is_strobe);
+        visit(joypad_bits);
+    }
 };
 
 }  // namespace NES
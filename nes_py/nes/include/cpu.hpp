@@ -11,6 +11,9 @@
 #include "common.hpp"
 #include "cpu_opcodes.hpp"
 #include "main_bus.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "profiler.hpp"
 
 namespace NES {
 
@@ -33,6 +36,78 @@ class CPU {
     int skip_cycles;
     /// The number of cycles the CPU has run
     int cycles;
+    /// A bitmap of program counter breakpoints (nullptr if there are none)
+    const uint64_t* breakpoints;
+    /// whether an instruction at a breakpoint has executed
+    bool is_breakpoint_hit;
+    /// the instrumentation counters of the emulator
+    Stats* stats;
+    /// the profiler to record executed instructions in (nullptr if off)
+    Profiler* profiler;
+    /// the instruction trace of the emulator
+    Trace* trace;
+
+    // Idle loop detection
+
+    /// The maximal number of instructions in an idle loop
+    static const int IDLE_LOOP_SIZE = 4;
+    /// The maximal distance in bytes of the jump back to the loop head
+    static const int IDLE_LOOP_DISTANCE = 16;
+
+    /// The registers after one instruction of an idle loop
+    struct IdleStep {
+        /// the address of the instruction
+        NES_Address pc;
+        /// the program counter after the instruction
+        NES_Address next_pc;
+        /// the A register after the instruction
+        NES_Byte A;
+        /// the X register after the instruction
+        NES_Byte X;
+        /// the Y register after the instruction
+        NES_Byte Y;
+        /// the flags after the instruction
+        NES_Byte flags;
+        /// the number of cycles the instruction takes
+        int cycles;
+        /// whether the instruction reads the PPU status register
+        bool is_status_read;
+    };
+
+    /// The states of the idle loop detector
+    enum IdleState {
+        /// not in a loop
+        IDLE_NONE,
+        /// recording an iteration of a candidate loop
+        IDLE_RECORDING,
+        /// replaying a loop that is a fixed point of the registers
+        IDLE_REPLAYING,
+    } idle_state;
+    /// the address of the first instruction in the loop
+    NES_Address idle_head;
+    /// the A, X, Y, and flags registers at the head of the loop
+    NES_Byte idle_head_registers[4];
+    /// the instructions of the loop
+    IdleStep idle_loop[IDLE_LOOP_SIZE];
+    /// the number of instructions in the loop
+    int idle_length;
+    /// the index of the next instruction to replay
+    int idle_index;
+
+    /// Track an executed instruction for the idle loop detector.
+    ///
+    /// @param bus the bus to read operands from
+    /// @param pc the address of the instruction
+    /// @param opcode the opcode of the instruction
+    ///
+    void track_idle(MainBus &bus, NES_Address pc, NES_Byte opcode);
+
+    /// Replay the next instruction of an idle loop without decoding it.
+    ///
+    /// @return true if the instruction was replayed, false if it has to be
+    /// executed (it reads the PPU status or the loop was left)
+    ///
+    bool replay_idle();
 
     /// Set the zero and negative flags based on the given value.
     ///
@@ -135,7 +210,13 @@ class CPU {
     };
 
     /// Initialize a new CPU.
-    CPU() { };
+    CPU() :
+        breakpoints(nullptr),
+        is_breakpoint_hit(false),
+        stats(nullptr),
+        profiler(nullptr),
+        trace(nullptr),
+        idle_state(IDLE_NONE) { };
 
     /// Reset using the given main bus to lookup a starting address.
     ///
@@ -164,7 +245,54 @@ class CPU {
     /// 513 = 256 read + 256 write + 1 dummy read
     /// &1 -> +1 if on odd cycle
     ///
-    inline void skip_DMA_cycles() { skip_cycles += 513 + (cycles & 1); }
+    inline void skip_DMA_cycles() {
+        stats->count_DMA(513 + (cycles & 1));
+        skip_cycles += 513 + (cycles & 1);
+    }
+
+    /// Forget any detected idle loop. This must be called when memory may
+    /// have changed outside of the CPU (e.g., between frames).
+    inline void reset_idle() { idle_state = IDLE_NONE; }
+
+    /// Set the bitmap of program counter breakpoints.
+    ///
+    /// @param bitmap a bitmap with one bit per address in the 64KB address
+    /// space, or nullptr to disable breakpoints
+    ///
+    inline void set_breakpoints(const uint64_t* bitmap) { breakpoints = bitmap; }
+
+    /// Set the instrumentation counters to count CPU events in.
+    ///
+    /// @param stats the stats of the emulator that owns the CPU
+    ///
+    inline void set_stats(Stats* stats) { this->stats = stats; }
+
+    /// Set the profiler to record executed instructions in.
+    ///
+    /// @param profiler the profiler to record in, or nullptr to disable it
+    ///
+    inline void set_profiler(Profiler* profiler) { this->profiler = profiler; }
+
+    /// Set the instruction trace to record executed instructions in.
+    ///
+    /// @param trace the trace of the emulator that owns the CPU
+    ///
+    inline void set_trace(Trace* trace) { this->trace = trace; }
+
+    /// Return the number of cycles the CPU has run.
+    inline int get_cycles() const { return cycles; }
+
+    /// Return true if an instruction at a breakpoint has executed.
+    inline bool get_is_breakpoint_hit() const { return is_breakpoint_hit; }
+
+    /// Clear the flag for executing an instruction at a breakpoint.
+    inline void clear_is_breakpoint_hit() { is_breakpoint_hit = false; }
+
+    /// Visit the registers and counters of the CPU.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
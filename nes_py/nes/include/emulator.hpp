@@ -8,24 +8,45 @@
 #ifndef EMULATOR_HPP
 #define EMULATOR_HPP
 
+#include <memory>
 #include <string>
+#include <vector>
 #include "common.hpp"
 #include "cartridge.hpp"
+#include "cell_archive.hpp"
 #include "controller.hpp"
 #include "cpu.hpp"
 #include "ppu.hpp"
 #include "main_bus.hpp"
+#include "movie.hpp"
 #include "picture_bus.hpp"
+#include "ram_policy.hpp"
+#include "ram_program.hpp"
+#include "rewind.hpp"
+#include "speculator.hpp"
+#include "start_pool.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "telemetry.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+#include "trajectory.hpp"
+#include "transition_cache.hpp"
+#include "visit_counter.hpp"
 
 namespace NES {
 
 /// An NES Emulator and OpenAI Gym interface
 class Emulator {
  private:
-    /// The number of cycles in 1 frame
-    static const int CYCLES_PER_FRAME = 29781;
+    /// the path to the ROM the emulator was loaded from (to create clones)
+    std::string rom_path;
+    /// the hash of the PRG and CHR ROM (to match movies to the game)
+    NES_Hash rom_hash;
     /// the virtual cartridge with ROM and mapper data
     Cartridge cartridge;
+    /// the mapper for the cartridge
+    Mapper* mapper;
     /// the 2 controllers on the emulator
     Controller controllers[2];
 
@@ -38,6 +59,46 @@ class Emulator {
     /// the emulators' PPU
     PPU ppu;
 
+    /// the instrumentation counters of the emulator
+    Stats stats;
+    /// the latency histograms and frame rate of the emulator
+    Telemetry telemetry;
+    /// the instruction trace of the emulator
+    Trace trace;
+    /// the profiler of the 6502 code (nullptr if profiling is off)
+    std::unique_ptr<Profiler> profiler;
+    /// the program that computes rewards and flags from RAM after each step
+    RAMProgram program;
+    /// a bitmap of program counter breakpoints for the CPU
+    std::vector<uint64_t> breakpoints;
+    /// the number of addresses with a breakpoint
+    int num_breakpoints;
+    /// the movie of controller input that is recorded or replayed
+    std::unique_ptr<Movie> movie;
+    /// whether each step appends its input to the movie
+    bool is_recording;
+    /// the ring buffer of recent states (nullptr if rewinding is off)
+    std::unique_ptr<RewindBuffer> rewind_buffer;
+    /// the speculative steps of likely next actions (nullptr if off)
+    std::unique_ptr<Speculator> speculator;
+    /// whether each speculative step speculates on repeating its action
+    bool is_speculating_repeat;
+    /// the cache of the outcomes of frames (nullptr if caching is off),
+    /// which may be shared with other emulators of the same ROM
+    std::shared_ptr<TransitionCache> transition_cache;
+    /// the states to reset episodes to (nullptr if there is no pool)
+    std::unique_ptr<StartPool> start_pool;
+    /// whether step_episode resets to a start when an episode ends
+    bool is_autoresetting;
+    /// the return and length of the running and last episode
+    EpisodeStats episode;
+    /// the recording of every step to a file (nullptr if not recording)
+    std::unique_ptr<TrajectoryRecorder> trajectory;
+    /// the Go-Explore archive of the cells of every step (nullptr if off)
+    std::unique_ptr<CellArchive> cell_archive;
+    /// the counts of the RAM values of every step (nullptr if off)
+    std::unique_ptr<VisitCounter> visit_counter;
+
     /// the main data bus of the emulator
     MainBus backup_bus;
     /// the picture bus from the PPU of the emulator
@@ -47,11 +108,42 @@ class Emulator {
     /// the emulators' PPU
     PPU backup_ppu;
 
+    /// the emulators that run the expansions of the state of this emulator
+    std::vector<std::unique_ptr<Emulator>> clones;
+    /// the serialized state that the clones start each expansion from
+    std::vector<NES_Byte> expand_state;
+
+    /// Create clones until there are at least a number of them.
+    ///
+    /// @param count the number of clones to provide
+    ///
+    void reserve_clones(std::size_t count);
+
+    /// Run the cycles of a frame and evaluate the RAM program after it.
+    void run_frame();
+
+    /// Return true if a movie, the rewind buffer, a trajectory, the cell
+    /// archive, or the visit counts observe every frame that is stepped.
+    inline bool is_observing_frames() const {
+        return is_recording || rewind_buffer != nullptr || trajectory != nullptr ||
+            cell_archive != nullptr || visit_counter != nullptr;
+    }
+
+    /// Load a cell of the cell archive and reset the RAM program.
+    ///
+    /// @param cell the cell to load, or nullptr for none
+    /// @param is_chosen whether to count the load as a selection
+    /// @return true if the cell was loaded, false if it is nullptr
+    ///
+    bool restore_cell(const CellArchive::Cell* cell, bool is_chosen);
+
  public:
     /// The width of the NES screen in pixels
     static const int WIDTH = SCANLINE_VISIBLE_DOTS;
     /// The height of the NES screen in pixels
     static const int HEIGHT = VISIBLE_SCANLINES;
+    /// The number of cycles in 1 frame
+    static const int CYCLES_PER_FRAME = 29781;
 
     /// Initialize a new emulator with a path to a ROM file.
     ///
@@ -59,6 +151,9 @@ class Emulator {
     ///
     explicit Emulator(std::string rom_path);
 
+    /// Delete the mapper of the emulator.
+    ~Emulator();
+
     /// Return a 32-bit pointer to the screen buffer's first address.
     ///
     /// @return a 32-bit pointer to the screen buffer's first address
@@ -80,12 +175,503 @@ class Emulator {
         return controllers[port].get_joypad_buffer();
     }
 
+    /// Return the CPU of the emulator (for tools that drive it directly).
+    inline CPU& get_cpu() { return cpu; }
+
+    /// Return the PPU of the emulator (for tools that drive it directly).
+    inline PPU& get_ppu() { return ppu; }
+
+    /// Return the main bus of the emulator.
+    inline MainBus& get_bus() { return bus; }
+
+    /// Return the picture bus of the emulator.
+    inline PictureBus& get_picture_bus() { return picture_bus; }
+
+    /// Return a pointer to the RAM program evaluated after each step.
+    ///
+    /// @return a pointer to the RAM program of the emulator
+    ///
+    inline RAMProgram* get_program() { return &program; }
+
+    /// Return the instrumentation counters of the emulator.
+    ///
+    /// @return a pointer to the stats of the emulator
+    ///
+    inline Stats* get_stats() { return &stats; }
+
+    /// Return the latency histograms and frame rate of the emulator.
+    inline Telemetry* get_telemetry() { return &telemetry; }
+
+    /// Return the instruction trace of the emulator.
+    ///
+    /// @return a pointer to the trace of the emulator
+    ///
+    inline Trace* get_trace() { return &trace; }
+
+    /// Enable or disable the profiler of the 6502 code. Enabling the
+    /// profiler discards any samples from an earlier run.
+    ///
+    /// @param is_enabled whether to profile executed instructions
+    ///
+    void set_profiler(bool is_enabled);
+
+    /// Return the profiler of the 6502 code.
+    ///
+    /// @return a pointer to the profiler, or nullptr if profiling is off
+    ///
+    inline Profiler* get_profiler() { return profiler.get(); }
+
+    /// Apply a visitor to each field of the machine state.
+    ///
+    /// @param visit the visitor to apply to the machine state
+    ///
+    void visit_state(StateVisitor& visit);
+
+    /// Return a 64-bit hash of the full machine state (CPU, RAM, PPU, VRAM,
+    /// mapper, and controller shift registers).
+    ///
+    /// @return a 64-bit non-cryptographic hash of the machine state
+    ///
+    NES_Hash get_state_hash();
+
+    /// Return the hash of the PRG and CHR ROM (to match files to the game).
+    inline NES_Hash get_rom_hash() const { return rom_hash; }
+
+    /// Return a 64-bit hash of the screen buffer.
+    ///
+    /// @return a 64-bit non-cryptographic hash of the screen buffer
+    ///
+    inline NES_Hash get_screen_hash() {
+        return hash_bytes(get_screen_buffer(), sizeof(NES_Pixel) * WIDTH * HEIGHT);
+    }
+
+    /// Return the number of bytes in the serialized machine state.
+    ///
+    /// @return the size of the buffer for save_state and load_state
+    ///
+    std::size_t state_size();
+
+    /// Serialize the full machine state (the state that get_state_hash
+    /// covers) into a buffer.
+    ///
+    /// @param buffer the buffer of state_size() bytes to write to
+    ///
+    void save_state(NES_Byte* buffer);
+
+    /// Deserialize the full machine state from a buffer that save_state
+    /// wrote on an emulator running the same ROM.
+    ///
+    /// @param buffer the buffer of state_size() bytes to read from
+    /// @return true if the state loaded, false if a field of the buffer is
+    /// out of range (the emulator is then in a safe but unspecified state
+    /// until a valid state is loaded)
+    ///
+    bool load_state(const NES_Byte* buffer);
+
+    /// Step a clone of the current state for each of a set of actions and
+    /// collect the outcomes. The clones run in parallel on the shared thread
+    /// pool and this emulator is left unchanged.
+    ///
+    /// @param actions the controller byte for each clone to hold
+    /// @param num_actions the number of actions (and clones)
+    /// @param frames the number of frames to step each clone
+    /// @param screens an output for the screen of each clone (num_actions
+    /// blocks of WIDTH * HEIGHT pixels), or nullptr to skip
+    /// @param ram an output for the RAM of each clone (num_actions blocks of
+    /// 0x800 bytes), or nullptr to skip
+    /// @param states an output for the state of each clone (num_actions
+    /// blocks of state_size() bytes for load_state), or nullptr to skip
+    ///
+    void expand(
+        const NES_Byte* actions,
+        int num_actions,
+        int frames,
+        NES_Pixel* screens,
+        NES_Byte* ram,
+        NES_Byte* states
+    );
+
+    /// Evaluate a batch of open-loop action sequences from the current
+    /// state. The sequences are merged into a prefix trie so each shared
+    /// prefix is emulated once; clones snapshot the state at each branch of
+    /// the trie and the branches run in parallel on the shared thread pool.
+    /// This emulator is left unchanged.
+    ///
+    /// @param actions the actions of all sequences back to back (one frame
+    /// per action)
+    /// @param lengths the number of actions in each sequence
+    /// @param num_sequences the number of sequences
+    /// @param program the RAM program to evaluate after each frame (reset on
+    /// the current RAM), a sequence stops early when it sets the done flag
+    /// @param results an output for the result of the program after the last
+    /// frame of each sequence with the reward summed over the frames
+    /// @param frames an output for the number of frames of each sequence
+    /// that ran before it stopped
+    /// @param ram an output for the RAM after each sequence (num_sequences
+    /// blocks of 0x800 bytes), or nullptr to skip
+    /// @return the number of frames that were emulated
+    ///
+    int64_t evaluate_sequences(
+        const NES_Byte* actions,
+        const int* lengths,
+        int num_sequences,
+        RAMProgram& program,
+        RAMProgramResult* results,
+        int* frames,
+        NES_Byte* ram
+    );
+
+    /// Run an episode with a RAM policy in the loop from the current state.
+    ///
+    /// @param policy the policy that selects the action from the RAM
+    /// @param program the RAM program that computes the reward and the done
+    /// flag after each frame (reset on the current RAM)
+    /// @param max_steps the maximal number of actions in the episode
+    /// @param frame_skip the number of frames to hold each action
+    /// @param steps an output for the number of actions in the episode
+    /// @return the reward summed over the frames of the episode
+    ///
+    double rollout(
+        const RAMPolicy& policy,
+        RAMProgram& program,
+        int max_steps,
+        int frame_skip,
+        int* steps
+    );
+
+    /// Run an episode for each member of a population of policies from the
+    /// current state. The episodes run on clones in parallel on the shared
+    /// thread pool and this emulator is left unchanged.
+    ///
+    /// @param policy the policy that the members share the layout of
+    /// @param weights the weights of each member (num_policies blocks of
+    /// policy.get_num_weights() values)
+    /// @param num_policies the number of members of the population
+    /// @param program the RAM program for the reward and the done flag
+    /// @param max_steps the maximal number of actions in each episode
+    /// @param frame_skip the number of frames to hold each action
+    /// @param returns an output for the return of each episode
+    /// @param steps an output for the number of actions in each episode
+    ///
+    void rollout_batch(
+        const RAMPolicy& policy,
+        const double* weights,
+        int num_policies,
+        const RAMProgram& program,
+        int max_steps,
+        int frame_skip,
+        double* returns,
+        int* steps
+    );
+
+    /// Start recording a new movie of the controller input from the current
+    /// state. Loading a state or restoring a backup while recording breaks
+    /// the continuity of the movie.
+    ///
+    /// @param keyframe_interval the number of frames between keyframes
+    ///
+    void start_recording(int keyframe_interval);
+
+    /// Stop appending the input of each step to the movie.
+    inline void stop_recording() { is_recording = false; }
+
+    /// Return the movie of the emulator.
+    ///
+    /// @return a pointer to the movie, or nullptr if there is none
+    ///
+    inline const Movie* get_movie() const { return movie.get(); }
+
+    /// Put the emulator in the state after a frame of the movie by loading
+    /// the keyframe at or before the frame and replaying the input from it.
+    ///
+    /// @param frame the number of frames of the movie to have run
+    /// @return true if the emulator seeked, false if there is no movie, the
+    /// movie is recording, or the frame is out of range
+    ///
+    bool seek(int frame);
+
+    /// Write the movie to a file.
+    ///
+    /// @param path the path of the file to write
+    /// @param has_keyframes whether to write every keyframe instead of only
+    /// the first (the rest are rebuilt on load)
+    /// @return true if the file was written, false otherwise
+    ///
+    bool save_movie(const std::string& path, bool has_keyframes);
+
+    /// Read a movie from a file and seek to its first frame. Keyframes that
+    /// the file does not contain are rebuilt by replaying the movie.
+    ///
+    /// @param path the path of the file to read
+    /// @return true if the movie loaded, false if the file is invalid, has
+    /// an invalid keyframe, or was recorded on a different ROM
+    ///
+    bool load_movie(const std::string& path);
+
+    /// Enable or disable the capture of the state every k frames into a
+    /// ring buffer for rewinding. Enabling the buffer discards its history
+    /// and captures the current state.
+    ///
+    /// @param interval the number of frames between captures (k), or 0 to
+    /// disable rewinding and free the buffer
+    /// @param max_bytes the size of the pool for the compressed older states
+    ///
+    void set_rewind(int interval, std::size_t max_bytes);
+
+    /// Return the rewind buffer of the emulator.
+    ///
+    /// @return a pointer to the rewind buffer, or nullptr if rewinding is off
+    ///
+    inline const RewindBuffer* get_rewind() const { return rewind_buffer.get(); }
+
+    /// Load the newest captured state that is at least a number of frames
+    /// old and discard the states after it.
+    ///
+    /// @param frames_back the number of frames to go back
+    /// @return the number of frames that were rewound (less than requested
+    /// if the history is shorter), or -1 if rewinding is off
+    ///
+    int64_t rewind(int64_t frames_back);
+
+    /// Enable or disable speculative steps. Disabling discards any running
+    /// speculation and the hit and miss counts.
+    ///
+    /// @param is_enabled whether to speculate
+    /// @param is_repeat whether each step_speculative starts a speculation
+    /// on repeating its action (otherwise the caller calls speculate)
+    ///
+    void set_speculation(bool is_enabled, bool is_repeat);
+
+    /// Start emulating likely next actions from the current state on
+    /// spare threads (nothing if speculation is off).
+    ///
+    /// @param actions the controller byte of each likely action
+    /// @param num_actions the number of likely actions
+    /// @param frames the number of frames the next step will hold for
+    ///
+    void speculate(const NES_Byte* actions, int num_actions, int frames);
+
+    /// Step the emulator with the action on the controllers. If a running
+    /// speculation emulated that action from the current state, its outcome
+    /// is loaded instead of emulated. Frames are always emulated while
+    /// something observes every frame (see is_observing_frames), and
+    /// committed frames are not counted in the stats of this emulator.
+    ///
+    /// @param frames the number of frames to hold the action for
+    /// @return true if the outcome came from a speculation
+    ///
+    bool step_speculative(int frames);
+
+    /// Discard any running speculation (i.e., after changing the program).
+    inline void cancel_speculation() { if (speculator) speculator->cancel(); }
+
+    /// Cache the outcomes of frames so that stepping a state with an input
+    /// it was stepped with before loads the outcome instead of running the
+    /// frame. Frames loaded from the cache do not run the CPU, so they are
+    /// not seen by the stats, trace, or profiler (the cache is bypassed
+    /// while a breakpoint is set).
+    ///
+    /// @param max_bytes the memory for the cached outcomes, or 0 to disable
+    /// caching
+    /// @param is_caching_screens whether to cache the screen of each frame
+    /// (if not, a cached frame leaves the screen buffer unchanged)
+    ///
+    void set_transition_cache(std::size_t max_bytes, bool is_caching_screens);
+
+    /// Use the transition cache of another emulator of the same ROM.
+    ///
+    /// @param other the emulator to share the cache of
+    /// @return true if the cache is shared, false if the ROMs differ
+    ///
+    inline bool share_transition_cache(const Emulator& other) {
+        if (rom_hash != other.rom_hash)
+            return false;
+        transition_cache = other.transition_cache;
+        return true;
+    }
+
+    /// Return the transition cache of the emulator.
+    ///
+    /// @return a pointer to the cache, or nullptr if caching is off
+    ///
+    inline TransitionCache* get_transition_cache() { return transition_cache.get(); }
+
+    /// Replace the start pool with an empty one.
+    ///
+    /// @param max_noops the largest number of no-op frames after a start,
+    /// or a negative number to remove the pool
+    /// @param noop_action the controller byte of the no-op action
+    /// @param seed the seed of the generator of random starts
+    ///
+    void set_start_pool(int max_noops, NES_Byte noop_action, uint64_t seed);
+
+    /// Add a state to the start pool, along with the states after each
+    /// number of no-op frames (emulated on a clone, so the state of this
+    /// emulator is unchanged).
+    ///
+    /// @param state the machine state to add
+    /// @param screen the screen of the state (a reset to the start without
+    /// no-ops restores it, the state alone cannot produce it)
+    /// @return true if the state was added, false if there is no pool, the
+    /// screen is missing, or the state is invalid
+    ///
+    bool add_start(const NES_Byte* state, const NES_Pixel* screen);
+
+    /// Load a random start from the pool, record the deltas of the RAM
+    /// program, and begin a new episode.
+    ///
+    /// @return true if a start was loaded, false if the pool is empty
+    ///
+    bool reset_to_start();
+
+    /// Set whether step_episode resets to a start when an episode ends.
+    inline void set_autoreset(bool is_enabled) { is_autoresetting = is_enabled; }
+
+    /// Step the emulator and count the reward of the RAM program towards
+    /// the episode. If the done flag of the program is set, the episode
+    /// ends and (with autoreset) the emulator resets to a start, keeping the
+    /// outputs of the program from the last frame of the episode, and the
+    /// cell archive (if any) begins a new trajectory.
+    ///
+    /// @param frames the number of frames to hold the action for (fewer if
+    /// the episode ends first)
+    /// @return true if the episode ended, false otherwise
+    ///
+    bool step_episode(int frames);
+
+    /// Return the return and length of the running and last episode.
+    inline EpisodeStats* get_episode() { return &episode; }
+
+    /// Return the start pool of the emulator.
+    ///
+    /// @return a pointer to the pool, or nullptr if there is no pool
+    ///
+    inline StartPool* get_start_pool() { return start_pool.get(); }
+
+    /// Record every following step (its controllers, RAM, screen, and the
+    /// reward and done flag of the RAM program) to a trajectory file,
+    /// stopping any running recording. Steps are encoded on the calling
+    /// thread and written to the file on a background thread.
+    ///
+    /// @param path the path of the file to create
+    /// @param chunk_steps the number of steps in each chunk of the file
+    /// @return true if the file was created, false otherwise
+    ///
+    bool start_trajectory(const std::string& path, uint32_t chunk_steps);
+
+    /// Write the remaining steps of the recording and close its file.
+    ///
+    /// @return true if every step was written, false if a write failed or
+    /// nothing was being recorded
+    ///
+    bool stop_trajectory();
+
+    /// Return the number of steps of the running recording (0 if none).
+    inline uint64_t get_trajectory_size() const {
+        return trajectory == nullptr ? 0 : trajectory->get_num_steps();
+    }
+
+    /// Replace the cell archive with an empty one that maps each following
+    /// step to a cell (see CellArchive for the parameters). Steps that the
+    /// RAM program marks as done are not added to the archive.
+    void set_cell_archive(
+        int frame_width,
+        int frame_height,
+        int frame_depth,
+        const NES_Address* addresses,
+        const NES_Byte* divisors,
+        int num_addresses,
+        uint64_t seed
+    );
+
+    /// Stop mapping steps to cells and discard the cell archive.
+    inline void remove_cell_archive() { cell_archive.reset(); }
+
+    /// Start a new trajectory of the cell archive from the current state
+    /// (nothing if there is no archive).
+    inline void begin_cells() { if (cell_archive) cell_archive->begin(*this); }
+
+    /// Load a random cell of the archive to explore from.
+    ///
+    /// @return true if a cell was loaded, false if the archive is empty
+    ///
+    inline bool select_cell() {
+        return cell_archive != nullptr && restore_cell(cell_archive->select(), true);
+    }
+
+    /// Load a cell of the archive.
+    ///
+    /// @param key the key of the cell
+    /// @return true if the cell was loaded, false if it is not archived
+    ///
+    inline bool load_cell(NES_Hash key) {
+        return cell_archive != nullptr && restore_cell(cell_archive->find(key), false);
+    }
+
+    /// Return the cell archive of the emulator.
+    ///
+    /// @return a pointer to the archive, or nullptr if there is none
+    ///
+    inline CellArchive* get_cell_archive() { return cell_archive.get(); }
+
+    /// Count the RAM values of each following step for exploration bonuses
+    /// (see VisitCounter for the parameters), replacing any counts.
+    void set_visit_counter(
+        const NES_Address* addresses,
+        int num_addresses,
+        const NES_Address* tuple_addresses,
+        const int* tuple_sizes,
+        int num_tuples,
+        int table_bits,
+        double scale
+    );
+
+    /// Stop counting RAM values and discard the counts.
+    inline void remove_visit_counter() { visit_counter.reset(); }
+
+    /// Return the visit counts of the emulator.
+    ///
+    /// @return a pointer to the counts, or nullptr if counting is off
+    ///
+    inline VisitCounter* get_visit_counter() { return visit_counter.get(); }
+
+    /// Return the speculative steps of the emulator.
+    ///
+    /// @return a pointer to the speculator, or nullptr if speculation is off
+    ///
+    inline const Speculator* get_speculator() const { return speculator.get(); }
+
     /// Load the ROM into the NES.
-    inline void reset() { cpu.reset(bus); ppu.reset(); }
+    inline void reset() {
+        const uint64_t start = Telemetry::now();
+        cpu.reset(bus);
+        ppu.reset();
+        trace.load(cpu.get_cycles());
+        telemetry.record(LATENCY_RESET, start);
+    }
 
     /// Perform a step on the emulator, i.e., a single frame.
     void step();
 
+    /// Enable or disable a breakpoint on a program counter address.
+    ///
+    /// @param address the address of the instruction to break on
+    /// @param is_enabled whether to set (true) or clear (false) the breakpoint
+    ///
+    void set_breakpoint(NES_Address address, bool is_enabled);
+
+    /// Run frames until a condition holds or a breakpoint is hit. The frame
+    /// that triggers the condition or breakpoint is run to completion.
+    ///
+    /// @param condition a RAM program that stores the condition as its done
+    /// flag (evaluated after each frame), or an empty program for none
+    /// @param max_frames the maximal number of frames to run
+    /// @param is_triggered an output for whether the condition or a
+    /// breakpoint triggered (false if the frame limit was reached)
+    /// @return the number of frames that elapsed
+    ///
+    int run_until(RAMProgram& condition, int max_frames, bool* is_triggered);
+
     /// Create a backup state on the emulator.
     inline void backup() {
         backup_bus = bus;
@@ -96,10 +682,16 @@ class Emulator {
 
     /// Restore the backup state on the emulator.
     inline void restore() {
+        const uint64_t start = Telemetry::now();
         bus = backup_bus;
         picture_bus = backup_picture_bus;
         cpu = backup_cpu;
         ppu = backup_ppu;
+        // the breakpoints belong to the emulator, not to the backup state
+        cpu.set_breakpoints(num_breakpoints ? breakpoints.data() : nullptr);
+        cpu.set_profiler(profiler.get());
+        trace.load(cpu.get_cycles());
+        telemetry.record(LATENCY_RESET, start);
     }
 };
 
@@ -0,0 +1,123 @@
+//  Program:      nes-py
+//  File:         hash.hpp
+//  Description:  Fast non-cryptographic 64-bit hashing (xxHash64)
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstring>
+#include "common.hpp"
+
+namespace NES {
+
+/// A 64-bit hash value
+typedef uint64_t NES_Hash;
+
+/// The prime constants of the xxHash64 algorithm
+const NES_Hash HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+const NES_Hash HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+const NES_Hash HASH_PRIME_3 = 0x165667B19E3779F9ULL;
+const NES_Hash HASH_PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+const NES_Hash HASH_PRIME_5 = 0x27D4EB2F165667C5ULL;
+
+/// Rotate a 64-bit value to the left.
+///
+/// @param value the value to rotate
+/// @param bits the number of bits to rotate by
+/// @return the rotated value
+///
+inline NES_Hash hash_rotate(NES_Hash value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/// Read a 64-bit little-endian word from unaligned memory.
+inline NES_Hash hash_read64(const NES_Byte* data) {
+    NES_Hash word; std::memcpy(&word, data, sizeof word); return word;
+}
+
+/// Read a 32-bit little-endian word from unaligned memory.
+inline NES_Hash hash_read32(const NES_Byte* data) {
+    uint32_t word; std::memcpy(&word, data, sizeof word); return word;
+}
+
+/// Mix a word of input into an accumulator (one xxHash64 round).
+inline NES_Hash hash_round(NES_Hash accumulator, NES_Hash input) {
+    accumulator += input * HASH_PRIME_2;
+    accumulator = hash_rotate(accumulator, 31);
+    return accumulator * HASH_PRIME_1;
+}
+
+/// Combine a hash with another hash in an order-dependent way.
+///
+/// @param seed the running hash value
+/// @param value the hash value to fold into the running hash
+/// @return the combined hash value
+///
+inline NES_Hash hash_combine(NES_Hash seed, NES_Hash value) {
+    seed ^= hash_round(0, value);
+    return seed * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+/// Return the xxHash64 digest of a block of memory.
+///
+/// @param data a pointer to the first byte to hash
+/// @param length the number of bytes to hash
+/// @param seed the seed for the hash function
+/// @return the 64-bit hash of the memory block
+///
+inline NES_Hash hash_bytes(const void* data, std::size_t length, NES_Hash seed = 0) {
+    auto input = static_cast<const NES_Byte*>(data);
+    const NES_Byte* const end = input + length;
+    NES_Hash hash;
+    if (length >= 32) {
+        const NES_Byte* const limit = end - 32;
+        NES_Hash v1 = seed + HASH_PRIME_1 + HASH_PRIME_2;
+        NES_Hash v2 = seed + HASH_PRIME_2;
+        NES_Hash v3 = seed;
+        NES_Hash v4 = seed - HASH_PRIME_1;
+        do {
+            v1 = hash_round(v1, hash_read64(input));
+            v2 = hash_round(v2, hash_read64(input + 8));
+            v3 = hash_round(v3, hash_read64(input + 16));
+            v4 = hash_round(v4, hash_read64(input + 24));
+            input += 32;
+        } while (input <= limit);
+        hash = hash_rotate(v1, 1) + hash_rotate(v2, 7) + hash_rotate(v3, 12) + hash_rotate(v4, 18);
+        hash = hash_combine(hash, v1);
+        hash = hash_combine(hash, v2);
+        hash = hash_combine(hash, v3);
+        hash = hash_combine(hash, v4);
+    } else {
+        hash = seed + HASH_PRIME_5;
+    }
+    hash += length;
+    // consume the remaining input in 8, 4, and 1 byte strides
+    for (; input + 8 <= end; input += 8) {
+        hash ^= hash_round(0, hash_read64(input));
+        hash = hash_rotate(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (input + 4 <= end) {
+        hash ^= hash_read32(input) * HASH_PRIME_1;
+        hash = hash_rotate(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        input += 4;
+    }
+    for (; input < end; input++) {
+        hash ^= (*input) * HASH_PRIME_5;
+        hash = hash_rotate(hash, 11) * HASH_PRIME_1;
+    }
+    // avalanche the bits of the final hash
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+}  // namespace NES
+
+#endif  // HASH_HPP
@@ -12,6 +12,9 @@
 #include <unordered_map>
 #include "common.hpp"
 #include "mapper.hpp"
+#include "state.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
 namespace NES {
 
@@ -53,16 +56,38 @@ class MainBus {
     std::vector<NES_Byte> ram;
     /// The extended RAM (if the mapper has extended RAM)
     std::vector<NES_Byte> extended_ram;
+    /// the write tracking for the extended RAM
+    StateRegion extended_ram_region;
     /// a pointer to the mapper on the cartridge
     Mapper* mapper;
+    /// the instrumentation counters of the emulator
+    Stats* stats;
+    /// the instruction trace of the emulator
+    Trace* trace;
     /// a map of IO registers to callback methods for writes
     IORegisterToWriteCallbackMap write_callbacks;
     /// a map of IO registers to callback methods for reads
     IORegisterToReadCallbackMap read_callbacks;
 
+    /// Read a byte from an address without counting or tracing the access.
+    /// Reads of IO registers have their side effects (i.e., reading the
+    /// PPU status clears the vertical blank flag).
+    ///
+    /// @param address the 16-bit address of the byte to read
+    /// @return the byte located at the given address
+    ///
+    NES_Byte load(NES_Address address);
+
+    /// Write a byte to an address without counting or tracing the access.
+    ///
+    /// @param address the 16-bit address to write the byte to
+    /// @param value the byte to write to the given address
+    ///
+    void store(NES_Address address, NES_Byte value);
+
  public:
     /// Initialize a new main bus.
-    MainBus() : ram(0x800, 0), mapper(nullptr) { }
+    MainBus() : ram(0x800, 0), mapper(nullptr), stats(nullptr), trace(nullptr) { }
 
     /// Return a 8-bit pointer to the RAM buffer's first address.
     ///
@@ -76,14 +101,32 @@ class MainBus {
     ///
     /// @return the byte located at the given address
     ///
-    NES_Byte read(NES_Address address);
+    inline NES_Byte read(NES_Address address) {
+        stats->count_read(address);
+        NES_Byte value = load(address);
+        trace->read(address, value);
+        return value;
+    }
 
     /// Write a byte to an address in the RAM.
     ///
     /// @param address the 16-bit address to write the byte to in RAM
     /// @param value the byte to write to the given address
     ///
-    void write(NES_Address address, NES_Byte value);
+    inline void write(NES_Address address, NES_Byte value) {
+        stats->count_write(address);
+        trace->write(address, value);
+        store(address, value);
+    }
+
+    /// Read a byte from an address without any side effects, i.e., without
+    /// counting or tracing the access or reading IO registers.
+    ///
+    /// @param address the 16-bit address of the byte to read
+    /// @return the byte located at the given address (0 for IO registers
+    /// and the expansion ROM)
+    ///
+    NES_Byte peek(NES_Address address);
 
     /// Set the mapper pointer to a new value.
     ///
@@ -91,6 +134,18 @@ class MainBus {
     ///
     void set_mapper(Mapper* mapper);
 
+    /// Set the instrumentation counters to count bus accesses in.
+    ///
+    /// @param stats the stats of the emulator that owns the bus
+    ///
+    inline void set_stats(Stats* stats) { this->stats = stats; }
+
+    /// Set the instruction trace to record bus accesses in.
+    ///
+    /// @param trace the trace of the emulator that owns the bus
+    ///
+    inline void set_trace(Trace* trace) { this->trace = trace; }
+
     /// Set a callback for when writes occur.
     inline void set_write_callback(IORegisters reg, WriteCallback callback) {
         write_callbacks.insert({reg, callback});
@@ -103,6 +158,12 @@ class MainBus {
 
     /// Return a pointer to the page in memory.
     const NES_Byte* get_page_pointer(NES_Byte page);
+
+    /// Visit the RAM and extended RAM on the bus.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
@@ -11,6 +11,7 @@
 #include <functional>
 #include "common.hpp"
 #include "cartridge.hpp"
+#include "state.hpp"
 
 namespace NES {
 
@@ -36,6 +37,9 @@ class Mapper {
     ///
     explicit Mapper(Cartridge* game) : cartridge(game) { }
 
+    /// Destroy the mapper (the emulator deletes it through the base type).
+    virtual ~Mapper() { }
+
     /// Return the name table mirroring mode of this mapper.
     inline virtual NameTableMirroring getNameTableMirroring() {
         return static_cast<NameTableMirroring>(cartridge->getNameTableMirroring());
@@ -58,6 +62,13 @@ class Mapper {
     ///
     virtual void writePRG(NES_Address address, NES_Byte value) = 0;
 
+    /// Return the 16KB PRG ROM bank mapped at an address.
+    ///
+    /// @param address the 16-bit address in the PRG ROM ($8000-$FFFF)
+    /// @return the index of the 16KB bank of the ROM the address reads from
+    ///
+    virtual int getPRGBank(NES_Address address) = 0;
+
     /// Read a byte from the CHR RAM.
     ///
     /// @param address the 16-bit address of the byte to read
@@ -71,6 +82,12 @@ class Mapper {
     /// @param value the byte to write to the given address
     ///
     virtual void writeCHR(NES_Address address, NES_Byte value) = 0;
+
+    /// Visit the registers and RAM of the mapper.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    virtual void visit_state(StateVisitor& visit) = 0;
 };
 
 }  // namespace NES
@@ -42,6 +42,15 @@ class MapperCNROM : public Mapper {
             return cartridge->getROM()[(address - 0x8000) & 0x3fff];
     }
 
+    /// Return the 16KB PRG ROM bank mapped at an address.
+    ///
+    /// @param address the 16-bit address in the PRG ROM ($8000-$FFFF)
+    /// @return the index of the 16KB bank of the ROM the address reads from
+    ///
+    inline int getPRGBank(NES_Address address) {
+        return is_one_bank ? 0 : (address - 0x8000) >> 14;
+    }
+
     /// Write a byte to an address in the PRG RAM.
     ///
     /// @param address the 16-bit address to write to
@@ -66,6 +75,17 @@ class MapperCNROM : public Mapper {
     /// @param value the byte to write to the given address
     ///
     void writeCHR(NES_Address address, NES_Byte value);
+
+    /// Visit the registers of the mapper.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    inline void visit_state(StateVisitor& visit) {
+        visit(select_chr);
+        // the selected bank must be an 8KB bank of the CHR ROM
+        if (!visit.check(select_chr < cartridge->getVROM().size() >> 13))
+            select_chr = 0;
+    }
 };
 
 }  // namespace NES
@@ -22,6 +22,8 @@ class MapperNROM : public Mapper {
     bool has_character_ram;
     /// the character RAM on the mapper
     std::vector<NES_Byte> character_ram;
+    /// the write tracking for the character RAM
+    StateRegion character_ram_region;
 
  public:
     /// Create a new mapper with a cartridge.
@@ -42,6 +44,15 @@ class MapperNROM : public Mapper {
             return cartridge->getROM()[(address - 0x8000) & 0x3fff];
     }
 
+    /// Return the 16KB PRG ROM bank mapped at an address.
+    ///
+    /// @param address the 16-bit address in the PRG ROM ($8000-$FFFF)
+    /// @return the index of the 16KB bank of the ROM the address reads from
+    ///
+    inline int getPRGBank(NES_Address address) {
+        return is_one_bank ? 0 : (address - 0x8000) >> 14;
+    }
+
     /// Write a byte to an address in the PRG RAM.
     ///
     /// @param address the 16-bit address to write to
@@ -67,6 +78,12 @@ class MapperNROM : public Mapper {
     /// @param value the byte to write to the given address
     ///
     void writeCHR(NES_Address address, NES_Byte value);
+
+    /// Visit the registers and RAM of the mapper.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
@@ -46,6 +46,8 @@ class MapperSxROM : public Mapper {
     std::size_t second_bank_chr;
     /// The character RAM on the cartridge
     std::vector<NES_Byte> character_ram;
+    /// the write tracking for the character RAM
+    StateRegion character_ram_region;
 
     /// TODO: what does this do
     void calculatePRGPointers();
@@ -77,6 +79,15 @@ class MapperSxROM : public Mapper {
     ///
     void writePRG(NES_Address address, NES_Byte value);
 
+    /// Return the 16KB PRG ROM bank mapped at an address.
+    ///
+    /// @param address the 16-bit address in the PRG ROM ($8000-$FFFF)
+    /// @return the index of the 16KB bank of the ROM the address reads from
+    ///
+    inline int getPRGBank(NES_Address address) {
+        return (address < 0xc000 ? first_bank_prg : second_bank_prg) >> 14;
+    }
+
     /// Read a byte from the CHR RAM.
     ///
     /// @param address the 16-bit address of the byte to read
@@ -100,6 +111,12 @@ class MapperSxROM : public Mapper {
 
     /// Return the name table mirroring mode of this mapper.
     inline NameTableMirroring getNameTableMirroring() { return mirroring; }
+
+    /// Visit the registers and RAM of the mapper.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
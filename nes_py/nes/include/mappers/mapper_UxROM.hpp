@@ -24,6 +24,8 @@ class MapperUxROM : public Mapper {
     NES_Address select_prg;
     /// The character RAM on the mapper
     std::vector<NES_Byte> character_ram;
+    /// the write tracking for the character RAM
+    StateRegion character_ram_region;
 
  public:
     /// Create a new mapper with a cartridge.
@@ -48,6 +50,15 @@ class MapperUxROM : public Mapper {
         select_prg = value;
     }
 
+    /// Return the 16KB PRG ROM bank mapped at an address.
+    ///
+    /// @param address the 16-bit address in the PRG ROM ($8000-$FFFF)
+    /// @return the index of the 16KB bank of the ROM the address reads from
+    ///
+    inline int getPRGBank(NES_Address address) {
+        return address < 0xc000 ? select_prg : last_bank_pointer >> 14;
+    }
+
     /// Read a byte from the CHR RAM.
     ///
     /// @param address the 16-bit address of the byte to read
@@ -61,6 +72,12 @@ class MapperUxROM : public Mapper {
     /// @param value the byte to write to the given address
     ///
     void writeCHR(NES_Address address, NES_Byte value);
+
+    /// Visit the registers and RAM of the mapper.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
@@ -0,0 +1,123 @@
+//  Program:      nes-py
+//  File:         movie.hpp
+//  Description:  A recording of controller input with periodic keyframes
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef MOVIE_HPP
+#define MOVIE_HPP
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+/// A recording of the input of both controller ports, one byte per port per
+/// frame, with a snapshot of the machine state (a keyframe) every N frames.
+/// Any frame of the movie is reached by loading the keyframe at or before it
+/// and replaying at most N - 1 frames of input.
+class Movie {
+ private:
+    /// the number of frames between keyframes
+    int keyframe_interval;
+    /// the size of a keyframe in bytes
+    std::size_t state_size;
+    /// the hash of the ROM the movie was recorded on
+    NES_Hash rom_hash;
+    /// the input of each frame (port 0 and port 1 interleaved)
+    std::vector<NES_Byte> inputs;
+    /// the state before frames 0, N, 2N, ... back to back
+    std::vector<NES_Byte> keyframes;
+
+ public:
+    /// Initialize a new empty movie.
+    ///
+    /// @param keyframe_interval the number of frames between keyframes
+    /// @param state_size the size of a keyframe in bytes
+    /// @param rom_hash the hash of the ROM the movie is recorded on
+    ///
+    Movie(int keyframe_interval, std::size_t state_size, NES_Hash rom_hash) :
+        keyframe_interval(keyframe_interval < 1 ? 1 : keyframe_interval),
+        state_size(state_size),
+        rom_hash(rom_hash) { }
+
+    /// Return the number of frames between keyframes.
+    inline int get_keyframe_interval() const { return keyframe_interval; }
+
+    /// Return the hash of the ROM the movie was recorded on.
+    inline NES_Hash get_rom_hash() const { return rom_hash; }
+
+    /// Return the number of recorded frames.
+    inline int get_num_frames() const { return inputs.size() / 2; }
+
+    /// Return the number of keyframes.
+    inline int get_num_keyframes() const {
+        return state_size ? keyframes.size() / state_size : 0;
+    }
+
+    /// Return a pointer to the input of the first frame (two bytes a frame).
+    inline const NES_Byte* get_inputs() const { return inputs.data(); }
+
+    /// Return true if the next recorded frame needs a keyframe before it.
+    inline bool needs_keyframe() const {
+        return get_num_frames() == get_num_keyframes() * keyframe_interval;
+    }
+
+    /// Append a keyframe and return a pointer to its state_size bytes.
+    inline NES_Byte* add_keyframe() {
+        keyframes.resize(keyframes.size() + state_size);
+        return &keyframes[keyframes.size() - state_size];
+    }
+
+    /// Return a keyframe.
+    ///
+    /// @param index the index of the keyframe (the state before frame
+    /// index * keyframe_interval)
+    /// @return a pointer to the state_size bytes of the keyframe
+    ///
+    inline const NES_Byte* get_keyframe(int index) const {
+        return &keyframes[index * state_size];
+    }
+
+    /// Discard every keyframe after the first (i.e., to rebuild them).
+    inline void clear_keyframes() {
+        keyframes.resize(std::min(keyframes.size(), state_size));
+    }
+
+    /// Append the input of a frame.
+    ///
+    /// @param port0 the controller byte of port 0
+    /// @param port1 the controller byte of port 1
+    ///
+    inline void record(NES_Byte port0, NES_Byte port1) {
+        inputs.push_back(port0);
+        inputs.push_back(port1);
+    }
+
+    /// Write the movie to a file. The input is run-length encoded, so a
+    /// movie without keyframes (save only the first) is a few bytes per
+    /// change of input.
+    ///
+    /// @param path the path of the file to write
+    /// @param has_keyframes whether to write every keyframe instead of only
+    /// the first (the rest are rebuilt on load)
+    /// @return true if the file was written, false otherwise
+    ///
+    bool save(const std::string& path, bool has_keyframes) const;
+
+    /// Read a movie from a file.
+    ///
+    /// @param path the path of the file to read
+    /// @return true if the file is a valid movie for the same state size,
+    /// false otherwise (the movie is unchanged)
+    ///
+    bool load(const std::string& path);
+};
+
+}  // namespace NES
+
+#endif  // MOVIE_HPP
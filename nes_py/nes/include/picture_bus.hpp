@@ -12,6 +12,7 @@
 #include <cstdlib>
 #include "common.hpp"
 #include "mapper.hpp"
+#include "state.hpp"
 
 namespace NES {
 
@@ -20,6 +21,8 @@ class PictureBus {
  private:
     /// the VRAM on the picture bus
     std::vector<NES_Byte> ram;
+    /// the write tracking for the VRAM
+    StateRegion ram_region;
     /// indexes where they start in RAM vector
     std::size_t name_tables[4] = {0, 0, 0, 0};
     /// the palette for decoding RGB tuples
@@ -66,6 +69,12 @@ class PictureBus {
 
     /// Update the mirroring and name table from the mapper.
     void update_mirroring();
+
+    /// Visit the VRAM, palette, and name table layout on the bus.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
@@ -10,6 +10,7 @@
 
 #include "common.hpp"
 #include "picture_bus.hpp"
+#include "state.hpp"
 
 namespace NES {
 
@@ -182,6 +183,18 @@ class PPU {
 
     /// Return a pointer to the screen buffer.
     inline NES_Pixel* get_screen_buffer() { return *screen; }
+
+    /// Return true if background or sprite rendering is enabled.
+    inline bool is_rendering() const {
+        return is_showing_background || is_showing_sprites;
+    }
+
+    /// Visit the registers, flags, and OAM memory of the PPU. The screen is
+    /// an output of the PPU and is not part of the visited state.
+    ///
+    /// @param visit the visitor to apply to each field of the state
+    ///
+    void visit_state(StateVisitor& visit);
 };
 
 }  // namespace NES
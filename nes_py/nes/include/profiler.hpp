@@ -0,0 +1,143 @@
+//  Program:      nes-py
+//  File:         profiler.hpp
+//  Description:  A profiler for the 6502 code running on the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+#include "mapper.hpp"
+
+namespace NES {
+
+/// A profiler that attributes the cycles of executed instructions to their
+/// program counter (qualified by the PRG bank) and to the stack of routines
+/// that are running, which is tracked from JSR, RTS, RTI, and interrupts.
+class Profiler {
+ private:
+    /// The maximal depth of the tracked routine stack
+    static const std::size_t MAX_DEPTH = 64;
+    /// The flag on a routine label for an interrupt handler
+    static const uint32_t INTERRUPT_LABEL = 1 << 24;
+
+    /// The executions of a bank-qualified program counter
+    struct Count {
+        /// the number of instructions executed
+        uint64_t instructions = 0;
+        /// the number of cycles the instructions took
+        uint64_t cycles = 0;
+    };
+
+    /// A node in the tree of routine stacks
+    struct Node {
+        /// the index of the calling node (the root is its own parent)
+        uint32_t parent;
+        /// the bank-qualified address of the routine
+        uint32_t label;
+        /// the number of cycles spent in the routine (excluding callees)
+        uint64_t cycles;
+    };
+
+    /// A routine on the tracked stack
+    struct Frame {
+        /// the index of the node of the routine in the tree
+        uint32_t node;
+        /// the stack pointer of the CPU before the routine was entered
+        NES_Byte stack_pointer;
+    };
+
+    /// the mapper to look up PRG banks from
+    Mapper* mapper;
+    /// a map of bank-qualified program counters to executions
+    std::unordered_map<uint32_t, Count> counts;
+    /// the tree of routine stacks (the first node is the root)
+    std::vector<Node> nodes;
+    /// a map of (parent, label) keys to the index of the child node
+    std::unordered_map<uint64_t, uint32_t> children;
+    /// the stack of routines that are currently running
+    std::vector<Frame> stack;
+
+    /// Return the bank-qualified label of an address.
+    inline uint32_t get_label(NES_Address address) {
+        // code in RAM or SRAM has no bank, mark it with bank 0xff
+        int bank = address < 0x8000 ? 0xff : mapper->getPRGBank(address) & 0xff;
+        return bank << 16 | address;
+    }
+
+    /// Push a routine onto the tracked stack.
+    ///
+    /// @param label the bank-qualified address of the routine
+    /// @param stack_pointer the stack pointer before the routine was entered
+    ///
+    void push(uint32_t label, NES_Byte stack_pointer);
+
+    /// Return the printable name of a routine label.
+    static std::string get_name(uint32_t label);
+
+ public:
+    /// Initialize a new profiler.
+    ///
+    /// @param mapper the mapper of the cartridge to look up PRG banks from
+    ///
+    explicit Profiler(Mapper* mapper);
+
+    /// Clear all samples and the tracked stack.
+    void reset();
+
+    /// Record an executed instruction.
+    ///
+    /// @param pc the address of the instruction
+    /// @param opcode the opcode of the instruction
+    /// @param cycles the number of cycles the instruction took
+    /// @param next_pc the program counter after the instruction
+    /// @param stack_pointer the stack pointer after the instruction
+    ///
+    inline void record(
+        NES_Address pc,
+        NES_Byte opcode,
+        int cycles,
+        NES_Address next_pc,
+        NES_Byte stack_pointer
+    ) {
+        Count& count = counts[get_label(pc)];
+        count.instructions++;
+        count.cycles += cycles;
+        nodes[stack.empty() ? 0 : stack.back().node].cycles += cycles;
+        if (opcode == 0x20)  // JSR, the return address was pushed
+            push(get_label(next_pc), stack_pointer + 2);
+        else if (opcode == 0x60 || opcode == 0x40)  // RTS, RTI
+            // pop every routine entered at or below the current stack level
+            // so routines that discard their return address are also popped
+            while (!stack.empty() && stack.back().stack_pointer <= stack_pointer)
+                stack.pop_back();
+    }
+
+    /// Record an interrupt.
+    ///
+    /// @param handler the address of the interrupt handler
+    /// @param stack_pointer the stack pointer after the interrupt
+    ///
+    inline void interrupt(NES_Address handler, NES_Byte stack_pointer) {
+        push(get_label(handler) | INTERRUPT_LABEL, stack_pointer + 3);
+    }
+
+    /// Write the samples to a file.
+    ///
+    /// @param path the path of the file to write
+    /// @param is_folded whether to write folded stacks (one line per stack
+    /// of routines with its cycles, for flame graphs) instead of a flat
+    /// histogram of program counters sorted by cycles
+    /// @return true if the file was written, false otherwise
+    ///
+    bool dump(const std::string& path, bool is_folded) const;
+};
+
+}  // namespace NES
+
+#endif  // PROFILER_HPP
@@ -0,0 +1,99 @@
+//  Program:      nes-py
+//  File:         ram_policy.hpp
+//  Description:  Tiny tabular and linear policies over RAM features
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef RAM_POLICY_HPP
+#define RAM_POLICY_HPP
+
+#include <vector>
+#include "common.hpp"
+
+namespace NES {
+
+/// The maximal number of bits in the index of a tabular policy
+const int RAM_POLICY_MAX_TABLE_BITS = 20;
+/// The maximal number of actions of a policy
+const int RAM_POLICY_MAX_ACTIONS = 256;
+
+/// The kinds of RAM policies
+enum RAMPolicyKind {
+    /// scores are an affine map of the features scaled to [0, 1]; the
+    /// weights are a row of (features..., bias) per action
+    RAM_POLICY_LINEAR,
+    /// scores are a row of a table indexed by the concatenated high bits of
+    /// the features; the weights are a row of scores per action per index
+    RAM_POLICY_TABULAR,
+    /// the number of kinds of policies
+    RAM_POLICY_NUM_KINDS,
+};
+
+/// A policy that selects a controller byte from an action table by the
+/// highest score over a set of RAM bytes. Policies are small enough to run
+/// every frame natively, so whole episodes run without calls into Python.
+class RAMPolicy {
+ private:
+    /// the kind of the policy (a RAMPolicyKind)
+    int kind;
+    /// the RAM addresses of the features
+    std::vector<NES_Address> addresses;
+    /// the number of low bits to drop from each feature (tabular only)
+    std::vector<int> shifts;
+    /// the weights of the policy
+    std::vector<double> weights;
+    /// the controller byte of each action
+    std::vector<NES_Byte> actions;
+
+ public:
+    /// Initialize a new empty policy.
+    RAMPolicy() : kind(RAM_POLICY_LINEAR) { }
+
+    /// Validate and load a policy, and return true if the policy is valid.
+    ///
+    /// @param kind the kind of the policy (a RAMPolicyKind)
+    /// @param addresses the RAM address of each feature
+    /// @param shifts the number of low bits to drop from each feature, only
+    /// used by tabular policies (nullptr for none)
+    /// @param num_features the number of features
+    /// @param weights the weights of the policy (get_num_weights() values)
+    /// @param num_weights the number of weights
+    /// @param actions the controller byte of each action
+    /// @param num_actions the number of actions
+    /// @return true if the policy loaded, false if it is invalid (leaving
+    /// the policy unchanged)
+    ///
+    bool load(
+        int kind,
+        const int32_t* addresses,
+        const int32_t* shifts,
+        int num_features,
+        const double* weights,
+        int num_weights,
+        const NES_Byte* actions,
+        int num_actions
+    );
+
+    /// Return the number of weights of the policy.
+    std::size_t get_num_weights() const;
+
+    /// Replace the weights of the policy (i.e., a member of a population).
+    ///
+    /// @param weights the get_num_weights() new weights
+    ///
+    inline void set_weights(const double* weights) {
+        this->weights.assign(weights, weights + this->weights.size());
+    }
+
+    /// Return the controller byte that the policy selects for a RAM.
+    ///
+    /// @param ram the 2KB RAM of the emulator
+    /// @return the controller byte of the action with the highest score
+    ///
+    NES_Byte act(const NES_Byte* ram) const;
+};
+
+}  // namespace NES
+
+#endif  // RAM_POLICY_HPP
@@ -0,0 +1,162 @@
+//  Program:      nes-py
+//  File:         ram_program.hpp
+//  Description:  A bytecode interpreter for RAM-derived rewards and flags
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef RAM_PROGRAM_HPP
+#define RAM_PROGRAM_HPP
+
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+/// The number of info values a RAM program can output
+const int RAM_PROGRAM_INFO_SIZE = 16;
+/// The maximal depth of the value stack of a RAM program
+const int RAM_PROGRAM_STACK_SIZE = 32;
+/// The maximal number of addresses in a multi-byte load
+const int RAM_PROGRAM_MAX_BYTES = 8;
+
+/// The operations of the RAM program bytecode. Values are evaluated on a
+/// stack of doubles; the operands of an operation follow it in the code.
+enum RAMOperation {
+    /// push constants[k] (operands: k)
+    RAM_CONSTANT,
+    /// push a RAM byte (operands: address)
+    RAM_BYTE,
+    /// push a little-endian unsigned integer (operands: n, addresses...)
+    RAM_UNSIGNED,
+    /// push decimal digits stored one per byte, most significant first
+    /// (operands: n, addresses...)
+    RAM_DIGITS,
+    /// push packed binary-coded decimal, most significant byte first
+    /// (operands: n, addresses...)
+    RAM_BCD,
+    /// replace the top with its change since the last evaluation
+    /// (operands: slot)
+    RAM_DELTA,
+    /// binary arithmetic and comparisons on the top two values
+    RAM_ADD,
+    RAM_SUBTRACT,
+    RAM_MULTIPLY,
+    RAM_DIVIDE,
+    RAM_MINIMUM,
+    RAM_MAXIMUM,
+    RAM_EQUAL,
+    RAM_NOT_EQUAL,
+    RAM_LESS,
+    RAM_LESS_EQUAL,
+    RAM_GREATER,
+    RAM_GREATER_EQUAL,
+    RAM_AND,
+    RAM_OR,
+    RAM_BIT_AND,
+    /// unary operations on the top value
+    RAM_NEGATE,
+    RAM_ABSOLUTE,
+    RAM_NOT,
+    /// pop the top into the reward of the result
+    RAM_STORE_REWARD,
+    /// pop the top into the done flag of the result
+    RAM_STORE_DONE,
+    /// pop the top into an info value of the result (operands: index)
+    RAM_STORE_INFO,
+    /// the number of operations (not an operation)
+    RAM_NUM_OPERATIONS,
+};
+
+/// The outputs of a RAM program after an evaluation
+struct RAMProgramResult {
+    /// the reward for the frame
+    double reward;
+    /// whether the episode is over (non-zero for true)
+    double done;
+    /// auxiliary values for the frame
+    double info[RAM_PROGRAM_INFO_SIZE];
+};
+
+/// A compiled program that computes a reward, done flag, and info values
+/// from the RAM of the emulator.
+class RAMProgram {
+ private:
+    /// the bytecode of the program
+    std::vector<int32_t> code;
+    /// the constants referenced by the program
+    std::vector<double> constants;
+    /// the previous value of each delta slot
+    std::vector<double> memory;
+    /// the outputs of the last evaluation
+    RAMProgramResult result;
+
+    /// Run the program over the given RAM.
+    ///
+    /// @param ram a pointer to the 2KB RAM of the NES
+    /// @param is_priming whether to only record the values of delta slots
+    ///
+    void run(const NES_Byte* ram, bool is_priming);
+
+ public:
+    /// Initialize a new empty RAM program.
+    RAMProgram() : result() { }
+
+    /// Load new bytecode into the program.
+    ///
+    /// @param code the bytecode of the program
+    /// @param code_length the number of words in the bytecode
+    /// @param constants the constants referenced by the bytecode
+    /// @param num_constants the number of constants
+    /// @return true if the bytecode is valid and was loaded, false otherwise
+    ///
+    bool load(
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants
+    );
+
+    /// Return true if the program has no bytecode, false otherwise.
+    inline bool is_empty() const { return code.empty(); }
+
+    /// Record the current value of each delta slot and clear the result.
+    ///
+    /// @param ram a pointer to the 2KB RAM of the NES
+    ///
+    inline void reset(const NES_Byte* ram) { run(ram, true); }
+
+    /// Evaluate the program and update the result.
+    ///
+    /// @param ram a pointer to the 2KB RAM of the NES
+    ///
+    inline void evaluate(const NES_Byte* ram) { run(ram, false); }
+
+    /// Return a pointer to the outputs of the last evaluation.
+    inline RAMProgramResult* get_result() { return &result; }
+
+    /// Return a pointer to the outputs of the last evaluation.
+    inline const RAMProgramResult* get_result() const { return &result; }
+
+    /// Return the number of delta slots of the program.
+    inline std::size_t get_memory_size() const { return memory.size(); }
+
+    /// Return a pointer to the previous value of each delta slot.
+    inline const double* get_memory() const { return memory.data(); }
+
+    /// Restore the delta values and the outputs of an evaluation.
+    ///
+    /// @param memory the previous value of each delta slot
+    /// @param result the outputs of the evaluation
+    ///
+    void restore(const double* memory, const RAMProgramResult& result);
+
+    /// Return a hash of the bytecode, constants, and delta values, i.e.,
+    /// of everything besides the RAM that the next evaluation depends on.
+    NES_Hash get_hash() const;
+};
+
+}  // namespace NES
+
+#endif  // RAM_PROGRAM_HPP
@@ -0,0 +1,100 @@
+//  Program:      nes-py
+//  File:         rewind.hpp
+//  Description:  A ring buffer of recent delta-compressed machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef REWIND_HPP
+#define REWIND_HPP
+
+#include <deque>
+#include <vector>
+#include "common.hpp"
+
+namespace NES {
+
+/// A ring buffer of the machine state every k frames. Only the newest state
+/// is stored in full; every older state is stored as the run-length encoded
+/// XOR of itself and the next newer state, so consecutive states that share
+/// most of their bytes cost a few hundred bytes each. The encoded states are
+/// written to a preallocated pool and the oldest are dropped when it fills.
+class RewindBuffer {
+ private:
+    /// An older state in the pool
+    struct Entry {
+        /// the offset of the encoded delta in the pool
+        std::size_t offset;
+        /// the length of the encoded delta in bytes
+        std::size_t length;
+        /// the frame the state was captured after
+        int64_t frame;
+    };
+
+    /// the number of frames between captures
+    int interval;
+    /// the preallocated pool of encoded deltas
+    std::vector<NES_Byte> pool;
+    /// the offset in the pool to write the next delta to
+    std::size_t head;
+    /// the older states, oldest first
+    std::deque<Entry> entries;
+    /// the newest captured state
+    std::vector<NES_Byte> latest;
+    /// the frame the newest state was captured after
+    int64_t latest_frame;
+    /// the state being captured
+    std::vector<NES_Byte> capture;
+    /// a scratch buffer for encoding a delta
+    std::vector<NES_Byte> delta;
+    /// the number of frames since the buffer was created (or rewound to)
+    int64_t frame;
+
+    /// Write an encoded delta to the pool, dropping the oldest entries
+    /// that it overwrites.
+    ///
+    /// @param frame the frame of the state the delta decodes to
+    ///
+    void push(int64_t frame);
+
+ public:
+    /// Initialize a new rewind buffer.
+    ///
+    /// @param interval the number of frames between captures
+    /// @param state_size the size of the machine state in bytes
+    /// @param max_bytes the size of the pool of older states in bytes
+    ///
+    RewindBuffer(int interval, std::size_t state_size, std::size_t max_bytes);
+
+    /// Return the buffer to write the first state to (before any frame).
+    inline NES_Byte* get_latest() { return latest.data(); }
+
+    /// Count a frame and return true if its state should be captured.
+    inline bool advance() { return ++frame % interval == 0; }
+
+    /// Return the buffer to write the state of the current frame to.
+    inline NES_Byte* get_capture() { return capture.data(); }
+
+    /// Make the captured state the newest one.
+    void commit();
+
+    /// Return the number of states in the buffer (including the newest).
+    inline std::size_t get_num_states() const { return entries.size() + 1; }
+
+    /// Return the number of bytes of the pool in use.
+    std::size_t get_used_bytes() const;
+
+    /// Discard every state newer than a number of frames back.
+    ///
+    /// @param frames_back the number of frames to go back
+    /// @param state an output for the state to rewind to
+    /// @return the number of frames actually rewound, which is less than
+    /// requested if the buffer does not go back far enough and is rounded
+    /// up to a captured frame otherwise
+    ///
+    int64_t rewind(int64_t frames_back, NES_Byte* state);
+};
+
+}  // namespace NES
+
+#endif  // REWIND_HPP
@@ -0,0 +1,65 @@
+//  Program:      nes-py
+//  File:         screen_runs.hpp
+//  Description:  Run-length encoding of screens for stored frames
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef SCREEN_RUNS_HPP
+#define SCREEN_RUNS_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include "common.hpp"
+
+namespace NES {
+
+// A screen is encoded as runs of equal pixels, each a pair of NES_Pixels
+// (the length of the run, then its pixel). The backgrounds of NES games are
+// flat tiles, so a screen of 61440 pixels is typically a few thousand runs.
+
+/// Return the number of runs of equal pixels in a screen.
+///
+/// @param screen the pixels of the screen
+/// @param num_pixels the number of pixels in the screen
+/// @return the number of runs to encode the screen with
+///
+inline std::size_t count_screen_runs(const NES_Pixel* screen, std::size_t num_pixels) {
+    std::size_t num_runs = 0;
+    for (std::size_t pixel = 0; pixel < num_pixels; pixel++)
+        num_runs += pixel == 0 || screen[pixel] != screen[pixel - 1];
+    return num_runs;
+}
+
+/// Encode a screen as runs of equal pixels.
+///
+/// @param screen the pixels of the screen
+/// @param num_pixels the number of pixels in the screen
+/// @param runs an output for 2 * count_screen_runs(screen) NES_Pixels
+///
+inline void encode_screen_runs(const NES_Pixel* screen, std::size_t num_pixels, NES_Pixel* runs) {
+    NES_Pixel* run = runs - 2;
+    for (std::size_t pixel = 0; pixel < num_pixels; pixel++) {
+        if (pixel == 0 || screen[pixel] != screen[pixel - 1]) {
+            run += 2;
+            run[0] = 0;
+            run[1] = screen[pixel];
+        }
+        run[0]++;
+    }
+}
+
+/// Decode runs of equal pixels into a screen.
+///
+/// @param runs the runs from encode_screen_runs
+/// @param num_runs the number of runs
+/// @param screen an output for the pixels of the screen
+///
+inline void decode_screen_runs(const NES_Pixel* runs, std::size_t num_runs, NES_Pixel* screen) {
+    for (std::size_t run = 0; run < num_runs; run++, runs += 2)
+        screen = std::fill_n(screen, runs[0], runs[1]);
+}
+
+}  // namespace NES
+
+#endif  // SCREEN_RUNS_HPP
@@ -0,0 +1,63 @@
+//  Program:      nes-py
+//  File:         sequence_trie.hpp
+//  Description:  A prefix trie over a batch of open-loop action sequences
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef SEQUENCE_TRIE_HPP
+#define SEQUENCE_TRIE_HPP
+
+#include <vector>
+#include "common.hpp"
+
+namespace NES {
+
+/// A prefix trie over a batch of open-loop action sequences. Each edge is
+/// one frame of one controller byte, so sequences that share a prefix share
+/// the edges (and the emulation) of the prefix.
+class SequenceTrie {
+ public:
+    /// A node in the trie, i.e., the state after a prefix of actions
+    struct Node {
+        /// the action on the edge into the node
+        NES_Byte action;
+        /// the number of frames from the root to the node
+        int depth;
+        /// the indexes of the child nodes
+        std::vector<uint32_t> children;
+        /// the indexes of the sequences that end at the node
+        std::vector<uint32_t> sequences;
+    };
+
+ private:
+    /// the nodes of the trie (the first node is the root)
+    std::vector<Node> nodes;
+
+ public:
+    /// Build a trie from a batch of sequences.
+    ///
+    /// @param actions the actions of all sequences back to back
+    /// @param lengths the number of actions in each sequence
+    /// @param num_sequences the number of sequences
+    ///
+    SequenceTrie(const NES_Byte* actions, const int* lengths, int num_sequences);
+
+    /// Return a node of the trie.
+    inline const Node& operator[](uint32_t index) const { return nodes[index]; }
+
+    /// Return the number of edges in the trie, i.e., the number of frames to
+    /// emulate to evaluate every sequence.
+    inline std::size_t get_num_edges() const { return nodes.size() - 1; }
+
+    /// Append the sequences that end in the subtree of a node.
+    ///
+    /// @param index the index of the root of the subtree
+    /// @param sequences the vector to append the indexes of sequences to
+    ///
+    void collect(uint32_t index, std::vector<uint32_t>& sequences) const;
+};
+
+}  // namespace NES
+
+#endif  // SEQUENCE_TRIE_HPP
@@ -0,0 +1,189 @@
+//  Program:      nes-py
+//  File:         shm_channel.hpp
+//  Description:  An environment server over a POSIX shared memory segment
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef SHM_CHANNEL_HPP
+#define SHM_CHANNEL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "common.hpp"
+#include "emulator.hpp"
+
+namespace NES {
+
+/// the magic string at the start of a channel segment
+static const char SHM_MAGIC[8] = {'N', 'E', 'S', 'S', 'H', 'M', 0, 0};
+/// the version of the layout of a channel segment
+static const uint32_t SHM_VERSION = 1;
+
+/// The commands a client sends to the server of a channel
+enum ShmCommand : uint32_t {
+    /// reset the emulator (or restore its backup) and reset its RAM program
+    SHM_RESET = 0,
+    /// hold an action for a number of frames
+    SHM_STEP,
+};
+
+/// A request in the ring from the client to the server
+struct ShmRequest {
+    /// the command to run (a ShmCommand)
+    uint32_t command;
+    /// the number of frames to hold the action for
+    uint32_t frames;
+    /// the controller byte for port 0
+    NES_Byte action;
+};
+
+/// A response in the ring from the server to the client
+struct ShmResponse {
+    /// the result of the RAM program of the emulator after the request
+    RAMProgramResult result;
+    /// the screen after the request
+    NES_Pixel screen[Emulator::WIDTH * Emulator::HEIGHT];
+    /// the RAM after the request
+    NES_Byte ram[0x800];
+};
+
+/// The counters of a lock-free single-producer single-consumer ring. Each
+/// counter is a futex word that the other side sleeps on.
+struct ShmRing {
+    /// the number of items the producer published
+    alignas(64) std::atomic<uint32_t> head;
+    /// the number of items the consumer released
+    alignas(64) std::atomic<uint32_t> tail;
+};
+
+/// The header at the start of a channel segment, followed by the request
+/// slots and the (64-byte aligned) response slots.
+struct ShmHeader {
+    /// the magic string SHM_MAGIC
+    char magic[8];
+    /// the version SHM_VERSION
+    uint32_t version;
+    /// the number of slots in each ring
+    uint32_t num_slots;
+    /// the size of a response slot in bytes
+    uint32_t response_size;
+    /// whether the server closed the channel (non-zero for true)
+    alignas(64) std::atomic<uint32_t> is_closed;
+    /// the ring of requests from the client
+    ShmRing requests;
+    /// the ring of responses from the server
+    ShmRing responses;
+};
+
+/// A server that runs an emulator for one client over a shared memory
+/// segment. A thread of the server sleeps until the client publishes a
+/// request, runs it, and publishes the screen, RAM, and RAM program result
+/// to the next response slot, so no data is serialized or copied through a
+/// pipe.
+class ShmServer {
+ private:
+    /// the emulator to serve (not owned)
+    Emulator* emulator;
+    /// whether a reset restores the backup of the emulator
+    bool is_reset_to_backup;
+    /// the name of the shared memory segment
+    std::string name;
+    /// the mapping of the segment (nullptr before open)
+    void* memory;
+    /// the size of the segment in bytes
+    std::size_t size;
+    /// the thread that serves the requests of the client
+    std::thread server;
+
+    /// The main loop of the server thread.
+    void serve();
+
+ public:
+    /// Initialize a new server.
+    ///
+    /// @param emulator the emulator to serve (the caller must not use it
+    /// until the server is deleted)
+    /// @param is_reset_to_backup whether a reset restores the backup of the
+    /// emulator instead of resetting the machine
+    ///
+    ShmServer(Emulator* emulator, bool is_reset_to_backup) :
+        emulator(emulator),
+        is_reset_to_backup(is_reset_to_backup),
+        memory(nullptr),
+        size(0) { }
+
+    /// Close the channel, stop the server thread, and remove the segment.
+    ~ShmServer();
+
+    /// Create the shared memory segment and start serving it.
+    ///
+    /// @param name the name of the segment (i.e., "/nes-0")
+    /// @param num_slots the number of slots in each ring
+    /// @return true if the segment was created, false otherwise (i.e., the
+    /// name is in use or the platform has no POSIX shared memory)
+    ///
+    bool open(const std::string& name, uint32_t num_slots);
+};
+
+/// The client side of a shared memory channel.
+class ShmClient {
+ private:
+    /// the mapping of the segment (nullptr before connect)
+    void* memory;
+    /// the size of the segment in bytes
+    std::size_t size;
+    /// whether the client holds the oldest published response
+    bool is_holding;
+
+    /// Return the header of the segment.
+    inline ShmHeader* get_header() { return static_cast<ShmHeader*>(memory); }
+
+ public:
+    /// Initialize a new unconnected client.
+    ShmClient() : memory(nullptr), size(0), is_holding(false) { }
+
+    /// Unmap the segment.
+    ~ShmClient();
+
+    /// Map the shared memory segment of a server.
+    ///
+    /// @param name the name the server opened the segment with
+    /// @return true if the segment is a channel of this version, false
+    /// otherwise
+    ///
+    bool connect(const std::string& name);
+
+    /// Return the number of slots in each ring.
+    inline uint32_t get_num_slots() { return get_header()->num_slots; }
+
+    /// Return a response slot.
+    ///
+    /// @param index the index of the slot in [0, num_slots)
+    /// @return a pointer to the response in the slot
+    ///
+    const ShmResponse* get_slot(uint32_t index);
+
+    /// Publish a request, waiting while the request ring is full. At most
+    /// num_slots requests may be in flight before receiving a response.
+    ///
+    /// @param command the command to run (a ShmCommand)
+    /// @param action the controller byte for port 0
+    /// @param frames the number of frames to hold the action for
+    /// @return true if the request was published, false if the server closed
+    ///
+    bool send(uint32_t command, NES_Byte action, uint32_t frames);
+
+    /// Release the last received response and wait for the next one.
+    ///
+    /// @return the slot of the response (valid until the next receive), or
+    /// -1 if the server closed
+    ///
+    int receive();
+};
+
+}  // namespace NES
+
+#endif  // SHM_CHANNEL_HPP
@@ -0,0 +1,160 @@
+//  Program:      nes-py
+//  File:         socket_server.hpp
+//  Description:  A server for batches of emulators over a stream socket
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef SOCKET_SERVER_HPP
+#define SOCKET_SERVER_HPP
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+#include "emulator.hpp"
+
+namespace NES {
+
+/// The opcodes of the requests to a socket server. Every message on the
+/// socket is a little-endian uint32 length followed by that many bytes:
+/// a request is (uint32 id, uint8 opcode, payload) and its response is
+/// (uint32 id, uint8 status, payload) with a status of 0 for success.
+///
+/// - INFO: no payload, responds (uint32 num_envs, width, height,
+///   state_size, info_size)
+/// - RESET: (uint8 outputs) resets every emulator and its RAM program,
+///   responds with the outputs
+/// - STEP: (uint8 outputs, uint32 frames, uint8 action per emulator),
+///   responds with the outputs
+/// - SAVE: (uint32 index), responds with the state of the emulator
+/// - LOAD: (uint32 index, state), no response payload (an error if a
+///   field of the state is out of range)
+/// - PROGRAM: (uint32 code_length, int32 code..., uint32 num_constants,
+///   double constants...) sets the RAM program of every emulator
+///
+/// The outputs of a reset or step are the RAMProgramResult of each
+/// emulator, then the screen of each emulator (if outputs & SCREENS), then
+/// the RAM of each emulator (if outputs & RAM).
+enum SocketOpcode : uint8_t {
+    SOCKET_INFO = 0,
+    SOCKET_RESET,
+    SOCKET_STEP,
+    SOCKET_SAVE,
+    SOCKET_LOAD,
+    SOCKET_PROGRAM,
+};
+
+/// The flags of the outputs of a reset or step
+enum SocketOutputs : uint8_t {
+    SOCKET_SCREENS = 1,
+    SOCKET_RAM = 2,
+};
+
+/// the largest request a socket server accepts in bytes
+static const uint32_t SOCKET_MAX_REQUEST = 64 << 20;
+
+/// A server that runs requests for a batch of emulators from clients of a
+/// TCP or Unix stream socket. Clients are served one at a time and may
+/// pipeline requests (send many before reading responses); responses are
+/// written in request order, gathered straight from the screen and RAM
+/// buffers of the emulators.
+class SocketServer {
+ private:
+    /// the emulators of the batch (not owned)
+    std::vector<Emulator*> emulators;
+    /// whether a reset restores the backup of each emulator
+    std::vector<bool> is_reset_to_backup;
+    /// the listening socket (-1 before listen)
+    int listener;
+    /// the path of a Unix socket to remove on close (empty for TCP)
+    std::string unix_path;
+    /// the pipe that wakes the serving loop to stop
+    int wake[2];
+    /// the bytes of the request being read
+    std::vector<NES_Byte> request;
+    /// the bytes of the payload of the response being written
+    std::vector<NES_Byte> response;
+    /// the RAM program results of a reset or step
+    std::vector<RAMProgramResult> results;
+    /// the thread that serves in the background (after start)
+    std::thread background;
+
+    /// Serve the requests of a connected client until it disconnects.
+    ///
+    /// @param client the socket of the client
+    /// @return false if the server was stopped, true otherwise
+    ///
+    bool serve_client(int client);
+
+    /// Run a request and write its response.
+    ///
+    /// @param client the socket of the client
+    /// @param length the length of the request in bytes
+    /// @return true if the response was written, false otherwise
+    ///
+    bool handle(int client, std::size_t length);
+
+    /// Write a response that ends with the outputs of a reset or step.
+    ///
+    /// @param client the socket of the client
+    /// @param id the id of the request
+    /// @param outputs the flags of the outputs to write
+    /// @return true if the response was written, false otherwise
+    ///
+    bool write_outputs(int client, uint32_t id, uint8_t outputs);
+
+    /// Write a response with the payload in the response buffer.
+    ///
+    /// @param client the socket of the client
+    /// @param id the id of the request
+    /// @param status the status of the response (0 for success)
+    /// @return true if the response was written, false otherwise
+    ///
+    bool write_response(int client, uint32_t id, uint8_t status);
+
+ public:
+    /// Initialize a new server.
+    ///
+    /// @param emulators the emulators to serve (the caller must not use
+    /// them until the server is deleted)
+    /// @param is_reset_to_backup whether a reset restores the backup of
+    /// each emulator instead of resetting the machine
+    ///
+    SocketServer(const std::vector<Emulator*>& emulators, const std::vector<bool>& is_reset_to_backup);
+
+    /// Stop serving in the background and close the listening socket.
+    ~SocketServer();
+
+    /// Listen for clients on a TCP port.
+    ///
+    /// @param host the IPv4 address to bind (i.e., "127.0.0.1")
+    /// @param port the port to bind, or 0 for any free port
+    /// @return true if the socket is listening, false otherwise
+    ///
+    bool listen_tcp(const std::string& host, int port);
+
+    /// Listen for clients on a Unix socket.
+    ///
+    /// @param path the path of the socket file to create
+    /// @return true if the socket is listening, false otherwise
+    ///
+    bool listen_unix(const std::string& path);
+
+    /// Return the port of a TCP server (i.e., after binding port 0).
+    int get_port() const;
+
+    /// Accept and serve clients until stop is called.
+    void serve();
+
+    /// Make serve return after the current request (safe from any thread).
+    void stop();
+
+    /// Accept and serve clients on a background thread until deleted.
+    void start();
+};
+
+}  // namespace NES
+
+#endif  // SOCKET_SERVER_HPP
@@ -0,0 +1,154 @@
+//  Program:      nes-py
+//  File:         speculator.hpp
+//  Description:  Speculative emulation of likely next actions
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef SPECULATOR_HPP
+#define SPECULATOR_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+#include "ram_program.hpp"
+
+namespace NES {
+
+class Emulator;
+
+/// Speculative steps of an emulator. While the caller decides on its next
+/// action (i.e., runs a policy), clones of the current state step the most
+/// likely next actions on background threads. If the real action is one of
+/// them, its outcome is committed to the emulator instead of emulated. Each
+/// clone has a persistent thread of its own (rather than the shared thread
+/// pool) so a speculation neither blocks other parallel loops nor pays for
+/// creating a thread on every step.
+class Speculator {
+ public:
+    /// The outcome of one speculative action
+    struct Branch {
+        /// the controller byte the branch held
+        NES_Byte action;
+        /// the machine state after the branch
+        std::vector<NES_Byte> state;
+        /// the screen after the branch
+        std::vector<NES_Pixel> screen;
+        /// the RAM program after the branch (its result and delta values)
+        RAMProgram program;
+    };
+
+ private:
+    /// the path of the ROM to create clones from
+    std::string rom_path;
+    /// the emulators that run the branches
+    std::vector<std::unique_ptr<Emulator>> clones;
+    /// the branches of the running (or finished) speculation
+    std::vector<Branch> branches;
+    /// the number of branches in the speculation
+    std::size_t num_branches;
+    /// the number of frames each branch steps
+    int frames;
+    /// the state the branches start from
+    std::vector<NES_Byte> root;
+    /// the RAM program the branches start from
+    RAMProgram root_program;
+    /// the hash of the state the branches start from
+    NES_Hash root_hash;
+    /// the controller byte of port 1 the branches hold
+    NES_Byte second_controller;
+    /// the thread of each clone
+    std::vector<std::thread> workers;
+    /// the lock that guards the job counters and the shutdown flag
+    std::mutex lock;
+    /// the signal to workers that a speculation started (or they stop)
+    std::condition_variable job_posted;
+    /// the signal to the caller that a worker finished its branch
+    std::condition_variable job_finished;
+    /// a counter of started speculations so workers run each one once
+    uint64_t generation;
+    /// the number of branches that are still running
+    std::size_t num_busy;
+    /// whether the workers are shutting down
+    bool is_stopping;
+    /// whether a speculation was started and not yet waited for
+    bool is_running;
+    /// whether the branches should stop early
+    std::atomic<bool> is_cancelled;
+    /// the id of the process that started the threads
+    int owner;
+    /// the number of steps committed from a branch
+    uint64_t hits;
+    /// the number of steps that found no matching branch
+    uint64_t misses;
+
+    /// The main loop of the thread of a clone.
+    ///
+    /// @param index the index of the clone and of its branch
+    /// @param seen the generation the thread was created at
+    ///
+    void work(std::size_t index, uint64_t seen);
+
+    /// Run a branch on its clone.
+    ///
+    /// @param index the index of the branch
+    ///
+    void run(std::size_t index);
+
+    /// Wait for the branches of the running speculation to finish.
+    void wait();
+
+    /// Drop the threads inherited from a parent process after a fork.
+    void adopt();
+
+ public:
+    /// Initialize a new speculator.
+    ///
+    /// @param rom_path the path of the ROM of the emulator
+    ///
+    explicit Speculator(const std::string& rom_path);
+
+    /// Cancel the running speculation and join the threads.
+    ~Speculator();
+
+    /// Start speculating on the outcomes of actions from the current state
+    /// of an emulator (cancelling any running speculation). The emulator
+    /// can be used while the speculation runs.
+    ///
+    /// @param emulator the emulator to speculate on
+    /// @param actions the controller byte of each branch (most likely first)
+    /// @param num_actions the number of branches
+    /// @param frames the number of frames each branch steps
+    ///
+    void start(Emulator& emulator, const NES_Byte* actions, int num_actions, int frames);
+
+    /// Wait for the speculation and return the branch for a real step.
+    ///
+    /// @param emulator the emulator to step, which must still be in the
+    /// state the speculation started from (i.e., not loaded or written to)
+    /// @param frames the number of frames of the real step
+    /// @return the branch for the controllers of the emulator, or nullptr
+    /// if there is none (the speculation is consumed either way). A hit or
+    /// miss is only counted if a speculation was running.
+    ///
+    const Branch* finish(Emulator& emulator, int frames);
+
+    /// Stop and discard the running speculation.
+    void cancel();
+
+    /// Return the number of steps committed from a branch.
+    inline uint64_t get_hits() const { return hits; }
+
+    /// Return the number of steps that found no matching branch.
+    inline uint64_t get_misses() const { return misses; }
+};
+
+}  // namespace NES
+
+#endif  // SPECULATOR_HPP
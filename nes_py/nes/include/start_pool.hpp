@@ -0,0 +1,94 @@
+//  Program:      nes-py
+//  File:         start_pool.hpp
+//  Description:  A pool of start states for randomized resets
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef START_POOL_HPP
+#define START_POOL_HPP
+
+#include <random>
+#include <vector>
+#include "common.hpp"
+
+namespace NES {
+
+/// The return and length of episodes that a RAM program ends (must match
+/// EpisodeStats in nes_env.py)
+struct EpisodeStats {
+    /// the reward summed over the running episode
+    double episode_return;
+    /// the number of steps in the running episode
+    int64_t episode_length;
+    /// the return of the last finished episode
+    double final_return;
+    /// the number of steps in the last finished episode
+    int64_t final_length;
+    /// the number of finished episodes
+    int64_t num_episodes;
+};
+
+/// A pool of states to start episodes from. Each start is stored along with
+/// the states after 1 to max_noops frames of a no-op action, so a reset to a
+/// random start with a random number of no-ops loads a state and emulates
+/// no frames.
+class StartPool {
+ public:
+    /// A state to reset to
+    struct Start {
+        /// the machine state
+        std::vector<NES_Byte> state;
+        /// the screen as runs of equal pixels
+        std::vector<NES_Pixel> runs;
+    };
+
+ private:
+    /// the largest number of no-op frames after a start
+    int max_noops;
+    /// the controller byte of the no-op action
+    NES_Byte noop_action;
+    /// the starts, each followed by its no-op variants
+    std::vector<Start> starts;
+    /// the generator of random starts
+    std::mt19937_64 generator;
+
+ public:
+    /// Initialize a new empty pool.
+    ///
+    /// @param max_noops the largest number of no-op frames after a start
+    /// @param noop_action the controller byte of the no-op action
+    /// @param seed the seed of the generator of random starts
+    ///
+    StartPool(int max_noops, NES_Byte noop_action, uint64_t seed);
+
+    /// Return the largest number of no-op frames after a start.
+    inline int get_max_noops() const { return max_noops; }
+
+    /// Return the controller byte of the no-op action.
+    inline NES_Byte get_noop_action() const { return noop_action; }
+
+    /// Return the number of starts in the pool (without no-op variants).
+    inline std::size_t get_num_starts() const { return starts.size() / (max_noops + 1); }
+
+    /// Append a start or one of its no-op variants (in order of no-ops).
+    ///
+    /// @param state the machine state
+    /// @param state_size the size of the state in bytes
+    /// @param screen the screen of the state
+    ///
+    void add(const NES_Byte* state, std::size_t state_size, const NES_Pixel* screen);
+
+    /// Return a random start with a random number of no-ops.
+    ///
+    /// @return a start, or nullptr if the pool has no complete start
+    ///
+    const Start* sample();
+
+    /// Reseed the generator of random starts.
+    inline void seed(uint64_t seed) { generator.seed(seed); }
+};
+
+}  // namespace NES
+
+#endif  // START_POOL_HPP
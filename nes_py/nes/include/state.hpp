@@ -0,0 +1,204 @@
+//  Program:      nes-py
+//  File:         state.hpp
+//  Description:  Visitors over the machine state of the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef STATE_HPP
+#define STATE_HPP
+
+#include <cstddef>
+#include <cstring>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+/// A large block of memory in the machine state that tracks its own writes.
+/// The hash is cached until the owner marks the block as dirty, so blocks
+/// that rarely change (CHR RAM, extended RAM, VRAM) are not rehashed.
+struct StateRegion {
+    /// whether the memory has been written since the hash was computed
+    bool is_dirty = true;
+    /// the cached hash of the memory block
+    NES_Hash hash = 0;
+
+    /// Mark the memory block as written.
+    inline void touch() { is_dirty = true; }
+};
+
+/// An abstract visitor over the fields of the machine state. Each component
+/// of the emulator walks its state through a visitor so that operations over
+/// the whole machine (hashing, etc.) share a single definition of the state.
+class StateVisitor {
+ private:
+    /// whether every checked field of the state was in range
+    bool is_valid = true;
+
+ public:
+    virtual ~StateVisitor() { }
+
+    /// Visit a block of bytes in the machine state.
+    ///
+    /// @param data a pointer to the first byte of the block
+    /// @param length the number of bytes in the block
+    ///
+    virtual void bytes(void* data, std::size_t length) = 0;
+
+    /// Visit a block of bytes that tracks writes with a region.
+    ///
+    /// @param data a pointer to the first byte of the block
+    /// @param length the number of bytes in the block
+    /// @param region the write tracking structure for the block
+    ///
+    virtual void region(void* data, std::size_t length, StateRegion& region) = 0;
+
+    /// Visit a scalar value in the machine state.
+    ///
+    /// @param value the value to visit
+    ///
+    template<typename T>
+    inline void operator()(T& value) { bytes(&value, sizeof value); }
+
+    /// Check that a visited field holds a value in its range. A reader may
+    /// visit a buffer from outside the emulator, so each component checks
+    /// the fields it uses as indexes and replaces them if they are invalid.
+    ///
+    /// @param condition whether the visited fields are in range
+    /// @return the condition
+    ///
+    inline bool check(bool condition) {
+        is_valid = is_valid && condition;
+        return condition;
+    }
+
+    /// Return true if every checked field of the state was in range.
+    inline bool get_is_valid() const { return is_valid; }
+};
+
+/// A visitor that computes a 64-bit hash of the machine state.
+class StateHasher : public StateVisitor {
+ private:
+    /// the size of the buffer that batches small fields
+    static const std::size_t BUFFER_SIZE = 256;
+    /// a buffer of small fields waiting to be hashed together
+    NES_Byte buffer[BUFFER_SIZE];
+    /// the number of bytes in the buffer
+    std::size_t buffer_length;
+    /// the running hash value
+    NES_Hash hash;
+
+    /// Fold the buffered fields into the running hash.
+    inline void flush() {
+        if (buffer_length == 0) return;
+        hash = hash_combine(hash, hash_bytes(buffer, buffer_length));
+        buffer_length = 0;
+    }
+
+ public:
+    /// Initialize a new state hasher.
+    StateHasher() : buffer_length(0), hash(0) { }
+
+    /// Visit a block of bytes in the machine state.
+    void bytes(void* data, std::size_t length) override {
+        if (length > BUFFER_SIZE / 4) {
+            flush();
+            hash = hash_combine(hash, hash_bytes(data, length));
+            return;
+        }
+        if (buffer_length + length > BUFFER_SIZE) flush();
+        std::memcpy(buffer + buffer_length, data, length);
+        buffer_length += length;
+    }
+
+    /// Visit a block of bytes that tracks writes with a region.
+    void region(void* data, std::size_t length, StateRegion& region) override {
+        if (region.is_dirty) {
+            region.hash = hash_bytes(data, length);
+            region.is_dirty = false;
+        }
+        flush();
+        hash = hash_combine(hash, region.hash);
+    }
+
+    /// Return the hash of the visited state.
+    inline NES_Hash digest() { flush(); return hash; }
+};
+
+/// A visitor that counts the bytes of the machine state.
+class StateSizer : public StateVisitor {
+ private:
+    /// the number of bytes visited
+    std::size_t size;
+
+ public:
+    /// Initialize a new state sizer.
+    StateSizer() : size(0) { }
+
+    /// Visit a block of bytes in the machine state.
+    void bytes(void*, std::size_t length) override { size += length; }
+
+    /// Visit a block of bytes that tracks writes with a region.
+    void region(void*, std::size_t length, StateRegion&) override { size += length; }
+
+    /// Return the number of bytes in the visited state.
+    inline std::size_t get_size() const { return size; }
+};
+
+/// A visitor that serializes the machine state into a flat buffer. The
+/// buffer must hold at least as many bytes as a StateSizer counts.
+class StateWriter : public StateVisitor {
+ private:
+    /// the next byte of the buffer to write
+    NES_Byte* buffer;
+
+ public:
+    /// Initialize a new state writer.
+    ///
+    /// @param buffer the buffer to serialize the state into
+    ///
+    explicit StateWriter(NES_Byte* buffer) : buffer(buffer) { }
+
+    /// Visit a block of bytes in the machine state.
+    void bytes(void* data, std::size_t length) override {
+        std::memcpy(buffer, data, length);
+        buffer += length;
+    }
+
+    /// Visit a block of bytes that tracks writes with a region.
+    void region(void* data, std::size_t length, StateRegion&) override {
+        bytes(data, length);
+    }
+};
+
+/// A visitor that deserializes the machine state from a flat buffer that a
+/// StateWriter wrote on an emulator running the same ROM.
+class StateReader : public StateVisitor {
+ private:
+    /// the next byte of the buffer to read
+    const NES_Byte* buffer;
+
+ public:
+    /// Initialize a new state reader.
+    ///
+    /// @param buffer the buffer to deserialize the state from
+    ///
+    explicit StateReader(const NES_Byte* buffer) : buffer(buffer) { }
+
+    /// Visit a block of bytes in the machine state.
+    void bytes(void* data, std::size_t length) override {
+        std::memcpy(data, buffer, length);
+        buffer += length;
+    }
+
+    /// Visit a block of bytes that tracks writes with a region.
+    void region(void* data, std::size_t length, StateRegion& region) override {
+        bytes(data, length);
+        region.touch();
+    }
+};
+
+}  // namespace NES
+
+#endif  // STATE_HPP
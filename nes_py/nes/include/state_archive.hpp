@@ -0,0 +1,197 @@
+//  Program:      nes-py
+//  File:         state_archive.hpp
+//  Description:  A memory-mapped file of machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef STATE_ARCHIVE_HPP
+#define STATE_ARCHIVE_HPP
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+/// A committed version of an archive. The header has two commits that are
+/// written in turn, so a crash while writing one leaves the other intact.
+struct ArchiveCommit {
+    /// the number of the commit (0 if the slot was never written)
+    uint64_t sequence;
+    /// the offset of the index in the file
+    uint64_t index_offset;
+    /// the number of records in the index
+    uint64_t num_records;
+    /// the hash of the fields above (to detect a torn write)
+    uint64_t checksum;
+};
+
+/// The header of an archive file, followed by the records and the index
+struct ArchiveHeader {
+    /// the magic string "NESSTATE"
+    char magic[8];
+    /// the version of the format
+    uint32_t version;
+    /// the size of a machine state in bytes
+    uint32_t state_size;
+    /// the hash of the ROM the states are for
+    uint64_t rom_hash;
+    /// the two most recent commits
+    ArchiveCommit commits[2];
+};
+
+/// The flags of a record in an archive
+enum ArchiveFlags : uint32_t {
+    /// the record is a delta from the first record (otherwise a state)
+    ARCHIVE_DELTA = 1,
+};
+
+/// An entry of the index of an archive
+struct ArchiveEntry {
+    /// the offset of the record in the file
+    uint64_t offset;
+    /// the length of the record in bytes
+    uint32_t length;
+    /// the flags of the record (ArchiveFlags)
+    uint32_t flags;
+    /// the hash of the bytes of the record
+    uint64_t hash;
+};
+
+/// A read-only view of an archive of machine states. The file is mapped
+/// into memory and the index is read in place, so opening an archive costs
+/// the same for any number of records and only the pages of the records
+/// that are loaded become resident.
+class StateArchive {
+ private:
+    /// the mapped file (nullptr if not open)
+    const NES_Byte* memory;
+    /// the size of the mapped file in bytes
+    std::size_t size;
+    /// the header of the file
+    const ArchiveHeader* header;
+    /// the index of the committed records
+    const ArchiveEntry* entries;
+    /// the number of committed records
+    std::size_t num_records;
+
+ public:
+    /// Initialize a new closed archive.
+    StateArchive();
+
+    /// Unmap the file of the archive.
+    ~StateArchive();
+
+    /// Map an archive file.
+    ///
+    /// @param path the path of the file
+    /// @return true if the file is a valid archive, false otherwise
+    ///
+    bool open(const std::string& path);
+
+    /// Return the hash of the ROM the states are for.
+    inline NES_Hash get_rom_hash() const { return header->rom_hash; }
+
+    /// Return the size of a machine state in bytes.
+    inline std::size_t get_state_size() const { return header->state_size; }
+
+    /// Return the number of committed records.
+    inline std::size_t get_num_records() const { return num_records; }
+
+    /// Return a pointer to a state stored without compression.
+    ///
+    /// @param index the index of the record
+    /// @return the state in the mapped file, or nullptr if the record is
+    /// compressed or the index is out of range
+    ///
+    const NES_Byte* get_state(std::size_t index) const;
+
+    /// Copy (and decompress) a state.
+    ///
+    /// @param index the index of the record
+    /// @param output a buffer of get_state_size() bytes for the state
+    /// @return false if the index is out of range or the record is
+    /// malformed, true otherwise
+    ///
+    bool read(std::size_t index, NES_Byte* output) const;
+
+    /// Return true if the bytes of a record match the hash in its entry.
+    bool verify(std::size_t index) const;
+};
+
+/// A writer that appends states to an archive file. Records are written
+/// after the last committed index and a new index follows them on commit,
+/// so a crash before a commit finishes leaves the last commit readable.
+class StateArchiveWriter {
+ private:
+    /// the file descriptor of the archive (-1 if not open)
+    int descriptor;
+    /// the header of the file
+    ArchiveHeader header;
+    /// the index of the records
+    std::vector<ArchiveEntry> entries;
+    /// the number of entries in the last commit
+    std::size_t num_committed;
+    /// the sequence number of the last commit
+    uint64_t sequence;
+    /// the offset to write the next record to
+    uint64_t end;
+    /// the first state of the archive, which the others are deltas from
+    std::vector<NES_Byte> base;
+    /// whether to store states as deltas from the first state
+    bool is_compressing;
+    /// a scratch buffer for encoding a delta
+    std::vector<NES_Byte> delta;
+
+ public:
+    /// Initialize a new closed writer.
+    StateArchiveWriter();
+
+    /// Commit the appended records and close the file.
+    ~StateArchiveWriter();
+
+    /// Create an archive file, or open one to append to.
+    ///
+    /// @param path the path of the file
+    /// @param state_size the size of a machine state in bytes
+    /// @param rom_hash the hash of the ROM the states are for
+    /// @param is_compressing whether to store states as deltas from the
+    /// first state of the archive
+    /// @return false if the file exists and is not an archive for the same
+    /// ROM, or if another writer has it open, true otherwise
+    ///
+    bool open(
+        const std::string& path,
+        std::size_t state_size,
+        NES_Hash rom_hash,
+        bool is_compressing
+    );
+
+    /// Return the number of records, including those not yet committed.
+    inline std::size_t get_num_records() const { return entries.size(); }
+
+    /// Append a state to the archive (readable after the next commit).
+    ///
+    /// @param state the machine state to append
+    /// @return true if the state was written, false otherwise
+    ///
+    bool append(const NES_Byte* state);
+
+    /// Write the index and make the appended records durable.
+    ///
+    /// @return true if the commit is on disk, false otherwise
+    ///
+    bool commit();
+
+    /// Commit the appended records and close the file.
+    ///
+    /// @return true if the commit is on disk, false otherwise
+    ///
+    bool close();
+};
+
+}  // namespace NES
+
+#endif  // STATE_ARCHIVE_HPP
@@ -0,0 +1,92 @@
+//  Program:      nes-py
+//  File:         state_delta.hpp
+//  Description:  Compact XOR deltas between machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef STATE_DELTA_HPP
+#define STATE_DELTA_HPP
+
+#include <cstddef>
+#include "common.hpp"
+
+namespace NES {
+
+// A delta is the XOR of two buffers encoded as runs of (LEB128 number of
+// zero bytes, LEB128 number of literal bytes, literal bytes). States that
+// share most of their bytes encode to a few hundred bytes.
+
+/// Append an unsigned LEB128 integer to a buffer.
+inline NES_Byte* write_varint(NES_Byte* output, std::size_t value) {
+    while (value > 0x7f) {
+        *output++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *output++ = value;
+    return output;
+}
+
+/// Read an unsigned LEB128 integer from a buffer.
+///
+/// @param input the first byte of the integer
+/// @param end the end of the buffer
+/// @param value an output for the integer
+/// @return the byte after the integer, or nullptr if it is malformed
+///
+inline const NES_Byte* read_varint(const NES_Byte* input, const NES_Byte* end, std::size_t* value) {
+    std::size_t result = 0;
+    int shift = 0;
+    do {
+        if (input == end || shift > 56)
+            return nullptr;
+        result |= static_cast<std::size_t>(*input & 0x7f) << shift;
+        shift += 7;
+    } while (*input++ & 0x80);
+    *value = result;
+    return input;
+}
+
+/// Return the largest length of the delta of two buffers.
+///
+/// @param length the length of both buffers
+/// @return the size of an output buffer for encode_delta
+///
+inline std::size_t max_delta_length(std::size_t length) {
+    return length + length / 2 + 16;
+}
+
+/// Encode the XOR of two buffers as a delta.
+///
+/// @param a the first buffer
+/// @param b the second buffer
+/// @param length the length of both buffers
+/// @param output a buffer of at least max_delta_length(length) bytes
+/// @return the number of bytes written to the output (at least 1)
+///
+std::size_t encode_delta(
+    const NES_Byte* a,
+    const NES_Byte* b,
+    std::size_t length,
+    NES_Byte* output
+);
+
+/// Apply a delta to a buffer in place (i.e., turn a into b or b into a).
+///
+/// @param delta the encoded delta
+/// @param length the length of the delta in bytes
+/// @param state the buffer to apply the delta to
+/// @param state_length the length of the buffer
+/// @return false if the delta is malformed or exceeds the buffer (which
+/// is then partially updated), true otherwise
+///
+bool apply_delta(
+    const NES_Byte* delta,
+    std::size_t length,
+    NES_Byte* state,
+    std::size_t state_length
+);
+
+}  // namespace NES
+
+#endif  // STATE_DELTA_HPP
@@ -0,0 +1,161 @@
+//  Program:      nes-py
+//  File:         stats.hpp
+//  Description:  Optional instrumentation counters for the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "common.hpp"
+
+// whether the emulator counts events in its stats (set by the build, i.e.,
+// `scons stats=1`). When disabled, the counting calls compile to nothing.
+#ifndef NES_STATS
+#define NES_STATS 0
+#endif
+
+namespace NES {
+
+/// The regions of the CPU address space that stats count accesses to
+enum BusRegion {
+    /// the 2KB internal RAM and its mirrors ($0000-$1FFF)
+    BUS_RAM,
+    /// the PPU registers and their mirrors ($2000-$3FFF)
+    BUS_PPU,
+    /// the APU and I/O registers ($4000-$401F)
+    BUS_IO,
+    /// the expansion ROM ($4020-$5FFF)
+    BUS_EXPANSION,
+    /// the extended (save) RAM on the cartridge ($6000-$7FFF)
+    BUS_EXTENDED_RAM,
+    /// the PRG ROM; writes go to the mapper registers ($8000-$FFFF)
+    BUS_PRG,
+    /// the number of regions (not a region)
+    BUS_NUM_REGIONS,
+};
+
+/// Return the region of the CPU address space that an address belongs to.
+///
+/// @param address the address to find the region of
+/// @return the region that contains the address
+///
+inline BusRegion bus_region(NES_Address address) {
+    if (address < 0x2000) return BUS_RAM;
+    if (address < 0x4000) return BUS_PPU;
+    if (address < 0x4020) return BUS_IO;
+    if (address < 0x6000) return BUS_EXPANSION;
+    if (address < 0x8000) return BUS_EXTENDED_RAM;
+    return BUS_PRG;
+}
+
+/// The counters of an emulator. The layout is shared with Python (ctypes)
+/// so fields must only be appended, and all of them are 64-bit.
+struct StatsCounters {
+    /// 1 if the library was built with stats, 0 otherwise
+    uint64_t is_enabled;
+    /// the number of instructions retired (including replayed idle loops)
+    uint64_t instructions;
+    /// the number of CPU cycles
+    uint64_t cycles;
+    /// the number of cycles spent waiting on multi-cycle instructions
+    uint64_t stall_cycles;
+    /// the number of cycles of idle loop instructions that were replayed
+    uint64_t idle_cycles;
+    /// the number of cycles the CPU was suspended for OAM DMA
+    uint64_t dma_cycles;
+    /// the number of reads from each region of the address space
+    uint64_t reads[BUS_NUM_REGIONS];
+    /// the number of writes to each region of the address space
+    uint64_t writes[BUS_NUM_REGIONS];
+    /// the number of writes to mapper registers ($8000-$FFFF). A bank
+    /// switch takes one or more writes (five serial writes on MMC1) and
+    /// some games write there without switching banks.
+    uint64_t mapper_writes;
+    /// the number of non-maskable interrupts taken
+    uint64_t nmis;
+    /// the number of maskable interrupts taken
+    uint64_t irqs;
+    /// the number of frames with background or sprite rendering enabled
+    uint64_t frames_rendered;
+    /// the number of frames with rendering disabled (blank screen)
+    uint64_t frames_skipped;
+};
+
+/// Instrumentation counters for an emulator with a compile-time switch.
+/// All counting methods are empty when IS_ENABLED is false, so the calls
+/// throughout the emulator cost nothing in a build without stats.
+///
+/// @tparam IS_ENABLED whether to count events
+///
+template<bool IS_ENABLED>
+class BasicStats {
+ private:
+    /// the values of the counters
+    StatsCounters counters;
+
+ public:
+    /// Initialize new stats with all counters at zero.
+    BasicStats() { reset(); }
+
+    /// Set all counters to zero.
+    inline void reset() {
+        counters = StatsCounters();
+        counters.is_enabled = IS_ENABLED;
+    }
+
+    /// Return a pointer to the values of the counters.
+    inline const StatsCounters* get_counters() const { return &counters; }
+
+    /// Count a CPU cycle that executes or replays an instruction.
+    inline void count_instruction() {
+        if (IS_ENABLED) { ++counters.instructions; ++counters.cycles; }
+    }
+
+    /// Count a CPU cycle that waits on the previous instruction.
+    inline void count_stall() {
+        if (IS_ENABLED) { ++counters.stall_cycles; ++counters.cycles; }
+    }
+
+    /// Count the cycles of a replayed idle loop instruction.
+    inline void count_idle(int cycles) {
+        if (IS_ENABLED) counters.idle_cycles += cycles;
+    }
+
+    /// Count the cycles of an OAM DMA transfer.
+    inline void count_DMA(int cycles) {
+        if (IS_ENABLED) counters.dma_cycles += cycles;
+    }
+
+    /// Count a read from the CPU address space.
+    inline void count_read(NES_Address address) {
+        if (IS_ENABLED) ++counters.reads[bus_region(address)];
+    }
+
+    /// Count a write to the CPU address space.
+    inline void count_write(NES_Address address) {
+        if (IS_ENABLED) {
+            auto region = bus_region(address);
+            ++counters.writes[region];
+            counters.mapper_writes += region == BUS_PRG;
+        }
+    }
+
+    /// Count an interrupt taken by the CPU.
+    inline void count_interrupt(bool is_NMI) {
+        if (IS_ENABLED) ++(is_NMI ? counters.nmis : counters.irqs);
+    }
+
+    /// Count a frame.
+    inline void count_frame(bool is_rendering) {
+        if (IS_ENABLED) ++(is_rendering ? counters.frames_rendered : counters.frames_skipped);
+    }
+};
+
+/// The stats type of the emulator as selected by the build
+typedef BasicStats<NES_STATS> Stats;
+
+}  // namespace NES
+
+#endif  // STATS_HPP
@@ -0,0 +1,224 @@
+//  Program:      nes-py
+//  File:         telemetry.hpp
+//  Description:  Lock-free latency histograms and frame rates
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef TELEMETRY_HPP
+#define TELEMETRY_HPP
+
+#include <atomic>
+#include <chrono>
+#include "common.hpp"
+
+namespace NES {
+
+/// The operations of an emulator with a latency histogram (must match
+/// LATENCY_KINDS in nes_env.py)
+enum LatencyKind {
+    /// a frame of a step (or a speculative step committed at once)
+    LATENCY_STEP,
+    /// a reset, a restore of the backup, or a load of a start or cell
+    LATENCY_RESET,
+    /// a render of the screen (recorded by the caller)
+    LATENCY_RENDER,
+    /// the number of kinds (not a kind)
+    LATENCY_NUM_KINDS,
+};
+
+/// A histogram of latencies in nanoseconds with log-linear buckets (as in
+/// HdrHistogram): values below 2^SUB_BITS have a bucket each and every
+/// power of 2 above is split into 2^SUB_BITS buckets, so a bucket is within
+/// 1 / 2^SUB_BITS (3%) of its values up to 2^MAX_BITS ns (18 minutes).
+/// Recording is a few relaxed atomic adds, so a thread can read (or reset)
+/// the histogram while another records to it.
+class LatencyHistogram {
+ public:
+    /// the log2 of the number of buckets per power of 2
+    static const int SUB_BITS = 5;
+    /// the log2 of the largest latency (larger latencies are clamped)
+    static const int MAX_BITS = 40;
+    /// the number of buckets
+    static const std::size_t NUM_BUCKETS = std::size_t(MAX_BITS - SUB_BITS + 1) << SUB_BITS;
+
+ private:
+    /// the number of latencies in each bucket
+    std::atomic<uint64_t> buckets[NUM_BUCKETS];
+    /// the number of latencies
+    std::atomic<uint64_t> count;
+    /// the sum of the latencies
+    std::atomic<uint64_t> sum;
+    /// the smallest latency
+    std::atomic<uint64_t> smallest;
+    /// the largest latency
+    std::atomic<uint64_t> largest;
+
+ public:
+    /// Initialize a new empty histogram.
+    LatencyHistogram() { reset(); }
+
+    /// Return the bucket of a latency.
+    static inline std::size_t get_bucket(uint64_t nanoseconds) {
+        if (nanoseconds >> MAX_BITS)
+            nanoseconds = (uint64_t(1) << MAX_BITS) - 1;
+        if (nanoseconds < (uint64_t(1) << SUB_BITS))
+            return nanoseconds;
+        int exponent = SUB_BITS;
+        while (nanoseconds >> (exponent + 1))
+            exponent++;
+        const int shift = exponent - SUB_BITS;
+        return (std::size_t(shift + 1) << SUB_BITS) + (nanoseconds >> shift) - (uint64_t(1) << SUB_BITS);
+    }
+
+    /// Return the smallest latency of a bucket.
+    static inline uint64_t get_lower_bound(std::size_t bucket) {
+        if (bucket < (std::size_t(1) << SUB_BITS))
+            return bucket;
+        const int shift = (bucket >> SUB_BITS) - 1;
+        return ((uint64_t(1) << SUB_BITS) + (bucket & ((1 << SUB_BITS) - 1))) << shift;
+    }
+
+    /// Return the number of latencies of a bucket.
+    static inline uint64_t get_width(std::size_t bucket) {
+        return bucket < (std::size_t(1) << SUB_BITS) ? 1 : uint64_t(1) << ((bucket >> SUB_BITS) - 1);
+    }
+
+    /// Record a latency.
+    inline void record(uint64_t nanoseconds) {
+        buckets[get_bucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t bound = smallest.load(std::memory_order_relaxed);
+        while (nanoseconds < bound && !smallest.compare_exchange_weak(bound, nanoseconds, std::memory_order_relaxed)) { }
+        bound = largest.load(std::memory_order_relaxed);
+        while (nanoseconds > bound && !largest.compare_exchange_weak(bound, nanoseconds, std::memory_order_relaxed)) { }
+    }
+
+    /// Remove every latency from the histogram.
+    void reset();
+
+    /// Return a summary of the latencies.
+    ///
+    /// @param output an output for the count, mean, min, max, and the 50th,
+    /// 90th, 99th, and 99.9th percentiles (in nanoseconds, 0 if empty)
+    ///
+    void get_summary(double* output) const;
+
+    /// Return the latency at a quantile.
+    ///
+    /// @param quantile the quantile in [0, 1]
+    /// @return the middle of the bucket of the quantile (0 if empty)
+    ///
+    double get_quantile(double quantile) const;
+
+    /// Copy the number of latencies in each bucket.
+    ///
+    /// @param output a buffer of NUM_BUCKETS counts
+    ///
+    void get_buckets(uint64_t* output) const;
+};
+
+/// The number of frames an emulator ran over a rolling window of time. The
+/// window is a ring of slots of time, each holding its epoch and the frames
+/// counted in it, so counting and reading take no lock (a slot is only
+/// written by the thread that steps the emulator).
+class FrameRate {
+ public:
+    /// the number of slots of the window
+    static const int NUM_SLOTS = 16;
+    /// the length of a slot in nanoseconds
+    static const uint64_t SLOT_NANOSECONDS = 250000000;
+
+ private:
+    /// the epoch (above bit 24) and number of frames of each slot
+    std::atomic<uint64_t> slots[NUM_SLOTS];
+    /// the time of the first frame since a reset (0 before it)
+    std::atomic<uint64_t> start;
+
+ public:
+    /// Initialize a new rate with no frames.
+    FrameRate() { reset(); }
+
+    /// Count frames.
+    ///
+    /// @param now the time of the frames (see Telemetry::now)
+    /// @param frames the number of frames
+    ///
+    inline void count(uint64_t now, uint64_t frames) {
+        const uint64_t epoch = now / SLOT_NANOSECONDS;
+        std::atomic<uint64_t>& slot = slots[epoch % NUM_SLOTS];
+        const uint64_t value = slot.load(std::memory_order_relaxed);
+        if (value >> 24 == epoch)
+            slot.store(value + frames, std::memory_order_relaxed);
+        else
+            slot.store((epoch << 24) | frames, std::memory_order_relaxed);
+        if (start.load(std::memory_order_relaxed) == 0)
+            start.store(now, std::memory_order_relaxed);
+    }
+
+    /// Return the frames per second over the window before a time.
+    ///
+    /// @param now the time to end the window at
+    ///
+    double get_rate(uint64_t now) const;
+
+    /// Forget every frame.
+    void reset();
+};
+
+/// The latency histograms and frame rate of an emulator. They are always
+/// on: a frame takes about a millisecond and recording it takes tens of
+/// nanoseconds.
+class Telemetry {
+ private:
+    /// the histogram of each kind of operation
+    LatencyHistogram latencies[LATENCY_NUM_KINDS];
+    /// the rolling rate of frames
+    FrameRate frame_rate;
+
+ public:
+    /// Return the time of a monotonic clock in nanoseconds.
+    static inline uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()
+        ).count();
+    }
+
+    /// Record the latency of an operation since a start time.
+    ///
+    /// @param kind the kind of the operation
+    /// @param start the time the operation started (see now)
+    ///
+    inline void record(LatencyKind kind, uint64_t start) {
+        latencies[kind].record(now() - start);
+    }
+
+    /// Record the latency of a step and count its frames.
+    ///
+    /// @param start the time the step started (see now)
+    /// @param frames the number of frames of the step
+    ///
+    inline void record_step(uint64_t start, uint64_t frames) {
+        const uint64_t end = now();
+        latencies[LATENCY_STEP].record(end - start);
+        frame_rate.count(end, frames);
+    }
+
+    /// Return the histogram of a kind of operation.
+    inline LatencyHistogram& get_latency(LatencyKind kind) { return latencies[kind]; }
+
+    /// Return the frames per second over the last few seconds.
+    inline double get_frame_rate() const { return frame_rate.get_rate(now()); }
+
+    /// Reset every histogram and the frame rate.
+    inline void reset() {
+        for (auto& latency : latencies)
+            latency.reset();
+        frame_rate.reset();
+    }
+};
+
+}  // namespace NES
+
+#endif  // TELEMETRY_HPP
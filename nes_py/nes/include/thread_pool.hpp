@@ -0,0 +1,84 @@
+//  Program:      nes-py
+//  File:         thread_pool.hpp
+//  Description:  A pool of worker threads for running emulators in parallel
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NES {
+
+/// A fixed pool of worker threads that run the iterations of parallel loops.
+/// One process-wide pool is shared by all emulators so that many emulators
+/// in one process do not oversubscribe the cores.
+class ThreadPool {
+ private:
+    /// the worker threads
+    std::vector<std::thread> workers;
+    /// the lock that guards the job and the shutdown flag
+    std::mutex lock;
+    /// the signal to workers that a job was posted (or the pool stops)
+    std::condition_variable job_posted;
+    /// the signal to the caller that a worker finished with the job
+    std::condition_variable job_finished;
+    /// the body of the running loop
+    const std::function<void(std::size_t)>* task;
+    /// the number of iterations of the running loop
+    std::size_t num_iterations;
+    /// the next iteration of the running loop to claim
+    std::atomic<std::size_t> next_iteration;
+    /// the number of workers that are still running the job
+    std::size_t num_busy;
+    /// a counter of posted jobs so workers run each job once
+    uint64_t generation;
+    /// whether the pool is shutting down
+    bool is_stopping;
+    /// the lock that serializes parallel loops from different callers
+    std::mutex caller_lock;
+
+    /// Claim and run iterations of the running loop until none are left.
+    void run_iterations();
+
+    /// The main loop of a worker thread.
+    void work();
+
+ public:
+    /// Initialize a new thread pool.
+    ///
+    /// @param num_threads the number of worker threads (the calling thread
+    /// of a loop also runs iterations)
+    ///
+    explicit ThreadPool(std::size_t num_threads);
+
+    /// Stop and join the worker threads.
+    ~ThreadPool();
+
+    /// Return the number of threads that run iterations of a loop.
+    inline std::size_t get_concurrency() const { return workers.size() + 1; }
+
+    /// Run the iterations of a loop on the pool and wait for all of them.
+    ///
+    /// @param num_iterations the number of iterations of the loop
+    /// @param task the body of the loop that accepts the iteration index
+    ///
+    void parallel_for(std::size_t num_iterations, const std::function<void(std::size_t)>& task);
+
+    /// Return the process-wide pool with a worker for each extra core. The
+    /// pool is created on first use and lives until the process exits.
+    static ThreadPool& shared();
+};
+
+}  // namespace NES
+
+#endif  // THREAD_POOL_HPP
@@ -0,0 +1,197 @@
+//  Program:      nes-py
+//  File:         trace.hpp
+//  Description:  An optional binary trace of the instructions of the CPU
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+// whether the emulator records an instruction trace (set by the build, i.e.,
+// `scons trace=1`). When disabled, the tracing calls compile to nothing.
+#ifndef NES_TRACE
+#define NES_TRACE 0
+#endif
+
+// the number of records in the trace ring buffer (must be a power of 2)
+#ifndef NES_TRACE_SIZE
+#define NES_TRACE_SIZE (1 << 20)
+#endif
+
+namespace NES {
+
+/// The kinds of records in an instruction trace
+enum TraceKind {
+    /// an instruction about to execute (registers before execution)
+    TRACE_INSTRUCTION,
+    /// an instruction of an idle loop that was replayed without bus access
+    TRACE_IDLE,
+    /// a read from the bus by the last instruction
+    TRACE_READ,
+    /// a write to the bus by the last instruction
+    TRACE_WRITE,
+    /// an interrupt (address is the return address, value is the type)
+    TRACE_INTERRUPT,
+    /// a jump of the cycle counter from a reset or a loaded state (the
+    /// cycle is the counter of the new state)
+    TRACE_LOAD,
+};
+
+/// A record in the instruction trace. The layout is the binary format of
+/// the trace file (little-endian) that nes_py/trace.py decodes.
+struct TraceRecord {
+    /// the low 32 bits of the CPU cycle counter
+    uint32_t cycle;
+    /// the program counter or the address of the bus access
+    uint16_t address;
+    /// the kind of record (a TraceKind)
+    uint8_t kind;
+    /// the opcode or the value of the bus access
+    uint8_t value;
+    /// the A, X, Y, SP, and P registers (instructions only)
+    uint8_t A, X, Y, SP, P;
+    /// padding to 16 bytes
+    uint8_t padding[3];
+};
+
+static_assert(sizeof(TraceRecord) == 16, "trace records must be 16 bytes");
+
+/// Write the records of a trace ring buffer to a file, oldest first.
+///
+/// @param path the path of the file to write
+/// @param records the ring buffer of records
+/// @param count the total number of records ever pushed to the buffer
+/// @return true if the file was written, false otherwise
+///
+bool write_trace(
+    const std::string& path,
+    const std::vector<TraceRecord>& records,
+    uint64_t count
+);
+
+/// A ring buffer of the most recent instructions and bus accesses with a
+/// compile-time switch. All recording methods are empty when IS_ENABLED is
+/// false, so the calls throughout the emulator cost nothing without trace.
+///
+/// @tparam IS_ENABLED whether to record the trace
+///
+template<bool IS_ENABLED>
+class BasicTrace {
+ private:
+    /// the ring buffer of records
+    std::vector<TraceRecord> records;
+    /// the total number of records pushed to the buffer
+    uint64_t count;
+    /// the cycle of the last instruction (for its bus accesses)
+    uint32_t cycle;
+    /// the last instruction if its opcode has not been fetched yet
+    TraceRecord* pending;
+
+    /// Return the next record in the ring buffer to write to.
+    inline TraceRecord& push(uint8_t kind, uint16_t address, uint8_t value) {
+        TraceRecord& record = records[count++ & (NES_TRACE_SIZE - 1)];
+        record = TraceRecord();
+        record.cycle = cycle;
+        record.kind = kind;
+        record.address = address;
+        record.value = value;
+        return record;
+    }
+
+ public:
+    static_assert(
+        (NES_TRACE_SIZE & (NES_TRACE_SIZE - 1)) == 0,
+        "NES_TRACE_SIZE must be a power of 2"
+    );
+
+    /// Initialize a new trace (the buffer is only allocated if enabled).
+    BasicTrace() :
+        records(IS_ENABLED ? NES_TRACE_SIZE : 0),
+        count(0),
+        cycle(0),
+        pending(nullptr) { }
+
+    /// Discard all records.
+    inline void reset() { count = 0; pending = nullptr; }
+
+    /// Record an instruction that is about to execute. The opcode is taken
+    /// from the next read, which is the fetch of the instruction.
+    inline void instruction(
+        uint32_t cycle,
+        uint16_t pc,
+        uint8_t A, uint8_t X, uint8_t Y, uint8_t SP, uint8_t P
+    ) {
+        if (!IS_ENABLED) return;
+        this->cycle = cycle;
+        TraceRecord& record = push(TRACE_INSTRUCTION, pc, 0);
+        record.A = A; record.X = X; record.Y = Y; record.SP = SP; record.P = P;
+        pending = &record;
+    }
+
+    /// Record an instruction of an idle loop that is replayed.
+    inline void idle(
+        uint32_t cycle,
+        uint16_t pc,
+        uint8_t A, uint8_t X, uint8_t Y, uint8_t SP, uint8_t P
+    ) {
+        if (!IS_ENABLED) return;
+        this->cycle = cycle;
+        TraceRecord& record = push(TRACE_IDLE, pc, 0);
+        record.A = A; record.X = X; record.Y = Y; record.SP = SP; record.P = P;
+    }
+
+    /// Record a read from the bus.
+    inline void read(uint16_t address, uint8_t value) {
+        if (!IS_ENABLED) return;
+        if (pending != nullptr) {
+            pending->value = value;
+            pending = nullptr;
+            return;
+        }
+        push(TRACE_READ, address, value);
+    }
+
+    /// Record a write to the bus.
+    inline void write(uint16_t address, uint8_t value) {
+        if (IS_ENABLED) push(TRACE_WRITE, address, value);
+    }
+
+    /// Record an interrupt.
+    inline void interrupt(uint32_t cycle, uint16_t return_address, uint8_t type) {
+        if (!IS_ENABLED) return;
+        this->cycle = cycle;
+        pending = nullptr;
+        push(TRACE_INTERRUPT, return_address, type);
+    }
+
+    /// Record that the CPU state was replaced, so the cycle counter of the
+    /// following records does not continue from the previous records.
+    inline void load(uint32_t cycle) {
+        if (!IS_ENABLED) return;
+        this->cycle = cycle;
+        pending = nullptr;
+        push(TRACE_LOAD, 0, 0);
+    }
+
+    /// Write the records to a file, oldest first.
+    ///
+    /// @param path the path of the file to write
+    /// @return true if the file was written, false if the trace is compiled
+    /// out or the file could not be written
+    ///
+    inline bool dump(const std::string& path) const {
+        return IS_ENABLED && write_trace(path, records, count);
+    }
+};
+
+/// The trace type of the emulator as selected by the build
+typedef BasicTrace<NES_TRACE> Trace;
+
+}  // namespace NES
+
+#endif  // TRACE_HPP
@@ -0,0 +1,246 @@
+//  Program:      nes-py
+//  File:         trajectory.hpp
+//  Description:  Streaming recordings of steps for offline learning
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+/// The header of a trajectory file, followed by chunks of steps
+struct TrajectoryHeader {
+    /// the magic string "NESTRAJ\0"
+    char magic[8];
+    /// the version of the format
+    uint32_t version;
+    /// the largest number of steps in a chunk
+    uint32_t chunk_steps;
+    /// the width of a frame in pixels
+    uint32_t width;
+    /// the height of a frame in pixels
+    uint32_t height;
+    /// the size of the RAM of a step in bytes
+    uint32_t ram_size;
+    /// padding to align the hash
+    uint32_t reserved;
+    /// the hash of the ROM the steps were recorded on
+    uint64_t rom_hash;
+};
+
+/// The header of a chunk of steps. A chunk starts from blank frame and RAM
+/// buffers, so it decodes without the chunks before it. Each step is the
+/// controller bytes of both ports, the done flag, the reward (a double),
+/// the RAM as a delta (state_delta.hpp) from the RAM of the last step, and
+/// the frame as palette indices XOR the indices of the last frame encoded
+/// as runs. Each delta is prefixed with its LEB128 length.
+struct TrajectoryChunk {
+    /// the magic string "STEP"
+    char magic[4];
+    /// the number of steps in the chunk
+    uint32_t num_steps;
+    /// the index of the first step of the chunk in the file
+    uint64_t first_step;
+    /// the length of the steps of the chunk in bytes
+    uint64_t length;
+    /// the hash of the steps of the chunk (to detect a torn write)
+    uint64_t hash;
+};
+
+/// A step of a trajectory
+struct TrajectoryStep {
+    /// the controller byte of port 0
+    NES_Byte action;
+    /// the controller byte of port 1
+    NES_Byte second_action;
+    /// whether the RAM program ended the episode on the step
+    bool done;
+    /// the reward of the RAM program for the step
+    double reward;
+};
+
+/// A recorder that streams the steps of an emulator to a file. The steps
+/// are encoded on the calling thread into chunks, and full chunks are
+/// written to the file by a background thread.
+class TrajectoryRecorder {
+ private:
+    /// the header of the file
+    TrajectoryHeader header;
+    /// the file the chunks are written to
+    std::ofstream file;
+    /// the thread that writes full chunks to the file
+    std::thread writer;
+    /// the lock that guards the queue of full chunks
+    std::mutex lock;
+    /// the signal to the writer that a chunk is queued (or it should stop)
+    std::condition_variable chunk_queued;
+    /// the signal to the recorder that a chunk was written
+    std::condition_variable chunk_written;
+    /// the full chunks (with their headers) that are waiting to be written
+    std::deque<std::vector<NES_Byte>> queue;
+    /// whether the writer should stop after the queue is empty
+    bool is_closing;
+    /// whether a write to the file failed
+    std::atomic<bool> is_failed;
+    /// the chunk being encoded (a header followed by its steps)
+    std::vector<NES_Byte> chunk;
+    /// the number of steps in the chunk being encoded
+    uint32_t chunk_size;
+    /// the number of steps recorded
+    uint64_t num_steps;
+    /// the palette indices of the last frame
+    std::vector<NES_Byte> frame;
+    /// the palette indices of the current frame XOR the last frame
+    std::vector<NES_Byte> changes;
+    /// the RAM of the last step
+    std::vector<NES_Byte> ram;
+    /// a scratch buffer for the encoded RAM and frame of a step
+    std::vector<NES_Byte> delta;
+
+    /// Write queued chunks to the file until closed.
+    void write_chunks();
+
+    /// Queue the chunk being encoded for the writer and start a new one.
+    void flush();
+
+ public:
+    /// Initialize a new recorder.
+    ///
+    /// @param width the width of a frame in pixels
+    /// @param height the height of a frame in pixels
+    /// @param ram_size the size of the RAM of a step in bytes
+    /// @param chunk_steps the largest number of steps in a chunk (a step is
+    /// decoded from the start of its chunk)
+    /// @param rom_hash the hash of the ROM of the emulator
+    ///
+    TrajectoryRecorder(
+        uint32_t width,
+        uint32_t height,
+        uint32_t ram_size,
+        uint32_t chunk_steps,
+        NES_Hash rom_hash
+    );
+
+    /// Close the recorder.
+    ~TrajectoryRecorder();
+
+    /// Create the file and start the writer.
+    ///
+    /// @param path the path of the file to create
+    /// @return true if the file was created, false otherwise
+    ///
+    bool open(const std::string& path);
+
+    /// Encode a step.
+    ///
+    /// @param step the inputs and outputs of the step
+    /// @param ram the RAM after the step
+    /// @param screen the screen after the step
+    ///
+    void record(const TrajectoryStep& step, const NES_Byte* ram, const NES_Pixel* screen);
+
+    /// Write the remaining steps and close the file.
+    ///
+    /// @return true if every chunk was written, false otherwise
+    ///
+    bool close();
+
+    /// Return the number of steps recorded.
+    inline uint64_t get_num_steps() const { return num_steps; }
+};
+
+/// A read-only view of a trajectory file with random access to its steps.
+/// The file is mapped into memory and a step is decoded from the start of
+/// its chunk, or from the last decoded step if it is in the same chunk.
+class TrajectoryReader {
+ private:
+    /// the mapped file (nullptr if not open)
+    const NES_Byte* memory;
+    /// the size of the mapped file in bytes
+    std::size_t size;
+    /// the header of the file
+    const TrajectoryHeader* header;
+    /// the offset of each intact chunk in the file
+    std::vector<std::size_t> chunks;
+    /// the index of the first step of each intact chunk
+    std::vector<uint64_t> first_steps;
+    /// the number of steps in the intact chunks
+    uint64_t num_steps;
+    /// the chunk of the last decoded step (-1 for none)
+    int64_t cursor_chunk;
+    /// the number of steps of the chunk that were decoded
+    uint32_t cursor_steps;
+    /// the offset of the step after the last decoded step
+    std::size_t cursor_offset;
+    /// the offset of the end of the chunk of the last decoded step
+    std::size_t cursor_end;
+    /// the last decoded step
+    TrajectoryStep cursor;
+    /// the palette indices of the last decoded frame
+    std::vector<NES_Byte> frame;
+    /// the RAM of the last decoded step
+    std::vector<NES_Byte> ram;
+
+    /// Decode the step after the last decoded one.
+    ///
+    /// @return false if the step is malformed, true otherwise
+    ///
+    bool decode_next();
+
+ public:
+    /// Initialize a new closed reader.
+    TrajectoryReader();
+
+    /// Unmap the file of the reader.
+    ~TrajectoryReader();
+
+    /// Map a trajectory file.
+    ///
+    /// @param path the path of the file
+    /// @return true if the file is a trajectory, false otherwise
+    ///
+    bool open(const std::string& path);
+
+    /// Return the hash of the ROM the steps were recorded on.
+    inline NES_Hash get_rom_hash() const { return header->rom_hash; }
+
+    /// Return the number of steps in the intact chunks of the file.
+    inline uint64_t get_num_steps() const { return num_steps; }
+
+    /// Return the width of a frame in pixels.
+    inline uint32_t get_width() const { return header->width; }
+
+    /// Return the height of a frame in pixels.
+    inline uint32_t get_height() const { return header->height; }
+
+    /// Return the size of the RAM of a step in bytes.
+    inline uint32_t get_ram_size() const { return header->ram_size; }
+
+    /// Decode a step.
+    ///
+    /// @param index the index of the step
+    /// @param step an output for the inputs and outputs of the step
+    /// @param ram an output for the RAM (nullptr to skip it)
+    /// @param frame an output for the palette indices of the frame (nullptr
+    /// to skip it)
+    /// @return false if the index is out of range or the step is malformed
+    ///
+    bool read(uint64_t index, TrajectoryStep* step, NES_Byte* ram, NES_Byte* frame);
+};
+
+}  // namespace NES
+
+#endif  // TRAJECTORY_HPP
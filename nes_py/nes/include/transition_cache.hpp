@@ -0,0 +1,132 @@
+//  Program:      nes-py
+//  File:         transition_cache.hpp
+//  Description:  A bounded cache of the outcomes of emulated frames
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef TRANSITION_CACHE_HPP
+#define TRANSITION_CACHE_HPP
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "common.hpp"
+#include "hash.hpp"
+
+namespace NES {
+
+class Emulator;
+
+/// A bounded cache that maps a machine state and controller input to the
+/// outcome of the frame it runs (the next state, the RAM program outputs,
+/// and optionally the screen). Emulation is deterministic, so a search that
+/// revisits a (state, action) pair can load its outcome instead of running
+/// the frame again. The cache is split into shards with a lock each so the
+/// emulators of a batch or an expansion can share it, and each shard evicts
+/// with the CLOCK (second chance) approximation of LRU when it is full.
+class TransitionCache {
+ private:
+    /// An outcome in a shard
+    struct Slot {
+        /// the key of the transition
+        NES_Hash key;
+        /// the encoded outcome (empty for a free slot)
+        std::vector<NES_Byte> value;
+        /// whether the slot was used since the clock hand last passed it
+        bool is_referenced;
+    };
+
+    /// A partition of the cache with its own lock
+    struct Shard {
+        /// the lock that guards the shard
+        std::mutex lock;
+        /// a map of keys to the index of their slot
+        std::unordered_map<NES_Hash, std::size_t> index;
+        /// the slots of the outcomes
+        std::vector<Slot> slots;
+        /// the indexes of the free slots
+        std::vector<std::size_t> free_slots;
+        /// the index of the next slot the clock hand checks
+        std::size_t hand;
+        /// the bytes of memory the outcomes of the shard use
+        std::size_t used_bytes;
+    };
+
+    /// the shards of the cache
+    std::vector<Shard> shards;
+    /// the bytes of memory each shard may use
+    std::size_t shard_bytes;
+    /// whether outcomes include the screen
+    bool is_caching_screens;
+    /// the number of lookups that found an outcome
+    std::atomic<uint64_t> hits;
+    /// the number of lookups that found no outcome
+    std::atomic<uint64_t> misses;
+    /// the number of outcomes dropped to make room for others
+    std::atomic<uint64_t> evictions;
+
+    /// Return the shard of a key.
+    inline Shard& get_shard(NES_Hash key) {
+        return shards[(key >> 40) % shards.size()];
+    }
+
+    /// Drop outcomes of a shard until a number of bytes fits in it.
+    ///
+    /// @param shard the shard to make room in (which must be locked)
+    /// @param bytes the number of bytes to make room for
+    ///
+    void evict(Shard& shard, std::size_t bytes);
+
+ public:
+    /// Initialize a new transition cache.
+    ///
+    /// @param max_bytes the bytes of memory the outcomes may use
+    /// @param is_caching_screens whether outcomes include the screen (if
+    /// not, a hit leaves the screen of the previous frame in the buffer)
+    /// @param num_shards the number of independently locked partitions
+    ///
+    TransitionCache(std::size_t max_bytes, bool is_caching_screens, int num_shards = 16);
+
+    /// Return the key of the next frame of an emulator, i.e., a hash of its
+    /// machine state, its ROM, its RAM program, and its controller input.
+    static NES_Hash get_key(Emulator& emulator);
+
+    /// Load the outcome of a frame into an emulator if it is cached.
+    ///
+    /// @param key the key of the frame from before it ran
+    /// @param emulator the emulator to load the outcome into
+    /// @return true if the outcome was cached and loaded, false otherwise
+    ///
+    bool load(NES_Hash key, Emulator& emulator);
+
+    /// Cache the outcome of a frame.
+    ///
+    /// @param key the key of the frame from before it ran
+    /// @param emulator the emulator the frame just ran on
+    ///
+    void store(NES_Hash key, Emulator& emulator);
+
+    /// Drop every outcome in the cache.
+    void clear();
+
+    /// Return the number of lookups that found an outcome.
+    inline uint64_t get_hits() const { return hits; }
+
+    /// Return the number of lookups that found no outcome.
+    inline uint64_t get_misses() const { return misses; }
+
+    /// Return the number of outcomes dropped to make room for others.
+    inline uint64_t get_evictions() const { return evictions; }
+
+    /// Return the number of cached outcomes.
+    std::size_t get_num_entries();
+
+    /// Return the bytes of memory the cached outcomes use.
+    std::size_t get_used_bytes();
+};
+
+}  // namespace NES
+
+#endif  // TRANSITION_CACHE_HPP
@@ -0,0 +1,116 @@
+//  Program:      nes-py
+//  File:         visit_counter.hpp
+//  Description:  Counts of visited RAM values for exploration bonuses
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#ifndef VISIT_COUNTER_HPP
+#define VISIT_COUNTER_HPP
+
+#include <vector>
+#include "common.hpp"
+
+namespace NES {
+
+/// Counts of the RAM values an emulator visits for count-based exploration.
+/// Each frame counts the value of each selected address in a histogram of
+/// its 256 values and the values of each tuple of addresses in a hashed
+/// table (where tuples may collide). A frame earns an intrinsic bonus of
+/// scale * sum(1 / sqrt(n)) over the counts n of its values after counting.
+class VisitCounter {
+ public:
+    /// the log2 of the largest number of slots of the table (128MB)
+    static const int MAX_TABLE_BITS = 24;
+
+ private:
+    /// the addresses with a histogram of values
+    std::vector<NES_Address> addresses;
+    /// the 256 counts of the values of each address, back to back
+    std::vector<double> histograms;
+    /// the addresses of the tuples, back to back
+    std::vector<NES_Address> tuple_addresses;
+    /// the end of each tuple in the tuple addresses
+    std::vector<std::size_t> tuple_ends;
+    /// the hashed counts of the values of the tuples
+    std::vector<double> table;
+    /// the scale of the bonus of a frame
+    double scale;
+    /// the bonus summed over the frames since the last take_bonus
+    double bonus;
+    /// a scratch buffer for the values of a tuple
+    std::vector<NES_Byte> values;
+
+    /// Return the slot of the table of the values of a tuple.
+    ///
+    /// @param tuple the index of the tuple
+    /// @param ram the RAM to read the values from
+    /// @return the index of the count of the values in the table
+    ///
+    std::size_t get_slot(std::size_t tuple, const NES_Byte* ram);
+
+ public:
+    /// Initialize new zero counts.
+    ///
+    /// @param addresses the addresses to count the values of
+    /// @param num_addresses the number of addresses
+    /// @param tuple_addresses the addresses of each tuple, back to back
+    /// @param tuple_sizes the number of addresses of each tuple
+    /// @param num_tuples the number of tuples
+    /// @param table_bits the log2 of the number of slots of the table of
+    /// tuple counts (clamped to [1, MAX_TABLE_BITS])
+    /// @param scale the scale of the bonus of a frame
+    ///
+    VisitCounter(
+        const NES_Address* addresses,
+        int num_addresses,
+        const NES_Address* tuple_addresses,
+        const int* tuple_sizes,
+        int num_tuples,
+        int table_bits,
+        double scale
+    );
+
+    /// Count the values of a RAM and add the bonus of the frame.
+    ///
+    /// @param ram the RAM after a frame
+    ///
+    void count(const NES_Byte* ram);
+
+    /// Return the bonus summed over the frames since the last call.
+    inline double take_bonus() {
+        const double taken = bonus;
+        bonus = 0;
+        return taken;
+    }
+
+    /// Multiply every count by a factor (i.e., to forget old visits).
+    ///
+    /// @param factor the factor in [0, 1], where 0 resets the counts
+    ///
+    void decay(double factor);
+
+    /// Look up the counts of the values of a RAM without counting them.
+    ///
+    /// @param ram the RAM to look up
+    /// @param output an output for the count of each address followed by
+    /// the count of each tuple
+    ///
+    void get_counts(const NES_Byte* ram, double* output);
+
+    /// Return the number of addresses with a histogram.
+    inline std::size_t get_num_addresses() const { return addresses.size(); }
+
+    /// Return the number of tuples.
+    inline std::size_t get_num_tuples() const { return tuple_ends.size(); }
+
+    /// Return the 256 counts of the values of an address.
+    ///
+    /// @param index the index of the address
+    ///
+    inline const double* get_histogram(std::size_t index) const { return &histograms[256 * index]; }
+};
+
+}  // namespace NES
+
+#endif  // VISIT_COUNTER_HPP
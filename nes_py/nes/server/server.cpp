@@ -0,0 +1,88 @@
+//  Program:      nes-py
+//  File:         server.cpp
+//  Description:  A rollout server for batches of emulators over a socket
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+//  Usage:
+//      nes_server [--envs N] [--host HOST] [--port PORT | --unix PATH] ROM
+//
+//  N emulators (default 1) are created from the ROM and served to one
+//  client at a time over a TCP port (default 127.0.0.1:9000) or a Unix
+//  socket. The binary protocol is documented in socket_server.hpp and
+//  implemented in Python by nes_py.remote_env.RemoteEnvBatch. SIGINT and
+//  SIGTERM stop the server after the current request.
+//
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "emulator.hpp"
+#include "socket_server.hpp"
+
+/// the server to stop from the signal handler
+static NES::SocketServer* running_server = nullptr;
+
+/// Stop the running server (stop only writes to a pipe, so it is safe to
+/// call from a signal handler).
+static void handle_signal(int) {
+    if (running_server != nullptr)
+        running_server->stop();
+}
+
+int main(int argc, char** argv) {
+    int num_envs = 1;
+    std::string host = "127.0.0.1";
+    int port = 9000;
+    std::string unix_path;
+    std::string rom;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--envs" && has_value) num_envs = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--host" && has_value) host = argv[++i];
+        else if (arg == "--port" && has_value) port = std::atoi(argv[++i]);
+        else if (arg == "--unix" && has_value) unix_path = argv[++i];
+        else if (arg.compare(0, 2, "--") == 0 || !rom.empty()) {
+            rom.clear();
+            break;
+        } else {
+            rom = arg;
+        }
+    }
+    if (rom.empty()) {
+        std::cerr << "usage: " << argv[0] << " [--envs N] [--host HOST]"
+            << " [--port PORT | --unix PATH] ROM" << std::endl;
+        return 2;
+    }
+    std::vector<std::unique_ptr<NES::Emulator>> emulators;
+    std::vector<NES::Emulator*> batch;
+    for (int i = 0; i < num_envs; i++) {
+        emulators.emplace_back(new NES::Emulator(rom));
+        emulators.back()->reset();
+        batch.push_back(emulators.back().get());
+    }
+    // the emulators have no backup, so a reset is a power-on reset
+    NES::SocketServer server(batch, std::vector<bool>(num_envs, false));
+    bool is_listening = unix_path.empty() ?
+        server.listen_tcp(host, port) :
+        server.listen_unix(unix_path);
+    if (!is_listening) {
+        std::cerr << "failed to listen on " << (unix_path.empty() ? host + ":" + std::to_string(port) : unix_path) << std::endl;
+        return 1;
+    }
+    running_server = &server;
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+    if (unix_path.empty())
+        std::cerr << "serving " << num_envs << " emulators on " << host << ":" << server.get_port() << std::endl;
+    else
+        std::cerr << "serving " << num_envs << " emulators on " << unix_path << std::endl;
+    server.serve();
+    running_server = nullptr;
+    return 0;
+}
@@ -0,0 +1,100 @@
+//  Program:      nes-py
+//  File:         async_batch.cpp
+//  Description:  A batch of emulators that step in the background
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include "async_batch.hpp"
+#include "thread_pool.hpp"
+
+namespace NES {
+
+/// the number of pixels in a screen
+static const std::size_t SCREEN_PIXELS = Emulator::WIDTH * Emulator::HEIGHT;
+/// the number of bytes of RAM
+static const std::size_t RAM_BYTES = 0x800;
+
+AsyncBatch::AsyncBatch(const std::vector<Emulator*>& emulators) :
+    emulators(emulators),
+    actions(emulators.size(), 0),
+    frames(1),
+    is_pending(false),
+    is_stopping(false),
+    num_steps(0) {
+    for (int buffer = 0; buffer < 2; buffer++) {
+        screens[buffer].resize(emulators.size() * SCREEN_PIXELS);
+        ram[buffer].resize(emulators.size() * RAM_BYTES);
+        results[buffer].resize(emulators.size(), RAMProgramResult());
+    }
+    dispatcher = std::thread(&AsyncBatch::dispatch, this);
+}
+
+AsyncBatch::~AsyncBatch() {
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        step_finished.wait(guard, [&]() { return !is_pending; });
+        is_stopping = true;
+    }
+    step_requested.notify_one();
+    dispatcher.join();
+}
+
+void AsyncBatch::run_step() {
+    // the caller reads the buffer of the last step while this one is filled
+    const int buffer = num_steps % 2;
+    ThreadPool::shared().parallel_for(emulators.size(), [&](std::size_t index) {
+        Emulator* emulator = emulators[index];
+        *emulator->get_controller(0) = actions[index];
+        for (int frame = 0; frame < frames; frame++)
+            emulator->step();
+        std::copy_n(emulator->get_screen_buffer(), SCREEN_PIXELS, &screens[buffer][index * SCREEN_PIXELS]);
+        std::copy_n(emulator->get_memory_buffer(), RAM_BYTES, &ram[buffer][index * RAM_BYTES]);
+        results[buffer][index] = *emulator->get_program()->get_result();
+    });
+}
+
+void AsyncBatch::dispatch() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            step_requested.wait(guard, [&]() { return is_stopping || is_pending; });
+            if (is_stopping)
+                return;
+        }
+        run_step();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            num_steps++;
+            is_pending = false;
+        }
+        step_finished.notify_all();
+    }
+}
+
+bool AsyncBatch::step(const NES_Byte* actions, int frames) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (is_pending)
+            return false;
+        std::copy_n(actions, emulators.size(), this->actions.begin());
+        this->frames = std::max(frames, 1);
+        is_pending = true;
+    }
+    step_requested.notify_one();
+    return true;
+}
+
+bool AsyncBatch::poll() {
+    std::lock_guard<std::mutex> guard(lock);
+    return !is_pending;
+}
+
+int AsyncBatch::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    step_finished.wait(guard, [&]() { return !is_pending; });
+    return num_steps == 0 ? -1 : (num_steps - 1) % 2;
+}
+
+}  // namespace NES
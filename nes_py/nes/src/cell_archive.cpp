@@ -0,0 +1,177 @@
+//  Program:      nes-py
+//  File:         cell_archive.cpp
+//  Description:  An archive of the best state of each cell for Go-Explore
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "cell_archive.hpp"
+#include "emulator.hpp"
+#include "screen_runs.hpp"
+#include "state_delta.hpp"
+
+namespace NES {
+
+/// Return the luma of an xRGB pixel in [0, 255].
+static inline uint32_t luma(NES_Pixel pixel) {
+    return (77 * ((pixel >> 16) & 0xff) + 150 * ((pixel >> 8) & 0xff) + 29 * (pixel & 0xff)) >> 8;
+}
+
+/// Return the weight of a cell for a selection.
+static inline double selection_weight(const CellInfo& info) {
+    return 1 / std::sqrt(info.times_chosen + 1.0) +
+        1 / std::sqrt(info.times_chosen_since_new + 1.0) +
+        1 / std::sqrt(info.times_seen + 1.0);
+}
+
+CellArchive::CellArchive(
+    int frame_width,
+    int frame_height,
+    int frame_depth,
+    const NES_Address* addresses,
+    const NES_Byte* divisors,
+    int num_addresses,
+    uint64_t seed
+) :
+    frame_width(std::min(std::max(frame_width, 0), SCANLINE_VISIBLE_DOTS)),
+    frame_height(std::min(std::max(frame_height, 1), VISIBLE_SCANLINES)),
+    frame_depth(std::min(std::max(frame_depth, 1), 256)),
+    generator(seed),
+    score(0),
+    length(0),
+    source(0),
+    has_source(false),
+    current(0) {
+    for (int index = 0; index < num_addresses; index++) {
+        // the RAM is mirrored every 0x800 bytes
+        this->addresses.push_back(addresses[index] & 0x7ff);
+        this->divisors.push_back(std::max<NES_Byte>(divisors[index], 1));
+    }
+    if (this->frame_width > 0) {
+        block_columns.resize(SCANLINE_VISIBLE_DOTS);
+        for (int x = 0; x < SCANLINE_VISIBLE_DOTS; x++)
+            block_columns[x] = x * this->frame_width / SCANLINE_VISIBLE_DOTS;
+        block_sums.resize(this->frame_width * this->frame_height);
+        block_sizes.resize(block_sums.size(), 0);
+        for (int y = 0; y < VISIBLE_SCANLINES; y++)
+            for (int x = 0; x < SCANLINE_VISIBLE_DOTS; x++)
+                block_sizes[y * this->frame_height / VISIBLE_SCANLINES * this->frame_width + block_columns[x]]++;
+    }
+}
+
+NES_Hash CellArchive::get_key(const NES_Byte* ram, const NES_Pixel* screen) {
+    features.clear();
+    if (frame_width > 0) {
+        std::fill(block_sums.begin(), block_sums.end(), 0);
+        // look up the luma once per run of equal pixels
+        NES_Pixel color = screen[0];
+        uint32_t value = luma(color);
+        for (int y = 0; y < VISIBLE_SCANLINES; y++) {
+            uint32_t* row = &block_sums[y * frame_height / VISIBLE_SCANLINES * frame_width];
+            const NES_Pixel* pixels = screen + y * SCANLINE_VISIBLE_DOTS;
+            for (int x = 0; x < SCANLINE_VISIBLE_DOTS; x++) {
+                if (pixels[x] != color) {
+                    color = pixels[x];
+                    value = luma(color);
+                }
+                row[block_columns[x]] += value;
+            }
+        }
+        for (std::size_t block = 0; block < block_sums.size(); block++)
+            features.push_back(uint64_t(block_sums[block]) * frame_depth / (uint64_t(block_sizes[block]) * 256));
+    }
+    for (std::size_t index = 0; index < addresses.size(); index++)
+        features.push_back(ram[addresses[index]] / divisors[index]);
+    return hash_bytes(features.data(), features.size());
+}
+
+void CellArchive::visit(Emulator& emulator) {
+    current = get_key(emulator.get_memory_buffer(), emulator.get_screen_buffer());
+    auto found = cells.find(current);
+    const bool is_new = found == cells.end();
+    if (is_new) {
+        found = cells.emplace(current, Cell()).first;
+        found->second.info = CellInfo{current, 0, 0, 0, 0, 0};
+        keys.push_back(current);
+        // the cell the trajectory was restored from led somewhere new
+        auto origin = has_source ? cells.find(source) : cells.end();
+        if (origin != cells.end())
+            origin->second.info.times_chosen_since_new = 0;
+    }
+    Cell& cell = found->second;
+    cell.info.times_seen++;
+    if (!is_new && (score < cell.info.score || (score == cell.info.score && length >= cell.info.length)))
+        return;
+    cell.info.score = score;
+    cell.info.length = length;
+    if (state.empty()) {
+        state.resize(emulator.state_size());
+        delta.resize(max_delta_length(state.size()));
+    }
+    emulator.save_state(state.data());
+    if (base.empty())
+        base = state;
+    const std::size_t size = encode_delta(base.data(), state.data(), state.size(), delta.data());
+    cell.delta.assign(delta.begin(), delta.begin() + size);
+    const std::size_t num_pixels = SCANLINE_VISIBLE_DOTS * VISIBLE_SCANLINES;
+    cell.runs.resize(2 * count_screen_runs(emulator.get_screen_buffer(), num_pixels));
+    encode_screen_runs(emulator.get_screen_buffer(), num_pixels, cell.runs.data());
+}
+
+void CellArchive::begin(Emulator& emulator) {
+    score = 0;
+    length = 0;
+    has_source = false;
+    visit(emulator);
+}
+
+void CellArchive::observe(Emulator& emulator, double reward) {
+    score += reward;
+    length++;
+    visit(emulator);
+}
+
+const CellArchive::Cell* CellArchive::select() {
+    if (keys.empty())
+        return nullptr;
+    weights.resize(keys.size());
+    double total = 0;
+    for (std::size_t index = 0; index < keys.size(); index++) {
+        total += selection_weight(cells.find(keys[index])->second.info);
+        weights[index] = total;
+    }
+    std::uniform_real_distribution<double> uniform(0, total);
+    const std::size_t index = std::upper_bound(weights.begin(), weights.end(), uniform(generator)) - weights.begin();
+    return &cells.find(keys[std::min(index, keys.size() - 1)])->second;
+}
+
+const CellArchive::Cell* CellArchive::find(NES_Hash key) const {
+    auto found = cells.find(key);
+    return found == cells.end() ? nullptr : &found->second;
+}
+
+void CellArchive::restore(Emulator& emulator, const Cell& cell, bool is_chosen) {
+    state = base;
+    apply_delta(cell.delta.data(), cell.delta.size(), state.data(), state.size());
+    emulator.load_state(state.data());
+    decode_screen_runs(cell.runs.data(), cell.runs.size() / 2, emulator.get_screen_buffer());
+    score = cell.info.score;
+    length = cell.info.length;
+    current = cell.info.key;
+    source = cell.info.key;
+    has_source = is_chosen;
+    if (is_chosen) {
+        CellInfo& info = cells.find(cell.info.key)->second.info;
+        info.times_chosen++;
+        info.times_chosen_since_new++;
+    }
+}
+
+void CellArchive::get_cells(CellInfo* output) const {
+    for (NES_Hash key : keys)
+        *output++ = cells.find(key)->second.info;
+}
+
+}  // namespace NES
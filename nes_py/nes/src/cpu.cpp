@@ -5,6 +5,7 @@
 //  Copyright (c) 2019 Christian Kauten. All rights reserved.
 //
 
+#include <algorithm>
 #include "cpu.hpp"
 #include "log.hpp"
 
@@ -497,7 +498,132 @@ bool CPU::type2(MainBus &bus, NES_Byte opcode) {
     return true;
 }
 
+/// The kinds of instruction that can be part of an idle loop
+enum IdleMode {
+    /// the instruction writes memory, uses the stack, or has side effects
+    IDLE_UNSAFE,
+    /// the instruction only reads its operands from the code
+    IDLE_IMMEDIATE,
+    /// the instruction reads a zero page address
+    IDLE_ZERO_PAGE,
+    /// the instruction reads an absolute address
+    IDLE_ABSOLUTE,
+};
+
+/// Return the idle loop mode of an opcode.
+static IdleMode idle_mode(NES_Byte opcode) {
+    switch (opcode) {
+        // LDA, LDX, LDY, CMP, CPX, CPY, AND, ORA, EOR (immediate)
+        case 0xa9: case 0xa2: case 0xa0: case 0xc9: case 0xe0:
+        case 0xc0: case 0x29: case 0x09: case 0x49:
+        // branches
+        case 0x10: case 0x30: case 0x50: case 0x70:
+        case 0x90: case 0xb0: case 0xd0: case 0xf0:
+        // JMP (absolute)
+        case 0x4c:
+        // NOP, CLC, SEC, CLV
+        case 0xea: case 0x18: case 0x38: case 0xb8:
+            return IDLE_IMMEDIATE;
+        // LDA, LDX, LDY, CMP, CPX, CPY, AND, ORA, EOR, BIT (zero page)
+        case 0xa5: case 0xa6: case 0xa4: case 0xc5: case 0xe4:
+        case 0xc4: case 0x25: case 0x05: case 0x45: case 0x24:
+            return IDLE_ZERO_PAGE;
+        // LDA, LDX, LDY, CMP, CPX, CPY, AND, ORA, EOR, BIT (absolute)
+        case 0xad: case 0xae: case 0xac: case 0xcd: case 0xec:
+        case 0xcc: case 0x2d: case 0x0d: case 0x4d: case 0x2c:
+            return IDLE_ABSOLUTE;
+        default:
+            return IDLE_UNSAFE;
+    }
+}
+
+void CPU::track_idle(MainBus &bus, NES_Address pc, NES_Byte opcode) {
+    if (idle_state == IDLE_RECORDING) {
+        auto mode = idle_mode(opcode);
+        // find the address of the operand and make sure reading it has no
+        // side effects (RAM, SRAM, ROM), or that it is the PPU status
+        // register, which is read for real whenever the loop is replayed
+        bool is_status_read = false;
+        if (mode == IDLE_ZERO_PAGE || mode == IDLE_ABSOLUTE) {
+            NES_Address address = mode == IDLE_ZERO_PAGE ? bus.peek(pc + 1) :
+                bus.peek(pc + 1) | bus.peek(pc + 2) << 8;
+            if (address >= 0x2000 && address < 0x4000 && (address & 0x7) == 0x2)
+                is_status_read = true;
+            else if (address >= 0x2000 && address < 0x6000)
+                mode = IDLE_UNSAFE;
+        }
+        if (mode == IDLE_UNSAFE || idle_length == IDLE_LOOP_SIZE) {
+            idle_state = IDLE_NONE;
+        } else {
+            idle_loop[idle_length++] = {
+                pc,
+                register_PC,
+                register_A,
+                register_X,
+                register_Y,
+                flags.byte,
+                skip_cycles,
+                is_status_read
+            };
+            if (register_PC != idle_head)
+                return;
+            // back at the head of the loop, if the registers match the last
+            // iteration then every following iteration is identical until
+            // memory changes through an interrupt or the PPU status changes
+            NES_Byte registers[4] = {register_A, register_X, register_Y, flags.byte};
+            if (std::equal(registers, registers + 4, idle_head_registers)) {
+                idle_state = IDLE_REPLAYING;
+                idle_index = 0;
+                return;
+            }
+            // record another iteration from the new registers
+            std::copy(registers, registers + 4, idle_head_registers);
+            idle_length = 0;
+            return;
+        }
+    }
+    // start recording on a short backward jump or branch to a loop head
+    if (idle_state == IDLE_NONE &&
+        register_PC <= pc &&
+        pc - register_PC < IDLE_LOOP_DISTANCE &&
+        idle_mode(opcode) == IDLE_IMMEDIATE
+    ) {
+        idle_state = IDLE_RECORDING;
+        idle_head = register_PC;
+        idle_head_registers[0] = register_A;
+        idle_head_registers[1] = register_X;
+        idle_head_registers[2] = register_Y;
+        idle_head_registers[3] = flags.byte;
+        idle_length = 0;
+    }
+}
+
+bool CPU::replay_idle() {
+    const IdleStep& step = idle_loop[idle_index];
+    if (step.pc != register_PC) {
+        idle_state = IDLE_NONE;
+        return false;
+    }
+    if (step.is_status_read)
+        return false;
+    trace->idle(cycles, register_PC, register_A, register_X, register_Y, register_SP, flags.byte);
+    register_PC = step.next_pc;
+    register_A = step.A;
+    register_X = step.X;
+    register_Y = step.Y;
+    flags.byte = step.flags;
+    skip_cycles += step.cycles;
+    stats->count_idle(step.cycles);
+    // idle loops contain no calls or returns, record the step as a NOP
+    if (profiler != nullptr)
+        profiler->record(step.pc, 0xea, step.cycles, step.next_pc, register_SP);
+    if (++idle_index == idle_length)
+        idle_index = 0;
+    return true;
+}
+
 void CPU::reset(NES_Address start_address) {
+    idle_state = IDLE_NONE;
     skip_cycles = 0;
     cycles = 0;
     register_A = 0;
@@ -518,6 +644,7 @@ void CPU::reset(NES_Address start_address) {
 void CPU::interrupt(MainBus &bus, InterruptType type) {
     if (flags.bits.I && type != NMI_INTERRUPT && type != BRK_INTERRUPT)
         return;
+    trace->interrupt(cycles, register_PC, type);
     // Add one if BRK, a quirk of 6502
     if (type == BRK_INTERRUPT)
         ++register_PC;
@@ -527,6 +654,10 @@ void CPU::interrupt(MainBus &bus, InterruptType type) {
     push_stack(bus, flags.byte | 0b00100000 | (type == BRK_INTERRUPT) << 4);
     // set the interrupt flag
     flags.bits.I = true;
+    if (type != BRK_INTERRUPT)
+        stats->count_interrupt(type == NMI_INTERRUPT);
+    // the handler may change the memory that an idle loop is waiting on
+    idle_state = IDLE_NONE;
     // handle the kind of interrupt
     switch (type) {
         case IRQ_INTERRUPT:
@@ -537,6 +668,8 @@ void CPU::interrupt(MainBus &bus, InterruptType type) {
             register_PC = read_address(bus, NMI_VECTOR);
             break;
     }
+    if (profiler != nullptr)
+        profiler->interrupt(register_PC, register_SP);
     // add the number of cycles to handle the interrupt
     skip_cycles += 7;
 }
@@ -545,11 +678,22 @@ void CPU::cycle(MainBus &bus) {
     // increment the number of cycles
     ++cycles;
     // if in a skip cycle, return
-    if (skip_cycles-- > 1)
+    if (skip_cycles-- > 1) {
+        stats->count_stall();
         return;
+    }
+    stats->count_instruction();
     // reset the number of skip cycles to 0
     skip_cycles = 0;
+    // check the program counter against the breakpoints (if there are any)
+    if (breakpoints != nullptr && (breakpoints[register_PC >> 6] >> (register_PC & 63)) & 1)
+        is_breakpoint_hit = true;
+    // replay the instruction if the CPU is spinning in an idle loop
+    if (idle_state == IDLE_REPLAYING && replay_idle())
+        return;
     // read the opcode from the bus and lookup the number of cycles
+    NES_Address pc = register_PC;
+    trace->instruction(cycles, pc, register_A, register_X, register_Y, register_SP, flags.byte);
     NES_Byte op = bus.read(register_PC++);
     // Using short-circuit evaluation, call the other function only if the
     // first failed. ExecuteImplied must be called first and ExecuteBranch
@@ -558,6 +702,38 @@ void CPU::cycle(MainBus &bus) {
         skip_cycles += OPERATION_CYCLES[op];
     else
         std::cout << "failed to execute opcode: " << std::hex << +op << std::endl;
+    if (profiler != nullptr)
+        profiler->record(pc, op, skip_cycles, register_PC, register_SP);
+    if (idle_state == IDLE_REPLAYING) {
+        // an instruction that reads the PPU status was executed for real,
+        // keep replaying only if it matches the recorded iteration
+        const IdleStep& step = idle_loop[idle_index];
+        if (register_PC == step.next_pc &&
+            register_A == step.A &&
+            register_X == step.X &&
+            register_Y == step.Y &&
+            flags.byte == step.flags &&
+            skip_cycles == step.cycles
+        ) {
+            if (++idle_index == idle_length)
+                idle_index = 0;
+        } else {
+            idle_state = IDLE_NONE;
+        }
+    } else if (register_PC <= pc || idle_state == IDLE_RECORDING) {
+        track_idle(bus, pc, op);
+    }
+}
+
+void CPU::visit_state(StateVisitor& visit) {
+    visit(register_PC);
+    visit(register_SP);
+    visit(register_A);
+    visit(register_X);
+    visit(register_Y);
+    visit(flags.byte);
+    visit(skip_cycles);
+    visit(cycles);
 }
 
 }  // namespace NES
@@ -5,13 +5,32 @@
 //  Copyright (c) 2019 Christian Kauten. All rights reserved.
 //
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include "emulator.hpp"
 #include "mapper_factory.hpp"
+#include "screen_runs.hpp"
 #include "log.hpp"
+#include "sequence_trie.hpp"
+#include "thread_pool.hpp"
 
 namespace NES {
 
-Emulator::Emulator(std::string rom_path) {
+Emulator::Emulator(std::string rom_path) :
+    rom_path(rom_path),
+    num_breakpoints(0),
+    is_recording(false),
+    is_speculating_repeat(false),
+    is_autoresetting(false),
+    episode() {
+    // give the CPU and bus the counters to record events in
+    cpu.set_stats(&stats);
+    bus.set_stats(&stats);
+    // give the CPU and bus the trace to record instructions in
+    cpu.set_trace(&trace);
+    bus.set_trace(&trace);
     // set the read callbacks
     bus.set_read_callback(PPUSTATUS, [&](void) { return ppu.get_status();          });
     bus.set_read_callback(PPUDATA,   [&](void) { return ppu.get_data(picture_bus); });
@@ -33,13 +52,60 @@ Emulator::Emulator(std::string rom_path) {
     // load the ROM from disk, expect that the Python code has validated it
     cartridge.loadFromFile(rom_path);
     // create the mapper based on the mapper ID in the iNES header of the ROM
-    auto mapper = MapperFactory(&cartridge, [&](){ picture_bus.update_mirroring(); });
+    mapper = MapperFactory(&cartridge, [&](){ picture_bus.update_mirroring(); });
     // give the IO buses a pointer to the mapper
     bus.set_mapper(mapper);
     picture_bus.set_mapper(mapper);
+    // identify the game by its ROM for movies
+    const auto& prg = cartridge.getROM();
+    const auto& chr = cartridge.getVROM();
+    rom_hash = hash_combine(hash_bytes(prg.data(), prg.size()), hash_bytes(chr.data(), chr.size()));
 }
 
+Emulator::~Emulator() { delete mapper; }
+
 void Emulator::step() {
+    const uint64_t start = Telemetry::now();
+    // memory may have been changed from outside of the emulator since the
+    // last frame, so any idle loop the CPU detected has to be verified again
+    cpu.reset_idle();
+    if (is_recording) {
+        if (movie->needs_keyframe())
+            save_state(movie->add_keyframe());
+        movie->record(*get_controller(0), *get_controller(1));
+    }
+    if (transition_cache != nullptr && num_breakpoints == 0) {
+        // load the outcome of the frame if this state and input ran before
+        const NES_Hash key = TransitionCache::get_key(*this);
+        if (!transition_cache->load(key, *this)) {
+            run_frame();
+            transition_cache->store(key, *this);
+        }
+    } else {
+        run_frame();
+    }
+    // capture the state for rewinding every k frames
+    if (rewind_buffer != nullptr && rewind_buffer->advance()) {
+        save_state(rewind_buffer->get_capture());
+        rewind_buffer->commit();
+    }
+    if (trajectory != nullptr) {
+        TrajectoryStep record;
+        record.action = *get_controller(0);
+        record.second_action = *get_controller(1);
+        record.done = !program.is_empty() && program.get_result()->done;
+        record.reward = program.is_empty() ? 0 : program.get_result()->reward;
+        trajectory->record(record, get_memory_buffer(), get_screen_buffer());
+    }
+    // terminal states are not worth exploring from
+    if (cell_archive != nullptr && (program.is_empty() || !program.get_result()->done))
+        cell_archive->observe(*this, program.is_empty() ? 0 : program.get_result()->reward);
+    if (visit_counter != nullptr)
+        visit_counter->count(get_memory_buffer());
+    telemetry.record_step(start, 1);
+}
+
+void Emulator::run_frame() {
     // render a single frame on the emulator
     for (int i = 0; i < CYCLES_PER_FRAME; i++) {
         // 3 PPU steps per CPU step
@@ -48,6 +114,571 @@ void Emulator::step() {
         ppu.cycle(picture_bus);
         cpu.cycle(bus);
     }
+    stats.count_frame(ppu.is_rendering());
+    // compute the rewards and flags for the frame from the RAM
+    if (!program.is_empty())
+        program.evaluate(bus.get_memory_buffer());
+}
+
+void Emulator::set_breakpoint(NES_Address address, bool is_enabled) {
+    if (breakpoints.empty())
+        breakpoints.resize(0x10000 / 64, 0);
+    uint64_t& word = breakpoints[address >> 6];
+    const uint64_t bit = uint64_t(1) << (address & 63);
+    if (is_enabled != static_cast<bool>(word & bit))
+        num_breakpoints += is_enabled ? 1 : -1;
+    word = is_enabled ? word | bit : word & ~bit;
+    // only give the CPU the bitmap when a breakpoint is set so the check in
+    // the instruction fetch is a single null test otherwise
+    cpu.set_breakpoints(num_breakpoints ? breakpoints.data() : nullptr);
+}
+
+void Emulator::set_profiler(bool is_enabled) {
+    profiler.reset(is_enabled ? new Profiler(mapper) : nullptr);
+    cpu.set_profiler(profiler.get());
+}
+
+int Emulator::run_until(RAMProgram& condition, int max_frames, bool* is_triggered) {
+    *is_triggered = false;
+    cpu.clear_is_breakpoint_hit();
+    if (!condition.is_empty())
+        condition.reset(bus.get_memory_buffer());
+    for (int frame = 1; frame <= max_frames; frame++) {
+        step();
+        if (cpu.get_is_breakpoint_hit()) {
+            *is_triggered = true;
+            return frame;
+        }
+        if (!condition.is_empty()) {
+            condition.evaluate(bus.get_memory_buffer());
+            if (condition.get_result()->done) {
+                *is_triggered = true;
+                return frame;
+            }
+        }
+    }
+    return max_frames;
+}
+
+void Emulator::visit_state(StateVisitor& visit) {
+    cpu.visit_state(visit);
+    bus.visit_state(visit);
+    ppu.visit_state(visit);
+    picture_bus.visit_state(visit);
+    mapper->visit_state(visit);
+    controllers[0].visit_state(visit);
+    controllers[1].visit_state(visit);
+}
+
+NES_Hash Emulator::get_state_hash() {
+    StateHasher hasher;
+    visit_state(hasher);
+    return hasher.digest();
+}
+
+void Emulator::start_recording(int keyframe_interval) {
+    movie.reset(new Movie(keyframe_interval, state_size(), rom_hash));
+    save_state(movie->add_keyframe());
+    is_recording = true;
+}
+
+bool Emulator::seek(int frame) {
+    if (movie == nullptr || is_recording || frame < 0 || frame > movie->get_num_frames())
+        return false;
+    const int interval = movie->get_keyframe_interval();
+    const int keyframe = std::min(frame / interval, movie->get_num_keyframes() - 1);
+    if (!load_state(movie->get_keyframe(keyframe)))
+        return false;
+    const NES_Byte* inputs = movie->get_inputs();
+    for (int index = keyframe * interval; index < frame; index++) {
+        *get_controller(0) = inputs[2 * index];
+        *get_controller(1) = inputs[2 * index + 1];
+        step();
+    }
+    return true;
+}
+
+bool Emulator::save_movie(const std::string& path, bool has_keyframes) {
+    return movie != nullptr && movie->save(path, has_keyframes);
+}
+
+bool Emulator::load_movie(const std::string& path) {
+    std::unique_ptr<Movie> loaded(new Movie(1, state_size(), rom_hash));
+    if (!loaded->load(path) || loaded->get_rom_hash() != rom_hash)
+        return false;
+    const int interval = loaded->get_keyframe_interval();
+    const int num_frames = loaded->get_num_frames();
+    const int num_keyframes = num_frames ? (num_frames - 1) / interval + 1 : 1;
+    // check the keyframes of the file on a clone before replacing the movie
+    reserve_clones(1);
+    for (int keyframe = 0; keyframe < loaded->get_num_keyframes(); keyframe++)
+        if (!clones[0]->load_state(loaded->get_keyframe(keyframe)))
+            return false;
+    if (loaded->get_num_keyframes() < num_keyframes) {
+        // rebuild the keyframes by replaying the movie from the first one
+        loaded->clear_keyframes();
+        load_state(loaded->get_keyframe(0));
+        const NES_Byte* inputs = loaded->get_inputs();
+        for (int frame = 0; frame < num_frames; frame++) {
+            if (frame && frame % interval == 0)
+                save_state(loaded->add_keyframe());
+            *get_controller(0) = inputs[2 * frame];
+            *get_controller(1) = inputs[2 * frame + 1];
+            step();
+        }
+    }
+    movie.swap(loaded);
+    is_recording = false;
+    return seek(0);
+}
+
+void Emulator::set_rewind(int interval, std::size_t max_bytes) {
+    if (interval <= 0) {
+        rewind_buffer.reset();
+        return;
+    }
+    rewind_buffer.reset(new RewindBuffer(interval, state_size(), max_bytes));
+    save_state(rewind_buffer->get_latest());
+}
+
+int64_t Emulator::rewind(int64_t frames_back) {
+    if (rewind_buffer == nullptr)
+        return -1;
+    expand_state.resize(state_size());
+    int64_t rewound = rewind_buffer->rewind(frames_back, expand_state.data());
+    load_state(expand_state.data());
+    return rewound;
+}
+
+void Emulator::set_speculation(bool is_enabled, bool is_repeat) {
+    if (!is_enabled) {
+        speculator.reset();
+        return;
+    }
+    if (speculator == nullptr)
+        speculator.reset(new Speculator(rom_path));
+    is_speculating_repeat = is_repeat;
+}
+
+void Emulator::speculate(const NES_Byte* actions, int num_actions, int frames) {
+    if (speculator != nullptr)
+        speculator->start(*this, actions, num_actions, frames);
+}
+
+bool Emulator::step_speculative(int frames) {
+    const uint64_t start = Telemetry::now();
+    const Speculator::Branch* branch = nullptr;
+    if (speculator != nullptr) {
+        if (is_observing_frames())
+            speculator->cancel();
+        else
+            branch = speculator->finish(*this, frames);
+    }
+    if (branch != nullptr) {
+        load_state(branch->state.data());
+        std::memcpy(get_screen_buffer(), branch->screen.data(), sizeof(NES_Pixel) * WIDTH * HEIGHT);
+        program = branch->program;
+        telemetry.record_step(start, frames);
+    } else {
+        for (int frame = 0; frame < frames; frame++)
+            step();
+    }
+    if (speculator != nullptr && is_speculating_repeat)
+        speculator->start(*this, get_controller(0), 1, frames);
+    return branch != nullptr;
+}
+
+void Emulator::set_transition_cache(std::size_t max_bytes, bool is_caching_screens) {
+    if (max_bytes == 0)
+        transition_cache.reset();
+    else
+        transition_cache.reset(new TransitionCache(max_bytes, is_caching_screens));
+}
+
+void Emulator::set_start_pool(int max_noops, NES_Byte noop_action, uint64_t seed) {
+    if (max_noops < 0)
+        start_pool.reset();
+    else
+        start_pool.reset(new StartPool(max_noops, noop_action, seed));
+}
+
+bool Emulator::add_start(const NES_Byte* state, const NES_Pixel* screen) {
+    if (start_pool == nullptr || screen == nullptr)
+        return false;
+    // check the state and step its no-op variants on a clone to keep the
+    // state of this emulator
+    reserve_clones(1);
+    Emulator& clone = *clones[0];
+    if (!clone.load_state(state))
+        return false;
+    const std::size_t size = state_size();
+    start_pool->add(state, size, screen);
+    if (start_pool->get_max_noops() == 0)
+        return true;
+    *clone.get_controller(0) = start_pool->get_noop_action();
+    *clone.get_controller(1) = 0;
+    std::vector<NES_Byte> variant(size);
+    for (int noops = 1; noops <= start_pool->get_max_noops(); noops++) {
+        clone.step();
+        clone.save_state(variant.data());
+        start_pool->add(variant.data(), size, clone.get_screen_buffer());
+    }
+    return true;
+}
+
+bool Emulator::reset_to_start() {
+    const uint64_t begin = Telemetry::now();
+    const StartPool::Start* start = start_pool == nullptr ? nullptr : start_pool->sample();
+    if (start == nullptr)
+        return false;
+    load_state(start->state.data());
+    decode_screen_runs(start->runs.data(), start->runs.size() / 2, get_screen_buffer());
+    if (!program.is_empty())
+        program.reset(bus.get_memory_buffer());
+    episode.episode_return = 0;
+    episode.episode_length = 0;
+    telemetry.record(LATENCY_RESET, begin);
+    return true;
+}
+
+bool Emulator::step_episode(int frames) {
+    bool is_done = false;
+    for (int frame = 0; frame < frames && !is_done; frame++) {
+        step();
+        if (!program.is_empty()) {
+            episode.episode_return += program.get_result()->reward;
+            is_done = program.get_result()->done;
+        }
+    }
+    episode.episode_length++;
+    if (!is_done)
+        return false;
+    episode.final_return = episode.episode_return;
+    episode.final_length = episode.episode_length;
+    episode.num_episodes++;
+    episode.episode_return = 0;
+    episode.episode_length = 0;
+    if (is_autoresetting) {
+        // keep the outputs of the last frame of the episode for the caller
+        const RAMProgramResult result = *program.get_result();
+        if (reset_to_start()) {
+            *program.get_result() = result;
+            if (cell_archive != nullptr)
+                cell_archive->begin(*this);
+        }
+    }
+    return true;
+}
+
+bool Emulator::start_trajectory(const std::string& path, uint32_t chunk_steps) {
+    trajectory.reset(new TrajectoryRecorder(WIDTH, HEIGHT, 0x800, chunk_steps, rom_hash));
+    if (trajectory->open(path))
+        return true;
+    trajectory.reset();
+    return false;
+}
+
+bool Emulator::stop_trajectory() {
+    if (trajectory == nullptr)
+        return false;
+    const bool is_written = trajectory->close();
+    trajectory.reset();
+    return is_written;
+}
+
+void Emulator::set_cell_archive(
+    int frame_width,
+    int frame_height,
+    int frame_depth,
+    const NES_Address* addresses,
+    const NES_Byte* divisors,
+    int num_addresses,
+    uint64_t seed
+) {
+    cell_archive.reset(new CellArchive(
+        frame_width,
+        frame_height,
+        frame_depth,
+        addresses,
+        divisors,
+        num_addresses,
+        seed
+    ));
+}
+
+void Emulator::set_visit_counter(
+    const NES_Address* addresses,
+    int num_addresses,
+    const NES_Address* tuple_addresses,
+    const int* tuple_sizes,
+    int num_tuples,
+    int table_bits,
+    double scale
+) {
+    visit_counter.reset(new VisitCounter(
+        addresses,
+        num_addresses,
+        tuple_addresses,
+        tuple_sizes,
+        num_tuples,
+        table_bits,
+        scale
+    ));
+}
+
+bool Emulator::restore_cell(const CellArchive::Cell* cell, bool is_chosen) {
+    if (cell == nullptr)
+        return false;
+    const uint64_t start = Telemetry::now();
+    cell_archive->restore(*this, *cell, is_chosen);
+    if (!program.is_empty())
+        program.reset(bus.get_memory_buffer());
+    telemetry.record(LATENCY_RESET, start);
+    return true;
+}
+
+std::size_t Emulator::state_size() {
+    StateSizer sizer;
+    visit_state(sizer);
+    return sizer.get_size();
+}
+
+void Emulator::save_state(NES_Byte* buffer) {
+    StateWriter writer(buffer);
+    visit_state(writer);
+}
+
+bool Emulator::load_state(const NES_Byte* buffer) {
+    StateReader reader(buffer);
+    visit_state(reader);
+    // the loaded code may differ from the code of a detected idle loop
+    cpu.reset_idle();
+    trace.load(cpu.get_cycles());
+    return reader.get_is_valid();
+}
+
+void Emulator::reserve_clones(std::size_t count) {
+    // create the clones on the calling thread, they persist between calls so
+    // the ROM is only loaded the first time each clone is needed
+    while (clones.size() < count)
+        clones.emplace_back(new Emulator(rom_path));
+    // the clones step states of this emulator, so they share its cache
+    for (auto& clone : clones)
+        clone->share_transition_cache(*this);
+}
+
+void Emulator::expand(
+    const NES_Byte* actions,
+    int num_actions,
+    int frames,
+    NES_Pixel* screens,
+    NES_Byte* ram,
+    NES_Byte* states
+) {
+    if (num_actions <= 0)
+        return;
+    const std::size_t size = state_size();
+    expand_state.resize(size);
+    save_state(expand_state.data());
+    reserve_clones(num_actions);
+    const NES_Byte second_controller = *get_controller(1);
+    ThreadPool::shared().parallel_for(num_actions, [&](std::size_t index) {
+        Emulator& clone = *clones[index];
+        clone.load_state(expand_state.data());
+        *clone.get_controller(0) = actions[index];
+        *clone.get_controller(1) = second_controller;
+        for (int frame = 0; frame < frames; frame++)
+            clone.step();
+        if (screens != nullptr)
+            std::memcpy(screens + index * WIDTH * HEIGHT,
+                clone.get_screen_buffer(), sizeof(NES_Pixel) * WIDTH * HEIGHT);
+        if (ram != nullptr)
+            std::memcpy(ram + index * 0x800, clone.get_memory_buffer(), 0x800);
+        if (states != nullptr)
+            clone.save_state(states + index * size);
+    });
+}
+
+int64_t Emulator::evaluate_sequences(
+    const NES_Byte* actions,
+    const int* lengths,
+    int num_sequences,
+    RAMProgram& program,
+    RAMProgramResult* results,
+    int* frames,
+    NES_Byte* ram
+) {
+    if (num_sequences <= 0)
+        return 0;
+    const SequenceTrie trie(actions, lengths, num_sequences);
+    const std::size_t size = state_size();
+    if (!program.is_empty())
+        program.reset(bus.get_memory_buffer());
+    // a branch of the trie to evaluate: the node to step into from a state
+    // with the program and the reward summed along the path to the state
+    struct Task {
+        uint32_t node;
+        std::shared_ptr<const std::vector<NES_Byte>> state;
+        RAMProgram program;
+        double reward;
+    };
+    std::vector<Task> tasks;
+    std::mutex lock;
+    std::condition_variable task_pushed;
+    // the number of tasks that are queued or running
+    std::size_t num_outstanding = 0;
+    std::atomic<int64_t> num_frames(0);
+
+    // write the result of each sequence that ends at a node (or of all the
+    // sequences below the node if the program stopped at it)
+    auto finish = [&](const std::vector<uint32_t>& sequences, Emulator& emulator,
+        const RAMProgram& program, double reward, int depth) {
+        for (uint32_t sequence : sequences) {
+            RAMProgramResult result = program.is_empty() ?
+                RAMProgramResult() : *program.get_result();
+            result.reward = reward;
+            results[sequence] = result;
+            frames[sequence] = depth;
+            if (ram != nullptr)
+                std::memcpy(ram + sequence * 0x800, emulator.get_memory_buffer(), 0x800);
+        }
+    };
+    // queue a task for each child of a node after the first
+    auto branch = [&](const SequenceTrie::Node& node, Emulator& emulator,
+        const RAMProgram& program, double reward) {
+        auto state = std::make_shared<std::vector<NES_Byte>>(size);
+        emulator.save_state(state->data());
+        std::lock_guard<std::mutex> guard(lock);
+        for (std::size_t child = 1; child < node.children.size(); child++)
+            tasks.push_back(Task{node.children[child], state, program, reward});
+        num_outstanding += node.children.size() - 1;
+        task_pushed.notify_all();
+    };
+    // run a task depth first, following the first child at each branch
+    auto run = [&](Task& task, Emulator& clone) {
+        clone.load_state(task.state->data());
+        *clone.get_controller(1) = *get_controller(1);
+        uint32_t index = task.node;
+        for (;;) {
+            const SequenceTrie::Node& node = trie[index];
+            *clone.get_controller(0) = node.action;
+            clone.step();
+            num_frames++;
+            if (!task.program.is_empty()) {
+                task.program.evaluate(clone.get_memory_buffer());
+                task.reward += task.program.get_result()->reward;
+                if (task.program.get_result()->done) {
+                    std::vector<uint32_t> sequences;
+                    trie.collect(index, sequences);
+                    finish(sequences, clone, task.program, task.reward, node.depth);
+                    return;
+                }
+            }
+            finish(node.sequences, clone, task.program, task.reward, node.depth);
+            if (node.children.empty())
+                return;
+            if (node.children.size() > 1)
+                branch(node, clone, task.program, task.reward);
+            index = node.children[0];
+        }
+    };
+
+    // the empty sequences end at the current state, the rest branch from it
+    if (!trie[0].sequences.empty()) {
+        RAMProgram current = program;
+        if (!current.is_empty())
+            current.evaluate(bus.get_memory_buffer());
+        finish(trie[0].sequences, *this, current, 0, 0);
+    }
+    if (trie[0].children.empty())
+        return 0;
+    auto root = std::make_shared<std::vector<NES_Byte>>(size);
+    save_state(root->data());
+    for (uint32_t child : trie[0].children)
+        tasks.push_back(Task{child, root, program, 0});
+    num_outstanding = tasks.size();
+    // run a worker with its own clone on each thread of the pool
+    const std::size_t num_workers = ThreadPool::shared().get_concurrency();
+    reserve_clones(num_workers);
+    ThreadPool::shared().parallel_for(num_workers, [&](std::size_t worker) {
+        for (;;) {
+            std::unique_lock<std::mutex> guard(lock);
+            task_pushed.wait(guard, [&]() {
+                return !tasks.empty() || num_outstanding == 0;
+            });
+            if (tasks.empty())
+                return;
+            Task task = std::move(tasks.back());
+            tasks.pop_back();
+            guard.unlock();
+            run(task, *clones[worker]);
+            guard.lock();
+            if (--num_outstanding == 0)
+                task_pushed.notify_all();
+        }
+    });
+    return num_frames;
+}
+
+double Emulator::rollout(
+    const RAMPolicy& policy,
+    RAMProgram& program,
+    int max_steps,
+    int frame_skip,
+    int* steps
+) {
+    NES_Byte* ram = bus.get_memory_buffer();
+    if (!program.is_empty())
+        program.reset(ram);
+    double total = 0;
+    for (*steps = 0; *steps < max_steps;) {
+        *get_controller(0) = policy.act(ram);
+        ++*steps;
+        for (int frame = 0; frame < frame_skip; frame++) {
+            step();
+            if (program.is_empty())
+                continue;
+            program.evaluate(ram);
+            total += program.get_result()->reward;
+            if (program.get_result()->done)
+                return total;
+        }
+    }
+    return total;
+}
+
+void Emulator::rollout_batch(
+    const RAMPolicy& policy,
+    const double* weights,
+    int num_policies,
+    const RAMProgram& program,
+    int max_steps,
+    int frame_skip,
+    double* returns,
+    int* steps
+) {
+    if (num_policies <= 0)
+        return;
+    expand_state.resize(state_size());
+    save_state(expand_state.data());
+    const std::size_t num_weights = policy.get_num_weights();
+    // run a worker with its own clone on each thread of the pool, each one
+    // claims the next member of the population until none are left
+    const std::size_t num_workers = std::min<std::size_t>(
+        ThreadPool::shared().get_concurrency(), num_policies);
+    reserve_clones(num_workers);
+    std::atomic<int> next_policy(0);
+    ThreadPool::shared().parallel_for(num_workers, [&](std::size_t worker) {
+        Emulator& clone = *clones[worker];
+        RAMPolicy member = policy;
+        for (int index = next_policy++; index < num_policies; index = next_policy++) {
+            member.set_weights(weights + index * num_weights);
+            RAMProgram episode = program;
+            clone.load_state(expand_state.data());
+            *clone.get_controller(1) = *get_controller(1);
+            returns[index] = clone.rollout(member, episode, max_steps, frame_skip, &steps[index]);
+        }
+    });
 }
 
 }  // namespace NES
@@ -5,9 +5,18 @@
 //  Copyright (c) 2019 Christian Kauten. All rights reserved.
 //
 
+#include <algorithm>
+#include <limits>
 #include <string>
+#include <vector>
 #include "common.hpp"
+#include "async_batch.hpp"
 #include "emulator.hpp"
+#include "palette.hpp"
+#include "shm_channel.hpp"
+#include "socket_server.hpp"
+#include "state_archive.hpp"
+#include "trajectory.hpp"
 
 // Windows-base systems
 #if defined(_WIN32) || defined(WIN32) || defined(__CYGWIN__) || defined(__MINGW32__) || defined(__BORLANDC__)
@@ -57,6 +66,103 @@ extern "C" {
         return emu->get_memory_buffer();
     }
 
+    /// Return a 64-bit hash of the machine state
+    EXP uint64_t StateHash(NES::Emulator* emu) {
+        return emu->get_state_hash();
+    }
+
+    /// Return a 64-bit hash of the screen buffer
+    EXP uint64_t ScreenHash(NES::Emulator* emu) {
+        return emu->get_screen_hash();
+    }
+
+    /// Load a RAM program to evaluate after each step, return false if the
+    /// bytecode is invalid
+    EXP bool SetProgram(
+        NES::Emulator* emu,
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants
+    ) {
+        emu->cancel_speculation();
+        return emu->get_program()->load(code, code_length, constants, num_constants);
+    }
+
+    /// Record the current values of the deltas in the RAM program
+    EXP void ResetProgram(NES::Emulator* emu) {
+        emu->cancel_speculation();
+        emu->get_program()->reset(emu->get_memory_buffer());
+    }
+
+    /// Return the pointer to the outputs of the RAM program
+    EXP NES::RAMProgramResult* ProgramResult(NES::Emulator* emu) {
+        return emu->get_program()->get_result();
+    }
+
+    /// Enable or disable a breakpoint on a program counter address
+    EXP void SetBreakpoint(NES::Emulator* emu, int address, bool is_enabled) {
+        emu->set_breakpoint(address, is_enabled);
+    }
+
+    /// Run frames until a RAM condition holds or a breakpoint is hit and
+    /// return the number of frames that elapsed (-1 if the condition is an
+    /// invalid RAM program)
+    EXP int RunUntil(
+        NES::Emulator* emu,
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants,
+        int max_frames,
+        bool* is_triggered
+    ) {
+        NES::RAMProgram condition;
+        if (!condition.load(code, code_length, constants, num_constants))
+            return -1;
+        return emu->run_until(condition, max_frames, is_triggered);
+    }
+
+    /// Return the pointer to the instrumentation counters of the emulator
+    EXP const NES::StatsCounters* Stats(NES::Emulator* emu) {
+        return emu->get_stats()->get_counters();
+    }
+
+    /// Set the instrumentation counters of the emulator to zero
+    EXP void ResetStats(NES::Emulator* emu) {
+        emu->get_stats()->reset();
+    }
+
+    /// Enable or disable the profiler of the 6502 code
+    EXP void SetProfiler(NES::Emulator* emu, bool is_enabled) {
+        emu->set_profiler(is_enabled);
+    }
+
+    /// Write the samples of the profiler to a file and return true if the
+    /// file was written (false if profiling is off or the file failed)
+    EXP bool DumpProfile(NES::Emulator* emu, wchar_t* path, bool is_folded) {
+        if (emu->get_profiler() == nullptr)
+            return false;
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string profile_path(ws_path.begin(), ws_path.end());
+        return emu->get_profiler()->dump(profile_path, is_folded);
+    }
+
+    /// Write the instruction trace to a file and return true if the file was
+    /// written (false if the library was built without trace)
+    EXP bool DumpTrace(NES::Emulator* emu, wchar_t* path) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string trace_path(ws_path.begin(), ws_path.end());
+        return emu->get_trace()->dump(trace_path);
+    }
+
+    /// Discard the records of the instruction trace
+    EXP void ResetTrace(NES::Emulator* emu) {
+        emu->get_trace()->reset();
+    }
+
     /// Reset the emulator
     EXP void Reset(NES::Emulator* emu) {
         emu->reset();
@@ -77,6 +183,759 @@ extern "C" {
         emu->restore();
     }
 
+    /// Return the number of bytes in the serialized machine state
+    EXP int StateSize(NES::Emulator* emu) {
+        return emu->state_size();
+    }
+
+    /// Serialize the machine state into a buffer of StateSize bytes
+    EXP void SaveState(NES::Emulator* emu, NES::NES_Byte* buffer) {
+        emu->save_state(buffer);
+    }
+
+    /// Deserialize the machine state from a buffer of StateSize bytes and
+    /// return false if the state is invalid
+    EXP bool LoadState(NES::Emulator* emu, const NES::NES_Byte* buffer) {
+        return emu->load_state(buffer);
+    }
+
+    /// Step a clone of the machine state for each of K actions in parallel
+    /// and write the screens, RAM, and states of the clones to the outputs
+    /// (any output may be null to skip it)
+    EXP void Expand(
+        NES::Emulator* emu,
+        const NES::NES_Byte* actions,
+        int num_actions,
+        int frames,
+        NES::NES_Pixel* out_screens,
+        NES::NES_Byte* out_ram,
+        NES::NES_Byte* out_states
+    ) {
+        emu->expand(actions, num_actions, frames, out_screens, out_ram, out_states);
+    }
+
+    /// Evaluate a batch of open-loop action sequences with a RAM program
+    /// through a prefix trie and return the number of frames emulated (-1
+    /// if the program is invalid)
+    EXP int64_t EvaluateSequences(
+        NES::Emulator* emu,
+        const NES::NES_Byte* actions,
+        const int* lengths,
+        int num_sequences,
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants,
+        NES::RAMProgramResult* out_results,
+        int* out_frames,
+        NES::NES_Byte* out_ram
+    ) {
+        NES::RAMProgram program;
+        if (!program.load(code, code_length, constants, num_constants))
+            return -1;
+        return emu->evaluate_sequences(
+            actions,
+            lengths,
+            num_sequences,
+            program,
+            out_results,
+            out_frames,
+            out_ram
+        );
+    }
+
+    /// Run an episode with a native RAM policy in the loop and return the
+    /// return of the episode (NaN if the policy or the RAM program is
+    /// invalid, in which case steps is -1)
+    EXP double Rollout(
+        NES::Emulator* emu,
+        int kind,
+        const int32_t* addresses,
+        const int32_t* shifts,
+        int num_features,
+        const double* weights,
+        int num_weights,
+        const NES::NES_Byte* actions,
+        int num_actions,
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants,
+        int max_steps,
+        int frame_skip,
+        int* steps
+    ) {
+        NES::RAMPolicy policy;
+        NES::RAMProgram program;
+        *steps = -1;
+        if (!policy.load(kind, addresses, shifts, num_features, weights, num_weights, actions, num_actions) ||
+            !program.load(code, code_length, constants, num_constants))
+            return std::numeric_limits<double>::quiet_NaN();
+        return emu->rollout(policy, program, max_steps, frame_skip, steps);
+    }
+
+    /// Run an episode for each member of a population of native RAM
+    /// policies in parallel from the current state and return false if the
+    /// policy or the RAM program is invalid
+    EXP bool RolloutBatch(
+        NES::Emulator* emu,
+        int kind,
+        const int32_t* addresses,
+        const int32_t* shifts,
+        int num_features,
+        const double* weights,
+        int num_weights,
+        int num_policies,
+        const NES::NES_Byte* actions,
+        int num_actions,
+        const int32_t* code,
+        int code_length,
+        const double* constants,
+        int num_constants,
+        int max_steps,
+        int frame_skip,
+        double* out_returns,
+        int* out_steps
+    ) {
+        NES::RAMPolicy policy;
+        NES::RAMProgram program;
+        if (!policy.load(kind, addresses, shifts, num_features, weights, num_weights, actions, num_actions) ||
+            !program.load(code, code_length, constants, num_constants))
+            return false;
+        emu->rollout_batch(
+            policy,
+            weights,
+            num_policies,
+            program,
+            max_steps,
+            frame_skip,
+            out_returns,
+            out_steps
+        );
+        return true;
+    }
+
+    /// Start recording a movie of the controller input with a keyframe
+    /// every keyframe_interval frames
+    EXP void StartRecording(NES::Emulator* emu, int keyframe_interval) {
+        emu->start_recording(keyframe_interval);
+    }
+
+    /// Stop recording the movie of the controller input
+    EXP void StopRecording(NES::Emulator* emu) {
+        emu->stop_recording();
+    }
+
+    /// Return the number of frames in the movie (-1 if there is none)
+    EXP int MovieFrames(NES::Emulator* emu) {
+        return emu->get_movie() == nullptr ? -1 : emu->get_movie()->get_num_frames();
+    }
+
+    /// Return the pointer to the input of the movie (two bytes per frame)
+    EXP const NES::NES_Byte* MovieInputs(NES::Emulator* emu) {
+        return emu->get_movie() == nullptr ? nullptr : emu->get_movie()->get_inputs();
+    }
+
+    /// Put the emulator in the state after a frame of the movie and return
+    /// false if the frame is out of range or there is no movie to seek
+    EXP bool Seek(NES::Emulator* emu, int frame) {
+        return emu->seek(frame);
+    }
+
+    /// Write the movie to a file and return true if the file was written
+    EXP bool SaveMovie(NES::Emulator* emu, wchar_t* path, bool has_keyframes) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string movie_path(ws_path.begin(), ws_path.end());
+        return emu->save_movie(movie_path, has_keyframes);
+    }
+
+    /// Read a movie from a file and seek to its first frame, return false if
+    /// the file is invalid or belongs to another ROM
+    EXP bool LoadMovie(NES::Emulator* emu, wchar_t* path) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string movie_path(ws_path.begin(), ws_path.end());
+        return emu->load_movie(movie_path);
+    }
+
+    /// Capture the state every interval frames into a rewind ring buffer
+    /// with a pool of max_bytes (an interval of 0 disables rewinding)
+    EXP void SetRewind(NES::Emulator* emu, int interval, int64_t max_bytes) {
+        emu->set_rewind(interval, max_bytes < 0 ? 0 : max_bytes);
+    }
+
+    /// Rewind the emulator by at least a number of frames and return the
+    /// number of frames rewound (-1 if rewinding is off)
+    EXP int64_t Rewind(NES::Emulator* emu, int64_t frames_back) {
+        return emu->rewind(frames_back);
+    }
+
+    /// Return the number of states in the rewind buffer and write the bytes
+    /// of the pool in use to used_bytes (0 states if rewinding is off)
+    EXP int RewindStates(NES::Emulator* emu, int64_t* used_bytes) {
+        const NES::RewindBuffer* buffer = emu->get_rewind();
+        *used_bytes = buffer == nullptr ? 0 : buffer->get_used_bytes();
+        return buffer == nullptr ? 0 : buffer->get_num_states();
+    }
+
+    /// Create a batch of emulators that steps in the background
+    EXP NES::AsyncBatch* CreateBatch(NES::Emulator** emus, int num_emulators) {
+        return new NES::AsyncBatch(std::vector<NES::Emulator*>(emus, emus + num_emulators));
+    }
+
+    /// Start a step of every emulator in a batch and return false if a step
+    /// is already pending
+    EXP bool StepAsync(NES::AsyncBatch* batch, const NES::NES_Byte* actions, int frames) {
+        return batch->step(actions, frames);
+    }
+
+    /// Return true if a batch has no pending step
+    EXP bool Poll(NES::AsyncBatch* batch) {
+        return batch->poll();
+    }
+
+    /// Wait for the pending step of a batch and return the buffer with its
+    /// outputs (-1 if no step has finished)
+    EXP int Wait(NES::AsyncBatch* batch) {
+        return batch->wait();
+    }
+
+    /// Return the pointer to the screens of a buffer of a batch
+    EXP NES::NES_Pixel* BatchScreens(NES::AsyncBatch* batch, int buffer) {
+        return batch->get_screens(buffer);
+    }
+
+    /// Return the pointer to the RAM of a buffer of a batch
+    EXP NES::NES_Byte* BatchMemory(NES::AsyncBatch* batch, int buffer) {
+        return batch->get_ram(buffer);
+    }
+
+    /// Return the pointer to the RAM program results of a buffer of a batch
+    EXP NES::RAMProgramResult* BatchResults(NES::AsyncBatch* batch, int buffer) {
+        return batch->get_results(buffer);
+    }
+
+    /// Wait for the pending step of a batch and delete it
+    EXP void CloseBatch(NES::AsyncBatch* batch) {
+        delete batch;
+    }
+
+    /// Serve an emulator to one client over a new shared memory segment and
+    /// return the server (nullptr if the segment could not be created)
+    EXP NES::ShmServer* CreateShmServer(
+        NES::Emulator* emu,
+        wchar_t* name,
+        int num_slots,
+        bool is_reset_to_backup
+    ) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_name(name);
+        std::string shm_name(ws_name.begin(), ws_name.end());
+        auto server = new NES::ShmServer(emu, is_reset_to_backup);
+        if (num_slots < 1 || !server->open(shm_name, num_slots)) {
+            delete server;
+            return nullptr;
+        }
+        return server;
+    }
+
+    /// Stop a shared memory server and remove its segment
+    EXP void CloseShmServer(NES::ShmServer* server) {
+        delete server;
+    }
+
+    /// Connect to the shared memory segment of a server and return the
+    /// client (nullptr if there is no such server)
+    EXP NES::ShmClient* ShmConnect(wchar_t* name) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_name(name);
+        std::string shm_name(ws_name.begin(), ws_name.end());
+        auto client = new NES::ShmClient();
+        if (!client->connect(shm_name)) {
+            delete client;
+            return nullptr;
+        }
+        return client;
+    }
+
+    /// Return the number of response slots of a shared memory client
+    EXP int ShmNumSlots(NES::ShmClient* client) {
+        return client->get_num_slots();
+    }
+
+    /// Return the pointer to a response slot of a shared memory client
+    EXP const NES::ShmResponse* ShmSlot(NES::ShmClient* client, int index) {
+        return client->get_slot(index);
+    }
+
+    /// Send a request to the server of a shared memory client and return
+    /// false if the server closed
+    EXP bool ShmSend(NES::ShmClient* client, int command, NES::NES_Byte action, int frames) {
+        return client->send(command, action, frames);
+    }
+
+    /// Wait for the next response from the server of a shared memory client
+    /// and return its slot (-1 if the server closed)
+    EXP int ShmReceive(NES::ShmClient* client) {
+        return client->receive();
+    }
+
+    /// Disconnect a shared memory client
+    EXP void ShmDisconnect(NES::ShmClient* client) {
+        delete client;
+    }
+
+    /// Serve a batch of emulators on a background thread over a TCP port
+    /// of a host (or a Unix socket at a path if port is negative) and return
+    /// the server (nullptr if the socket could not be bound). A reset of an
+    /// emulator restores its backup if is_reset_to_backup is set for it.
+    EXP NES::SocketServer* CreateSocketServer(
+        NES::Emulator** emus,
+        bool* is_reset_to_backup,
+        int num_emulators,
+        wchar_t* address,
+        int port
+    ) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_address(address);
+        std::string socket_address(ws_address.begin(), ws_address.end());
+        auto server = new NES::SocketServer(
+            std::vector<NES::Emulator*>(emus, emus + num_emulators),
+            std::vector<bool>(is_reset_to_backup, is_reset_to_backup + num_emulators)
+        );
+        bool is_listening = port < 0 ?
+            server->listen_unix(socket_address) :
+            server->listen_tcp(socket_address, port);
+        if (!is_listening) {
+            delete server;
+            return nullptr;
+        }
+        server->start();
+        return server;
+    }
+
+    /// Return the TCP port of a socket server (-1 for a Unix socket)
+    EXP int SocketServerPort(NES::SocketServer* server) {
+        return server->get_port();
+    }
+
+    /// Stop a socket server and close its socket
+    EXP void CloseSocketServer(NES::SocketServer* server) {
+        delete server;
+    }
+
+    /// Enable or disable speculative steps, and whether each speculative
+    /// step speculates on repeating its action
+    EXP void SetSpeculation(NES::Emulator* emu, bool is_enabled, bool is_repeat) {
+        emu->set_speculation(is_enabled, is_repeat);
+    }
+
+    /// Start emulating likely next actions on spare threads
+    EXP void Speculate(NES::Emulator* emu, const NES::NES_Byte* actions, int num_actions, int frames) {
+        emu->speculate(actions, num_actions, frames);
+    }
+
+    /// Step the emulator for a number of frames, committing the outcome of
+    /// a speculation if one matches, and return true if one did
+    EXP bool StepSpeculative(NES::Emulator* emu, int frames) {
+        return emu->step_speculative(frames);
+    }
+
+    /// Write the number of speculative steps that hit and missed
+    EXP void SpeculationStats(NES::Emulator* emu, uint64_t* hits, uint64_t* misses) {
+        const NES::Speculator* speculator = emu->get_speculator();
+        *hits = speculator == nullptr ? 0 : speculator->get_hits();
+        *misses = speculator == nullptr ? 0 : speculator->get_misses();
+    }
+
+    /// Cache the outcomes of frames in max_bytes of memory (0 disables the
+    /// cache), with or without their screens
+    EXP void SetTransitionCache(NES::Emulator* emu, int64_t max_bytes, bool is_caching_screens) {
+        emu->set_transition_cache(max_bytes, is_caching_screens);
+    }
+
+    /// Use the transition cache of another emulator of the same ROM and
+    /// return false if the ROMs differ
+    EXP bool ShareTransitionCache(NES::Emulator* emu, NES::Emulator* other) {
+        return emu->share_transition_cache(*other);
+    }
+
+    /// Write the hits, misses, evictions, entries, and used bytes of the
+    /// transition cache to stats and return false if caching is off
+    EXP bool TransitionCacheStats(NES::Emulator* emu, uint64_t* stats) {
+        NES::TransitionCache* cache = emu->get_transition_cache();
+        if (cache == nullptr)
+            return false;
+        stats[0] = cache->get_hits();
+        stats[1] = cache->get_misses();
+        stats[2] = cache->get_evictions();
+        stats[3] = cache->get_num_entries();
+        stats[4] = cache->get_used_bytes();
+        return true;
+    }
+
+    /// Replace the start pool with an empty one with up to max_noops no-op
+    /// frames after each start (a negative max_noops removes the pool)
+    EXP void SetStartPool(NES::Emulator* emu, int max_noops, NES::NES_Byte noop_action, uint64_t seed) {
+        emu->set_start_pool(max_noops, noop_action, seed);
+    }
+
+    /// Add a state and its screen to the start pool (nullptr for the current
+    /// state and screen) and return false if there is no pool or the state
+    /// is invalid
+    EXP bool AddStartState(
+        NES::Emulator* emu,
+        const NES::NES_Byte* state,
+        const NES::NES_Pixel* screen
+    ) {
+        if (state != nullptr)
+            return emu->add_start(state, screen);
+        std::vector<NES::NES_Byte> current(emu->state_size());
+        emu->save_state(current.data());
+        return emu->add_start(current.data(), emu->get_screen_buffer());
+    }
+
+    /// Return the number of states in the start pool (without no-ops)
+    EXP int StartPoolSize(NES::Emulator* emu) {
+        NES::StartPool* pool = emu->get_start_pool();
+        return pool == nullptr ? 0 : pool->get_num_starts();
+    }
+
+    /// Reseed the generator of random starts of the start pool
+    EXP void SeedStartPool(NES::Emulator* emu, uint64_t seed) {
+        if (emu->get_start_pool() != nullptr)
+            emu->get_start_pool()->seed(seed);
+    }
+
+    /// Reset the emulator to a random start from the pool and return false
+    /// if the pool is empty
+    EXP bool ResetToStart(NES::Emulator* emu) {
+        return emu->reset_to_start();
+    }
+
+    /// Set whether StepEpisode resets to a start when an episode ends
+    EXP void SetAutoreset(NES::Emulator* emu, bool is_enabled) {
+        emu->set_autoreset(is_enabled);
+    }
+
+    /// Step the emulator for a number of frames, counting the reward of the
+    /// RAM program towards the episode, and return true if it ended
+    EXP bool StepEpisode(NES::Emulator* emu, int frames) {
+        return emu->step_episode(frames);
+    }
+
+    /// Return the pointer to the return and length of the episodes
+    EXP NES::EpisodeStats* Episode(NES::Emulator* emu) {
+        return emu->get_episode();
+    }
+
+    /// Map an archive of states for the ROM of an emulator (nullptr if the
+    /// file is not an archive or is for another ROM)
+    EXP NES::StateArchive* OpenArchive(wchar_t* path, NES::Emulator* emu) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string archive_path(ws_path.begin(), ws_path.end());
+        auto archive = new NES::StateArchive();
+        if (!archive->open(archive_path) ||
+            archive->get_rom_hash() != emu->get_rom_hash() ||
+            archive->get_state_size() != emu->state_size()) {
+            delete archive;
+            return nullptr;
+        }
+        return archive;
+    }
+
+    /// Return the number of committed states in an archive
+    EXP int64_t ArchiveSize(NES::StateArchive* archive) {
+        return archive->get_num_records();
+    }
+
+    /// Load a state of an archive into an emulator (straight from the mapped
+    /// file if it is not compressed) and return false if it is invalid
+    EXP bool ArchiveLoad(NES::StateArchive* archive, NES::Emulator* emu, int64_t index) {
+        if (index < 0)
+            return false;
+        const NES::NES_Byte* state = archive->get_state(index);
+        if (state != nullptr)
+            return emu->load_state(state);
+        std::vector<NES::NES_Byte> decoded(archive->get_state_size());
+        return archive->read(index, decoded.data()) && emu->load_state(decoded.data());
+    }
+
+    /// Copy a state of an archive to a buffer of StateSize bytes and return
+    /// false if it is invalid
+    EXP bool ArchiveRead(NES::StateArchive* archive, int64_t index, NES::NES_Byte* output) {
+        return index >= 0 && archive->read(index, output);
+    }
+
+    /// Return true if the bytes of a record of an archive match its hash
+    EXP bool ArchiveVerify(NES::StateArchive* archive, int64_t index) {
+        return index >= 0 && archive->verify(index);
+    }
+
+    /// Unmap an archive
+    EXP void CloseArchive(NES::StateArchive* archive) {
+        delete archive;
+    }
+
+    /// Create an archive for the ROM of an emulator or open one to append to
+    /// (nullptr if the file is not such an archive or has another writer)
+    EXP NES::StateArchiveWriter* CreateArchiveWriter(wchar_t* path, NES::Emulator* emu, bool is_compressing) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string archive_path(ws_path.begin(), ws_path.end());
+        auto writer = new NES::StateArchiveWriter();
+        if (!writer->open(archive_path, emu->state_size(), emu->get_rom_hash(), is_compressing)) {
+            delete writer;
+            return nullptr;
+        }
+        return writer;
+    }
+
+    /// Append a state of StateSize bytes to an archive and return false if
+    /// it could not be written
+    EXP bool ArchiveAppend(NES::StateArchiveWriter* writer, const NES::NES_Byte* state) {
+        return writer->append(state);
+    }
+
+    /// Return the number of states in an archive being written
+    EXP int64_t ArchiveWriterSize(NES::StateArchiveWriter* writer) {
+        return writer->get_num_records();
+    }
+
+    /// Make the appended states of an archive durable and readable, return
+    /// false if the commit failed
+    EXP bool ArchiveCommit(NES::StateArchiveWriter* writer) {
+        return writer->commit();
+    }
+
+    /// Commit and close an archive writer, return false if the commit failed
+    EXP bool CloseArchiveWriter(NES::StateArchiveWriter* writer) {
+        const bool is_committed = writer->close();
+        delete writer;
+        return is_committed;
+    }
+
+    /// Record every following step of an emulator to a trajectory file,
+    /// return false if the file could not be created
+    EXP bool StartTrajectory(NES::Emulator* emu, wchar_t* path, int chunk_steps) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string trajectory_path(ws_path.begin(), ws_path.end());
+        return chunk_steps > 0 && emu->start_trajectory(trajectory_path, chunk_steps);
+    }
+
+    /// Finish the trajectory file of an emulator, return false if a write
+    /// failed or nothing was being recorded
+    EXP bool StopTrajectory(NES::Emulator* emu) {
+        return emu->stop_trajectory();
+    }
+
+    /// Return the number of steps of the running recording of an emulator
+    EXP int64_t RecordedSteps(NES::Emulator* emu) {
+        return emu->get_trajectory_size();
+    }
+
+    /// Map a trajectory file (nullptr if it is not a trajectory)
+    EXP NES::TrajectoryReader* OpenTrajectory(wchar_t* path) {
+        // convert the c string to a c++ std string data structure
+        std::wstring ws_path(path);
+        std::string trajectory_path(ws_path.begin(), ws_path.end());
+        auto reader = new NES::TrajectoryReader();
+        if (!reader->open(trajectory_path)) {
+            delete reader;
+            return nullptr;
+        }
+        return reader;
+    }
+
+    /// Return the number of intact steps of a trajectory file
+    EXP int64_t TrajectorySize(NES::TrajectoryReader* reader) {
+        return reader->get_num_steps();
+    }
+
+    /// Return the hash of the ROM a trajectory was recorded on
+    EXP uint64_t TrajectoryROMHash(NES::TrajectoryReader* reader) {
+        return reader->get_rom_hash();
+    }
+
+    /// Decode a step of a trajectory into a step, its 0x800 bytes of RAM,
+    /// and its Width * Height palette indices (either may be nullptr), and
+    /// return false if the index is out of range or the step is malformed
+    EXP bool TrajectoryRead(
+        NES::TrajectoryReader* reader,
+        int64_t index,
+        NES::TrajectoryStep* step,
+        NES::NES_Byte* ram,
+        NES::NES_Byte* frame
+    ) {
+        return index >= 0 && reader->read(index, step, ram, frame);
+    }
+
+    /// Unmap a trajectory file
+    EXP void CloseTrajectory(NES::TrajectoryReader* reader) {
+        delete reader;
+    }
+
+    /// Return the 64 colors of the palette (in xRGB) that the palette
+    /// indices of a trajectory refer to
+    EXP const NES::NES_Pixel* Palette() {
+        return NES::PALETTE;
+    }
+
+    /// Map each following step of an emulator to a cell of a new Go-Explore
+    /// archive (see CellArchive)
+    EXP void SetCellArchive(
+        NES::Emulator* emu,
+        int frame_width,
+        int frame_height,
+        int frame_depth,
+        const NES::NES_Address* addresses,
+        const NES::NES_Byte* divisors,
+        int num_addresses,
+        uint64_t seed
+    ) {
+        emu->set_cell_archive(frame_width, frame_height, frame_depth, addresses, divisors, num_addresses, seed);
+    }
+
+    /// Discard the cell archive of an emulator
+    EXP void RemoveCellArchive(NES::Emulator* emu) {
+        emu->remove_cell_archive();
+    }
+
+    /// Start a new trajectory of the cell archive from the current state
+    EXP void BeginCells(NES::Emulator* emu) {
+        emu->begin_cells();
+    }
+
+    /// Load a random cell to explore from, return false if there is none
+    EXP bool SelectCell(NES::Emulator* emu) {
+        return emu->select_cell();
+    }
+
+    /// Load a cell by key, return false if it is not archived
+    EXP bool LoadCell(NES::Emulator* emu, uint64_t key) {
+        return emu->load_cell(key);
+    }
+
+    /// Return the number of cells in the archive of an emulator
+    EXP int64_t CellArchiveSize(NES::Emulator* emu) {
+        return emu->get_cell_archive() == nullptr ? 0 : emu->get_cell_archive()->size();
+    }
+
+    /// Copy the statistics of CellArchiveSize cells in order of discovery
+    EXP void Cells(NES::Emulator* emu, NES::CellInfo* output) {
+        if (emu->get_cell_archive() != nullptr)
+            emu->get_cell_archive()->get_cells(output);
+    }
+
+    /// Return the key of the cell of the last step of an emulator
+    EXP uint64_t CurrentCell(NES::Emulator* emu) {
+        return emu->get_cell_archive() == nullptr ? 0 : emu->get_cell_archive()->get_current();
+    }
+
+    /// Reseed the random selections of the cell archive of an emulator
+    EXP void SeedCellArchive(NES::Emulator* emu, uint64_t seed) {
+        if (emu->get_cell_archive() != nullptr)
+            emu->get_cell_archive()->seed(seed);
+    }
+
+    /// Count the RAM values of each following step of an emulator for an
+    /// exploration bonus (see VisitCounter)
+    EXP void SetVisitCounts(
+        NES::Emulator* emu,
+        const NES::NES_Address* addresses,
+        int num_addresses,
+        const NES::NES_Address* tuple_addresses,
+        const int* tuple_sizes,
+        int num_tuples,
+        int table_bits,
+        double scale
+    ) {
+        emu->set_visit_counter(addresses, num_addresses, tuple_addresses, tuple_sizes, num_tuples, table_bits, scale);
+    }
+
+    /// Stop counting the RAM values of an emulator
+    EXP void RemoveVisitCounts(NES::Emulator* emu) {
+        emu->remove_visit_counter();
+    }
+
+    /// Return the exploration bonus summed over the steps since the last call
+    EXP double TakeVisitBonus(NES::Emulator* emu) {
+        return emu->get_visit_counter() == nullptr ? 0 : emu->get_visit_counter()->take_bonus();
+    }
+
+    /// Multiply the visit counts of an emulator by a factor (0 to reset)
+    EXP void DecayVisitCounts(NES::Emulator* emu, double factor) {
+        if (emu->get_visit_counter() != nullptr)
+            emu->get_visit_counter()->decay(factor);
+    }
+
+    /// Look up the count of the current value of each address, then each
+    /// tuple, in the visit counts of an emulator
+    EXP void VisitCounts(NES::Emulator* emu, double* output) {
+        if (emu->get_visit_counter() != nullptr)
+            emu->get_visit_counter()->get_counts(emu->get_memory_buffer(), output);
+    }
+
+    /// Copy the 256 counts of the values of an address of the visit counts
+    /// to output and return false if there are no counts or no such address
+    EXP bool VisitHistogram(NES::Emulator* emu, int index, double* output) {
+        const NES::VisitCounter* counter = emu->get_visit_counter();
+        if (counter == nullptr || index < 0 || static_cast<std::size_t>(index) >= counter->get_num_addresses())
+            return false;
+        const double* histogram = counter->get_histogram(index);
+        std::copy(histogram, histogram + 256, output);
+        return true;
+    }
+
+    /// Write the count, mean, min, max, and 50th, 90th, 99th, and 99.9th
+    /// percentile (in nanoseconds) of a latency histogram of an emulator to
+    /// output and return false if the kind is invalid
+    EXP bool LatencySummary(NES::Emulator* emu, int kind, double* output) {
+        if (kind < 0 || kind >= NES::LATENCY_NUM_KINDS)
+            return false;
+        emu->get_telemetry()->get_latency(static_cast<NES::LatencyKind>(kind)).get_summary(output);
+        return true;
+    }
+
+    /// Copy the bucket counts of a latency histogram of an emulator and
+    /// return false if the kind is invalid
+    EXP bool LatencyCounts(NES::Emulator* emu, int kind, uint64_t* output) {
+        if (kind < 0 || kind >= NES::LATENCY_NUM_KINDS)
+            return false;
+        emu->get_telemetry()->get_latency(static_cast<NES::LatencyKind>(kind)).get_buckets(output);
+        return true;
+    }
+
+    /// Return the number of buckets of a latency histogram and copy the
+    /// smallest latency of each bucket (in nanoseconds) if output is not null
+    EXP int LatencyBuckets(uint64_t* output) {
+        for (std::size_t bucket = 0; output != nullptr && bucket < NES::LatencyHistogram::NUM_BUCKETS; bucket++)
+            output[bucket] = NES::LatencyHistogram::get_lower_bound(bucket);
+        return NES::LatencyHistogram::NUM_BUCKETS;
+    }
+
+    /// Record a latency (in nanoseconds) measured by the caller, i.e., of a
+    /// render, and return false if the kind is invalid
+    EXP bool RecordLatency(NES::Emulator* emu, int kind, uint64_t nanoseconds) {
+        if (kind < 0 || kind >= NES::LATENCY_NUM_KINDS)
+            return false;
+        emu->get_telemetry()->get_latency(static_cast<NES::LatencyKind>(kind)).record(nanoseconds);
+        return true;
+    }
+
+    /// Return the frames per second of an emulator over the last 4 seconds
+    EXP double FramesPerSecond(NES::Emulator* emu) {
+        return emu->get_telemetry()->get_frame_rate();
+    }
+
+    /// Reset the latency histograms and frame rate of an emulator
+    EXP void ResetTelemetry(NES::Emulator* emu) {
+        emu->get_telemetry()->reset();
+    }
+
     /// Close the emulator, i.e., purge it from memory
     EXP void Close(NES::Emulator* emu) {
         delete emu;
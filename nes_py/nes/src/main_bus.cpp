@@ -10,7 +10,7 @@
 
 namespace NES {
 
-NES_Byte MainBus::read(NES_Address address) {
+NES_Byte MainBus::load(NES_Address address) {
     if (address < 0x2000) {
         return ram[address & 0x7ff];
     } else if (address < 0x4020) {
@@ -41,7 +41,17 @@ NES_Byte MainBus::read(NES_Address address) {
     return 0;
 }
 
-void MainBus::write(NES_Address address, NES_Byte value) {
+NES_Byte MainBus::peek(NES_Address address) {
+    if (address < 0x2000)
+        return ram[address & 0x7ff];
+    else if (address < 0x6000)
+        return 0;
+    else if (address < 0x8000)
+        return mapper->hasExtendedRAM() ? extended_ram[address - 0x6000] : 0;
+    return mapper->readPRG(address);
+}
+
+void MainBus::store(NES_Address address, NES_Byte value) {
     if (address < 0x2000) {
         ram[address & 0x7ff] = value;
     } else if (address < 0x4020) {
@@ -63,8 +73,10 @@ void MainBus::write(NES_Address address, NES_Byte value) {
     } else if (address < 0x6000) {
         LOG(InfoVerbose) << "Expansion ROM access attempted. This is currently unsupported" << std::endl;
     } else if (address < 0x8000) {
-        if (mapper->hasExtendedRAM())
+        if (mapper->hasExtendedRAM()) {
             extended_ram[address - 0x6000] = value;
+            extended_ram_region.touch();
+        }
     } else {
         mapper->writePRG(address, value);
     }
@@ -91,4 +103,11 @@ void MainBus::set_mapper(Mapper* mapper) {
         extended_ram.resize(0x2000);
 }
 
+void MainBus::visit_state(StateVisitor& visit) {
+    // the RAM is exposed to Python and may be written without the bus, so
+    // it is always visited in full instead of through a region
+    visit.bytes(ram.data(), ram.size());
+    visit.region(extended_ram.data(), extended_ram.size(), extended_ram_region);
+}
+
 }  // namespace NES
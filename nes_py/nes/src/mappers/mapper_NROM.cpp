@@ -30,9 +30,10 @@ void MapperNROM::writePRG(NES_Address address, NES_Byte value) {
 }
 
 void MapperNROM::writeCHR(NES_Address address, NES_Byte value) {
-    if (has_character_ram)
+    if (has_character_ram) {
         character_ram[address] = value;
-    else
+        character_ram_region.touch();
+    } else
         LOG(Info) <<
             "Read-only CHR memory write attempt at " <<
             std::hex <<
@@ -40,4 +41,8 @@ void MapperNROM::writeCHR(NES_Address address, NES_Byte value) {
             std::endl;
 }
 
+void MapperNROM::visit_state(StateVisitor& visit) {
+    visit.region(character_ram.data(), character_ram.size(), character_ram_region);
+}
+
 }  // namespace NES
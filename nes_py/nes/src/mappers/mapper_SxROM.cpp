@@ -112,10 +112,54 @@ void MapperSxROM::calculatePRGPointers() {
 }
 
 void MapperSxROM::writeCHR(NES_Address address, NES_Byte value) {
-    if (has_character_ram)
+    if (has_character_ram) {
         character_ram[address] = value;
-    else
+        character_ram_region.touch();
+    } else
         LOG(Info) << "Read-only CHR memory write attempt at " << std::hex << address << std::endl;
 }
 
+void MapperSxROM::visit_state(StateVisitor& visit) {
+    visit(mirroring);
+    visit(mode_chr);
+    visit(mode_prg);
+    visit(temp_register);
+    visit(write_counter);
+    visit(register_prg);
+    visit(register_chr0);
+    visit(register_chr1);
+    visit(first_bank_prg);
+    visit(second_bank_prg);
+    visit(first_bank_chr);
+    visit(second_bank_chr);
+    visit.region(character_ram.data(), character_ram.size(), character_ram_region);
+    // the banks are offsets into the ROM, so they must leave room for a bank
+    const std::size_t prg_size = cartridge->getROM().size();
+    const std::size_t chr_size = cartridge->getVROM().size();
+    const bool is_in_range =
+        (mirroring == HORIZONTAL || mirroring == VERTICAL ||
+         mirroring == ONE_SCREEN_LOWER || mirroring == ONE_SCREEN_HIGHER) &&
+        mode_chr >= 0 && mode_chr <= 1 &&
+        mode_prg >= 0 && mode_prg <= 3 &&
+        write_counter >= 0 && write_counter < 5 &&
+        first_bank_prg <= prg_size - 0x4000 &&
+        second_bank_prg <= prg_size - 0x4000 &&
+        (has_character_ram || (
+            chr_size >= 0x1000 &&
+            first_bank_chr <= chr_size - 0x1000 &&
+            second_bank_chr <= chr_size - 0x1000
+        ));
+    if (!visit.check(is_in_range)) {
+        mirroring = HORIZONTAL;
+        mode_chr = 0;
+        mode_prg = 3;
+        temp_register = 0;
+        write_counter = 0;
+        register_prg = register_chr0 = register_chr1 = 0;
+        first_bank_prg = 0;
+        second_bank_prg = prg_size - 0x4000;
+        first_bank_chr = second_bank_chr = 0;
+    }
+}
+
 }  // namespace NES
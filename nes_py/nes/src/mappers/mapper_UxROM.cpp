@@ -36,9 +36,10 @@ NES_Byte MapperUxROM::readCHR(NES_Address address) {
 }
 
 void MapperUxROM::writeCHR(NES_Address address, NES_Byte value) {
-    if (has_character_ram)
+    if (has_character_ram) {
         character_ram[address] = value;
-    else
+        character_ram_region.touch();
+    } else
         LOG(Info) <<
             "Read-only CHR memory write attempt at " <<
             std::hex <<
@@ -46,4 +47,12 @@ void MapperUxROM::writeCHR(NES_Address address, NES_Byte value) {
             std::endl;
 }
 
+void MapperUxROM::visit_state(StateVisitor& visit) {
+    visit(select_prg);
+    visit.region(character_ram.data(), character_ram.size(), character_ram_region);
+    // the selected bank must be a 16KB bank of the ROM
+    if (!visit.check(select_prg < cartridge->getROM().size() >> 14))
+        select_prg = 0;
+}
+
 }  // namespace NES
@@ -0,0 +1,132 @@
+//  Program:      nes-py
+//  File:         movie.cpp
+//  Description:  A recording of controller input with periodic keyframes
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <fstream>
+#include "movie.hpp"
+
+namespace NES {
+
+/// The header of a movie file
+struct MovieHeader {
+    /// the magic string "NESMOVIE"
+    char magic[8];
+    /// the version of the format
+    uint32_t version;
+    /// the number of frames between keyframes
+    uint32_t keyframe_interval;
+    /// the hash of the ROM the movie was recorded on
+    uint64_t rom_hash;
+    /// the number of recorded frames
+    uint64_t num_frames;
+    /// the number of runs of identical input in the file
+    uint64_t num_runs;
+    /// the size of a keyframe in bytes
+    uint32_t state_size;
+    /// the number of keyframes in the file
+    uint32_t num_keyframes;
+};
+
+/// The magic string at the start of a movie file
+static const char MOVIE_MAGIC[8] = {'N', 'E', 'S', 'M', 'O', 'V', 'I', 'E'};
+
+/// The most frames a movie file may hold (about 52 days at 60 FPS), which
+/// bounds the memory of the decoded input of a corrupt file to 512MB
+static const uint64_t MOVIE_MAX_FRAMES = uint64_t(1) << 28;
+
+bool Movie::save(const std::string& path, bool has_keyframes) const {
+    // encode the input as runs of (LEB128 length, port 0, port 1)
+    std::vector<NES_Byte> runs;
+    uint64_t num_runs = 0;
+    for (std::size_t frame = 0; frame < inputs.size();) {
+        std::size_t end = frame + 2;
+        while (end < inputs.size() && inputs[end] == inputs[frame] && inputs[end + 1] == inputs[frame + 1])
+            end += 2;
+        for (uint64_t length = (end - frame) / 2; ; length >>= 7) {
+            runs.push_back((length & 0x7f) | (length > 0x7f ? 0x80 : 0));
+            if (length <= 0x7f) break;
+        }
+        runs.push_back(inputs[frame]);
+        runs.push_back(inputs[frame + 1]);
+        num_runs++;
+        frame = end;
+    }
+    const int num_keyframes = has_keyframes ? get_num_keyframes() : std::min(get_num_keyframes(), 1);
+    MovieHeader header;
+    std::copy(MOVIE_MAGIC, MOVIE_MAGIC + 8, header.magic);
+    header.version = 1;
+    header.keyframe_interval = keyframe_interval;
+    header.rom_hash = rom_hash;
+    header.num_frames = get_num_frames();
+    header.num_runs = num_runs;
+    header.state_size = state_size;
+    header.num_keyframes = num_keyframes;
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+    file.write(reinterpret_cast<const char*>(runs.data()), runs.size());
+    file.write(reinterpret_cast<const char*>(keyframes.data()), num_keyframes * state_size);
+    return file.good();
+}
+
+bool Movie::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+        return false;
+    const uint64_t size = file.tellg();
+    file.seekg(0);
+    MovieHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof header))
+        return false;
+    if (!std::equal(MOVIE_MAGIC, MOVIE_MAGIC + 8, header.magic) ||
+        header.version != 1 ||
+        header.keyframe_interval < 1 ||
+        header.keyframe_interval > MOVIE_MAX_FRAMES ||
+        header.state_size != state_size ||
+        header.num_keyframes < 1 ||
+        header.num_frames > MOVIE_MAX_FRAMES)
+        return false;
+    // each run takes at least 3 bytes and each keyframe state_size bytes
+    // of the rest of the file (checked by division to avoid overflow)
+    const uint64_t remaining = size - sizeof header;
+    if (header.num_runs > remaining / 3 ||
+        header.num_keyframes > (remaining - 3 * header.num_runs) / state_size)
+        return false;
+    // grow the input as the runs decode rather than trusting the header
+    std::vector<NES_Byte> decoded;
+    for (uint64_t run = 0; run < header.num_runs; run++) {
+        uint64_t length = 0;
+        int shift = 0;
+        int byte;
+        do {
+            byte = file.get();
+            if (byte == EOF || shift > 56)
+                return false;
+            length |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        char input[2];
+        if (!file.read(input, 2) || decoded.size() / 2 + length > header.num_frames)
+            return false;
+        for (uint64_t frame = 0; frame < length; frame++) {
+            decoded.push_back(input[0]);
+            decoded.push_back(input[1]);
+        }
+    }
+    if (decoded.size() != 2 * header.num_frames)
+        return false;
+    std::vector<NES_Byte> states(static_cast<std::size_t>(header.num_keyframes) * state_size);
+    if (!file.read(reinterpret_cast<char*>(states.data()), states.size()))
+        return false;
+    keyframe_interval = header.keyframe_interval;
+    rom_hash = header.rom_hash;
+    inputs.swap(decoded);
+    keyframes.swap(states);
+    return true;
+}
+
+}  // namespace NES
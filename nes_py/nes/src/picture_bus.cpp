@@ -5,6 +5,7 @@
 //  Copyright (c) 2019 Christian Kauten. All rights reserved.
 //
 
+#include <algorithm>
 #include "picture_bus.hpp"
 #include "log.hpp"
 
@@ -40,11 +41,13 @@ void PictureBus::write(NES_Address address, NES_Byte value) {
             ram[name_tables[2] + (address & 0x3ff)] = value;
         else  // NT3
             ram[name_tables[3] + (address & 0x3ff)] = value;
+        ram_region.touch();
     } else if (address < 0x3fff) {
+        // the palette RAM holds 6-bit colors
         if (address == 0x3f10)
-            palette[0] = value;
+            palette[0] = value & 0x3f;
         else
-            palette[address & 0x1f] = value;
+            palette[address & 0x1f] = value & 0x3f;
     }
 }
 
@@ -85,4 +88,20 @@ void PictureBus::update_mirroring() {
     }
 }
 
+void PictureBus::visit_state(StateVisitor& visit) {
+    visit.region(ram.data(), ram.size(), ram_region);
+    visit.bytes(palette.data(), palette.size());
+    visit.bytes(name_tables, sizeof name_tables);
+    // the name tables are offsets into the 2KB of VRAM and the palette holds
+    // indexes into the 64 colors of the NES
+    const bool is_in_vram = std::all_of(name_tables, name_tables + 4,
+        [](std::size_t offset) { return offset <= 0x400; });
+    if (!visit.check(is_in_vram))
+        update_mirroring();
+    const bool is_in_palette = std::all_of(palette.begin(), palette.end(),
+        [](NES_Byte color) { return color < 0x40; });
+    if (!visit.check(is_in_palette))
+        for (auto& color : palette) color &= 0x3f;
+}
+
 }  // namespace NES
@@ -5,6 +5,7 @@
 //  Copyright (c) 2019 Christian Kauten. All rights reserved.
 //
 
+#include <algorithm>
 #include <cstring>
 #include "ppu.hpp"
 #include "palette.hpp"
@@ -16,13 +17,17 @@ void PPU::reset() {
     is_long_sprites = false;
     is_interrupting = false;
     is_vblank = false;
+    is_sprite_zero_hit = false;
     is_showing_background = true;
     is_showing_sprites = true;
+    is_hiding_edge_background = false;
+    is_hiding_edge_sprites = false;
     is_even_frame = true;
     is_first_write = true;
     background_page = LOW;
     sprite_page = LOW;
     data_address = 0;
+    data_buffer = 0;
     cycles = 0;
     scanline = 0;
     sprite_data_address = 0;
@@ -367,4 +372,53 @@ void PPU::set_scroll(NES_Byte scroll) {
     }
 }
 
+void PPU::visit_state(StateVisitor& visit) {
+    visit(pipeline_state);
+    visit(cycles);
+    visit(scanline);
+    visit(is_even_frame);
+    visit(is_vblank);
+    visit(is_sprite_zero_hit);
+    visit(data_address);
+    visit(temp_address);
+    visit(fine_x_scroll);
+    visit(is_first_write);
+    visit(data_buffer);
+    visit(sprite_data_address);
+    visit(is_showing_sprites);
+    visit(is_showing_background);
+    visit(is_hiding_edge_sprites);
+    visit(is_hiding_edge_background);
+    visit(is_long_sprites);
+    visit(is_interrupting);
+    visit(background_page);
+    visit(sprite_page);
+    visit(data_address_increment);
+    visit.bytes(sprite_memory.data(), sprite_memory.size());
+    // the sprites on the next scanline are a list of up to 8 OAM indexes,
+    // visit them as a fixed size block so the state has a constant size
+    NES_Byte sprites[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    NES_Byte num_sprites = scanline_sprites.size();
+    std::copy(scanline_sprites.begin(), scanline_sprites.end(), sprites);
+    visit(num_sprites);
+    visit(sprites);
+    scanline_sprites.assign(sprites, sprites + std::min<NES_Byte>(num_sprites, 8));
+    // the scan line and cycle index the screen and the sprites index OAM
+    const bool is_in_range =
+        pipeline_state >= PRE_RENDER && pipeline_state <= VERTICAL_BLANK &&
+        scanline >= 0 && scanline <= FRAME_END_SCANLINE &&
+        (pipeline_state != RENDER || scanline < VISIBLE_SCANLINES) &&
+        cycles >= 0 && cycles <= SCANLINE_END_CYCLE &&
+        fine_x_scroll < 8 &&
+        background_page <= HIGH && sprite_page <= HIGH &&
+        std::all_of(sprites, sprites + 8, [](NES_Byte sprite) { return sprite < 64; });
+    if (!visit.check(is_in_range)) {
+        pipeline_state = PRE_RENDER;
+        cycles = scanline = 0;
+        fine_x_scroll = 0;
+        background_page = sprite_page = LOW;
+        scanline_sprites.resize(0);
+    }
+}
+
 }  // namespace NES
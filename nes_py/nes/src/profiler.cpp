@@ -0,0 +1,78 @@
+//  Program:      nes-py
+//  File:         profiler.cpp
+//  Description:  A profiler for the 6502 code running on the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include "profiler.hpp"
+
+namespace NES {
+
+Profiler::Profiler(Mapper* mapper) : mapper(mapper) { reset(); }
+
+void Profiler::reset() {
+    counts.clear();
+    children.clear();
+    stack.clear();
+    nodes.assign(1, Node{0, 0, 0});
+}
+
+void Profiler::push(uint32_t label, NES_Byte stack_pointer) {
+    // games that never return from a routine would grow the stack without
+    // bound, so forget the outermost routine when the stack is full
+    if (stack.size() == MAX_DEPTH)
+        stack.erase(stack.begin());
+    uint32_t parent = stack.empty() ? 0 : stack.back().node;
+    uint64_t key = static_cast<uint64_t>(parent) << 32 | label;
+    auto child = children.find(key);
+    if (child == children.end()) {
+        child = children.insert({key, static_cast<uint32_t>(nodes.size())}).first;
+        nodes.push_back(Node{parent, label, 0});
+    }
+    stack.push_back(Frame{child->second, stack_pointer});
+}
+
+std::string Profiler::get_name(uint32_t label) {
+    char name[16];
+    std::snprintf(name, sizeof name, "%s%02X:%04X",
+        label & INTERRUPT_LABEL ? "int_" : "",
+        (label >> 16) & 0xff,
+        label & 0xffff
+    );
+    return name;
+}
+
+bool Profiler::dump(const std::string& path, bool is_folded) const {
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    if (is_folded) {
+        // write the path from the root to each node with its own cycles
+        for (std::size_t index = 1; index < nodes.size(); index++) {
+            if (nodes[index].cycles == 0)
+                continue;
+            std::string line;
+            for (uint32_t node = index; node != 0; node = nodes[node].parent)
+                line = get_name(nodes[node].label) + (line.empty() ? "" : ";") + line;
+            file << "main;" << line << " " << nodes[index].cycles << "\n";
+        }
+        if (nodes[0].cycles)
+            file << "main " << nodes[0].cycles << "\n";
+    } else {
+        std::vector<std::pair<uint32_t, Count>> rows(counts.begin(), counts.end());
+        std::sort(rows.begin(), rows.end(), [](
+            const std::pair<uint32_t, Count>& a,
+            const std::pair<uint32_t, Count>& b
+        ) { return a.second.cycles > b.second.cycles; });
+        file << "# bank:pc cycles instructions\n";
+        for (const auto& row : rows)
+            file << get_name(row.first) << " " << row.second.cycles << " " << row.second.instructions << "\n";
+    }
+    return file.good();
+}
+
+}  // namespace NES
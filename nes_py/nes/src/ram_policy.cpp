@@ -0,0 +1,111 @@
+//  Program:      nes-py
+//  File:         ram_policy.cpp
+//  Description:  Tiny tabular and linear policies over RAM features
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include "ram_policy.hpp"
+#include "log.hpp"
+
+namespace NES {
+
+/// The size of the RAM that policies may address
+const int RAM_POLICY_ADDRESS_SPACE = 0x800;
+
+bool RAMPolicy::load(
+    int kind,
+    const int32_t* addresses,
+    const int32_t* shifts,
+    int num_features,
+    const double* weights,
+    int num_weights,
+    const NES_Byte* actions,
+    int num_actions
+) {
+    if (kind < 0 || kind >= RAM_POLICY_NUM_KINDS) {
+        LOG(Error) << "Invalid RAM policy kind: " << kind << std::endl;
+        return false;
+    }
+    if (num_features < 0 || num_actions < 1 || num_actions > RAM_POLICY_MAX_ACTIONS) {
+        LOG(Error) << "Invalid RAM policy size: " << num_features << " features, "
+                   << num_actions << " actions" << std::endl;
+        return false;
+    }
+    int table_bits = 0;
+    for (int i = 0; i < num_features; i++) {
+        if (addresses[i] < 0 || addresses[i] >= RAM_POLICY_ADDRESS_SPACE) {
+            LOG(Error) << "Invalid RAM policy address: " << addresses[i] << std::endl;
+            return false;
+        }
+        int shift = shifts == nullptr ? 0 : shifts[i];
+        if (shift < 0 || shift > 8) {
+            LOG(Error) << "Invalid RAM policy shift: " << shift << std::endl;
+            return false;
+        }
+        table_bits += 8 - shift;
+    }
+    if (kind == RAM_POLICY_TABULAR && table_bits > RAM_POLICY_MAX_TABLE_BITS) {
+        LOG(Error) << "Invalid RAM policy table of 2^" << table_bits << " rows" << std::endl;
+        return false;
+    }
+    // validate the weights before changing the policy so that a rejected
+    // load leaves the last valid policy in place
+    const std::size_t expected = kind == RAM_POLICY_LINEAR ?
+        static_cast<std::size_t>(num_actions) * (num_features + 1) :
+        static_cast<std::size_t>(num_actions) << table_bits;
+    if (num_weights < 0 || static_cast<std::size_t>(num_weights) != expected) {
+        LOG(Error) << "Invalid RAM policy weights: " << num_weights
+                   << " (expected " << expected << ")" << std::endl;
+        return false;
+    }
+    this->kind = kind;
+    this->addresses.assign(addresses, addresses + num_features);
+    if (shifts == nullptr)
+        this->shifts.assign(num_features, 0);
+    else
+        this->shifts.assign(shifts, shifts + num_features);
+    this->actions.assign(actions, actions + num_actions);
+    this->weights.assign(weights, weights + num_weights);
+    return true;
+}
+
+std::size_t RAMPolicy::get_num_weights() const {
+    if (kind == RAM_POLICY_LINEAR)
+        return actions.size() * (addresses.size() + 1);
+    std::size_t table_bits = 0;
+    for (int shift : shifts)
+        table_bits += 8 - shift;
+    return actions.size() << table_bits;
+}
+
+NES_Byte RAMPolicy::act(const NES_Byte* ram) const {
+    const std::size_t num_actions = actions.size();
+    const double* scores;
+    double linear_scores[RAM_POLICY_MAX_ACTIONS];
+    if (kind == RAM_POLICY_LINEAR) {
+        // each row is the weights of the features followed by the bias
+        const std::size_t row = addresses.size() + 1;
+        for (std::size_t action = 0; action < num_actions; action++) {
+            const double* w = &weights[action * row];
+            double score = w[addresses.size()];
+            for (std::size_t i = 0; i < addresses.size(); i++)
+                score += w[i] * ram[addresses[i]] * (1.0 / 255.0);
+            linear_scores[action] = score;
+        }
+        scores = linear_scores;
+    } else {
+        std::size_t index = 0;
+        for (std::size_t i = 0; i < addresses.size(); i++)
+            index = (index << (8 - shifts[i])) | (ram[addresses[i]] >> shifts[i]);
+        scores = &weights[index * num_actions];
+    }
+    // ties go to the first action with the highest score
+    std::size_t best = 0;
+    for (std::size_t action = 1; action < num_actions; action++)
+        if (scores[action] > scores[best])
+            best = action;
+    return actions[best];
+}
+
+}  // namespace NES
@@ -0,0 +1,223 @@
+//  Program:      nes-py
+//  File:         ram_program.cpp
+//  Description:  A bytecode interpreter for RAM-derived rewards and flags
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "ram_program.hpp"
+#include "log.hpp"
+
+namespace NES {
+
+/// The size of the RAM that programs may address
+const int RAM_PROGRAM_ADDRESS_SPACE = 0x800;
+
+/// Return the number of values an operation pops off the stack.
+static int operation_inputs(int operation) {
+    switch (operation) {
+        case RAM_CONSTANT:
+        case RAM_BYTE:
+        case RAM_UNSIGNED:
+        case RAM_DIGITS:
+        case RAM_BCD:
+            return 0;
+        case RAM_DELTA:
+        case RAM_NEGATE:
+        case RAM_ABSOLUTE:
+        case RAM_NOT:
+        case RAM_STORE_REWARD:
+        case RAM_STORE_DONE:
+        case RAM_STORE_INFO:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+/// Return the number of values an operation pushes onto the stack.
+static int operation_outputs(int operation) {
+    switch (operation) {
+        case RAM_STORE_REWARD:
+        case RAM_STORE_DONE:
+        case RAM_STORE_INFO:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+bool RAMProgram::load(
+    const int32_t* code,
+    int code_length,
+    const double* constants,
+    int num_constants
+) {
+    // validate the program before replacing the current one by simulating
+    // the depth of the stack and checking the range of every operand
+    int depth = 0;
+    int num_slots = 0;
+    for (int i = 0; i < code_length;) {
+        int operation = code[i++];
+        if (operation < 0 || operation >= RAM_NUM_OPERATIONS) {
+            LOG(Error) << "Invalid RAM program operation: " << operation << std::endl;
+            return false;
+        }
+        switch (operation) {
+            case RAM_CONSTANT: {
+                if (i >= code_length || code[i] < 0 || code[i] >= num_constants)
+                    return false;
+                i++;
+                break;
+            }
+            case RAM_BYTE: {
+                if (i >= code_length || code[i] < 0 || code[i] >= RAM_PROGRAM_ADDRESS_SPACE)
+                    return false;
+                i++;
+                break;
+            }
+            case RAM_UNSIGNED:
+            case RAM_DIGITS:
+            case RAM_BCD: {
+                if (i >= code_length || code[i] < 1 || code[i] > RAM_PROGRAM_MAX_BYTES)
+                    return false;
+                int num_bytes = code[i++];
+                if (i + num_bytes > code_length)
+                    return false;
+                for (int j = 0; j < num_bytes; j++, i++)
+                    if (code[i] < 0 || code[i] >= RAM_PROGRAM_ADDRESS_SPACE)
+                        return false;
+                break;
+            }
+            case RAM_DELTA: {
+                if (i >= code_length || code[i] < 0 || code[i] >= code_length)
+                    return false;
+                num_slots = std::max(num_slots, code[i++] + 1);
+                break;
+            }
+            case RAM_STORE_INFO: {
+                if (i >= code_length || code[i] < 0 || code[i] >= RAM_PROGRAM_INFO_SIZE)
+                    return false;
+                i++;
+                break;
+            }
+            default: break;
+        }
+        depth -= operation_inputs(operation);
+        if (depth < 0)
+            return false;
+        depth += operation_outputs(operation);
+        if (depth > RAM_PROGRAM_STACK_SIZE)
+            return false;
+    }
+    this->code.assign(code, code + code_length);
+    this->constants.assign(constants, constants + num_constants);
+    memory.assign(num_slots, 0);
+    result = RAMProgramResult();
+    return true;
+}
+
+void RAMProgram::run(const NES_Byte* ram, bool is_priming) {
+    double stack[RAM_PROGRAM_STACK_SIZE];
+    // the index of the next free slot on the stack
+    int top = 0;
+    result = RAMProgramResult();
+    const int32_t* instruction = code.data();
+    const int32_t* const end = instruction + code.size();
+    while (instruction < end) {
+        switch (*instruction++) {
+            case RAM_CONSTANT: {
+                stack[top++] = constants[*instruction++];
+                break;
+            }
+            case RAM_BYTE: {
+                stack[top++] = ram[*instruction++];
+                break;
+            }
+            case RAM_UNSIGNED: {
+                int num_bytes = *instruction++;
+                double value = 0;
+                for (int i = num_bytes - 1; i >= 0; i--)
+                    value = value * 256 + ram[instruction[i]];
+                instruction += num_bytes;
+                stack[top++] = value;
+                break;
+            }
+            case RAM_DIGITS: {
+                int num_bytes = *instruction++;
+                double value = 0;
+                for (int i = 0; i < num_bytes; i++)
+                    value = value * 10 + ram[instruction[i]];
+                instruction += num_bytes;
+                stack[top++] = value;
+                break;
+            }
+            case RAM_BCD: {
+                int num_bytes = *instruction++;
+                double value = 0;
+                for (int i = 0; i < num_bytes; i++) {
+                    NES_Byte byte = ram[instruction[i]];
+                    value = value * 100 + (byte >> 4) * 10 + (byte & 0xf);
+                }
+                instruction += num_bytes;
+                stack[top++] = value;
+                break;
+            }
+            case RAM_DELTA: {
+                double& previous = memory[*instruction++];
+                double value = stack[top - 1];
+                stack[top - 1] = is_priming ? 0 : value - previous;
+                previous = value;
+                break;
+            }
+            case RAM_ADD: { top--; stack[top - 1] += stack[top]; break; }
+            case RAM_SUBTRACT: { top--; stack[top - 1] -= stack[top]; break; }
+            case RAM_MULTIPLY: { top--; stack[top - 1] *= stack[top]; break; }
+            case RAM_DIVIDE: {
+                top--;
+                // division by zero is defined as zero to keep outputs finite
+                stack[top - 1] = stack[top] ? stack[top - 1] / stack[top] : 0;
+                break;
+            }
+            case RAM_MINIMUM: { top--; stack[top - 1] = std::min(stack[top - 1], stack[top]); break; }
+            case RAM_MAXIMUM: { top--; stack[top - 1] = std::max(stack[top - 1], stack[top]); break; }
+            case RAM_EQUAL: { top--; stack[top - 1] = stack[top - 1] == stack[top]; break; }
+            case RAM_NOT_EQUAL: { top--; stack[top - 1] = stack[top - 1] != stack[top]; break; }
+            case RAM_LESS: { top--; stack[top - 1] = stack[top - 1] < stack[top]; break; }
+            case RAM_LESS_EQUAL: { top--; stack[top - 1] = stack[top - 1] <= stack[top]; break; }
+            case RAM_GREATER: { top--; stack[top - 1] = stack[top - 1] > stack[top]; break; }
+            case RAM_GREATER_EQUAL: { top--; stack[top - 1] = stack[top - 1] >= stack[top]; break; }
+            case RAM_AND: { top--; stack[top - 1] = stack[top - 1] && stack[top]; break; }
+            case RAM_OR: { top--; stack[top - 1] = stack[top - 1] || stack[top]; break; }
+            case RAM_BIT_AND: {
+                top--;
+                stack[top - 1] = static_cast<int64_t>(stack[top - 1]) & static_cast<int64_t>(stack[top]);
+                break;
+            }
+            case RAM_NEGATE: { stack[top - 1] = -stack[top - 1]; break; }
+            case RAM_ABSOLUTE: { stack[top - 1] = std::fabs(stack[top - 1]); break; }
+            case RAM_NOT: { stack[top - 1] = !stack[top - 1]; break; }
+            case RAM_STORE_REWARD: { result.reward = stack[--top]; break; }
+            case RAM_STORE_DONE: { result.done = stack[--top]; break; }
+            case RAM_STORE_INFO: { result.info[*instruction++] = stack[--top]; break; }
+        }
+    }
+    // a primed program has no outputs until the next evaluation
+    if (is_priming)
+        result = RAMProgramResult();
+}
+
+void RAMProgram::restore(const double* memory, const RAMProgramResult& result) {
+    std::copy(memory, memory + this->memory.size(), this->memory.begin());
+    this->result = result;
+}
+
+NES_Hash RAMProgram::get_hash() const {
+    NES_Hash hash = hash_bytes(code.data(), code.size() * sizeof(int32_t));
+    hash = hash_combine(hash, hash_bytes(constants.data(), constants.size() * sizeof(double)));
+    return hash_combine(hash, hash_bytes(memory.data(), memory.size() * sizeof(double)));
+}
+
+}  // namespace NES
@@ -0,0 +1,81 @@
+//  Program:      nes-py
+//  File:         rewind.cpp
+//  Description:  A ring buffer of recent delta-compressed machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <cstring>
+#include "rewind.hpp"
+#include "state_delta.hpp"
+
+namespace NES {
+
+RewindBuffer::RewindBuffer(int interval, std::size_t state_size, std::size_t max_bytes) :
+    interval(interval < 1 ? 1 : interval),
+    pool(max_bytes),
+    head(0),
+    latest(state_size),
+    latest_frame(0),
+    capture(state_size),
+    delta(max_delta_length(state_size)),
+    frame(0) { }
+
+void RewindBuffer::push(int64_t frame) {
+    const std::size_t length = encode_delta(latest.data(), capture.data(), latest.size(), delta.data());
+    if (length > pool.size()) {
+        // the delta does not fit at all, so the history ends here
+        entries.clear();
+        head = 0;
+        return;
+    }
+    if (head + length > pool.size()) {
+        // the end of the pool is too short, so drop the oldest entries in it
+        // and wrap around to the start
+        while (!entries.empty() && entries.front().offset >= head)
+            entries.pop_front();
+        head = 0;
+    }
+    // drop the oldest entries in the way of the new one, the entries are in
+    // ring order so only the front can overlap
+    while (!entries.empty() &&
+        entries.front().offset < head + length &&
+        head < entries.front().offset + entries.front().length)
+        entries.pop_front();
+    std::memcpy(&pool[head], delta.data(), length);
+    entries.push_back(Entry{head, length, frame});
+    head += length;
+}
+
+void RewindBuffer::commit() {
+    // the delta from the new state back to the old newest state
+    push(latest_frame);
+    latest.swap(capture);
+    latest_frame = frame;
+}
+
+std::size_t RewindBuffer::get_used_bytes() const {
+    std::size_t used = 0;
+    for (const auto& entry : entries)
+        used += entry.length;
+    return used;
+}
+
+int64_t RewindBuffer::rewind(int64_t frames_back, NES_Byte* state) {
+    const int64_t target = frame - frames_back;
+    // walk back from the newest state to the newest state at or before the
+    // target (or the oldest state if the buffer does not reach that far)
+    while (latest_frame > target && !entries.empty()) {
+        const Entry& entry = entries.back();
+        apply_delta(&pool[entry.offset], entry.length, latest.data(), latest.size());
+        latest_frame = entry.frame;
+        head = entry.offset;
+        entries.pop_back();
+    }
+    std::memcpy(state, latest.data(), latest.size());
+    const int64_t rewound = frame - latest_frame;
+    frame = latest_frame;
+    return rewound;
+}
+
+}  // namespace NES
@@ -0,0 +1,51 @@
+//  Program:      nes-py
+//  File:         sequence_trie.cpp
+//  Description:  A prefix trie over a batch of open-loop action sequences
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include "sequence_trie.hpp"
+
+namespace NES {
+
+SequenceTrie::SequenceTrie(
+    const NES_Byte* actions,
+    const int* lengths,
+    int num_sequences
+) : nodes(1, Node{0, 0, {}, {}}) {
+    for (int sequence = 0; sequence < num_sequences; sequence++) {
+        uint32_t node = 0;
+        for (int frame = 0; frame < lengths[sequence]; frame++) {
+            const NES_Byte action = *actions++;
+            // nodes have few children (the distinct actions), so a linear
+            // search is faster than a map
+            uint32_t next = 0;
+            for (uint32_t child : nodes[node].children) {
+                if (nodes[child].action == action) {
+                    next = child;
+                    break;
+                }
+            }
+            if (next == 0) {
+                next = nodes.size();
+                nodes.push_back(Node{action, nodes[node].depth + 1, {}, {}});
+                nodes[node].children.push_back(next);
+            }
+            node = next;
+        }
+        nodes[node].sequences.push_back(sequence);
+    }
+}
+
+void SequenceTrie::collect(uint32_t index, std::vector<uint32_t>& sequences) const {
+    std::vector<uint32_t> pending(1, index);
+    while (!pending.empty()) {
+        const Node& node = nodes[pending.back()];
+        pending.pop_back();
+        sequences.insert(sequences.end(), node.sequences.begin(), node.sequences.end());
+        pending.insert(pending.end(), node.children.begin(), node.children.end());
+    }
+}
+
+}  // namespace NES
@@ -0,0 +1,246 @@
+//  Program:      nes-py
+//  File:         shm_channel.cpp
+//  Description:  An environment server over a POSIX shared memory segment
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <chrono>
+#include <cstring>
+#include <new>
+#include "shm_channel.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#define NES_HAS_SHM 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace NES {
+
+/// the offset of the request slots in a segment
+static const std::size_t REQUESTS_OFFSET = (sizeof(ShmHeader) + 63) & ~std::size_t(63);
+
+/// Return the offset of the response slots in a segment.
+static inline std::size_t responses_offset(uint32_t num_slots) {
+    return (REQUESTS_OFFSET + num_slots * sizeof(ShmRequest) + 63) & ~std::size_t(63);
+}
+
+/// Return the size of a segment with a number of slots in each ring.
+static inline std::size_t segment_size(uint32_t num_slots) {
+    return responses_offset(num_slots) + num_slots * sizeof(ShmResponse);
+}
+
+/// Sleep until a futex word may differ from a value. The sleep times out
+/// so the caller can check whether the other side closed the channel.
+static void wait_word(std::atomic<uint32_t>* word, uint32_t value) {
+#if defined(__linux__)
+    // spin briefly, the other side usually answers within a frame
+    for (int i = 0; i < 64; i++)
+        if (word->load(std::memory_order_acquire) != value)
+            return;
+    struct timespec timeout = {0, 50 * 1000 * 1000};
+    // not FUTEX_PRIVATE_FLAG, the word is shared between processes
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, value, &timeout, nullptr, 0);
+#else
+    if (word->load(std::memory_order_acquire) == value)
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+}
+
+/// Wake every thread that sleeps on a futex word.
+static void wake_word(std::atomic<uint32_t>* word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+ShmServer::~ShmServer() {
+    if (memory == nullptr)
+        return;
+    ShmHeader* header = static_cast<ShmHeader*>(memory);
+    header->is_closed.store(1, std::memory_order_release);
+    wake_word(&header->requests.head);
+    wake_word(&header->requests.tail);
+    wake_word(&header->responses.head);
+    wake_word(&header->responses.tail);
+    server.join();
+#if defined(NES_HAS_SHM)
+    munmap(memory, size);
+    shm_unlink(name.c_str());
+#endif
+}
+
+bool ShmServer::open(const std::string& name, uint32_t num_slots) {
+#if defined(NES_HAS_SHM)
+    if (memory != nullptr || num_slots == 0)
+        return false;
+    const std::size_t size = segment_size(num_slots);
+    int descriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (descriptor < 0)
+        return false;
+    void* memory = MAP_FAILED;
+    if (ftruncate(descriptor, size) == 0)
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    // the segment is zero filled, so the counters start at 0 and the client
+    // only accepts the segment once the magic string is written
+    ShmHeader* header = new (memory) ShmHeader();
+    header->version = SHM_VERSION;
+    header->num_slots = num_slots;
+    header->response_size = sizeof(ShmResponse);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC));
+    this->name = name;
+    this->memory = memory;
+    this->size = size;
+    server = std::thread(&ShmServer::serve, this);
+    return true;
+#else
+    (void) name;
+    (void) num_slots;
+    return false;
+#endif
+}
+
+void ShmServer::serve() {
+    ShmHeader* header = static_cast<ShmHeader*>(memory);
+    const uint32_t num_slots = header->num_slots;
+    auto requests = reinterpret_cast<ShmRequest*>(static_cast<NES_Byte*>(memory) + REQUESTS_OFFSET);
+    auto responses = reinterpret_cast<ShmResponse*>(static_cast<NES_Byte*>(memory) + responses_offset(num_slots));
+    RAMProgram* program = emulator->get_program();
+    for (uint32_t index = 0; ; index++) {
+        // wait for the next request
+        while (header->requests.head.load(std::memory_order_acquire) == index) {
+            if (header->is_closed.load(std::memory_order_acquire))
+                return;
+            wait_word(&header->requests.head, index);
+        }
+        const ShmRequest request = requests[index % num_slots];
+        header->requests.tail.store(index + 1, std::memory_order_release);
+        wake_word(&header->requests.tail);
+        // run the request on the emulator
+        if (request.command == SHM_RESET) {
+            if (is_reset_to_backup)
+                emulator->restore();
+            else
+                emulator->reset();
+            if (!program->is_empty())
+                program->reset(emulator->get_memory_buffer());
+        } else {
+            *emulator->get_controller(0) = request.action;
+            for (uint32_t frame = 0; frame < request.frames; frame++)
+                emulator->step();
+        }
+        // wait for a free response slot (the client holds at most one)
+        while (index - header->responses.tail.load(std::memory_order_acquire) >= num_slots) {
+            if (header->is_closed.load(std::memory_order_acquire))
+                return;
+            wait_word(&header->responses.tail, header->responses.tail.load(std::memory_order_relaxed));
+        }
+        ShmResponse& response = responses[index % num_slots];
+        response.result = *program->get_result();
+        std::memcpy(response.screen, emulator->get_screen_buffer(), sizeof(response.screen));
+        std::memcpy(response.ram, emulator->get_memory_buffer(), sizeof(response.ram));
+        header->responses.head.store(index + 1, std::memory_order_release);
+        wake_word(&header->responses.head);
+    }
+}
+
+ShmClient::~ShmClient() {
+#if defined(NES_HAS_SHM)
+    if (memory != nullptr)
+        munmap(memory, size);
+#endif
+}
+
+bool ShmClient::connect(const std::string& name) {
+#if defined(NES_HAS_SHM)
+    if (memory != nullptr)
+        return false;
+    int descriptor = shm_open(name.c_str(), O_RDWR, 0600);
+    if (descriptor < 0)
+        return false;
+    struct stat status;
+    void* memory = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(ShmHeader)))
+        memory = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    close(descriptor);
+    if (memory == MAP_FAILED)
+        return false;
+    const ShmHeader* header = static_cast<const ShmHeader*>(memory);
+    if (std::memcmp(header->magic, SHM_MAGIC, sizeof(SHM_MAGIC)) != 0 ||
+        header->version != SHM_VERSION ||
+        header->num_slots == 0 ||
+        header->response_size != sizeof(ShmResponse) ||
+        static_cast<std::size_t>(status.st_size) < segment_size(header->num_slots)) {
+        munmap(memory, status.st_size);
+        return false;
+    }
+    this->memory = memory;
+    this->size = status.st_size;
+    return true;
+#else
+    (void) name;
+    return false;
+#endif
+}
+
+const ShmResponse* ShmClient::get_slot(uint32_t index) {
+    auto responses = static_cast<NES_Byte*>(memory) + responses_offset(get_num_slots());
+    return reinterpret_cast<const ShmResponse*>(responses) + index;
+}
+
+bool ShmClient::send(uint32_t command, NES_Byte action, uint32_t frames) {
+    ShmHeader* header = get_header();
+    const uint32_t num_slots = header->num_slots;
+    const uint32_t head = header->requests.head.load(std::memory_order_relaxed);
+    // wait for a free request slot
+    for (;;) {
+        const uint32_t tail = header->requests.tail.load(std::memory_order_acquire);
+        if (head - tail < num_slots)
+            break;
+        if (header->is_closed.load(std::memory_order_acquire))
+            return false;
+        wait_word(&header->requests.tail, tail);
+    }
+    if (header->is_closed.load(std::memory_order_acquire))
+        return false;
+    auto requests = reinterpret_cast<ShmRequest*>(static_cast<NES_Byte*>(memory) + REQUESTS_OFFSET);
+    requests[head % num_slots] = ShmRequest{command, frames, action};
+    header->requests.head.store(head + 1, std::memory_order_release);
+    wake_word(&header->requests.head);
+    return true;
+}
+
+int ShmClient::receive() {
+    ShmHeader* header = get_header();
+    uint32_t tail = header->responses.tail.load(std::memory_order_relaxed);
+    // release the response from the last receive
+    if (is_holding) {
+        header->responses.tail.store(++tail, std::memory_order_release);
+        wake_word(&header->responses.tail);
+        is_holding = false;
+    }
+    while (header->responses.head.load(std::memory_order_acquire) == tail) {
+        if (header->is_closed.load(std::memory_order_acquire))
+            return -1;
+        wait_word(&header->responses.head, tail);
+    }
+    is_holding = true;
+    return tail % header->num_slots;
+}
+
+}  // namespace NES
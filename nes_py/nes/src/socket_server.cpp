@@ -0,0 +1,397 @@
+//  Program:      nes-py
+//  File:         socket_server.cpp
+//  Description:  A server for batches of emulators over a stream socket
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "socket_server.hpp"
+#include "thread_pool.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#define NES_HAS_SOCKETS 1
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace NES {
+
+/// the number of bytes in a screen
+static const std::size_t SCREEN_BYTES = Emulator::WIDTH * Emulator::HEIGHT * sizeof(NES_Pixel);
+/// the number of bytes of RAM
+static const std::size_t RAM_BYTES = 0x800;
+/// the number of bytes in the header of a response (length, id, status)
+static const std::size_t HEADER_BYTES = 9;
+
+/// Read a little-endian value from a buffer.
+template<typename T>
+static inline T read_value(const NES_Byte* input) {
+    T value;
+    std::memcpy(&value, input, sizeof(T));
+    return value;
+}
+
+/// Append a little-endian value to a buffer.
+template<typename T>
+static inline void append_value(std::vector<NES_Byte>& output, T value) {
+    const NES_Byte* bytes = reinterpret_cast<const NES_Byte*>(&value);
+    output.insert(output.end(), bytes, bytes + sizeof(T));
+}
+
+#if defined(NES_HAS_SOCKETS)
+
+/// Read an exact number of bytes from a socket.
+///
+/// @param socket the socket to read from
+/// @param wake a descriptor that becomes readable to abort the read
+/// @param buffer the buffer to read into
+/// @param length the number of bytes to read
+/// @return true if every byte was read, false on end of stream, error, or
+/// wake up
+///
+static bool read_exact(int socket, int wake, NES_Byte* buffer, std::size_t length) {
+    while (length > 0) {
+        struct pollfd descriptors[2] = {{socket, POLLIN, 0}, {wake, POLLIN, 0}};
+        if (poll(descriptors, 2, -1) < 0)
+            return false;
+        if (descriptors[1].revents)
+            return false;
+        ssize_t count = recv(socket, buffer, length, 0);
+        if (count <= 0)
+            return false;
+        buffer += count;
+        length -= count;
+    }
+    return true;
+}
+
+/// Write every byte of a list of buffers to a socket. The buffers are
+/// gathered by the kernel (sendmsg is writev with flags), so they are never
+/// copied into one message in user space.
+///
+/// @param socket the socket to write to
+/// @param vectors the buffers to write (consumed by the call)
+/// @return true if every byte was written, false otherwise
+///
+static bool write_all(int socket, std::vector<struct iovec>& vectors) {
+    // a message has at most IOV_MAX buffers
+    static const std::size_t MAX_VECTORS = 512;
+#if defined(MSG_NOSIGNAL)
+    // a client that disconnects mid-response must not raise SIGPIPE
+    static const int FLAGS = MSG_NOSIGNAL;
+#else
+    static const int FLAGS = 0;
+#endif
+    std::size_t first = 0;
+    while (first < vectors.size()) {
+        struct msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = &vectors[first];
+        message.msg_iovlen = std::min(vectors.size() - first, MAX_VECTORS);
+        ssize_t written = sendmsg(socket, &message, FLAGS);
+        if (written < 0)
+            return false;
+        // skip the buffers that were written and advance a partial one
+        while (first < vectors.size() && static_cast<std::size_t>(written) >= vectors[first].iov_len)
+            written -= vectors[first++].iov_len;
+        if (first < vectors.size()) {
+            vectors[first].iov_base = static_cast<NES_Byte*>(vectors[first].iov_base) + written;
+            vectors[first].iov_len -= written;
+        }
+    }
+    return true;
+}
+
+SocketServer::SocketServer(const std::vector<Emulator*>& emulators, const std::vector<bool>& is_reset_to_backup) :
+    emulators(emulators),
+    is_reset_to_backup(is_reset_to_backup),
+    listener(-1),
+    results(emulators.size()) {
+    if (pipe(wake) != 0)
+        wake[0] = wake[1] = -1;
+}
+
+SocketServer::~SocketServer() {
+    if (background.joinable()) {
+        stop();
+        background.join();
+    }
+    if (listener >= 0)
+        close(listener);
+    if (!unix_path.empty())
+        unlink(unix_path.c_str());
+    if (wake[0] >= 0) {
+        close(wake[0]);
+        close(wake[1]);
+    }
+}
+
+bool SocketServer::listen_tcp(const std::string& host, int port) {
+    if (listener >= 0 || wake[0] < 0)
+        return false;
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        return false;
+    int descriptor = socket(AF_INET, SOCK_STREAM, 0);
+    if (descriptor < 0)
+        return false;
+    int enable = 1;
+    setsockopt(descriptor, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(descriptor, 16) != 0) {
+        close(descriptor);
+        return false;
+    }
+    listener = descriptor;
+    return true;
+}
+
+bool SocketServer::listen_unix(const std::string& path) {
+    if (listener >= 0 || wake[0] < 0)
+        return false;
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return false;
+    std::strcpy(address.sun_path, path.c_str());
+    int descriptor = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0)
+        return false;
+    if (bind(descriptor, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(descriptor, 16) != 0) {
+        close(descriptor);
+        return false;
+    }
+    listener = descriptor;
+    unix_path = path;
+    return true;
+}
+
+int SocketServer::get_port() const {
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (listener < 0 || !unix_path.empty() ||
+        getsockname(listener, reinterpret_cast<struct sockaddr*>(&address), &length) != 0)
+        return -1;
+    return ntohs(address.sin_port);
+}
+
+void SocketServer::serve() {
+    if (listener < 0)
+        return;
+    for (;;) {
+        struct pollfd descriptors[2] = {{listener, POLLIN, 0}, {wake[0], POLLIN, 0}};
+        if (poll(descriptors, 2, -1) < 0 || descriptors[1].revents)
+            return;
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        if (unix_path.empty()) {
+            // responses are whole messages, so send them without delay
+            int enable = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+#if defined(SO_NOSIGPIPE)
+        // platforms without MSG_NOSIGNAL disable SIGPIPE on the socket
+        int disable = 1;
+        setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &disable, sizeof(disable));
+#endif
+        const bool is_running = serve_client(client);
+        close(client);
+        if (!is_running)
+            return;
+    }
+}
+
+void SocketServer::stop() {
+    if (wake[1] >= 0) {
+        const char byte = 0;
+        (void) !write(wake[1], &byte, 1);
+    }
+}
+
+void SocketServer::start() {
+    if (!background.joinable())
+        background = std::thread(&SocketServer::serve, this);
+}
+
+bool SocketServer::serve_client(int client) {
+    for (;;) {
+        NES_Byte prefix[4];
+        if (!read_exact(client, wake[0], prefix, sizeof(prefix)))
+            break;
+        const uint32_t length = read_value<uint32_t>(prefix);
+        // a request has at least an id and an opcode
+        if (length < 5 || length > SOCKET_MAX_REQUEST)
+            break;
+        request.resize(length);
+        if (!read_exact(client, wake[0], request.data(), length) || !handle(client, length))
+            break;
+    }
+    // the wake pipe stays readable once the server is stopped
+    struct pollfd descriptor = {wake[0], POLLIN, 0};
+    return poll(&descriptor, 1, 0) == 0;
+}
+
+bool SocketServer::handle(int client, std::size_t length) {
+    const uint32_t id = read_value<uint32_t>(&request[0]);
+    const uint8_t opcode = request[4];
+    const NES_Byte* payload = &request[5];
+    const std::size_t payload_length = length - 5;
+    const std::size_t num_emulators = emulators.size();
+    response.clear();
+    switch (opcode) {
+        case SOCKET_INFO: {
+            append_value<uint32_t>(response, num_emulators);
+            append_value<uint32_t>(response, Emulator::WIDTH);
+            append_value<uint32_t>(response, Emulator::HEIGHT);
+            append_value<uint32_t>(response, num_emulators ? emulators[0]->state_size() : 0);
+            append_value<uint32_t>(response, RAM_PROGRAM_INFO_SIZE);
+            return write_response(client, id, 0);
+        }
+        case SOCKET_RESET: {
+            if (payload_length != 1)
+                return write_response(client, id, 1);
+            ThreadPool::shared().parallel_for(num_emulators, [&](std::size_t index) {
+                Emulator* emulator = emulators[index];
+                if (is_reset_to_backup[index])
+                    emulator->restore();
+                else
+                    emulator->reset();
+                RAMProgram* program = emulator->get_program();
+                if (!program->is_empty())
+                    program->reset(emulator->get_memory_buffer());
+            });
+            return write_outputs(client, id, payload[0]);
+        }
+        case SOCKET_STEP: {
+            if (payload_length != 5 + num_emulators)
+                return write_response(client, id, 1);
+            const uint32_t frames = read_value<uint32_t>(payload + 1);
+            const NES_Byte* actions = payload + 5;
+            ThreadPool::shared().parallel_for(num_emulators, [&](std::size_t index) {
+                Emulator* emulator = emulators[index];
+                *emulator->get_controller(0) = actions[index];
+                for (uint32_t frame = 0; frame < frames; frame++)
+                    emulator->step();
+            });
+            return write_outputs(client, id, payload[0]);
+        }
+        case SOCKET_SAVE: {
+            if (payload_length != 4)
+                return write_response(client, id, 1);
+            const uint32_t index = read_value<uint32_t>(payload);
+            if (index >= num_emulators)
+                return write_response(client, id, 1);
+            response.resize(emulators[index]->state_size());
+            emulators[index]->save_state(response.data());
+            return write_response(client, id, 0);
+        }
+        case SOCKET_LOAD: {
+            if (payload_length < 4)
+                return write_response(client, id, 1);
+            const uint32_t index = read_value<uint32_t>(payload);
+            if (index >= num_emulators || payload_length - 4 != emulators[index]->state_size())
+                return write_response(client, id, 1);
+            if (!emulators[index]->load_state(payload + 4))
+                return write_response(client, id, 1);
+            return write_response(client, id, 0);
+        }
+        case SOCKET_PROGRAM: {
+            // validate the lengths before reading the arrays
+            if (payload_length < 4)
+                return write_response(client, id, 1);
+            const uint32_t code_length = read_value<uint32_t>(payload);
+            const std::size_t code_bytes = std::size_t(code_length) * sizeof(int32_t);
+            if (payload_length < 8 + code_bytes)
+                return write_response(client, id, 1);
+            const uint32_t num_constants = read_value<uint32_t>(payload + 4 + code_bytes);
+            if (payload_length != 8 + code_bytes + std::size_t(num_constants) * sizeof(double))
+                return write_response(client, id, 1);
+            // copy the arrays out of the (unaligned) payload
+            std::vector<int32_t> code(code_length);
+            std::vector<double> constants(num_constants);
+            std::memcpy(code.data(), payload + 4, code_bytes);
+            std::memcpy(constants.data(), payload + 8 + code_bytes, num_constants * sizeof(double));
+            bool is_valid = true;
+            for (Emulator* emulator : emulators)
+                is_valid = emulator->get_program()->load(code.data(), code_length, constants.data(), num_constants) && is_valid;
+            return write_response(client, id, is_valid ? 0 : 1);
+        }
+        default:
+            return write_response(client, id, 1);
+    }
+}
+
+bool SocketServer::write_outputs(int client, uint32_t id, uint8_t outputs) {
+    const std::size_t num_emulators = emulators.size();
+    for (std::size_t index = 0; index < num_emulators; index++)
+        results[index] = *emulators[index]->get_program()->get_result();
+    const bool has_screens = outputs & SOCKET_SCREENS;
+    const bool has_ram = outputs & SOCKET_RAM;
+    const std::size_t length = 5 + num_emulators * (sizeof(RAMProgramResult) +
+        (has_screens ? SCREEN_BYTES : 0) + (has_ram ? RAM_BYTES : 0));
+    NES_Byte header[HEADER_BYTES];
+    const uint32_t message_length = length;
+    std::memcpy(header, &message_length, 4);
+    std::memcpy(header + 4, &id, 4);
+    header[8] = 0;
+    // gather the header, results, and the buffers of the emulators
+    std::vector<struct iovec> vectors;
+    vectors.reserve(2 + 2 * num_emulators);
+    vectors.push_back({header, HEADER_BYTES});
+    vectors.push_back({results.data(), num_emulators * sizeof(RAMProgramResult)});
+    if (has_screens)
+        for (Emulator* emulator : emulators)
+            vectors.push_back({emulator->get_screen_buffer(), SCREEN_BYTES});
+    if (has_ram)
+        for (Emulator* emulator : emulators)
+            vectors.push_back({emulator->get_memory_buffer(), RAM_BYTES});
+    return write_all(client, vectors);
+}
+
+bool SocketServer::write_response(int client, uint32_t id, uint8_t status) {
+    NES_Byte header[HEADER_BYTES];
+    const uint32_t message_length = 5 + response.size();
+    std::memcpy(header, &message_length, 4);
+    std::memcpy(header + 4, &id, 4);
+    header[8] = status;
+    std::vector<struct iovec> vectors = {{header, HEADER_BYTES}};
+    if (!response.empty())
+        vectors.push_back({response.data(), response.size()});
+    return write_all(client, vectors);
+}
+
+#else
+
+SocketServer::SocketServer(const std::vector<Emulator*>& emulators, const std::vector<bool>& is_reset_to_backup) :
+    emulators(emulators), is_reset_to_backup(is_reset_to_backup), listener(-1) { wake[0] = wake[1] = -1; }
+
+SocketServer::~SocketServer() { }
+
+bool SocketServer::listen_tcp(const std::string& host, int port) { return false; }
+
+bool SocketServer::listen_unix(const std::string& path) { return false; }
+
+int SocketServer::get_port() const { return -1; }
+
+void SocketServer::serve() { }
+
+void SocketServer::stop() { }
+
+void SocketServer::start() { }
+
+#endif
+
+}  // namespace NES
@@ -0,0 +1,185 @@
+//  Program:      nes-py
+//  File:         speculator.cpp
+//  Description:  Speculative emulation of likely next actions
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <cstring>
+#include "emulator.hpp"
+#include "speculator.hpp"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace NES {
+
+Speculator::Speculator(const std::string& rom_path) :
+    rom_path(rom_path),
+    num_branches(0),
+    frames(0),
+    root_hash(0),
+    second_controller(0),
+    generation(0),
+    num_busy(0),
+    is_stopping(false),
+    is_running(false),
+    is_cancelled(false),
+    owner(0),
+    hits(0),
+    misses(0) {
+#if !defined(_WIN32)
+    owner = getpid();
+#endif
+}
+
+Speculator::~Speculator() {
+    cancel();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        is_stopping = true;
+    }
+    job_posted.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void Speculator::work(std::size_t index, uint64_t seen) {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            job_posted.wait(guard, [&]() {
+                return is_stopping || generation != seen;
+            });
+            if (is_stopping)
+                return;
+            seen = generation;
+            // clones beyond the branches of this speculation sit it out
+            if (index >= num_branches)
+                continue;
+        }
+        run(index);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            num_busy--;
+        }
+        job_finished.notify_one();
+    }
+}
+
+void Speculator::run(std::size_t index) {
+    Emulator& clone = *clones[index];
+    Branch& branch = branches[index];
+    clone.load_state(root.data());
+    *clone.get_program() = root_program;
+    *clone.get_controller(0) = branch.action;
+    *clone.get_controller(1) = second_controller;
+    for (int frame = 0; frame < frames; frame++) {
+        if (is_cancelled.load(std::memory_order_relaxed))
+            return;
+        clone.step();
+    }
+    clone.save_state(branch.state.data());
+    std::memcpy(branch.screen.data(), clone.get_screen_buffer(), branch.screen.size() * sizeof(NES_Pixel));
+    branch.program = *clone.get_program();
+}
+
+void Speculator::adopt() {
+#if !defined(_WIN32)
+    // a forked child (i.e., a subprocess vector environment) inherits the
+    // workers but not their threads, so it leaks the old workers and starts
+    // its own on the next speculation
+    if (owner == getpid())
+        return;
+    owner = getpid();
+    new std::vector<std::thread>(std::move(workers));
+    workers.clear();
+    num_busy = 0;
+    is_running = false;
+#endif
+}
+
+void Speculator::wait() {
+    std::unique_lock<std::mutex> guard(lock);
+    job_finished.wait(guard, [&]() { return num_busy == 0; });
+    is_running = false;
+}
+
+void Speculator::start(Emulator& emulator, const NES_Byte* actions, int num_actions, int frames) {
+    cancel();
+    if (num_actions <= 0 || frames <= 0)
+        return;
+    // snapshot everything the branches read on the calling thread so the
+    // emulator is free to use while they run
+    const std::size_t size = emulator.state_size();
+    root.resize(size);
+    emulator.save_state(root.data());
+    root_program = *emulator.get_program();
+    root_hash = emulator.get_state_hash();
+    second_controller = *emulator.get_controller(1);
+    // create the clones and their threads on the calling thread, they
+    // persist between calls (and idle while no speculation runs)
+    while (clones.size() < static_cast<std::size_t>(num_actions))
+        clones.emplace_back(new Emulator(rom_path));
+    while (workers.size() < clones.size())
+        workers.emplace_back(&Speculator::work, this, workers.size(), generation);
+    if (branches.size() < static_cast<std::size_t>(num_actions))
+        branches.resize(num_actions);
+    for (int index = 0; index < num_actions; index++) {
+        branches[index].action = actions[index];
+        branches[index].state.resize(size);
+        branches[index].screen.resize(Emulator::WIDTH * Emulator::HEIGHT);
+    }
+    this->frames = frames;
+    is_cancelled = false;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        num_branches = num_actions;
+        num_busy = num_actions;
+        is_running = true;
+        generation++;
+    }
+    job_posted.notify_all();
+}
+
+const Speculator::Branch* Speculator::finish(Emulator& emulator, int frames) {
+    adopt();
+    // a step without a running speculation is neither a hit nor a miss
+    if (!is_running)
+        return nullptr;
+    wait();
+    const Branch* match = nullptr;
+    const NES_Byte action = *emulator.get_controller(0);
+    // the branches are only valid from the state they started from
+    if (frames == this->frames &&
+        *emulator.get_controller(1) == second_controller &&
+        emulator.get_state_hash() == root_hash) {
+        for (std::size_t index = 0; index < num_branches; index++) {
+            if (branches[index].action == action) {
+                match = &branches[index];
+                break;
+            }
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        num_branches = 0;
+    }
+    if (match != nullptr)
+        hits++;
+    else
+        misses++;
+    return match;
+}
+
+void Speculator::cancel() {
+    adopt();
+    if (is_running) {
+        is_cancelled = true;
+        wait();
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    num_branches = 0;
+}
+
+}  // namespace NES
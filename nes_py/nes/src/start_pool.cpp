@@ -0,0 +1,39 @@
+//  Program:      nes-py
+//  File:         start_pool.cpp
+//  Description:  A pool of start states for randomized resets
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include "start_pool.hpp"
+#include "ppu.hpp"
+#include "screen_runs.hpp"
+
+namespace NES {
+
+StartPool::StartPool(int max_noops, NES_Byte noop_action, uint64_t seed) :
+    max_noops(std::max(max_noops, 0)),
+    noop_action(noop_action),
+    generator(seed) { }
+
+void StartPool::add(const NES_Byte* state, std::size_t state_size, const NES_Pixel* screen) {
+    starts.emplace_back();
+    Start& start = starts.back();
+    start.state.assign(state, state + state_size);
+    const std::size_t num_pixels = SCANLINE_VISIBLE_DOTS * VISIBLE_SCANLINES;
+    start.runs.resize(2 * count_screen_runs(screen, num_pixels));
+    encode_screen_runs(screen, num_pixels, start.runs.data());
+}
+
+const StartPool::Start* StartPool::sample() {
+    const std::size_t num_starts = get_num_starts();
+    if (num_starts == 0)
+        return nullptr;
+    std::uniform_int_distribution<std::size_t> start(0, num_starts - 1);
+    std::uniform_int_distribution<int> noops(0, max_noops);
+    const std::size_t index = start(generator) * (max_noops + 1);
+    return &starts[index + noops(generator)];
+}
+
+}  // namespace NES
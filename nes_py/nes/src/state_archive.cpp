@@ -0,0 +1,352 @@
+//  Program:      nes-py
+//  File:         state_archive.cpp
+//  Description:  A memory-mapped file of machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include "state_archive.hpp"
+#include "state_delta.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#define NES_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NES {
+
+/// The magic string at the start of an archive file
+static const char ARCHIVE_MAGIC[8] = {'N', 'E', 'S', 'S', 'T', 'A', 'T', 'E'};
+
+/// The version of the archive format
+static const uint32_t ARCHIVE_VERSION = 1;
+
+/// Return the checksum of the fields of a commit.
+static inline NES_Hash commit_checksum(const ArchiveCommit& commit) {
+    return hash_bytes(&commit, offsetof(ArchiveCommit, checksum));
+}
+
+/// Return the latest intact commit of a header.
+///
+/// @param header the header of an archive
+/// @param file_size the size of the archive file in bytes
+/// @return the commit, or nullptr if no commit was written
+///
+static const ArchiveCommit* latest_commit(const ArchiveHeader& header, uint64_t file_size) {
+    const ArchiveCommit* latest = nullptr;
+    for (const auto& commit : header.commits) {
+        if (commit.sequence == 0 ||
+            commit.checksum != commit_checksum(commit) ||
+            commit.index_offset % 8 != 0 ||
+            commit.index_offset < sizeof(ArchiveHeader) ||
+            commit.index_offset > file_size ||
+            commit.num_records > (file_size - commit.index_offset) / sizeof(ArchiveEntry))
+            continue;
+        if (latest == nullptr || commit.sequence > latest->sequence)
+            latest = &commit;
+    }
+    return latest;
+}
+
+/// Return true if the record of an entry lies between the header and the
+/// end of a file.
+static inline bool is_in_file(const ArchiveEntry& entry, uint64_t file_size) {
+    return entry.offset >= sizeof(ArchiveHeader) &&
+        entry.offset <= file_size &&
+        entry.length <= file_size - entry.offset;
+}
+
+/// Return true if a header is the header of an archive of this version.
+static inline bool is_archive(const ArchiveHeader& header) {
+    return std::equal(ARCHIVE_MAGIC, ARCHIVE_MAGIC + 8, header.magic) &&
+        header.version == ARCHIVE_VERSION &&
+        header.state_size > 0;
+}
+
+#if defined(NES_HAS_MMAP)
+
+/// Write a whole buffer to a file at an offset.
+static bool write_all(int descriptor, const void* data, std::size_t length, uint64_t offset) {
+    auto input = static_cast<const char*>(data);
+    while (length > 0) {
+        const ssize_t written = pwrite(descriptor, input, length, offset);
+        if (written <= 0)
+            return false;
+        input += written;
+        length -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/// Read a whole buffer from a file at an offset.
+static bool read_all(int descriptor, void* data, std::size_t length, uint64_t offset) {
+    auto output = static_cast<char*>(data);
+    while (length > 0) {
+        const ssize_t count = pread(descriptor, output, length, offset);
+        if (count <= 0)
+            return false;
+        output += count;
+        length -= count;
+        offset += count;
+    }
+    return true;
+}
+
+#endif
+
+StateArchive::StateArchive() :
+    memory(nullptr),
+    size(0),
+    header(nullptr),
+    entries(nullptr),
+    num_records(0) { }
+
+StateArchive::~StateArchive() {
+#if defined(NES_HAS_MMAP)
+    if (memory != nullptr)
+        munmap(const_cast<NES_Byte*>(memory), size);
+#endif
+}
+
+bool StateArchive::open(const std::string& path) {
+#if defined(NES_HAS_MMAP)
+    if (memory != nullptr)
+        return false;
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+    struct stat status;
+    void* mapped = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(ArchiveHeader)))
+        mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    // the mapping outlives the descriptor
+    ::close(descriptor);
+    if (mapped == MAP_FAILED)
+        return false;
+    auto file = static_cast<const ArchiveHeader*>(mapped);
+    if (!is_archive(*file)) {
+        munmap(mapped, status.st_size);
+        return false;
+    }
+    // records are loaded in any order, so reading ahead only wastes memory
+    madvise(mapped, status.st_size, MADV_RANDOM);
+    memory = static_cast<const NES_Byte*>(mapped);
+    size = status.st_size;
+    header = file;
+    const ArchiveCommit* commit = latest_commit(*header, size);
+    if (commit != nullptr) {
+        entries = reinterpret_cast<const ArchiveEntry*>(memory + commit->index_offset);
+        num_records = commit->num_records;
+    }
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+const NES_Byte* StateArchive::get_state(std::size_t index) const {
+    if (index >= num_records)
+        return nullptr;
+    const ArchiveEntry& entry = entries[index];
+    if ((entry.flags & ARCHIVE_DELTA) || entry.length != header->state_size || !is_in_file(entry, size))
+        return nullptr;
+    return memory + entry.offset;
+}
+
+bool StateArchive::read(std::size_t index, NES_Byte* output) const {
+    if (index >= num_records)
+        return false;
+    const ArchiveEntry& entry = entries[index];
+    if (!(entry.flags & ARCHIVE_DELTA)) {
+        const NES_Byte* state = get_state(index);
+        if (state == nullptr)
+            return false;
+        std::memcpy(output, state, header->state_size);
+        return true;
+    }
+    // deltas are from the first state, which is never a delta
+    const NES_Byte* base = get_state(0);
+    if (base == nullptr || !is_in_file(entry, size))
+        return false;
+    std::memcpy(output, base, header->state_size);
+    return apply_delta(memory + entry.offset, entry.length, output, header->state_size);
+}
+
+bool StateArchive::verify(std::size_t index) const {
+    if (index >= num_records || !is_in_file(entries[index], size))
+        return false;
+    const ArchiveEntry& entry = entries[index];
+    return hash_bytes(memory + entry.offset, entry.length) == entry.hash;
+}
+
+StateArchiveWriter::StateArchiveWriter() :
+    descriptor(-1),
+    header(),
+    num_committed(0),
+    sequence(0),
+    end(sizeof(ArchiveHeader)),
+    is_compressing(false) { }
+
+StateArchiveWriter::~StateArchiveWriter() { close(); }
+
+bool StateArchiveWriter::open(
+    const std::string& path,
+    std::size_t state_size,
+    NES_Hash rom_hash,
+    bool is_compressing
+) {
+#if defined(NES_HAS_MMAP)
+    if (descriptor >= 0)
+        return false;
+    const int file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file < 0)
+        return false;
+    // only one writer may append to a file at a time
+    struct stat status;
+    if (flock(file, LOCK_EX | LOCK_NB) != 0 || fstat(file, &status) != 0) {
+        ::close(file);
+        return false;
+    }
+    ArchiveHeader existing;
+    std::memset(&existing, 0, sizeof existing);
+    std::vector<ArchiveEntry> index;
+    std::vector<NES_Byte> first;
+    uint64_t offset = sizeof(ArchiveHeader);
+    uint64_t last_sequence = 0;
+    bool is_valid = true;
+    if (status.st_size == 0) {
+        std::copy(ARCHIVE_MAGIC, ARCHIVE_MAGIC + 8, existing.magic);
+        existing.version = ARCHIVE_VERSION;
+        existing.state_size = state_size;
+        existing.rom_hash = rom_hash;
+        is_valid = write_all(file, &existing, sizeof existing, 0);
+    } else {
+        is_valid = read_all(file, &existing, sizeof existing, 0) &&
+            is_archive(existing) &&
+            existing.state_size == state_size &&
+            existing.rom_hash == rom_hash;
+        const ArchiveCommit* commit = is_valid ? latest_commit(existing, status.st_size) : nullptr;
+        if (commit != nullptr) {
+            // append after the committed index, anything past it is from a
+            // writer that did not finish its commit
+            index.resize(commit->num_records);
+            offset = commit->index_offset + index.size() * sizeof(ArchiveEntry);
+            last_sequence = commit->sequence;
+            is_valid = read_all(file, index.data(), index.size() * sizeof(ArchiveEntry), commit->index_offset);
+            if (is_valid && !index.empty()) {
+                const ArchiveEntry& entry = index.front();
+                first.resize(state_size);
+                is_valid = !(entry.flags & ARCHIVE_DELTA) &&
+                    entry.length == state_size &&
+                    read_all(file, first.data(), state_size, entry.offset);
+            }
+        }
+    }
+    if (!is_valid) {
+        ::close(file);
+        return false;
+    }
+    descriptor = file;
+    header = existing;
+    entries.swap(index);
+    num_committed = entries.size();
+    sequence = last_sequence;
+    end = offset;
+    base.swap(first);
+    this->is_compressing = is_compressing;
+    delta.resize(max_delta_length(state_size));
+    return true;
+#else
+    (void) path; (void) state_size; (void) rom_hash; (void) is_compressing;
+    return false;
+#endif
+}
+
+bool StateArchiveWriter::append(const NES_Byte* state) {
+#if defined(NES_HAS_MMAP)
+    if (descriptor < 0)
+        return false;
+    const std::size_t state_size = header.state_size;
+    ArchiveEntry entry;
+    entry.offset = end;
+    entry.length = state_size;
+    entry.flags = 0;
+    const NES_Byte* record = state;
+    // the first state is stored as is and the others as deltas from it
+    // where that is smaller
+    if (is_compressing && !base.empty()) {
+        const std::size_t length = encode_delta(base.data(), state, state_size, delta.data());
+        if (length < state_size) {
+            record = delta.data();
+            entry.length = length;
+            entry.flags = ARCHIVE_DELTA;
+        }
+    }
+    if (!write_all(descriptor, record, entry.length, entry.offset))
+        return false;
+    entry.hash = hash_bytes(record, entry.length);
+    entries.push_back(entry);
+    end += entry.length;
+    if (base.empty())
+        base.assign(state, state + state_size);
+    return true;
+#else
+    (void) state;
+    return false;
+#endif
+}
+
+bool StateArchiveWriter::commit() {
+#if defined(NES_HAS_MMAP)
+    if (descriptor < 0)
+        return false;
+    if (entries.size() == num_committed)
+        return true;
+    // the new index follows the new records, the last index stays intact
+    // until the header points past it
+    const uint64_t index_offset = (end + 7) & ~uint64_t(7);
+    const std::size_t index_bytes = entries.size() * sizeof(ArchiveEntry);
+    if (!write_all(descriptor, entries.data(), index_bytes, index_offset) || fsync(descriptor) != 0)
+        return false;
+    // write the commit over the older of the two in the header
+    ArchiveCommit commit;
+    commit.sequence = sequence + 1;
+    commit.index_offset = index_offset;
+    commit.num_records = entries.size();
+    commit.checksum = commit_checksum(commit);
+    const std::size_t slot = commit.sequence % 2;
+    const uint64_t offset = offsetof(ArchiveHeader, commits) + slot * sizeof(ArchiveCommit);
+    if (!write_all(descriptor, &commit, sizeof commit, offset) || fsync(descriptor) != 0)
+        return false;
+    header.commits[slot] = commit;
+    sequence = commit.sequence;
+    num_committed = entries.size();
+    end = index_offset + index_bytes;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool StateArchiveWriter::close() {
+    if (descriptor < 0)
+        return false;
+    const bool is_committed = commit();
+#if defined(NES_HAS_MMAP)
+    ::close(descriptor);
+#endif
+    descriptor = -1;
+    entries.clear();
+    base.clear();
+    return is_committed;
+}
+
+}  // namespace NES
@@ -0,0 +1,73 @@
+//  Program:      nes-py
+//  File:         state_delta.cpp
+//  Description:  Compact XOR deltas between machine states
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <cstring>
+#include "state_delta.hpp"
+
+namespace NES {
+
+std::size_t encode_delta(
+    const NES_Byte* a,
+    const NES_Byte* b,
+    std::size_t length,
+    NES_Byte* output
+) {
+    NES_Byte* start = output;
+    std::size_t index = 0;
+    while (index < length) {
+        // skip equal bytes a word at a time
+        std::size_t zeros = index;
+        while (zeros + 8 <= length && std::memcmp(a + zeros, b + zeros, 8) == 0)
+            zeros += 8;
+        while (zeros < length && a[zeros] == b[zeros])
+            zeros++;
+        if (zeros == length)
+            break;
+        // a literal run ends at the next pair of equal bytes (a single equal
+        // byte costs less as a literal than as a new run)
+        std::size_t end = zeros;
+        while (end < length && (a[end] != b[end] || (end + 1 < length && a[end + 1] != b[end + 1])))
+            end++;
+        output = write_varint(output, zeros - index);
+        output = write_varint(output, end - zeros);
+        for (std::size_t i = zeros; i < end; i++)
+            *output++ = a[i] ^ b[i];
+        index = end;
+    }
+    // an empty run keeps every delta at least 1 byte long, so every entry
+    // of a rewind buffer occupies its pool and is evicted in ring order
+    if (output == start) {
+        output = write_varint(output, 0);
+        output = write_varint(output, 0);
+    }
+    return output - start;
+}
+
+bool apply_delta(
+    const NES_Byte* delta,
+    std::size_t length,
+    NES_Byte* state,
+    std::size_t state_length
+) {
+    const NES_Byte* end = delta + length;
+    std::size_t position = 0;
+    while (delta < end) {
+        std::size_t zeros, literals;
+        if ((delta = read_varint(delta, end, &zeros)) == nullptr ||
+            (delta = read_varint(delta, end, &literals)) == nullptr ||
+            zeros > state_length - position ||
+            literals > state_length - position - zeros ||
+            literals > static_cast<std::size_t>(end - delta))
+            return false;
+        position += zeros;
+        for (std::size_t i = 0; i < literals; i++)
+            state[position++] ^= *delta++;
+    }
+    return true;
+}
+
+}  // namespace NES
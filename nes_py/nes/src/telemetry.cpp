@@ -0,0 +1,88 @@
+//  Program:      nes-py
+//  File:         telemetry.cpp
+//  Description:  Lock-free latency histograms and frame rates
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "telemetry.hpp"
+
+namespace NES {
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    smallest.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    largest.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::get_quantile(double quantile) const {
+    // count the buckets rather than using count, which a concurrent record
+    // may have updated before or after its bucket
+    uint64_t total = 0;
+    for (const auto& bucket : buckets)
+        total += bucket.load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(std::min(std::max(quantile, 0.0), 1.0) * total));
+    uint64_t seen = 0;
+    std::size_t index = 0;
+    for (; index < NUM_BUCKETS - 1; index++) {
+        seen += buckets[index].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            break;
+    }
+    const double middle = get_lower_bound(index) + (get_width(index) - 1) / 2.0;
+    // the middle of the first or last bucket may lie outside the latencies
+    const double low = smallest.load(std::memory_order_relaxed);
+    const double high = largest.load(std::memory_order_relaxed);
+    return std::min(std::max(middle, low), std::max(low, high));
+}
+
+void LatencyHistogram::get_summary(double* output) const {
+    const uint64_t total = count.load(std::memory_order_relaxed);
+    output[0] = total;
+    output[1] = total ? double(sum.load(std::memory_order_relaxed)) / total : 0;
+    output[2] = total ? smallest.load(std::memory_order_relaxed) : 0;
+    output[3] = largest.load(std::memory_order_relaxed);
+    output[4] = get_quantile(0.5);
+    output[5] = get_quantile(0.9);
+    output[6] = get_quantile(0.99);
+    output[7] = get_quantile(0.999);
+}
+
+void LatencyHistogram::get_buckets(uint64_t* output) const {
+    for (const auto& bucket : buckets)
+        *output++ = bucket.load(std::memory_order_relaxed);
+}
+
+double FrameRate::get_rate(uint64_t now) const {
+    const uint64_t first = start.load(std::memory_order_relaxed);
+    if (first == 0 || now <= first)
+        return 0;
+    const uint64_t epoch = now / SLOT_NANOSECONDS;
+    uint64_t frames = 0;
+    for (const auto& slot : slots) {
+        const uint64_t value = slot.load(std::memory_order_relaxed);
+        const uint64_t slot_epoch = value >> 24;
+        if (slot_epoch <= epoch && epoch - slot_epoch < NUM_SLOTS)
+            frames += value & 0xffffff;
+    }
+    // the window is the full slots and the elapsed part of the current
+    // one, or less if the first frame came later
+    const uint64_t window = (NUM_SLOTS - 1) * SLOT_NANOSECONDS + now % SLOT_NANOSECONDS;
+    return frames / (std::min(window, now - first) * 1e-9);
+}
+
+void FrameRate::reset() {
+    for (auto& slot : slots)
+        slot.store(0, std::memory_order_relaxed);
+    start.store(0, std::memory_order_relaxed);
+}
+
+}  // namespace NES
@@ -0,0 +1,112 @@
+//  Program:      nes-py
+//  File:         thread_pool.cpp
+//  Description:  A pool of worker threads for running emulators in parallel
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include "thread_pool.hpp"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+namespace NES {
+
+ThreadPool::ThreadPool(std::size_t num_threads) :
+    task(nullptr),
+    num_iterations(0),
+    next_iteration(0),
+    num_busy(0),
+    generation(0),
+    is_stopping(false) {
+    for (std::size_t i = 0; i < num_threads; i++)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        is_stopping = true;
+    }
+    job_posted.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::run_iterations() {
+    for (;;) {
+        std::size_t index = next_iteration.fetch_add(1);
+        if (index >= num_iterations)
+            return;
+        (*task)(index);
+    }
+}
+
+void ThreadPool::work() {
+    uint64_t last_generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            job_posted.wait(guard, [&]() {
+                return is_stopping || generation != last_generation;
+            });
+            if (is_stopping)
+                return;
+            last_generation = generation;
+        }
+        run_iterations();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            num_busy--;
+        }
+        job_finished.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(
+    std::size_t num_iterations,
+    const std::function<void(std::size_t)>& task
+) {
+    // a single iteration (or a pool without workers) gains nothing from a
+    // hand-off to the workers
+    if (num_iterations <= 1 || workers.empty()) {
+        for (std::size_t index = 0; index < num_iterations; index++)
+            task(index);
+        return;
+    }
+    std::lock_guard<std::mutex> caller_guard(caller_lock);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->task = &task;
+        this->num_iterations = num_iterations;
+        next_iteration = 0;
+        num_busy = workers.size();
+        generation++;
+    }
+    job_posted.notify_all();
+    // the calling thread claims iterations too instead of sleeping
+    run_iterations();
+    std::unique_lock<std::mutex> guard(lock);
+    job_finished.wait(guard, [&]() { return num_busy == 0; });
+    this->task = nullptr;
+}
+
+ThreadPool& ThreadPool::shared() {
+    static std::mutex shared_lock;
+    static ThreadPool* pool = nullptr;
+    std::lock_guard<std::mutex> guard(shared_lock);
+#if !defined(_WIN32)
+    // a forked child (i.e., a subprocess vector environment) inherits the
+    // pool but not its threads, so it leaks the old pool and starts its own
+    static pid_t owner = 0;
+    if (pool != nullptr && owner != getpid())
+        pool = nullptr;
+    owner = getpid();
+#endif
+    if (pool == nullptr)
+        pool = new ThreadPool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return *pool;
+}
+
+}  // namespace NES
@@ -0,0 +1,52 @@
+//  Program:      nes-py
+//  File:         trace.cpp
+//  Description:  An optional binary trace of the instructions of the CPU
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <fstream>
+#include "trace.hpp"
+
+namespace NES {
+
+/// The header of a trace file
+struct TraceHeader {
+    /// the magic string "NESTRACE"
+    char magic[8];
+    /// the version of the format
+    uint32_t version;
+    /// the size of a record in bytes
+    uint32_t record_size;
+    /// the number of records in the file
+    uint64_t num_records;
+    /// the number of older records that were overwritten in the buffer
+    uint64_t num_dropped;
+};
+
+bool write_trace(
+    const std::string& path,
+    const std::vector<TraceRecord>& records,
+    uint64_t count
+) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    const uint64_t capacity = records.size();
+    const uint64_t num_records = count < capacity ? count : capacity;
+    TraceHeader header = {
+        {'N', 'E', 'S', 'T', 'R', 'A', 'C', 'E'},
+        2,
+        sizeof(TraceRecord),
+        num_records,
+        count - num_records
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof header);
+    // the oldest record is at the write position once the buffer wraps
+    const uint64_t start = count - num_records;
+    for (uint64_t index = start; index < count; index++)
+        file.write(reinterpret_cast<const char*>(&records[index % capacity]), sizeof(TraceRecord));
+    return file.good();
+}
+
+}  // namespace NES
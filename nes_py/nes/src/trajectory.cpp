@@ -0,0 +1,432 @@
+//  Program:      nes-py
+//  File:         trajectory.cpp
+//  Description:  Streaming recordings of steps for offline learning
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "palette.hpp"
+#include "ppu.hpp"
+#include "state_delta.hpp"
+#include "trajectory.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#define NES_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NES {
+
+/// The magic string at the start of a trajectory file
+static const char TRAJECTORY_MAGIC[8] = {'N', 'E', 'S', 'T', 'R', 'A', 'J', '\0'};
+
+/// The magic string at the start of a chunk
+static const char CHUNK_MAGIC[4] = {'S', 'T', 'E', 'P'};
+
+/// The version of the trajectory format
+static const uint32_t TRAJECTORY_VERSION = 1;
+
+/// The size of the RAM of a step of a trajectory of the NES
+static const uint32_t TRAJECTORY_RAM_SIZE = 0x800;
+
+/// The number of full chunks that may wait for the writer before record
+/// blocks (bounding the memory of a slow disk)
+static const std::size_t MAX_PENDING_CHUNKS = 4;
+
+/// The shortest run of equal bytes to encode as a repeat
+static const std::size_t MIN_REPEAT = 3;
+
+/// The number of colors of the palette
+static const std::size_t PALETTE_SIZE = sizeof(PALETTE) / sizeof(NES_Pixel);
+
+/// The bytes of a step before its RAM (actions, done, and reward)
+static const std::size_t STEP_FIXED_SIZE = 3 + sizeof(double);
+
+/// A reverse lookup from the colors of the palette to their indices
+class PaletteIndex {
+ private:
+    /// the number of slots of the table (a power of 2)
+    static const std::size_t SLOTS = 256;
+    /// the color of each slot
+    NES_Pixel colors[SLOTS];
+    /// the palette index of each slot (-1 for an empty slot)
+    int indices[SLOTS];
+
+    /// Return the first slot to probe for a color.
+    static inline std::size_t slot(NES_Pixel color) {
+        return (color * 0x9E3779B1u) >> 24;
+    }
+
+ public:
+    /// Build the table (the first index of a repeated color wins).
+    PaletteIndex() {
+        std::fill(indices, indices + SLOTS, -1);
+        for (std::size_t index = 0; index < PALETTE_SIZE; index++) {
+            std::size_t probe = slot(PALETTE[index]);
+            while (indices[probe] != -1 && colors[probe] != PALETTE[index])
+                probe = (probe + 1) % SLOTS;
+            if (indices[probe] != -1)
+                continue;
+            colors[probe] = PALETTE[index];
+            indices[probe] = index;
+        }
+    }
+
+    /// Return the palette index of a color (0x0F, black, if not a color
+    /// of the palette).
+    inline NES_Byte find(NES_Pixel color) const {
+        for (std::size_t probe = slot(color); indices[probe] != -1; probe = (probe + 1) % SLOTS)
+            if (colors[probe] == color)
+                return indices[probe];
+        return 0x0F;
+    }
+};
+
+/// Return the largest length of the runs of a buffer.
+static inline std::size_t max_runs_length(std::size_t length) {
+    return length + length / 2 + 16;
+}
+
+/// Encode a buffer as runs of (LEB128 count << 1 | 1, byte) for a repeated
+/// byte or (LEB128 count << 1, bytes) for literal bytes.
+///
+/// @param input the buffer to encode
+/// @param length the length of the buffer
+/// @param output a buffer of at least max_runs_length(length) bytes
+/// @return the number of bytes written to the output
+///
+static std::size_t encode_runs(const NES_Byte* input, std::size_t length, NES_Byte* output) {
+    NES_Byte* out = output;
+    // the start of the literal bytes that are not written yet
+    std::size_t literal = 0;
+    std::size_t index = 0;
+    while (index < length) {
+        std::size_t run = index + 1;
+        while (run < length && input[run] == input[index])
+            run++;
+        if (run - index >= MIN_REPEAT) {
+            if (literal < index) {
+                out = write_varint(out, (index - literal) << 1);
+                std::memcpy(out, input + literal, index - literal);
+                out += index - literal;
+            }
+            out = write_varint(out, ((run - index) << 1) | 1);
+            *out++ = input[index];
+            literal = run;
+        }
+        index = run;
+    }
+    if (literal < length) {
+        out = write_varint(out, (length - literal) << 1);
+        std::memcpy(out, input + literal, length - literal);
+        out += length - literal;
+    }
+    return out - output;
+}
+
+/// XOR the bytes of runs into a buffer in place.
+///
+/// @param input the encoded runs
+/// @param length the length of the runs in bytes
+/// @param output the buffer to XOR the bytes into
+/// @param output_length the length of the buffer
+/// @return false if the runs are malformed or do not cover the buffer
+///
+static bool xor_runs(
+    const NES_Byte* input,
+    std::size_t length,
+    NES_Byte* output,
+    std::size_t output_length
+) {
+    const NES_Byte* end = input + length;
+    std::size_t position = 0;
+    while (input < end) {
+        std::size_t token;
+        input = read_varint(input, end, &token);
+        if (input == nullptr)
+            return false;
+        const std::size_t count = token >> 1;
+        if (count > output_length - position)
+            return false;
+        if (token & 1) {
+            if (input == end)
+                return false;
+            const NES_Byte value = *input++;
+            // unchanged pixels are the common case
+            if (value != 0)
+                for (std::size_t index = 0; index < count; index++)
+                    output[position + index] ^= value;
+        } else {
+            if (count > static_cast<std::size_t>(end - input))
+                return false;
+            for (std::size_t index = 0; index < count; index++)
+                output[position + index] ^= input[index];
+            input += count;
+        }
+        position += count;
+    }
+    return position == output_length;
+}
+
+TrajectoryRecorder::TrajectoryRecorder(
+    uint32_t width,
+    uint32_t height,
+    uint32_t ram_size,
+    uint32_t chunk_steps,
+    NES_Hash rom_hash
+) :
+    header(),
+    is_closing(false),
+    is_failed(false),
+    chunk(sizeof(TrajectoryChunk)),
+    chunk_size(0),
+    num_steps(0),
+    frame(width * height, 0),
+    changes(width * height),
+    ram(ram_size, 0),
+    delta(std::max(max_delta_length(ram_size), max_runs_length(width * height))) {
+    std::copy(TRAJECTORY_MAGIC, TRAJECTORY_MAGIC + 8, header.magic);
+    header.version = TRAJECTORY_VERSION;
+    header.chunk_steps = std::max(chunk_steps, 1u);
+    header.width = width;
+    header.height = height;
+    header.ram_size = ram_size;
+    header.rom_hash = rom_hash;
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() { close(); }
+
+bool TrajectoryRecorder::open(const std::string& path) {
+    if (file.is_open())
+        return false;
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header))) {
+        file.close();
+        return false;
+    }
+    file.flush();
+    is_closing = false;
+    writer = std::thread(&TrajectoryRecorder::write_chunks, this);
+    return true;
+}
+
+void TrajectoryRecorder::write_chunks() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        chunk_queued.wait(guard, [&] { return !queue.empty() || is_closing; });
+        if (queue.empty())
+            return;
+        // write without the lock so record keeps encoding meanwhile
+        std::vector<NES_Byte> data = std::move(queue.front());
+        guard.unlock();
+        // flush each chunk so readers of a growing file see whole chunks
+        if (!file.write(reinterpret_cast<const char*>(data.data()), data.size()) || !file.flush())
+            is_failed = true;
+        guard.lock();
+        queue.pop_front();
+        chunk_written.notify_all();
+    }
+}
+
+void TrajectoryRecorder::flush() {
+    TrajectoryChunk info;
+    std::copy(CHUNK_MAGIC, CHUNK_MAGIC + 4, info.magic);
+    info.num_steps = chunk_size;
+    info.first_step = num_steps - chunk_size;
+    info.length = chunk.size() - sizeof(TrajectoryChunk);
+    info.hash = hash_bytes(chunk.data() + sizeof(TrajectoryChunk), info.length);
+    std::memcpy(chunk.data(), &info, sizeof(info));
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        chunk_written.wait(guard, [&] { return queue.size() < MAX_PENDING_CHUNKS; });
+        queue.push_back(std::move(chunk));
+    }
+    chunk_queued.notify_one();
+    // the next chunk decodes from blank buffers
+    chunk.assign(sizeof(TrajectoryChunk), 0);
+    chunk_size = 0;
+    std::fill(frame.begin(), frame.end(), 0);
+    std::fill(ram.begin(), ram.end(), 0);
+}
+
+void TrajectoryRecorder::record(const TrajectoryStep& step, const NES_Byte* step_ram, const NES_Pixel* screen) {
+    static const PaletteIndex palette;
+    NES_Byte fixed[STEP_FIXED_SIZE] = {step.action, step.second_action, step.done};
+    std::memcpy(fixed + 3, &step.reward, sizeof(double));
+    chunk.insert(chunk.end(), fixed, fixed + STEP_FIXED_SIZE);
+    // the RAM as a delta from the last step
+    NES_Byte length[10];
+    std::size_t size = encode_delta(ram.data(), step_ram, ram.size(), delta.data());
+    chunk.insert(chunk.end(), length, write_varint(length, size));
+    chunk.insert(chunk.end(), delta.begin(), delta.begin() + size);
+    std::copy(step_ram, step_ram + ram.size(), ram.begin());
+    // the frame as the runs of its changes from the last frame, looking up
+    // each color once per run of equal pixels
+    NES_Pixel color = screen[0];
+    NES_Byte index = palette.find(color);
+    for (std::size_t pixel = 0; pixel < frame.size(); pixel++) {
+        if (screen[pixel] != color) {
+            color = screen[pixel];
+            index = palette.find(color);
+        }
+        changes[pixel] = frame[pixel] ^ index;
+        frame[pixel] = index;
+    }
+    size = encode_runs(changes.data(), changes.size(), delta.data());
+    chunk.insert(chunk.end(), length, write_varint(length, size));
+    chunk.insert(chunk.end(), delta.begin(), delta.begin() + size);
+    num_steps++;
+    if (++chunk_size == header.chunk_steps)
+        flush();
+}
+
+bool TrajectoryRecorder::close() {
+    if (!file.is_open())
+        return false;
+    if (chunk_size > 0)
+        flush();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        is_closing = true;
+    }
+    chunk_queued.notify_one();
+    writer.join();
+    file.close();
+    return !is_failed && !file.fail();
+}
+
+TrajectoryReader::TrajectoryReader() :
+    memory(nullptr),
+    size(0),
+    header(nullptr),
+    num_steps(0),
+    cursor_chunk(-1),
+    cursor_steps(0),
+    cursor_offset(0),
+    cursor_end(0),
+    cursor() { }
+
+TrajectoryReader::~TrajectoryReader() {
+#if defined(NES_HAS_MMAP)
+    if (memory != nullptr)
+        munmap(const_cast<NES_Byte*>(memory), size);
+#endif
+}
+
+bool TrajectoryReader::open(const std::string& path) {
+#if defined(NES_HAS_MMAP)
+    if (memory != nullptr)
+        return false;
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        return false;
+    struct stat status;
+    void* mapped = MAP_FAILED;
+    if (fstat(descriptor, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(TrajectoryHeader)))
+        mapped = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+    // the mapping outlives the descriptor
+    ::close(descriptor);
+    if (mapped == MAP_FAILED)
+        return false;
+    auto file = static_cast<const TrajectoryHeader*>(mapped);
+    if (!std::equal(TRAJECTORY_MAGIC, TRAJECTORY_MAGIC + 8, file->magic) ||
+        file->version != TRAJECTORY_VERSION ||
+        // the buffers are sized from the header, so only accept the NES
+        file->width != SCANLINE_VISIBLE_DOTS ||
+        file->height != VISIBLE_SCANLINES ||
+        file->ram_size != TRAJECTORY_RAM_SIZE) {
+        munmap(mapped, status.st_size);
+        return false;
+    }
+    memory = static_cast<const NES_Byte*>(mapped);
+    size = status.st_size;
+    header = file;
+    frame.resize(header->width * header->height);
+    ram.resize(header->ram_size);
+    // index the chunks up to the first torn or corrupt one (i.e., the last
+    // chunk of a recorder that crashed or is still writing)
+    std::size_t offset = sizeof(TrajectoryHeader);
+    while (size - offset >= sizeof(TrajectoryChunk)) {
+        // chunks are not aligned in the file
+        TrajectoryChunk info;
+        std::memcpy(&info, memory + offset, sizeof(info));
+        const std::size_t start = offset + sizeof(TrajectoryChunk);
+        if (!std::equal(CHUNK_MAGIC, CHUNK_MAGIC + 4, info.magic) ||
+            info.num_steps == 0 ||
+            info.first_step != num_steps ||
+            info.length > size - start ||
+            hash_bytes(memory + start, info.length) != info.hash)
+            break;
+        chunks.push_back(offset);
+        first_steps.push_back(num_steps);
+        num_steps += info.num_steps;
+        offset = start + info.length;
+    }
+    return true;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+bool TrajectoryReader::decode_next() {
+    const NES_Byte* input = memory + cursor_offset;
+    const NES_Byte* end = memory + cursor_end;
+    if (static_cast<std::size_t>(end - input) < STEP_FIXED_SIZE)
+        return false;
+    cursor.action = input[0];
+    cursor.second_action = input[1];
+    cursor.done = input[2] != 0;
+    std::memcpy(&cursor.reward, input + 3, sizeof(double));
+    input += STEP_FIXED_SIZE;
+    std::size_t length;
+    input = read_varint(input, end, &length);
+    if (input == nullptr || length > static_cast<std::size_t>(end - input) ||
+        !apply_delta(input, length, ram.data(), ram.size()))
+        return false;
+    input += length;
+    input = read_varint(input, end, &length);
+    if (input == nullptr || length > static_cast<std::size_t>(end - input) ||
+        !xor_runs(input, length, frame.data(), frame.size()))
+        return false;
+    cursor_offset = input + length - memory;
+    cursor_steps++;
+    return true;
+}
+
+bool TrajectoryReader::read(uint64_t index, TrajectoryStep* step, NES_Byte* step_ram, NES_Byte* step_frame) {
+    if (index >= num_steps)
+        return false;
+    const std::size_t chunk = std::upper_bound(first_steps.begin(), first_steps.end(), index) - first_steps.begin() - 1;
+    const uint64_t local = index - first_steps[chunk];
+    // decode from the start of the chunk unless the step is at or after
+    // the last decoded step of the same chunk
+    if (cursor_chunk != static_cast<int64_t>(chunk) || local + 1 < cursor_steps) {
+        TrajectoryChunk info;
+        std::memcpy(&info, memory + chunks[chunk], sizeof(info));
+        cursor_chunk = chunk;
+        cursor_steps = 0;
+        cursor_offset = chunks[chunk] + sizeof(TrajectoryChunk);
+        cursor_end = cursor_offset + info.length;
+        std::fill(frame.begin(), frame.end(), 0);
+        std::fill(ram.begin(), ram.end(), 0);
+    }
+    while (cursor_steps <= local) {
+        if (!decode_next()) {
+            cursor_chunk = -1;
+            return false;
+        }
+    }
+    *step = cursor;
+    if (step_ram != nullptr)
+        std::copy(ram.begin(), ram.end(), step_ram);
+    if (step_frame != nullptr)
+        std::copy(frame.begin(), frame.end(), step_frame);
+    return true;
+}
+
+}  // namespace NES
@@ -0,0 +1,167 @@
+//  Program:      nes-py
+//  File:         transition_cache.cpp
+//  Description:  A bounded cache of the outcomes of emulated frames
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+#include "emulator.hpp"
+#include "screen_runs.hpp"
+#include "transition_cache.hpp"
+
+namespace NES {
+
+/// The memory an outcome uses besides its encoding (its slot and map node)
+static const std::size_t ENTRY_OVERHEAD = 64;
+
+// An outcome is encoded as the RAMProgramResult, the delta values of the
+// program, the number of runs of the screen (uint64), the runs as (count,
+// pixel) pairs, and the machine state, so everything but the state is
+// aligned for direct access.
+
+TransitionCache::TransitionCache(
+    std::size_t max_bytes,
+    bool is_caching_screens,
+    int num_shards
+) :
+    shards(std::max(num_shards, 1)),
+    shard_bytes(max_bytes / std::max(num_shards, 1)),
+    is_caching_screens(is_caching_screens),
+    hits(0),
+    misses(0),
+    evictions(0) {
+    for (auto& shard : shards) {
+        shard.hand = 0;
+        shard.used_bytes = 0;
+    }
+}
+
+NES_Hash TransitionCache::get_key(Emulator& emulator) {
+    // the ROM is not part of the machine state, so two ROMs with the same
+    // mapper and reset vector have the same state hashes after a reset
+    NES_Hash key = hash_combine(emulator.get_state_hash(), emulator.get_rom_hash());
+    key = hash_combine(key, emulator.get_program()->get_hash());
+    return hash_combine(key, *emulator.get_controller(0) | *emulator.get_controller(1) << 8);
+}
+
+bool TransitionCache::load(NES_Hash key, Emulator& emulator) {
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    auto found = shard.index.find(key);
+    if (found == shard.index.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Slot& slot = shard.slots[found->second];
+    slot.is_referenced = true;
+    const NES_Byte* value = slot.value.data();
+    RAMProgram& program = *emulator.get_program();
+    auto memory = reinterpret_cast<const double*>(value + sizeof(RAMProgramResult));
+    program.restore(memory, *reinterpret_cast<const RAMProgramResult*>(value));
+    value += sizeof(RAMProgramResult) + program.get_memory_size() * sizeof(double);
+    uint64_t num_runs;
+    std::memcpy(&num_runs, value, sizeof num_runs);
+    auto runs = reinterpret_cast<const NES_Pixel*>(value + sizeof num_runs);
+    decode_screen_runs(runs, num_runs, emulator.get_screen_buffer());
+    emulator.load_state(reinterpret_cast<const NES_Byte*>(runs + 2 * num_runs));
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void TransitionCache::store(NES_Hash key, Emulator& emulator) {
+    // encode the outcome before taking the lock
+    const RAMProgram& program = *emulator.get_program();
+    const NES_Pixel* screen = emulator.get_screen_buffer();
+    const std::size_t num_pixels = Emulator::WIDTH * Emulator::HEIGHT;
+    const uint64_t num_runs = is_caching_screens ? count_screen_runs(screen, num_pixels) : 0;
+    const std::size_t memory_bytes = program.get_memory_size() * sizeof(double);
+    const std::size_t runs_bytes = sizeof num_runs + num_runs * 2 * sizeof(NES_Pixel);
+    std::vector<NES_Byte> value(sizeof(RAMProgramResult) + memory_bytes + runs_bytes + emulator.state_size());
+    NES_Byte* output = value.data();
+    std::memcpy(output, program.get_result(), sizeof(RAMProgramResult));
+    output += sizeof(RAMProgramResult);
+    std::memcpy(output, program.get_memory(), memory_bytes);
+    output += memory_bytes;
+    std::memcpy(output, &num_runs, sizeof num_runs);
+    if (num_runs)
+        encode_screen_runs(screen, num_pixels, reinterpret_cast<NES_Pixel*>(output + sizeof num_runs));
+    emulator.save_state(output + runs_bytes);
+    const std::size_t bytes = value.size() + ENTRY_OVERHEAD;
+    if (bytes > shard_bytes)
+        return;
+    Shard& shard = get_shard(key);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    // another emulator sharing the cache may have stored it first
+    if (shard.index.count(key))
+        return;
+    evict(shard, bytes);
+    std::size_t index;
+    if (shard.free_slots.empty()) {
+        index = shard.slots.size();
+        shard.slots.emplace_back();
+    } else {
+        index = shard.free_slots.back();
+        shard.free_slots.pop_back();
+    }
+    Slot& slot = shard.slots[index];
+    slot.key = key;
+    slot.value.swap(value);
+    // new outcomes get no second chance until they are used, so a scan of
+    // states that are never revisited does not flush the hot ones
+    slot.is_referenced = false;
+    shard.index.emplace(key, index);
+    shard.used_bytes += bytes;
+}
+
+void TransitionCache::evict(Shard& shard, std::size_t bytes) {
+    while (shard.used_bytes + bytes > shard_bytes && !shard.index.empty()) {
+        if (shard.hand >= shard.slots.size())
+            shard.hand = 0;
+        const std::size_t index = shard.hand++;
+        Slot& slot = shard.slots[index];
+        if (slot.value.empty())
+            continue;
+        if (slot.is_referenced) {
+            slot.is_referenced = false;
+            continue;
+        }
+        shard.used_bytes -= slot.value.size() + ENTRY_OVERHEAD;
+        shard.index.erase(slot.key);
+        std::vector<NES_Byte>().swap(slot.value);
+        shard.free_slots.push_back(index);
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void TransitionCache::clear() {
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        shard.index.clear();
+        shard.slots.clear();
+        shard.free_slots.clear();
+        shard.hand = 0;
+        shard.used_bytes = 0;
+    }
+}
+
+std::size_t TransitionCache::get_num_entries() {
+    std::size_t count = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        count += shard.index.size();
+    }
+    return count;
+}
+
+std::size_t TransitionCache::get_used_bytes() {
+    std::size_t bytes = 0;
+    for (auto& shard : shards) {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        bytes += shard.used_bytes;
+    }
+    return bytes;
+}
+
+}  // namespace NES
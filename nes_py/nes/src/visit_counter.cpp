@@ -0,0 +1,78 @@
+//  Program:      nes-py
+//  File:         visit_counter.cpp
+//  Description:  Counts of visited RAM values for exploration bonuses
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "hash.hpp"
+#include "visit_counter.hpp"
+
+namespace NES {
+
+VisitCounter::VisitCounter(
+    const NES_Address* addresses,
+    int num_addresses,
+    const NES_Address* tuple_addresses,
+    const int* tuple_sizes,
+    int num_tuples,
+    int table_bits,
+    double scale
+) :
+    histograms(256 * std::max(num_addresses, 0), 0),
+    scale(scale),
+    bonus(0) {
+    // the RAM is mirrored every 0x800 bytes
+    for (int index = 0; index < num_addresses; index++)
+        this->addresses.push_back(addresses[index] & 0x7ff);
+    for (int tuple = 0; tuple < num_tuples; tuple++) {
+        for (int index = 0; index < tuple_sizes[tuple]; index++)
+            this->tuple_addresses.push_back(*tuple_addresses++ & 0x7ff);
+        tuple_ends.push_back(this->tuple_addresses.size());
+    }
+    if (num_tuples > 0)
+        table.resize(std::size_t(1) << std::min(std::max(table_bits, 1), MAX_TABLE_BITS), 0);
+    values.reserve(this->tuple_addresses.size());
+}
+
+std::size_t VisitCounter::get_slot(std::size_t tuple, const NES_Byte* ram) {
+    values.clear();
+    for (std::size_t index = tuple ? tuple_ends[tuple - 1] : 0; index < tuple_ends[tuple]; index++)
+        values.push_back(ram[tuple_addresses[index]]);
+    // seed with the tuple so equal values of different tuples differ
+    return hash_bytes(values.data(), values.size(), tuple + 1) & (table.size() - 1);
+}
+
+void VisitCounter::count(const NES_Byte* ram) {
+    double frame_bonus = 0;
+    for (std::size_t index = 0; index < addresses.size(); index++) {
+        double& visits = histograms[256 * index + ram[addresses[index]]];
+        visits += 1;
+        frame_bonus += 1 / std::sqrt(visits);
+    }
+    for (std::size_t tuple = 0; tuple < tuple_ends.size(); tuple++) {
+        double& visits = table[get_slot(tuple, ram)];
+        visits += 1;
+        frame_bonus += 1 / std::sqrt(visits);
+    }
+    bonus += scale * frame_bonus;
+}
+
+void VisitCounter::decay(double factor) {
+    factor = std::min(std::max(factor, 0.0), 1.0);
+    for (double& visits : histograms)
+        visits *= factor;
+    for (double& visits : table)
+        visits *= factor;
+}
+
+void VisitCounter::get_counts(const NES_Byte* ram, double* output) {
+    for (std::size_t index = 0; index < addresses.size(); index++)
+        *output++ = histograms[256 * index + ram[addresses[index]]];
+    for (std::size_t tuple = 0; tuple < tuple_ends.size(); tuple++)
+        *output++ = table[get_slot(tuple, ram)];
+}
+
+}  // namespace NES
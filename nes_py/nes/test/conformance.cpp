@@ -0,0 +1,225 @@
+//  Program:      nes-py
+//  File:         conformance.cpp
+//  Description:  A golden frame hash conformance suite for the emulator
+//
+//  Copyright (c) 2019 Christian Kauten. All rights reserved.
+//
+//  Usage:
+//      nes_conformance [--movies DIR] [--games DIR] [--record] [NAME...]
+//
+//  Every movie <NAME>.movie in the movie directory is replayed on the ROM
+//  <NAME>.nes from the games directory, and after each frame the hashes of
+//  the RAM, the CPU registers, and the screen are compared to the golden
+//  file <NAME>.golden. The first divergent frame of each movie is reported
+//  and the exit status is 1 if any movie diverged.
+//
+//  A movie is a text file of "<frames> <controller byte in hex>" lines;
+//  lines that start with '#' are comments. A golden file has one line of
+//  "<RAM hash> <CPU hash> <screen hash>" per frame. With --record, golden
+//  files are (re)written from the current emulator instead of checked, so
+//  only record after verifying that a change is supposed to alter output.
+//
+
+#include <dirent.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "emulator.hpp"
+
+using NES::Emulator;
+using NES::NES_Hash;
+
+/// The hashes of the machine after a frame
+struct FrameHashes {
+    /// the hash of the 2KB RAM
+    NES_Hash ram;
+    /// the hash of the CPU registers and cycle counters
+    NES_Hash cpu;
+    /// the hash of the screen buffer
+    NES_Hash screen;
+
+    /// Return true if the hashes equal another set of hashes.
+    inline bool operator==(const FrameHashes& other) const {
+        return ram == other.ram && cpu == other.cpu && screen == other.screen;
+    }
+};
+
+/// Return the hashes of the machine in its current state.
+static FrameHashes get_hashes(Emulator& emulator) {
+    NES::StateHasher hasher;
+    emulator.get_cpu().visit_state(hasher);
+    return FrameHashes{
+        NES::hash_bytes(emulator.get_memory_buffer(), 0x800),
+        hasher.digest(),
+        emulator.get_screen_hash()
+    };
+}
+
+/// Read a movie into a vector of one controller byte per frame.
+static bool read_movie(const std::string& path, std::vector<NES::NES_Byte>& actions) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        int frames;
+        unsigned action;
+        if (!(fields >> std::dec >> frames >> std::hex >> action) || frames < 0 || action > 0xff)
+            return false;
+        actions.insert(actions.end(), frames, action);
+    }
+    return true;
+}
+
+/// Read a golden file into a vector of hashes per frame.
+static bool read_golden(const std::string& path, std::vector<FrameHashes>& golden) {
+    std::ifstream file(path);
+    if (!file.is_open())
+        return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        FrameHashes hashes;
+        if (std::sscanf(line.c_str(), "%" SCNx64 " %" SCNx64 " %" SCNx64,
+                &hashes.ram, &hashes.cpu, &hashes.screen) != 3)
+            return false;
+        golden.push_back(hashes);
+    }
+    return true;
+}
+
+/// Write a golden file from a vector of hashes per frame.
+static bool write_golden(const std::string& path, const std::vector<FrameHashes>& hashes) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+    for (const auto& frame : hashes)
+        std::fprintf(file, "%016" PRIx64 " %016" PRIx64 " %016" PRIx64 "\n",
+            frame.ram, frame.cpu, frame.screen);
+    return std::fclose(file) == 0;
+}
+
+/// Return the names of the movies in a directory in sorted order.
+static std::vector<std::string> find_movies(const std::string& directory) {
+    std::vector<std::string> names;
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return names;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 6 && name.compare(name.size() - 6, 6, ".movie") == 0)
+            names.push_back(name.substr(0, name.size() - 6));
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+/// Replay a movie and check (or record) its golden hashes.
+///
+/// @return true if the movie conforms to (or was recorded as) the golden
+///
+static bool run_movie(
+    const std::string& name,
+    const std::string& movies,
+    const std::string& games,
+    bool is_recording
+) {
+    std::vector<NES::NES_Byte> actions;
+    if (!read_movie(movies + "/" + name + ".movie", actions)) {
+        std::cerr << name << ": failed to read movie" << std::endl;
+        return false;
+    }
+    std::vector<FrameHashes> golden;
+    const std::string golden_path = movies + "/" + name + ".golden";
+    if (!is_recording && !read_golden(golden_path, golden)) {
+        std::cerr << name << ": failed to read golden file" << std::endl;
+        return false;
+    }
+    const std::string rom_path = games + "/" + name + ".nes";
+    if (!std::ifstream(rom_path).good()) {
+        std::cerr << name << ": missing ROM " << rom_path << std::endl;
+        return false;
+    }
+    Emulator emulator(rom_path);
+    emulator.reset();
+    std::vector<FrameHashes> hashes;
+    hashes.reserve(actions.size());
+    for (std::size_t frame = 0; frame < actions.size(); frame++) {
+        *emulator.get_controller(0) = actions[frame];
+        emulator.step();
+        hashes.push_back(get_hashes(emulator));
+        if (is_recording)
+            continue;
+        if (frame >= golden.size()) {
+            std::cerr << name << ": golden file ends at frame " << golden.size()
+                << " but the movie has " << actions.size() << " frames" << std::endl;
+            return false;
+        }
+        if (hashes.back() == golden[frame])
+            continue;
+        // report the first divergent frame and which parts diverged
+        const FrameHashes& expected = golden[frame];
+        const FrameHashes& actual = hashes.back();
+        std::cerr << name << ": diverged at frame " << frame + 1 << " (";
+        const char* separator = "";
+        if (actual.ram != expected.ram) { std::cerr << "RAM"; separator = ", "; }
+        if (actual.cpu != expected.cpu) { std::cerr << separator << "CPU"; separator = ", "; }
+        if (actual.screen != expected.screen) std::cerr << separator << "screen";
+        std::cerr << ")" << std::endl;
+        return false;
+    }
+    if (is_recording) {
+        if (!write_golden(golden_path, hashes)) {
+            std::cerr << name << ": failed to write golden file" << std::endl;
+            return false;
+        }
+        std::cout << name << ": recorded " << hashes.size() << " frames" << std::endl;
+        return true;
+    }
+    if (golden.size() != actions.size()) {
+        std::cerr << name << ": golden file has " << golden.size()
+            << " frames but the movie has " << actions.size() << std::endl;
+        return false;
+    }
+    std::cout << name << ": " << hashes.size() << " frames OK" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string movies = "nes_py/tests/conformance";
+    std::string games = "nes_py/tests/games";
+    bool is_recording = false;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--movies" && has_value) movies = argv[++i];
+        else if (arg == "--games" && has_value) games = argv[++i];
+        else if (arg == "--record") is_recording = true;
+        else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "usage: " << argv[0]
+                << " [--movies DIR] [--games DIR] [--record] [NAME...]" << std::endl;
+            return 2;
+        } else {
+            names.push_back(arg);
+        }
+    }
+    if (names.empty())
+        names = find_movies(movies);
+    if (names.empty()) {
+        std::cerr << "no movies found in " << movies << std::endl;
+        return 2;
+    }
+    int failures = 0;
+    for (const auto& name : names)
+        failures += !run_movie(name, movies, games, is_recording);
+    return failures ? 1 : 0;
+}
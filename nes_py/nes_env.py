@@ -4,12 +4,15 @@ import glob
 import itertools
 import os
 import sys
+import time
 import gym
 from gym.spaces import Box
 from gym.spaces import Discrete
 import numpy as np
 from ._rom import ROM
 from ._image_viewer import ImageViewer
+from .ram_program import RAMProgram
+from .ram_program import RAMProgramResult
 
 
 # the path to the directory this file is in
@@ -25,6 +28,59 @@ except IndexError:
     raise OSError('missing static lib_nes_env*.so library!')
 
 
+# the regions of the CPU address space that stats count accesses to
+BUS_REGIONS = ('ram', 'ppu', 'io', 'expansion', 'extended_ram', 'prg')
+
+
+# the operations with latency histograms (must match LatencyKind in telemetry.hpp)
+LATENCY_KINDS = ('step', 'reset', 'render')
+
+
+class StatsCounters(ctypes.Structure):
+    """The instrumentation counters of an emulator (must match stats.hpp)."""
+
+    _fields_ = [
+        ('is_enabled', ctypes.c_uint64),
+        ('instructions', ctypes.c_uint64),
+        ('cycles', ctypes.c_uint64),
+        ('stall_cycles', ctypes.c_uint64),
+        ('idle_cycles', ctypes.c_uint64),
+        ('dma_cycles', ctypes.c_uint64),
+        ('reads', ctypes.c_uint64 * len(BUS_REGIONS)),
+        ('writes', ctypes.c_uint64 * len(BUS_REGIONS)),
+        ('mapper_writes', ctypes.c_uint64),
+        ('nmis', ctypes.c_uint64),
+        ('irqs', ctypes.c_uint64),
+        ('frames_rendered', ctypes.c_uint64),
+        ('frames_skipped', ctypes.c_uint64),
+    ]
+
+
+class EpisodeStats(ctypes.Structure):
+    """The return and length of native episodes (must match start_pool.hpp)."""
+
+    _fields_ = [
+        ('episode_return', ctypes.c_double),
+        ('episode_length', ctypes.c_int64),
+        ('final_return', ctypes.c_double),
+        ('final_length', ctypes.c_int64),
+        ('num_episodes', ctypes.c_int64),
+    ]
+
+
+class CellInfo(ctypes.Structure):
+    """The statistics of a cell of a native archive (must match cell_archive.hpp)."""
+
+    _fields_ = [
+        ('key', ctypes.c_uint64),
+        ('score', ctypes.c_double),
+        ('length', ctypes.c_int64),
+        ('times_seen', ctypes.c_int64),
+        ('times_chosen', ctypes.c_int64),
+        ('times_chosen_since_new', ctypes.c_int64),
+    ]
+
+
 # setup the argument and return types for Width
 _LIB.Width.argtypes = None
 _LIB.Width.restype = ctypes.c_uint
@@ -55,6 +111,391 @@ _LIB.Backup.restype = None
 # setup the argument and return types for Restore
 _LIB.Restore.argtypes = [ctypes.c_void_p]
 _LIB.Restore.restype = None
+# setup the argument and return types for StateHash
+_LIB.StateHash.argtypes = [ctypes.c_void_p]
+_LIB.StateHash.restype = ctypes.c_uint64
+# setup the argument and return types for ScreenHash
+_LIB.ScreenHash.argtypes = [ctypes.c_void_p]
+_LIB.ScreenHash.restype = ctypes.c_uint64
+# setup the argument and return types for SetProgram
+_LIB.SetProgram.argtypes = [
+    ctypes.c_void_p,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+]
+_LIB.SetProgram.restype = ctypes.c_bool
+# setup the argument and return types for ResetProgram
+_LIB.ResetProgram.argtypes = [ctypes.c_void_p]
+_LIB.ResetProgram.restype = None
+# setup the argument and return types for ProgramResult
+_LIB.ProgramResult.argtypes = [ctypes.c_void_p]
+_LIB.ProgramResult.restype = ctypes.POINTER(RAMProgramResult)
+# setup the argument and return types for SetBreakpoint
+_LIB.SetBreakpoint.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_bool]
+_LIB.SetBreakpoint.restype = None
+# setup the argument and return types for RunUntil
+_LIB.RunUntil.argtypes = [
+    ctypes.c_void_p,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_bool),
+]
+_LIB.RunUntil.restype = ctypes.c_int
+# setup the argument and return types for Stats
+_LIB.Stats.argtypes = [ctypes.c_void_p]
+_LIB.Stats.restype = ctypes.POINTER(StatsCounters)
+# setup the argument and return types for ResetStats
+_LIB.ResetStats.argtypes = [ctypes.c_void_p]
+_LIB.ResetStats.restype = None
+# setup the argument and return types for SetProfiler
+_LIB.SetProfiler.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+_LIB.SetProfiler.restype = None
+# setup the argument and return types for DumpProfile
+_LIB.DumpProfile.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p, ctypes.c_bool]
+_LIB.DumpProfile.restype = ctypes.c_bool
+# setup the argument and return types for DumpTrace
+_LIB.DumpTrace.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p]
+_LIB.DumpTrace.restype = ctypes.c_bool
+# setup the argument and return types for ResetTrace
+_LIB.ResetTrace.argtypes = [ctypes.c_void_p]
+_LIB.ResetTrace.restype = None
+# setup the argument and return types for StateSize
+_LIB.StateSize.argtypes = [ctypes.c_void_p]
+_LIB.StateSize.restype = ctypes.c_int
+# setup the argument and return types for SaveState
+_LIB.SaveState.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.SaveState.restype = None
+# setup the argument and return types for LoadState
+_LIB.LoadState.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.LoadState.restype = ctypes.c_bool
+# setup the argument and return types for Expand
+_LIB.Expand.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.Expand.restype = None
+# setup the argument and return types for EvaluateSequences
+_LIB.EvaluateSequences.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.EvaluateSequences.restype = ctypes.c_int64
+# setup the argument and return types for Rollout
+_LIB.Rollout.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_uint8),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int),
+]
+_LIB.Rollout.restype = ctypes.c_double
+# setup the argument and return types for RolloutBatch
+_LIB.RolloutBatch.argtypes = [
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_uint8),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_int32),
+    ctypes.c_int,
+    ctypes.POINTER(ctypes.c_double),
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.c_int,
+    ctypes.c_void_p,
+    ctypes.c_void_p,
+]
+_LIB.RolloutBatch.restype = ctypes.c_bool
+# setup the argument and return types for StartRecording
+_LIB.StartRecording.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.StartRecording.restype = None
+# setup the argument and return types for StopRecording
+_LIB.StopRecording.argtypes = [ctypes.c_void_p]
+_LIB.StopRecording.restype = None
+# setup the argument and return types for MovieFrames
+_LIB.MovieFrames.argtypes = [ctypes.c_void_p]
+_LIB.MovieFrames.restype = ctypes.c_int
+# setup the argument and return types for MovieInputs
+_LIB.MovieInputs.argtypes = [ctypes.c_void_p]
+_LIB.MovieInputs.restype = ctypes.c_void_p
+# setup the argument and return types for Seek
+_LIB.Seek.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.Seek.restype = ctypes.c_bool
+# setup the argument and return types for SaveMovie
+_LIB.SaveMovie.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p, ctypes.c_bool]
+_LIB.SaveMovie.restype = ctypes.c_bool
+# setup the argument and return types for LoadMovie
+_LIB.LoadMovie.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p]
+_LIB.LoadMovie.restype = ctypes.c_bool
+# setup the argument and return types for SetRewind
+_LIB.SetRewind.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int64]
+_LIB.SetRewind.restype = None
+# setup the argument and return types for Rewind
+_LIB.Rewind.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+_LIB.Rewind.restype = ctypes.c_int64
+# setup the argument and return types for RewindStates
+_LIB.RewindStates.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int64)]
+_LIB.RewindStates.restype = ctypes.c_int
+# setup the argument and return types for CreateBatch
+_LIB.CreateBatch.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.c_int]
+_LIB.CreateBatch.restype = ctypes.c_void_p
+# setup the argument and return types for StepAsync
+_LIB.StepAsync.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int]
+_LIB.StepAsync.restype = ctypes.c_bool
+# setup the argument and return types for Poll
+_LIB.Poll.argtypes = [ctypes.c_void_p]
+_LIB.Poll.restype = ctypes.c_bool
+# setup the argument and return types for Wait
+_LIB.Wait.argtypes = [ctypes.c_void_p]
+_LIB.Wait.restype = ctypes.c_int
+# setup the argument and return types for BatchScreens
+_LIB.BatchScreens.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.BatchScreens.restype = ctypes.c_void_p
+# setup the argument and return types for BatchMemory
+_LIB.BatchMemory.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.BatchMemory.restype = ctypes.c_void_p
+# setup the argument and return types for BatchResults
+_LIB.BatchResults.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.BatchResults.restype = ctypes.POINTER(RAMProgramResult)
+# setup the argument and return types for CloseBatch
+_LIB.CloseBatch.argtypes = [ctypes.c_void_p]
+_LIB.CloseBatch.restype = None
+# setup the argument and return types for CreateShmServer
+_LIB.CreateShmServer.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p, ctypes.c_int, ctypes.c_bool]
+_LIB.CreateShmServer.restype = ctypes.c_void_p
+# setup the argument and return types for CloseShmServer
+_LIB.CloseShmServer.argtypes = [ctypes.c_void_p]
+_LIB.CloseShmServer.restype = None
+# setup the argument and return types for ShmConnect
+_LIB.ShmConnect.argtypes = [ctypes.c_wchar_p]
+_LIB.ShmConnect.restype = ctypes.c_void_p
+# setup the argument and return types for ShmNumSlots
+_LIB.ShmNumSlots.argtypes = [ctypes.c_void_p]
+_LIB.ShmNumSlots.restype = ctypes.c_int
+# setup the argument and return types for ShmSlot
+_LIB.ShmSlot.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.ShmSlot.restype = ctypes.c_void_p
+# setup the argument and return types for ShmSend
+_LIB.ShmSend.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_uint8, ctypes.c_int]
+_LIB.ShmSend.restype = ctypes.c_bool
+# setup the argument and return types for ShmReceive
+_LIB.ShmReceive.argtypes = [ctypes.c_void_p]
+_LIB.ShmReceive.restype = ctypes.c_int
+# setup the argument and return types for ShmDisconnect
+_LIB.ShmDisconnect.argtypes = [ctypes.c_void_p]
+_LIB.ShmDisconnect.restype = None
+# setup the argument and return types for CreateSocketServer
+_LIB.CreateSocketServer.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_bool), ctypes.c_int, ctypes.c_wchar_p, ctypes.c_int]
+_LIB.CreateSocketServer.restype = ctypes.c_void_p
+# setup the argument and return types for SocketServerPort
+_LIB.SocketServerPort.argtypes = [ctypes.c_void_p]
+_LIB.SocketServerPort.restype = ctypes.c_int
+# setup the argument and return types for CloseSocketServer
+_LIB.CloseSocketServer.argtypes = [ctypes.c_void_p]
+_LIB.CloseSocketServer.restype = None
+# setup the argument and return types for SetSpeculation
+_LIB.SetSpeculation.argtypes = [ctypes.c_void_p, ctypes.c_bool, ctypes.c_bool]
+_LIB.SetSpeculation.restype = None
+# setup the argument and return types for Speculate
+_LIB.Speculate.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+_LIB.Speculate.restype = None
+# setup the argument and return types for StepSpeculative
+_LIB.StepSpeculative.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.StepSpeculative.restype = ctypes.c_bool
+# setup the argument and return types for SpeculationStats
+_LIB.SpeculationStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64), ctypes.POINTER(ctypes.c_uint64)]
+_LIB.SpeculationStats.restype = None
+# setup the argument and return types for SetTransitionCache
+_LIB.SetTransitionCache.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_bool]
+_LIB.SetTransitionCache.restype = None
+# setup the argument and return types for ShareTransitionCache
+_LIB.ShareTransitionCache.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.ShareTransitionCache.restype = ctypes.c_bool
+# setup the argument and return types for TransitionCacheStats
+_LIB.TransitionCacheStats.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_uint64)]
+_LIB.TransitionCacheStats.restype = ctypes.c_bool
+# setup the argument and return types for SetStartPool
+_LIB.SetStartPool.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_uint8, ctypes.c_uint64]
+_LIB.SetStartPool.restype = None
+# setup the argument and return types for AddStartState
+_LIB.AddStartState.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+_LIB.AddStartState.restype = ctypes.c_bool
+# setup the argument and return types for StartPoolSize
+_LIB.StartPoolSize.argtypes = [ctypes.c_void_p]
+_LIB.StartPoolSize.restype = ctypes.c_int
+# setup the argument and return types for SeedStartPool
+_LIB.SeedStartPool.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_LIB.SeedStartPool.restype = None
+# setup the argument and return types for ResetToStart
+_LIB.ResetToStart.argtypes = [ctypes.c_void_p]
+_LIB.ResetToStart.restype = ctypes.c_bool
+# setup the argument and return types for SetAutoreset
+_LIB.SetAutoreset.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+_LIB.SetAutoreset.restype = None
+# setup the argument and return types for StepEpisode
+_LIB.StepEpisode.argtypes = [ctypes.c_void_p, ctypes.c_int]
+_LIB.StepEpisode.restype = ctypes.c_bool
+# setup the argument and return types for Episode
+_LIB.Episode.argtypes = [ctypes.c_void_p]
+_LIB.Episode.restype = ctypes.POINTER(EpisodeStats)
+# setup the argument and return types for OpenArchive
+_LIB.OpenArchive.argtypes = [ctypes.c_wchar_p, ctypes.c_void_p]
+_LIB.OpenArchive.restype = ctypes.c_void_p
+# setup the argument and return types for ArchiveSize
+_LIB.ArchiveSize.argtypes = [ctypes.c_void_p]
+_LIB.ArchiveSize.restype = ctypes.c_int64
+# setup the argument and return types for ArchiveLoad
+_LIB.ArchiveLoad.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int64]
+_LIB.ArchiveLoad.restype = ctypes.c_bool
+# setup the argument and return types for ArchiveRead
+_LIB.ArchiveRead.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_void_p]
+_LIB.ArchiveRead.restype = ctypes.c_bool
+# setup the argument and return types for ArchiveVerify
+_LIB.ArchiveVerify.argtypes = [ctypes.c_void_p, ctypes.c_int64]
+_LIB.ArchiveVerify.restype = ctypes.c_bool
+# setup the argument and return types for CloseArchive
+_LIB.CloseArchive.argtypes = [ctypes.c_void_p]
+_LIB.CloseArchive.restype = None
+# setup the argument and return types for CreateArchiveWriter
+_LIB.CreateArchiveWriter.argtypes = [ctypes.c_wchar_p, ctypes.c_void_p, ctypes.c_bool]
+_LIB.CreateArchiveWriter.restype = ctypes.c_void_p
+# setup the argument and return types for ArchiveAppend
+_LIB.ArchiveAppend.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.ArchiveAppend.restype = ctypes.c_bool
+# setup the argument and return types for ArchiveWriterSize
+_LIB.ArchiveWriterSize.argtypes = [ctypes.c_void_p]
+_LIB.ArchiveWriterSize.restype = ctypes.c_int64
+# setup the argument and return types for ArchiveCommit
+_LIB.ArchiveCommit.argtypes = [ctypes.c_void_p]
+_LIB.ArchiveCommit.restype = ctypes.c_bool
+# setup the argument and return types for CloseArchiveWriter
+_LIB.CloseArchiveWriter.argtypes = [ctypes.c_void_p]
+_LIB.CloseArchiveWriter.restype = ctypes.c_bool
+# setup the argument and return types for StartTrajectory
+_LIB.StartTrajectory.argtypes = [ctypes.c_void_p, ctypes.c_wchar_p, ctypes.c_int]
+_LIB.StartTrajectory.restype = ctypes.c_bool
+# setup the argument and return types for StopTrajectory
+_LIB.StopTrajectory.argtypes = [ctypes.c_void_p]
+_LIB.StopTrajectory.restype = ctypes.c_bool
+# setup the argument and return types for RecordedSteps
+_LIB.RecordedSteps.argtypes = [ctypes.c_void_p]
+_LIB.RecordedSteps.restype = ctypes.c_int64
+# setup the argument and return types for OpenTrajectory
+_LIB.OpenTrajectory.argtypes = [ctypes.c_wchar_p]
+_LIB.OpenTrajectory.restype = ctypes.c_void_p
+# setup the argument and return types for TrajectorySize
+_LIB.TrajectorySize.argtypes = [ctypes.c_void_p]
+_LIB.TrajectorySize.restype = ctypes.c_int64
+# setup the argument and return types for TrajectoryROMHash
+_LIB.TrajectoryROMHash.argtypes = [ctypes.c_void_p]
+_LIB.TrajectoryROMHash.restype = ctypes.c_uint64
+# setup the argument and return types for TrajectoryRead
+_LIB.TrajectoryRead.argtypes = [ctypes.c_void_p, ctypes.c_int64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+_LIB.TrajectoryRead.restype = ctypes.c_bool
+# setup the argument and return types for CloseTrajectory
+_LIB.CloseTrajectory.argtypes = [ctypes.c_void_p]
+_LIB.CloseTrajectory.restype = None
+# setup the argument and return types for Palette
+_LIB.Palette.argtypes = None
+_LIB.Palette.restype = ctypes.POINTER(ctypes.c_uint32)
+# setup the argument and return types for SetCellArchive
+_LIB.SetCellArchive.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_uint64]
+_LIB.SetCellArchive.restype = None
+# setup the argument and return types for RemoveCellArchive
+_LIB.RemoveCellArchive.argtypes = [ctypes.c_void_p]
+_LIB.RemoveCellArchive.restype = None
+# setup the argument and return types for BeginCells
+_LIB.BeginCells.argtypes = [ctypes.c_void_p]
+_LIB.BeginCells.restype = None
+# setup the argument and return types for SelectCell
+_LIB.SelectCell.argtypes = [ctypes.c_void_p]
+_LIB.SelectCell.restype = ctypes.c_bool
+# setup the argument and return types for LoadCell
+_LIB.LoadCell.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_LIB.LoadCell.restype = ctypes.c_bool
+# setup the argument and return types for CellArchiveSize
+_LIB.CellArchiveSize.argtypes = [ctypes.c_void_p]
+_LIB.CellArchiveSize.restype = ctypes.c_int64
+# setup the argument and return types for Cells
+_LIB.Cells.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.Cells.restype = None
+# setup the argument and return types for CurrentCell
+_LIB.CurrentCell.argtypes = [ctypes.c_void_p]
+_LIB.CurrentCell.restype = ctypes.c_uint64
+# setup the argument and return types for SeedCellArchive
+_LIB.SeedCellArchive.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+_LIB.SeedCellArchive.restype = None
+# setup the argument and return types for SetVisitCounts
+_LIB.SetVisitCounts.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_double]
+_LIB.SetVisitCounts.restype = None
+# setup the argument and return types for RemoveVisitCounts
+_LIB.RemoveVisitCounts.argtypes = [ctypes.c_void_p]
+_LIB.RemoveVisitCounts.restype = None
+# setup the argument and return types for TakeVisitBonus
+_LIB.TakeVisitBonus.argtypes = [ctypes.c_void_p]
+_LIB.TakeVisitBonus.restype = ctypes.c_double
+# setup the argument and return types for DecayVisitCounts
+_LIB.DecayVisitCounts.argtypes = [ctypes.c_void_p, ctypes.c_double]
+_LIB.DecayVisitCounts.restype = None
+# setup the argument and return types for VisitCounts
+_LIB.VisitCounts.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+_LIB.VisitCounts.restype = None
+# setup the argument and return types for VisitHistogram
+_LIB.VisitHistogram.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+_LIB.VisitHistogram.restype = ctypes.c_bool
+# setup the argument and return types for LatencySummary
+_LIB.LatencySummary.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+_LIB.LatencySummary.restype = ctypes.c_bool
+# setup the argument and return types for LatencyCounts
+_LIB.LatencyCounts.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p]
+_LIB.LatencyCounts.restype = ctypes.c_bool
+# setup the argument and return types for LatencyBuckets
+_LIB.LatencyBuckets.argtypes = [ctypes.c_void_p]
+_LIB.LatencyBuckets.restype = ctypes.c_int
+# setup the argument and return types for RecordLatency
+_LIB.RecordLatency.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_uint64]
+_LIB.RecordLatency.restype = ctypes.c_bool
+# setup the argument and return types for FramesPerSecond
+_LIB.FramesPerSecond.argtypes = [ctypes.c_void_p]
+_LIB.FramesPerSecond.restype = ctypes.c_double
+# setup the argument and return types for ResetTelemetry
+_LIB.ResetTelemetry.argtypes = [ctypes.c_void_p]
+_LIB.ResetTelemetry.restype = None
 # setup the argument and return types for Close
 _LIB.Close.argtypes = [ctypes.c_void_p]
 _LIB.Close.restype = None
@@ -149,6 +590,20 @@ class NESEnv(gym.Env):
         self.controllers = [self._controller_buffer(port) for port in range(2)]
         self.screen = self._screen_buffer()
         self.ram = self._ram_buffer()
+        # setup a placeholder for a native RAM program and its outputs
+        self._program = None
+        self._program_result = _LIB.ProgramResult(self._env).contents
+        # setup a flag for speculative steps
+        self._is_speculating = False
+        # setup flags for resets to a native start pool and the episodes
+        self._has_start_pool = False
+        self._is_autoresetting = False
+        self._episode = _LIB.Episode(self._env).contents
+        # setup a flag for a native Go-Explore cell archive
+        self._has_cell_archive = False
+        # setup the counted addresses and tuples of native visit counts
+        self._visit_addresses = None
+        self._visit_tuples = None
 
     def _screen_buffer(self):
         """Setup the screen buffer from the C++ code."""
@@ -208,7 +663,10 @@ class NESEnv(gym.Env):
         # set the action on the controller
         self.controllers[0][:] = action
         # perform a step on the emulator
-        _LIB.Step(self._env)
+        if self._is_speculating:
+            _LIB.StepSpeculative(self._env, 1)
+        else:
+            _LIB.Step(self._env)
 
     def _backup(self):
         """Backup the NES state in the emulator."""
@@ -219,6 +677,1089 @@ class NESEnv(gym.Env):
         """Restore the backup state into the NES emulator."""
         _LIB.Restore(self._env)
 
+    def _save_state(self):
+        """
+        Return a snapshot of the full machine state of the emulator.
+
+        Returns:
+            np.ndarray: a vector of bytes for _load_state on this environment
+
+        """
+        state = np.empty(_LIB.StateSize(self._env), dtype=np.uint8)
+        _LIB.SaveState(self._env, state.ctypes.data)
+        return state
+
+    def _load_state(self, state):
+        """
+        Load a snapshot of the machine state into the emulator.
+
+        Args:
+            state (np.ndarray): a snapshot from _save_state or _expand
+
+        Returns:
+            None
+
+        """
+        state = np.ascontiguousarray(state, dtype=np.uint8)
+        if state.size != _LIB.StateSize(self._env):
+            raise ValueError('state must have {} bytes'.format(_LIB.StateSize(self._env)))
+        if not _LIB.LoadState(self._env, state.ctypes.data):
+            raise ValueError('state is corrupt, load a valid state or reset')
+
+    def _expand(self, actions, frames=1, screens=True, ram=True, states=True):
+        """
+        Step a copy of the current state for each of a set of actions.
+
+        The copies run in parallel in the emulator and the state of this
+        environment is left unchanged.
+
+        Args:
+            actions (iterable): the controller byte for each copy to hold
+            frames (int): the number of frames to step each copy
+            screens (bool): whether to return the screen of each copy
+            ram (bool): whether to return the RAM of each copy
+            states (bool): whether to return the state of each copy
+
+        Returns:
+            tuple: the screens (K x height x width x 3), the RAM (K x 2048),
+            and the states (K x state size, for _load_state) of the K copies,
+            with None in place of each output that was not requested
+
+        """
+        actions = np.ascontiguousarray(actions, dtype=np.uint8).ravel()
+        num_actions = len(actions)
+        out_screens = None
+        out_ram = None
+        out_states = None
+        if screens:
+            out_screens = np.empty((num_actions,) + SCREEN_SHAPE_32_BIT, dtype=np.uint8)
+        if ram:
+            out_ram = np.empty((num_actions, 0x800), dtype=np.uint8)
+        if states:
+            out_states = np.empty((num_actions, _LIB.StateSize(self._env)), dtype=np.uint8)
+        _LIB.Expand(self._env,
+            actions.ctypes.data,
+            num_actions,
+            frames,
+            None if out_screens is None else out_screens.ctypes.data,
+            None if out_ram is None else out_ram.ctypes.data,
+            None if out_states is None else out_states.ctypes.data,
+        )
+        if out_screens is not None:
+            # convert the 32-bit pixels to RGB like the screen buffer
+            if sys.byteorder == 'little':
+                out_screens = out_screens[..., ::-1]
+            out_screens = out_screens[..., 1:]
+        return out_screens, out_ram, out_states
+
+    def _state_hash(self):
+        """
+        Return a 64-bit hash of the machine state in the emulator.
+
+        Returns:
+            int: the hash of the CPU, RAM, PPU, VRAM, and mapper state
+
+        """
+        return _LIB.StateHash(self._env)
+
+    def _screen_hash(self):
+        """
+        Return a 64-bit hash of the screen in the emulator.
+
+        Returns:
+            int: the hash of the pixels in the screen buffer
+
+        """
+        return _LIB.ScreenHash(self._env)
+
+    def _stats(self, reset=False):
+        """
+        Return the instrumentation counters of the emulator.
+
+        Args:
+            reset (bool): whether to set the counters to zero after reading
+
+        Returns:
+            dict: a map of counter names to values. All values are zero
+            unless the library was built with stats (`scons stats=1`)
+
+        """
+        counters = _LIB.Stats(self._env).contents
+        stats = {}
+        for name, _ in StatsCounters._fields_:
+            value = getattr(counters, name)
+            if name in ('reads', 'writes'):
+                value = dict(zip(BUS_REGIONS, value))
+            stats[name] = value
+        stats['is_enabled'] = bool(stats['is_enabled'])
+        if reset:
+            _LIB.ResetStats(self._env)
+        return stats
+
+    def _latency(self, reset=False):
+        """
+        Return the latency histograms and frame rate of the emulator.
+
+        Args:
+            reset (bool): whether to clear the histograms after reading
+
+        Returns:
+            dict: for each of 'step' (a frame), 'reset' (a reset, a restore
+            of the backup, or a reset to a start or cell), and 'render', a
+            map with the 'count' and the 'mean', 'min', 'max', 'p50',
+            'p90', 'p99', and 'p999' latency in seconds, and the 'fps' over
+            the last few seconds
+
+        Note:
+            the histograms are recorded natively on every operation and can
+            be read from another thread while the environment steps.
+            Percentiles are within 3% of the true latency
+
+        """
+        latency = {}
+        summary = np.zeros(8)
+        for kind, name in enumerate(LATENCY_KINDS):
+            _LIB.LatencySummary(self._env, kind, summary.ctypes.data)
+            latency[name] = {'count': int(summary[0])}
+            for key, value in zip(('mean', 'min', 'max', 'p50', 'p90', 'p99', 'p999'), summary[1:]):
+                latency[name][key] = value * 1e-9
+        latency['fps'] = _LIB.FramesPerSecond(self._env)
+        if reset:
+            _LIB.ResetTelemetry(self._env)
+        return latency
+
+    def _latency_histogram(self, kind='step'):
+        """
+        Return the buckets of a latency histogram (i.e., to merge workers).
+
+        Args:
+            kind (str): the operation of the histogram (see LATENCY_KINDS)
+
+        Returns:
+            a tuple of:
+            - np.ndarray: the smallest latency of each bucket in nanoseconds
+            - np.ndarray: the number of latencies in each bucket
+
+        """
+        if kind not in LATENCY_KINDS:
+            raise ValueError('kind must be one of {}'.format(LATENCY_KINDS))
+        bounds = np.zeros(_LIB.LatencyBuckets(None), dtype=np.uint64)
+        _LIB.LatencyBuckets(bounds.ctypes.data)
+        counts = np.zeros_like(bounds)
+        _LIB.LatencyCounts(self._env, LATENCY_KINDS.index(kind), counts.ctypes.data)
+        return bounds, counts
+
+    def _set_profiler(self, is_enabled=True):
+        """
+        Enable or disable the profiler of the 6502 code of the game.
+
+        Args:
+            is_enabled (bool): whether to profile executed instructions.
+                Enabling the profiler discards samples from an earlier run
+
+        Returns:
+            None
+
+        """
+        _LIB.SetProfiler(self._env, is_enabled)
+
+    def _dump_profile(self, path, folded=False):
+        """
+        Write the samples of the profiler to a file.
+
+        Args:
+            path (str): the path of the file to write
+            folded (bool): whether to write folded stacks of routines (for
+                flame graph tools) instead of a flat histogram of bank:pc
+                addresses sorted by cycles
+
+        Returns:
+            None
+
+        """
+        if not _LIB.DumpProfile(self._env, path, folded):
+            raise ValueError('failed to write profile to {}'.format(path))
+
+    def _dump_trace(self, path, reset=False):
+        """
+        Write the instruction trace of the emulator to a file.
+
+        Args:
+            path (str): the path of the file to write (see nes_py.trace to
+                decode it)
+            reset (bool): whether to discard the records after writing them
+
+        Returns:
+            None
+
+        """
+        if not _LIB.DumpTrace(self._env, path):
+            raise ValueError('failed to write trace to {} (the library must '
+                'be built with trace=1)'.format(path))
+        if reset:
+            _LIB.ResetTrace(self._env)
+
+    def _set_ram_program(self, reward=None, done=None, info=None):
+        """
+        Compute the reward, done flag, and info natively after each step.
+
+        Args:
+            reward (RAMExpression): the reward after each step, or None to
+              call _get_reward
+            done (RAMExpression): the done flag after each step, or None to
+              call _get_done
+            info (dict): a map of info keys to RAMExpressions (values are
+              returned as integers), or None to call _get_info
+
+        Returns:
+            None
+
+        """
+        program = RAMProgram(reward=reward, done=done, info=info)
+        if self._is_autoresetting:
+            self._check_autoreset(program)
+        code = (ctypes.c_int32 * len(program.code))(*program.code)
+        constants = (ctypes.c_double * len(program.constants))(*program.constants)
+        if not _LIB.SetProgram(self._env, code, len(code), constants, len(constants)):
+            raise ValueError('invalid RAM program')
+        # store the program if it replaces any of the Python callbacks
+        self._program = None if program.is_empty else program
+        # record the current values of RAM for any deltas in the program
+        _LIB.ResetProgram(self._env)
+
+    def _run_until(self, condition=None, pc=None, max_frames=1000, action=0):
+        """
+        Advance frames with a fixed action until a condition triggers.
+
+        Args:
+            condition (RAMExpression): a condition over RAM checked after each
+              frame, or None for no RAM condition
+            pc (int or iterable): address(es) of instructions that stop the
+              run after the frame that executes them, or None for no address
+            max_frames (int): the maximal number of frames to advance
+            action (byte): the action to press on the joy-pad
+
+        Returns:
+            a tuple of:
+            - (int) the number of frames that elapsed
+            - (bool) whether the condition or an address triggered before
+              reaching max_frames
+
+        """
+        program = RAMProgram(done=condition)
+        code = (ctypes.c_int32 * len(program.code))(*program.code)
+        constants = (ctypes.c_double * len(program.constants))(*program.constants)
+        addresses = [] if pc is None else [pc] if isinstance(pc, int) else list(pc)
+        # set the action on the controller
+        self.controllers[0][:] = action
+        for address in addresses:
+            _LIB.SetBreakpoint(self._env, address, True)
+        is_triggered = ctypes.c_bool()
+        try:
+            frames = _LIB.RunUntil(
+                self._env,
+                code,
+                len(code),
+                constants,
+                len(constants),
+                max_frames,
+                ctypes.byref(is_triggered)
+            )
+        finally:
+            for address in addresses:
+                _LIB.SetBreakpoint(self._env, address, False)
+        if frames < 0:
+            raise ValueError('invalid RAM condition')
+        return frames, is_triggered.value
+
+    def _evaluate_sequences(self, sequences, reward=None, done=None, info=None, ram=False):
+        """
+        Evaluate a batch of open-loop action sequences from the current state.
+
+        Sequences that share a prefix share the emulation of the prefix, so
+        the cost scales with the number of distinct prefixes rather than the
+        total length of the sequences. The state of this environment is left
+        unchanged.
+
+        Args:
+            sequences (iterable): the sequences of actions (one per frame)
+            reward (RAMExpression): the reward after each frame (summed over
+              each sequence), or None for no reward
+            done (RAMExpression): a condition that stops a sequence after the
+              frame it holds on, or None to run every sequence to its end
+            info (dict): a map of info keys to RAMExpressions to evaluate
+              after the last frame of each sequence, or None for no info
+            ram (bool): whether to return the RAM after each sequence
+
+        Returns:
+            dict: a map of result names to arrays with one entry per sequence:
+            - 'reward' (float) the reward summed over the frames
+            - 'done' (bool) whether the done condition stopped the sequence
+            - 'frames' (int) the number of frames that ran
+            - 'info' (dict) a map of info keys to arrays of integers
+            - 'ram' (uint8, sequences x 2048) the RAM, if requested
+            and 'emulated_frames' (int) the number of frames emulated in total
+
+        """
+        sequences = [np.asarray(sequence, dtype=np.uint8).ravel() for sequence in sequences]
+        num_sequences = len(sequences)
+        lengths = np.array([len(sequence) for sequence in sequences], dtype=np.intc)
+        actions = np.ascontiguousarray(np.concatenate(sequences) if sequences else [], dtype=np.uint8)
+        program = RAMProgram(reward=reward, done=done, info=info)
+        code = (ctypes.c_int32 * len(program.code))(*program.code)
+        constants = (ctypes.c_double * len(program.constants))(*program.constants)
+        results = (RAMProgramResult * num_sequences)()
+        frames = np.zeros(num_sequences, dtype=np.intc)
+        out_ram = np.empty((num_sequences, 0x800), dtype=np.uint8) if ram else None
+        emulated_frames = _LIB.EvaluateSequences(self._env,
+            actions.ctypes.data,
+            lengths.ctypes.data,
+            num_sequences,
+            code,
+            len(code),
+            constants,
+            len(constants),
+            results,
+            frames.ctypes.data,
+            None if out_ram is None else out_ram.ctypes.data,
+        )
+        if emulated_frames < 0:
+            raise ValueError('invalid RAM program')
+        # view the array of result structures as a structured NumPy array
+        results = np.ctypeslib.as_array(results)
+        info_keys = program.info_keys or ()
+        return {
+            'reward': results['reward'].copy(),
+            'done': results['done'] != 0,
+            'frames': frames,
+            'info': {k: results['info'][:, i].astype(int) for i, k in enumerate(info_keys)},
+            'ram': out_ram,
+            'emulated_frames': emulated_frames,
+        }
+
+    def _rollout(self, policy, reward=None, done=None, max_steps=1000, frame_skip=1):
+        """
+        Run an episode natively with a RAM policy choosing every action.
+
+        The episode starts from the current state and leaves the emulator in
+        the state after its last frame.
+
+        Args:
+            policy (RAMPolicy): the policy that selects actions from the RAM
+            reward (RAMExpression): the reward after each frame, or None
+            done (RAMExpression): a condition that ends the episode after the
+              frame it holds on, or None to run max_steps actions
+            max_steps (int): the maximal number of actions in the episode
+            frame_skip (int): the number of frames to hold each action
+
+        Returns:
+            a tuple of:
+            - (float) the reward summed over the frames of the episode
+            - (int) the number of actions in the episode
+
+        """
+        addresses = (ctypes.c_int32 * len(policy.addresses))(*policy.addresses)
+        shifts = (ctypes.c_int32 * len(policy.shifts))(*policy.shifts)
+        actions = (ctypes.c_uint8 * len(policy.actions))(*policy.actions)
+        weights = policy.weights
+        program = RAMProgram(reward=reward, done=done)
+        code = (ctypes.c_int32 * len(program.code))(*program.code)
+        constants = (ctypes.c_double * len(program.constants))(*program.constants)
+        steps = ctypes.c_int()
+        total = _LIB.Rollout(
+            self._env,
+            policy.kind,
+            addresses,
+            shifts,
+            len(addresses),
+            weights.ctypes.data,
+            len(weights),
+            actions,
+            len(actions),
+            code,
+            len(code),
+            constants,
+            len(constants),
+            max_steps,
+            frame_skip,
+            ctypes.byref(steps)
+        )
+        if steps.value < 0:
+            raise ValueError('invalid RAM policy or RAM program')
+        return total, steps.value
+
+    def _rollout_batch(self, policy, weights, reward=None, done=None, max_steps=1000, frame_skip=1):
+        """
+        Run an episode natively for each member of a population of policies.
+
+        The episodes run in parallel from the current state and the state of
+        this environment is left unchanged.
+
+        Args:
+            policy (RAMPolicy): the policy that the members share the layout of
+            weights (np.ndarray): the weights of each member, a matrix of
+              members x policy.num_weights
+            reward (RAMExpression): the reward after each frame, or None
+            done (RAMExpression): a condition that ends an episode after the
+              frame it holds on, or None to run max_steps actions
+            max_steps (int): the maximal number of actions in an episode
+            frame_skip (int): the number of frames to hold each action
+
+        Returns:
+            a tuple of:
+            - (np.ndarray) the return of the episode of each member
+            - (np.ndarray) the number of actions in the episode of each member
+
+        """
+        weights = np.ascontiguousarray(weights, dtype=np.float64)
+        weights = weights.reshape(-1, policy.num_weights)
+        num_policies = len(weights)
+        returns = np.zeros(num_policies, dtype=np.float64)
+        steps = np.zeros(num_policies, dtype=np.intc)
+        if num_policies == 0:
+            return returns, steps
+        addresses = (ctypes.c_int32 * len(policy.addresses))(*policy.addresses)
+        shifts = (ctypes.c_int32 * len(policy.shifts))(*policy.shifts)
+        actions = (ctypes.c_uint8 * len(policy.actions))(*policy.actions)
+        program = RAMProgram(reward=reward, done=done)
+        code = (ctypes.c_int32 * len(program.code))(*program.code)
+        constants = (ctypes.c_double * len(program.constants))(*program.constants)
+        is_valid = _LIB.RolloutBatch(
+            self._env,
+            policy.kind,
+            addresses,
+            shifts,
+            len(addresses),
+            weights.ctypes.data,
+            policy.num_weights,
+            num_policies,
+            actions,
+            len(actions),
+            code,
+            len(code),
+            constants,
+            len(constants),
+            max_steps,
+            frame_skip,
+            returns.ctypes.data,
+            steps.ctypes.data
+        )
+        if not is_valid:
+            raise ValueError('invalid RAM policy or RAM program')
+        return returns, steps
+
+    def _start_recording(self, keyframe_interval=600):
+        """
+        Start recording a movie of the controller input from the current state.
+
+        Args:
+            keyframe_interval (int): the number of frames between snapshots of
+              the state, seeking replays at most this many frames
+
+        Returns:
+            None
+
+        """
+        _LIB.StartRecording(self._env, keyframe_interval)
+
+    def _stop_recording(self):
+        """Stop recording the movie of the controller input."""
+        _LIB.StopRecording(self._env)
+
+    def _movie_inputs(self):
+        """
+        Return the input of the movie.
+
+        Returns:
+            np.ndarray: a matrix of frames x 2 controller bytes (port 0 and
+            port 1), or None if there is no movie
+
+        """
+        num_frames = _LIB.MovieFrames(self._env)
+        if num_frames < 0:
+            return None
+        if num_frames == 0:
+            return np.zeros((0, 2), dtype=np.uint8)
+        address = _LIB.MovieInputs(self._env)
+        buffer_ = ctypes.cast(address, ctypes.POINTER(ctypes.c_uint8 * (2 * num_frames))).contents
+        return np.frombuffer(buffer_, dtype='uint8').reshape(num_frames, 2).copy()
+
+    def _seek(self, frame):
+        """
+        Put the emulator in the state after a frame of the movie.
+
+        Args:
+            frame (int): the number of frames of the movie to have run
+
+        Returns:
+            None
+
+        """
+        if not _LIB.Seek(self._env, frame):
+            raise ValueError('cannot seek to frame {}'.format(frame))
+
+    def _save_movie(self, path, keyframes=False):
+        """
+        Write the movie to a file.
+
+        Args:
+            path (str): the path of the file to write
+            keyframes (bool): whether to write every keyframe instead of only
+              the initial state (the rest are rebuilt on load)
+
+        Returns:
+            None
+
+        """
+        if not _LIB.SaveMovie(self._env, path, keyframes):
+            raise ValueError('failed to write movie to {}'.format(path))
+
+    def _load_movie(self, path):
+        """
+        Read a movie from a file and seek to its first frame.
+
+        Args:
+            path (str): the path of the file to read
+
+        Returns:
+            None
+
+        """
+        if not _LIB.LoadMovie(self._env, path):
+            raise ValueError('{} is not a movie for this ROM'.format(path))
+
+    def _set_rewind(self, interval=1, max_bytes=16 << 20):
+        """
+        Capture the state every few frames into a ring buffer for rewinding.
+
+        Args:
+            interval (int): the number of frames between captures, or 0 to
+              disable rewinding and free the buffer
+            max_bytes (int): the memory for the compressed older states, the
+              oldest states are dropped when it fills
+
+        Returns:
+            None
+
+        """
+        if interval < 0:
+            raise ValueError('interval must be >= 0')
+        if max_bytes < 0:
+            raise ValueError('max_bytes must be >= 0')
+        _LIB.SetRewind(self._env, interval, max_bytes)
+
+    def _rewind(self, frames):
+        """
+        Rewind the emulator to a captured state at least a number of frames ago.
+
+        Args:
+            frames (int): the number of frames to go back
+
+        Returns:
+            int: the number of frames that were rewound, which is less than
+            requested if the buffer does not reach back that far
+
+        """
+        rewound = _LIB.Rewind(self._env, frames)
+        if rewound < 0:
+            raise ValueError('rewinding is disabled, call _set_rewind first')
+        return rewound
+
+    def _rewind_stats(self):
+        """
+        Return the usage of the rewind buffer.
+
+        Returns:
+            dict: the number of 'states' in the buffer and the number of
+            'bytes' of compressed older states
+
+        """
+        used_bytes = ctypes.c_int64()
+        states = _LIB.RewindStates(self._env, ctypes.byref(used_bytes))
+        return {'states': states, 'bytes': used_bytes.value}
+
+    def _set_speculation(self, is_enabled=True, repeat=True):
+        """
+        Emulate likely next actions on spare threads while the caller decides.
+
+        Args:
+            is_enabled (bool): whether to speculate, disabling discards the
+              running speculation and the statistics
+            repeat (bool): whether each step speculates on the same action
+              being repeated (otherwise call _speculate before each step)
+
+        Returns:
+            None
+
+        Note:
+            a step whose action was speculated loads the outcome instead of
+            emulating it, frames of a recording movie or a rewind buffer are
+            always emulated, and loaded frames are not counted in _stats
+
+        """
+        if is_enabled and self._is_autoresetting:
+            raise ValueError('cannot speculate while autoresetting')
+        _LIB.SetSpeculation(self._env, is_enabled, repeat)
+        self._is_speculating = bool(is_enabled)
+
+    def _speculate(self, actions=None, probabilities=None, k=2, frames=1):
+        """
+        Start emulating likely next actions from the current state.
+
+        Args:
+            actions (iterable): the controller byte of each action, or None
+              for the indexes of the probabilities
+            probabilities (iterable): the probability of each action, or None
+              to speculate on the actions in order
+            k (int): the number of most likely actions to speculate on
+            frames (int): the number of frames the next step holds for
+              (1 for step and _frame_advance)
+
+        Returns:
+            None
+
+        """
+        if probabilities is not None:
+            likely = np.argsort(-np.asarray(probabilities), kind='stable')[:k]
+            if actions is not None:
+                likely = np.asarray(actions)[likely]
+        elif actions is not None:
+            likely = np.asarray(actions)[:k]
+        else:
+            raise ValueError('either actions or probabilities is required')
+        likely = np.ascontiguousarray(likely, dtype=np.uint8)
+        _LIB.Speculate(self._env, likely.ctypes.data, len(likely), frames)
+
+    def _speculation_stats(self):
+        """
+        Return the outcomes of the speculative steps.
+
+        Returns:
+            dict: the number of 'hits' (steps loaded from a speculation) and
+            'misses' (steps emulated)
+
+        """
+        hits = ctypes.c_uint64()
+        misses = ctypes.c_uint64()
+        _LIB.SpeculationStats(self._env, ctypes.byref(hits), ctypes.byref(misses))
+        return {'hits': hits.value, 'misses': misses.value}
+
+    def _set_transition_cache(self, max_bytes=64 << 20, screens=True):
+        """
+        Cache the outcomes of frames to skip emulating revisited transitions.
+
+        Args:
+            max_bytes (int): the memory for the cached outcomes, the least
+              recently used are dropped when it fills, or 0 to disable the
+              cache
+            screens (bool): whether to cache the screen of each frame, if
+              False a cached frame leaves the previous screen in place
+
+        Returns:
+            None
+
+        Note:
+            outcomes are keyed on a hash of the machine state, the RAM
+            program, and the controllers, cached frames are not counted in
+            _stats, and the cache is bypassed while a breakpoint is set
+
+        """
+        _LIB.SetTransitionCache(self._env, max_bytes, screens)
+
+    def _share_transition_cache(self, env):
+        """
+        Use the transition cache of another environment of the same ROM.
+
+        Args:
+            env (NESEnv): the environment to share the cache of
+
+        Returns:
+            None
+
+        """
+        if not _LIB.ShareTransitionCache(self._env, env._env):
+            raise ValueError('cannot share a transition cache between ROMs')
+
+    def _transition_cache_stats(self):
+        """
+        Return the counters of the transition cache.
+
+        Returns:
+            dict: the number of 'hits', 'misses', and 'evictions' and the
+            number of 'entries' and 'bytes' in use, or None if caching is off
+
+        """
+        stats = (ctypes.c_uint64 * 5)()
+        if not _LIB.TransitionCacheStats(self._env, stats):
+            return None
+        return dict(zip(['hits', 'misses', 'evictions', 'entries', 'bytes'], stats))
+
+    def _set_start_pool(self, max_noops=0, noop=0, seed=None):
+        """
+        Reset to random states of a native pool instead of the backup state.
+
+        Args:
+            max_noops (int): the largest number of frames of the no-op action
+              after a start, a reset picks a random start and a random number
+              of no-ops in [0, max_noops] (the states after each number of
+              no-ops are emulated once, when the start is added)
+            noop (int): the controller byte of the no-op action
+            seed (int): the seed of the random starts, or None for a seed
+              from the random number generator of the environment
+
+        Returns:
+            None
+
+        """
+        if seed is None:
+            seed = self.np_random.randint(0, 2 ** 31)
+        _LIB.SetStartPool(self._env, max_noops, noop, seed)
+        self._has_start_pool = True
+
+    def _add_start_state(self, state=None, screen=None):
+        """
+        Add a start to the pool.
+
+        Args:
+            state (np.ndarray): a snapshot from _save_state, or None for the
+              current state with its screen
+            screen (np.ndarray): the screen of the snapshot (i.e., a copy of
+              self.screen or a screen from _expand), which a reset to the
+              start restores since the state alone does not hold it
+
+        Returns:
+            int: the number of starts in the pool
+
+        """
+        if not self._has_start_pool:
+            raise ValueError('no start pool, call _set_start_pool first')
+        if state is not None:
+            state = np.ascontiguousarray(state, dtype=np.uint8)
+            if state.size != _LIB.StateSize(self._env):
+                raise ValueError('state must have {} bytes'.format(_LIB.StateSize(self._env)))
+            if screen is None:
+                raise ValueError('a snapshot needs its screen')
+            screen = np.asarray(screen, dtype=np.uint8)
+            if screen.shape != SCREEN_SHAPE_24_BIT:
+                raise ValueError('screen must have shape {}'.format(SCREEN_SHAPE_24_BIT))
+            # pack the RGB channels into the 32-bit xRGB pixels of the screen
+            pixels = screen.astype(np.uint32)
+            pixels = (pixels[..., 0] << 16) | (pixels[..., 1] << 8) | pixels[..., 2]
+            pixels = np.ascontiguousarray(pixels)
+            if not _LIB.AddStartState(self._env, state.ctypes.data, pixels.ctypes.data):
+                raise ValueError('state is corrupt')
+        else:
+            _LIB.AddStartState(self._env, None, None)
+        return _LIB.StartPoolSize(self._env)
+
+    def _clear_start_pool(self):
+        """Remove the start pool and autoreset, resets use the backup again."""
+        _LIB.SetStartPool(self._env, -1, 0, 0)
+        _LIB.SetAutoreset(self._env, False)
+        self._has_start_pool = False
+        self._is_autoresetting = False
+
+    def _set_autoreset(self, is_enabled=True):
+        """
+        Reset to the start pool within step when the RAM program ends an episode.
+
+        Args:
+            is_enabled (bool): whether to reset automatically
+
+        Returns:
+            None
+
+        Note:
+            the step that ends an episode returns done=True along with the
+            screen of the next episode and info['episode'] with the return
+            'r' and length 'l' of the ended one, and the environment can be
+            stepped again without calling reset. The next episode starts
+            before Python sees the last frame, so the reward, done flag, and
+            info must come from the RAM program, the reset and step
+            callbacks must not be overridden, and speculation must be off
+
+        """
+        if is_enabled:
+            if not self._has_start_pool:
+                raise ValueError('no start pool, call _set_start_pool first')
+            if self._is_speculating:
+                raise ValueError('cannot autoreset while speculating')
+            self._check_autoreset(self._program)
+        _LIB.SetAutoreset(self._env, is_enabled)
+        self._is_autoresetting = bool(is_enabled)
+
+    def _check_autoreset(self, program):
+        """
+        Raise an error if steps that reset natively would skip Python code.
+
+        Args:
+            program (RAMProgram): the RAM program of the environment
+
+        Returns:
+            None
+
+        """
+        if program is None or not program.has_done or not program.has_reward or program.info_keys is None:
+            raise ValueError('autoreset needs a RAM program with a reward, done condition, and info')
+        # the callbacks would see the RAM of the next episode
+        for name in ('_will_reset', '_did_reset', '_did_step'):
+            if getattr(type(self), name) is not getattr(NESEnv, name):
+                raise ValueError('cannot autoreset with an overridden {}'.format(name))
+
+    def _episode_stats(self):
+        """
+        Return the natively accumulated return and length of the episodes.
+
+        Returns:
+            dict: the 'return' and 'length' of the running episode, the
+            'final_return' and 'final_length' of the last ended episode, and
+            the number of ended 'episodes'
+
+        """
+        episode = self._episode
+        return {
+            'return': episode.episode_return,
+            'length': episode.episode_length,
+            'final_return': episode.final_return,
+            'final_length': episode.final_length,
+            'episodes': episode.num_episodes,
+        }
+
+    def _set_cell_archive(self, frame_shape=(8, 11), frame_depth=8, ram=None, seed=None):
+        """
+        Map every following frame to a cell of a new native Go-Explore archive.
+
+        Args:
+            frame_shape (tuple): the (rows, columns) of blocks to downscale
+              the screen to, or None to leave the screen out of cells
+            frame_depth (int): the number of levels of the mean luma of a block
+            ram (iterable): the RAM bytes of a cell, each an address or an
+              (address, divisor) tuple for a byte that only matters in
+              buckets of divisor values (i.e., (0x86, 16) for an x position)
+            seed (int): the seed of the random cell selections, or None for a
+              seed from the random number generator of the environment
+
+        Returns:
+            None
+
+        Note:
+            the archive keeps the state of the best trajectory (highest sum
+            of the rewards of the RAM program, then fewest frames) to reach
+            each cell. A trajectory starts at reset or at _select_cell and
+            frames that the RAM program marks as done are not archived
+
+        """
+        rows, columns = frame_shape if frame_shape is not None else (1, 0)
+        if frame_shape is not None and (rows < 1 or columns < 1):
+            raise ValueError('frame_shape must be positive')
+        if not 1 <= frame_depth <= 256:
+            raise ValueError('frame_depth must be in [1, 256]')
+        ram = [(item, 1) if np.isscalar(item) else tuple(item) for item in (ram or [])]
+        if frame_shape is None and not ram:
+            raise ValueError('cells need a frame_shape or RAM bytes')
+        for address, divisor in ram:
+            if not 0 <= address < 0x800 or not 1 <= divisor <= 255:
+                raise ValueError('invalid RAM byte of a cell: {}'.format((address, divisor)))
+        addresses = np.array([address for address, _ in ram], dtype=np.uint16)
+        divisors = np.array([divisor for _, divisor in ram], dtype=np.uint8)
+        if seed is None:
+            seed = self.np_random.randint(0, 2 ** 31)
+        _LIB.SetCellArchive(self._env, columns, rows, frame_depth, addresses.ctypes.data, divisors.ctypes.data, len(ram), seed)
+        self._has_cell_archive = True
+        # the current state starts the first trajectory
+        _LIB.BeginCells(self._env)
+
+    def _remove_cell_archive(self):
+        """Stop mapping frames to cells and discard the cell archive."""
+        _LIB.RemoveCellArchive(self._env)
+        self._has_cell_archive = False
+
+    def _select_cell(self):
+        """
+        Load a random cell of the archive to explore from.
+
+        Returns:
+            np.ndarray: the screen of the cell
+
+        Note:
+            cells are weighted by 1 / sqrt(count + 1) summed over the number
+            of times they were seen, chosen, and chosen since exploring from
+            them found a new cell, and the running trajectory continues from
+            the score and length of the cell
+
+        """
+        if not self._has_cell_archive:
+            raise ValueError('no cell archive, call _set_cell_archive first')
+        if not _LIB.SelectCell(self._env):
+            raise ValueError('cell archive is empty')
+        self.done = False
+        return self.screen
+
+    def _load_cell(self, key):
+        """
+        Load a cell of the archive without counting it as a selection.
+
+        Args:
+            key (int): the key of the cell (see _cells)
+
+        Returns:
+            np.ndarray: the screen of the cell
+
+        """
+        if not self._has_cell_archive or not _LIB.LoadCell(self._env, key):
+            raise KeyError(key)
+        self.done = False
+        return self.screen
+
+    def _cells(self):
+        """
+        Return the statistics of the cells of the archive.
+
+        Returns:
+            np.ndarray: a record for each cell in order of discovery with the
+            'key', best 'score' and its 'length', 'times_seen',
+            'times_chosen', and 'times_chosen_since_new'
+
+        """
+        cells = (CellInfo * _LIB.CellArchiveSize(self._env))()
+        _LIB.Cells(self._env, cells)
+        return np.ctypeslib.as_array(cells).copy()
+
+    def _current_cell(self):
+        """Return the key of the cell of the last frame (or reset)."""
+        return _LIB.CurrentCell(self._env)
+
+    def _set_visit_counts(self, addresses=(), tuples=(), table_bits=16, scale=1.0):
+        """
+        Count the RAM values of every following frame for an exploration bonus.
+
+        Args:
+            addresses (iterable): the addresses to count the values of in a
+              histogram of their 256 values each
+            tuples (iterable): the tuples of addresses (i.e., (0x6d, 0x86)
+              for a position) to count the values of in a hashed table
+            table_bits (int): the log2 of the number of slots of the table
+              of tuple counts (tuples that hash to a slot share a count),
+              at most 24 (128MB of counts)
+            scale (float): the scale of the bonus of a frame
+
+        Returns:
+            None
+
+        Note:
+            each frame counts its values and earns a bonus of
+            scale * sum(1 / sqrt(n)) over the counts n of its values. step
+            returns the bonus of the frames since the last step as
+            info['intrinsic'] (the reward is unchanged)
+
+        """
+        addresses = [int(address) for address in addresses]
+        tuples = [tuple(int(address) for address in group) for group in tuples]
+        if not addresses and not tuples:
+            raise ValueError('visit counts need addresses or tuples')
+        if any(len(group) == 0 for group in tuples):
+            raise ValueError('tuples must have at least one address')
+        flat = [address for group in tuples for address in group]
+        if any(not 0 <= address < 0x800 for address in addresses + flat):
+            raise ValueError('addresses must be in [0, 0x800)')
+        if not 1 <= table_bits <= 24:
+            raise ValueError('table_bits must be in [1, 24]')
+        flat = np.array(flat, dtype=np.uint16)
+        sizes = np.array([len(group) for group in tuples], dtype=np.int32)
+        counted = np.array(addresses, dtype=np.uint16)
+        _LIB.SetVisitCounts(self._env, counted.ctypes.data, len(addresses), flat.ctypes.data, sizes.ctypes.data, len(tuples), table_bits, scale)
+        self._visit_addresses = addresses
+        self._visit_tuples = tuples
+
+    def _remove_visit_counts(self):
+        """Stop counting RAM values and discard the counts."""
+        _LIB.RemoveVisitCounts(self._env)
+        self._visit_addresses = None
+        self._visit_tuples = None
+
+    def _decay_visit_counts(self, factor):
+        """
+        Multiply every visit count by a factor to forget old visits.
+
+        Args:
+            factor (float): the factor in [0, 1], where 0 resets the counts
+
+        Returns:
+            None
+
+        """
+        if not 0 <= factor <= 1:
+            raise ValueError('factor must be in [0, 1]')
+        _LIB.DecayVisitCounts(self._env, factor)
+
+    def _visit_counts(self):
+        """
+        Return the counts of the current RAM values without counting them.
+
+        Returns:
+            np.ndarray: the count of the value of each address followed by
+            the count of the values of each tuple
+
+        """
+        if self._visit_addresses is None:
+            raise ValueError('no visit counts, call _set_visit_counts first')
+        counts = np.zeros(len(self._visit_addresses) + len(self._visit_tuples))
+        _LIB.VisitCounts(self._env, counts.ctypes.data)
+        return counts
+
+    def _visit_histogram(self, address):
+        """
+        Return the counts of the 256 values of a counted address.
+
+        Args:
+            address (int): an address from _set_visit_counts
+
+        Returns:
+            np.ndarray: the count of each value of the address
+
+        """
+        if self._visit_addresses is None or address not in self._visit_addresses:
+            raise ValueError('address {} is not counted'.format(address))
+        histogram = np.zeros(256)
+        _LIB.VisitHistogram(self._env, self._visit_addresses.index(address), histogram.ctypes.data)
+        return histogram
+
+    def _start_trajectory(self, path, chunk_steps=128):
+        """
+        Record every following frame to a trajectory file (see trajectory.py).
+
+        Args:
+            path (str): the path of the file to create
+            chunk_steps (int): the number of frames in each chunk of the
+              file (a frame is decoded from the start of its chunk)
+
+        Returns:
+            None
+
+        Note:
+            each frame records the controllers, the RAM, the screen, and the
+            reward and done flag of the RAM program. Frames are compressed
+            on the calling thread and written on a background thread
+
+        """
+        if chunk_steps < 1:
+            raise ValueError('chunk_steps must be at least 1')
+        if not _LIB.StartTrajectory(self._env, path, chunk_steps):
+            raise OSError('failed to create {}'.format(path))
+
+    def _stop_trajectory(self):
+        """
+        Write the remaining frames of the recording and close its file.
+
+        Returns:
+            int: the number of frames that were recorded
+
+        """
+        num_steps = _LIB.RecordedSteps(self._env)
+        if not _LIB.StopTrajectory(self._env):
+            raise OSError('no trajectory is recorded or a write failed')
+        return num_steps
+
     def _will_reset(self):
         """Handle any RAM hacking after a reset occurs."""
         pass
@@ -240,6 +1781,12 @@ class NESEnv(gym.Env):
             return []
         # set the random number seed for the NumPy random number generator
         self.np_random.seed(seed)
+        # reseed the random starts of the native start pool
+        if self._has_start_pool:
+            _LIB.SeedStartPool(self._env, seed)
+        # reseed the random selections of the native cell archive
+        if self._has_cell_archive:
+            _LIB.SeedCellArchive(self._env, seed)
         # return the list of seeds used by RNG(s) in the environment
         return [seed]
 
@@ -261,12 +1808,24 @@ class NESEnv(gym.Env):
         # call the before reset callback
         self._will_reset()
         # reset the emulator
-        if self._has_backup:
+        if self._has_start_pool:
+            if not _LIB.ResetToStart(self._env):
+                raise ValueError('start pool is empty, call _add_start_state first')
+        elif self._has_backup:
             self._restore()
         else:
             _LIB.Reset(self._env)
         # call the after reset callback
         self._did_reset()
+        # record the RAM values for deltas in the native RAM program
+        if self._program is not None:
+            _LIB.ResetProgram(self._env)
+        # start a new trajectory of the native cell archive
+        if self._has_cell_archive:
+            _LIB.BeginCells(self._env)
+        # discard the exploration bonus of the frames before the episode
+        if self._visit_addresses is not None:
+            _LIB.TakeVisitBonus(self._env)
         # set the done flag to false
         self.done = False
         # return the screen from the emulator
@@ -297,22 +1856,45 @@ class NESEnv(gym.Env):
         # set the action on the controller
         self.controllers[0][:] = action
         # pass the action to the emulator as an unsigned byte
-        _LIB.Step(self._env)
-        # get the reward for this step
-        reward = float(self._get_reward())
-        # get the done flag for this step
-        self.done = bool(self._get_done())
-        # get the info for this step
-        info = self._get_info()
+        if self._is_autoresetting:
+            _LIB.StepEpisode(self._env, 1)
+        elif self._is_speculating:
+            _LIB.StepSpeculative(self._env, 1)
+        else:
+            _LIB.Step(self._env)
+        # get the reward, done flag, and info for this step, using the
+        # outputs of the native RAM program where one is set
+        program = self._program
+        result = self._program_result
+        if program is not None and program.has_reward:
+            reward = result.reward
+        else:
+            reward = float(self._get_reward())
+        if program is not None and program.has_done:
+            self.done = bool(result.done)
+        else:
+            self.done = bool(self._get_done())
+        if program is not None and program.info_keys is not None:
+            info = {k: int(v) for k, v in zip(program.info_keys, result.info)}
+        else:
+            info = self._get_info()
         # call the after step callback
         self._did_step(self.done)
+        # add the exploration bonus of the frames since the last step
+        if self._visit_addresses is not None:
+            info['intrinsic'] = _LIB.TakeVisitBonus(self._env)
+        # the emulator already reset to a start, so the episode goes on
+        done = self.done
+        if self._is_autoresetting and done:
+            info['episode'] = {'r': self._episode.final_return, 'l': self._episode.final_length}
+            self.done = False
         # bound the reward in [min, max]
         if reward < self.reward_range[0]:
             reward = self.reward_range[0]
         elif reward > self.reward_range[1]:
             reward = self.reward_range[1]
         # return the screen from the emulator and other relevant data
-        return self.screen, reward, self.done, info
+        return self.screen, reward, done, info
 
     def _get_reward(self):
         """Return the reward after a step occurs."""
@@ -366,6 +1948,7 @@ class NESEnv(gym.Env):
             a numpy array if mode is 'rgb_array', None otherwise
 
         """
+        start = time.perf_counter()
         if mode == 'human':
             # if the viewer isn't setup, import it and create one
             if self.viewer is None:
@@ -384,13 +1967,15 @@ class NESEnv(gym.Env):
                 )
             # show the screen on the image viewer
             self.viewer.show(self.screen)
-        elif mode == 'rgb_array':
-            return self.screen
-        else:
+        elif mode != 'rgb_array':
             # unpack the modes as comma delineated strings ('a', 'b', ...)
             render_modes = [repr(x) for x in self.metadata['render.modes']]
             msg = 'valid render modes are: {}'.format(', '.join(render_modes))
             raise NotImplementedError(msg)
+        # record the wall time of the render in the native histogram
+        _LIB.RecordLatency(self._env, LATENCY_KINDS.index('render'), int((time.perf_counter() - start) * 1e9))
+        if mode == 'rgb_array':
+            return self.screen
 
     def get_keys_to_action(self):
         """Return the dictionary of keyboard keys to actions."""
@@ -0,0 +1,156 @@
+"""Tiny policies over RAM features that run natively in the emulator.
+
+Example:
+    >>> x = unsigned(0x86, 0x6d)
+    >>> policy = LinearPolicy(addresses=[0x0057, 0x00b5], actions=[128, 129])
+    >>> weights = np.random.randn(64, policy.num_weights)
+    >>> returns, steps = env._rollout_batch(policy, weights,
+    ...     reward=x.delta(),
+    ...     done=byte(0x000e) == 0x0b,
+    ...     max_steps=2000,
+    ... )
+
+"""
+import numpy as np
+from .ram_program import RAM_SIZE
+
+
+# the kinds of policies (must match ram_policy.hpp)
+(
+    LINEAR,
+    TABULAR,
+) = range(2)
+
+
+# the maximal number of bits in the index of a tabular policy
+MAX_TABLE_BITS = 20
+# the maximal number of actions of a policy
+MAX_ACTIONS = 256
+
+
+class RAMPolicy(object):
+    """A policy that picks the action with the highest score over RAM."""
+
+    def __init__(self, kind, addresses, actions, shifts=None, weights=None):
+        """
+        Initialize a new RAM policy.
+
+        Args:
+            kind (int): the kind of the policy (LINEAR or TABULAR)
+            addresses (iterable): the RAM address of each feature
+            actions (iterable): the controller byte of each action
+            shifts (iterable): the number of low bits to drop from each
+              feature (tabular policies only), or None to keep all bits
+            weights (np.ndarray): the weights of the policy, or None for zeros
+
+        Returns:
+            None
+
+        """
+        self.kind = kind
+        self.addresses = [int(address) for address in addresses]
+        self.actions = [int(action) for action in actions]
+        if shifts is None:
+            shifts = [0] * len(self.addresses)
+        self.shifts = [int(shift) for shift in shifts]
+        if any(not 0 <= address < RAM_SIZE for address in self.addresses):
+            raise ValueError('addresses must be in [0, {:#x})'.format(RAM_SIZE))
+        if not 1 <= len(self.actions) <= MAX_ACTIONS:
+            raise ValueError('a policy has 1 to {} actions'.format(MAX_ACTIONS))
+        if any(not 0 <= action <= 0xff for action in self.actions):
+            raise ValueError('actions must be controller bytes')
+        if len(self.shifts) != len(self.addresses):
+            raise ValueError('shifts must have one value per address')
+        if any(not 0 <= shift <= 8 for shift in self.shifts):
+            raise ValueError('shifts must be in [0, 8]')
+        if kind == TABULAR and self.table_bits > MAX_TABLE_BITS:
+            raise ValueError('a table index has at most {} bits'.format(MAX_TABLE_BITS))
+        if weights is None:
+            weights = np.zeros(self.num_weights)
+        self.weights = weights
+
+    @property
+    def table_bits(self):
+        """Return the number of bits in the index of a tabular policy."""
+        return sum(8 - shift for shift in self.shifts)
+
+    @property
+    def num_weights(self):
+        """Return the number of weights of the policy."""
+        if self.kind == LINEAR:
+            return len(self.actions) * (len(self.addresses) + 1)
+        return len(self.actions) << self.table_bits
+
+    @property
+    def weights(self):
+        """Return the weights of the policy."""
+        return self._weights
+
+    @weights.setter
+    def weights(self, weights):
+        """
+        Set the weights of the policy.
+
+        Args:
+            weights (np.ndarray): the num_weights weights of the policy
+
+        Returns:
+            None
+
+        """
+        weights = np.ascontiguousarray(weights, dtype=np.float64).ravel()
+        if len(weights) != self.num_weights:
+            raise ValueError('the policy has {} weights'.format(self.num_weights))
+        self._weights = weights
+
+
+class LinearPolicy(RAMPolicy):
+    """A policy that scores actions with an affine map of RAM bytes."""
+
+    def __init__(self, addresses, actions, weights=None):
+        """
+        Initialize a new linear policy.
+
+        Args:
+            addresses (iterable): the RAM address of each feature, features
+              are scaled from [0, 255] to [0, 1]
+            actions (iterable): the controller byte of each action
+            weights (np.ndarray): a row of (feature weights..., bias) for each
+              action, or None for zeros
+
+        Returns:
+            None
+
+        """
+        super().__init__(LINEAR, addresses, actions, weights=weights)
+
+
+class TabularPolicy(RAMPolicy):
+    """A policy that looks up action scores in a table indexed by RAM."""
+
+    def __init__(self, addresses, actions, shifts=None, weights=None):
+        """
+        Initialize a new tabular policy.
+
+        Args:
+            addresses (iterable): the RAM address of each feature, the table
+              is indexed by the concatenated bits of the features
+            actions (iterable): the controller byte of each action
+            shifts (iterable): the number of low bits to drop from each
+              feature, or None to keep all bits
+            weights (np.ndarray): a row of action scores for each index of
+              the table, or None for zeros
+
+        Returns:
+            None
+
+        """
+        super().__init__(TABULAR, addresses, actions, shifts=shifts, weights=weights)
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    RAMPolicy.__name__,
+    LinearPolicy.__name__,
+    TabularPolicy.__name__,
+]
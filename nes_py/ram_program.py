@@ -0,0 +1,312 @@
+"""Expressions over the NES RAM that compile to native RAM programs.
+
+Example:
+    >>> x = unsigned(0x86, 0x6d)
+    >>> lives = byte(0x075a)
+    >>> env._set_ram_program(
+    ...     reward=x.delta().clip(-5, 5),
+    ...     done=lives == 0xff,
+    ...     info={'x_pos': x, 'score': digits(*range(0x07dd, 0x07e3))},
+    ... )
+
+"""
+import ctypes
+
+
+# the operations of the RAM program bytecode (must match ram_program.hpp)
+(
+    CONSTANT,
+    BYTE,
+    UNSIGNED,
+    DIGITS,
+    BCD,
+    DELTA,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    MINIMUM,
+    MAXIMUM,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    AND,
+    OR,
+    BIT_AND,
+    NEGATE,
+    ABSOLUTE,
+    NOT,
+    STORE_REWARD,
+    STORE_DONE,
+    STORE_INFO,
+) = range(27)
+
+
+# the number of info values a RAM program can output
+INFO_SIZE = 16
+# the maximal number of addresses in a multi-byte load
+MAX_BYTES = 8
+# the size of the RAM that programs can address
+RAM_SIZE = 0x800
+
+
+class RAMProgramResult(ctypes.Structure):
+    """The outputs of a RAM program after an evaluation."""
+
+    _fields_ = [
+        ('reward', ctypes.c_double),
+        ('done', ctypes.c_double),
+        ('info', ctypes.c_double * INFO_SIZE),
+    ]
+
+
+class RAMExpression(object):
+    """An expression over the RAM in postfix (stack machine) order."""
+
+    def __init__(self, tokens):
+        """
+        Create a new RAM expression.
+
+        Args:
+            tokens (tuple): the postfix tokens of the expression
+
+        Returns:
+            None
+
+        """
+        self._tokens = tuple(tokens)
+
+    def __bool__(self):
+        """Raise an error because expressions are evaluated natively."""
+        raise TypeError('RAM expressions have no truth value in Python')
+
+    def _unary(self, operation):
+        """Return a new expression applying an operation to this one."""
+        return RAMExpression(self._tokens + ((operation,),))
+
+    def _binary(self, other, operation):
+        """Return a new expression applying an operation to two values."""
+        other = _expression(other)
+        return RAMExpression(self._tokens + other._tokens + ((operation,),))
+
+    def _reflected(self, other, operation):
+        """Return a new expression applying a reflected binary operation."""
+        return _expression(other)._binary(self, operation)
+
+    def __add__(self, other):
+        """Return the sum of this expression and another value."""
+        return self._binary(other, ADD)
+
+    def __radd__(self, other):
+        """Return the sum of another value and this expression."""
+        return self._reflected(other, ADD)
+
+    def __sub__(self, other):
+        """Return the difference of this expression and another value."""
+        return self._binary(other, SUBTRACT)
+
+    def __rsub__(self, other):
+        """Return the difference of another value and this expression."""
+        return self._reflected(other, SUBTRACT)
+
+    def __mul__(self, other):
+        """Return the product of this expression and another value."""
+        return self._binary(other, MULTIPLY)
+
+    def __rmul__(self, other):
+        """Return the product of another value and this expression."""
+        return self._reflected(other, MULTIPLY)
+
+    def __truediv__(self, other):
+        """Return the quotient of this expression and another value."""
+        return self._binary(other, DIVIDE)
+
+    def __rtruediv__(self, other):
+        """Return the quotient of another value and this expression."""
+        return self._reflected(other, DIVIDE)
+
+    def __eq__(self, other):
+        """Return 1 if this expression equals another value, else 0."""
+        return self._binary(other, EQUAL)
+
+    def __ne__(self, other):
+        """Return 1 if this expression differs from another value, else 0."""
+        return self._binary(other, NOT_EQUAL)
+
+    def __lt__(self, other):
+        """Return 1 if this expression is less than another value, else 0."""
+        return self._binary(other, LESS)
+
+    def __le__(self, other):
+        """Return 1 if this expression is at most another value, else 0."""
+        return self._binary(other, LESS_EQUAL)
+
+    def __gt__(self, other):
+        """Return 1 if this expression is greater than another value, else 0."""
+        return self._binary(other, GREATER)
+
+    def __ge__(self, other):
+        """Return 1 if this expression is at least another value, else 0."""
+        return self._binary(other, GREATER_EQUAL)
+
+    def __and__(self, other):
+        """Return the logical AND of this expression and another value."""
+        return self._binary(other, AND)
+
+    def __rand__(self, other):
+        """Return the logical AND of another value and this expression."""
+        return self._reflected(other, AND)
+
+    def __or__(self, other):
+        """Return the logical OR of this expression and another value."""
+        return self._binary(other, OR)
+
+    def __ror__(self, other):
+        """Return the logical OR of another value and this expression."""
+        return self._reflected(other, OR)
+
+    def __neg__(self):
+        """Return the negation of this expression."""
+        return self._unary(NEGATE)
+
+    def __abs__(self):
+        """Return the absolute value of this expression."""
+        return self._unary(ABSOLUTE)
+
+    def __invert__(self):
+        """Return the logical NOT of this expression."""
+        return self._unary(NOT)
+
+    # expressions compare by value, so they cannot be hashed
+    __hash__ = None
+
+    def delta(self):
+        """Return the change in this expression since the last step."""
+        return self._unary(DELTA)
+
+    def mask(self, bits):
+        """Return the bitwise AND of this expression with an integer mask."""
+        return self._binary(bits, BIT_AND)
+
+    def min(self, other):
+        """Return the minimum of this expression and another value."""
+        return self._binary(other, MINIMUM)
+
+    def max(self, other):
+        """Return the maximum of this expression and another value."""
+        return self._binary(other, MAXIMUM)
+
+    def clip(self, low, high):
+        """Return this expression bounded in [low, high]."""
+        return self.max(low).min(high)
+
+
+def _expression(value):
+    """Return a value as a RAM expression (numbers become constants)."""
+    if isinstance(value, RAMExpression):
+        return value
+    if isinstance(value, (bool, int, float)):
+        return RAMExpression(((CONSTANT, float(value)),))
+    raise TypeError('value must be a RAMExpression or a number')
+
+
+def _addresses(addresses):
+    """Validate and return a tuple of RAM addresses."""
+    if not 1 <= len(addresses) <= MAX_BYTES:
+        raise ValueError('expected 1 to {} addresses'.format(MAX_BYTES))
+    for address in addresses:
+        if not isinstance(address, int) or not 0 <= address < RAM_SIZE:
+            raise ValueError('invalid RAM address: {}'.format(address))
+    return tuple(addresses)
+
+
+def byte(address):
+    """Return an expression for the unsigned byte at a RAM address."""
+    return RAMExpression(((BYTE,) + _addresses((address,)),))
+
+
+def unsigned(*addresses):
+    """Return an expression for a little-endian unsigned integer."""
+    addresses = _addresses(addresses)
+    return RAMExpression(((UNSIGNED, len(addresses)) + addresses,))
+
+
+def digits(*addresses):
+    """Return an expression for decimal digits (one per byte, MSD first)."""
+    addresses = _addresses(addresses)
+    return RAMExpression(((DIGITS, len(addresses)) + addresses,))
+
+
+def bcd(*addresses):
+    """Return an expression for packed BCD bytes (most significant first)."""
+    addresses = _addresses(addresses)
+    return RAMExpression(((BCD, len(addresses)) + addresses,))
+
+
+class RAMProgram(object):
+    """A compiled RAM program ready to load into the emulator."""
+
+    def __init__(self, reward=None, done=None, info=None):
+        """
+        Compile expressions for the reward, done flag, and info values.
+
+        Args:
+            reward (RAMExpression): the reward after each step or None
+            done (RAMExpression): the done flag after each step or None
+            info (dict): a map of info keys to RAMExpressions or None
+
+        Returns:
+            None
+
+        """
+        if info is not None and len(info) > INFO_SIZE:
+            raise ValueError('at most {} info values'.format(INFO_SIZE))
+        self.has_reward = reward is not None
+        self.has_done = done is not None
+        self.info_keys = None if info is None else tuple(info.keys())
+        self.code = []
+        self.constants = []
+        # a map of constant values to their index in the constant table
+        indexes = {}
+        # the number of delta slots allocated so far
+        num_slots = 0
+        # the expressions to compile paired with their store instructions
+        outputs = []
+        if reward is not None:
+            outputs.append((reward, (STORE_REWARD,)))
+        if done is not None:
+            outputs.append((done, (STORE_DONE,)))
+        for index, value in enumerate((info or {}).values()):
+            outputs.append((value, (STORE_INFO, index)))
+        for expression, store in outputs:
+            for token in _expression(expression)._tokens:
+                if token[0] == CONSTANT:
+                    if token[1] not in indexes:
+                        indexes[token[1]] = len(self.constants)
+                        self.constants.append(token[1])
+                    self.code.extend((CONSTANT, indexes[token[1]]))
+                elif token[0] == DELTA:
+                    self.code.extend((DELTA, num_slots))
+                    num_slots += 1
+                else:
+                    self.code.extend(token)
+            self.code.extend(store)
+
+    @property
+    def is_empty(self):
+        """Return True if the program has no outputs."""
+        return not self.code
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    RAMExpression.__name__,
+    RAMProgram.__name__,
+    byte.__name__,
+    unsigned.__name__,
+    digits.__name__,
+    bcd.__name__,
+]
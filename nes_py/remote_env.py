@@ -0,0 +1,316 @@
+"""Batches of NES environments served over TCP or Unix sockets.
+
+A server (the nes_server binary, or RemoteServer in a Python process) runs
+a batch of emulators and answers requests in a length-prefixed binary
+protocol (see socket_server.hpp). Requests can be pipelined: send several
+with the send_* methods and read the responses in order with receive.
+
+Example:
+    >>> # nes_server --envs 8 --port 9000 super-mario-bros-1.nes
+    >>> batch = RemoteEnvBatch(('127.0.0.1', 9000))
+    >>> batch.set_ram_program(reward=x.delta(), done=byte(0x000e) == 0x0b)
+    >>> screens, ram, results = batch.reset()
+    >>> screens, ram, results = batch.step(actions, frames=4)
+    >>> rewards, dones = results['reward'], results['done'] != 0
+
+"""
+import collections
+import ctypes
+import socket
+import struct
+import sys
+import numpy as np
+from .nes_env import _LIB
+from .ram_program import RAMProgram
+from .ram_program import RAMProgramResult
+
+
+# the opcodes of the requests (must match socket_server.hpp)
+(
+    INFO,
+    RESET,
+    STEP,
+    SAVE,
+    LOAD,
+    PROGRAM,
+) = range(6)
+
+
+# the flags of the outputs of a reset or step (must match socket_server.hpp)
+SCREENS = 1
+RAM = 2
+
+
+# the layout of a RAM program result in a response
+RESULT_DTYPE = np.dtype(RAMProgramResult)
+
+
+class RemoteServer(object):
+    """A socket server for a batch of NES environments in this process."""
+
+    def __init__(self, envs, address=('127.0.0.1', 0)):
+        """
+        Serve a batch of environments on a background thread.
+
+        Args:
+            envs (iterable): the NESEnv instances to serve, which must not be
+              used until the server is closed
+            address (tuple or str): a (host, port) to listen on with TCP
+              (port 0 for any free port) or the path of a Unix socket
+
+        Returns:
+            None
+
+        """
+        self.envs = list(envs)
+        emulators = (ctypes.c_void_p * len(self.envs))(*[env._env for env in self.envs])
+        # a reset of a client restores the backup of each env like NESEnv
+        backups = (ctypes.c_bool * len(self.envs))(*[env._has_backup for env in self.envs])
+        if isinstance(address, str):
+            self._server = _LIB.CreateSocketServer(emulators, backups, len(self.envs), address, -1)
+            self.address = address
+        else:
+            host, port = address
+            self._server = _LIB.CreateSocketServer(emulators, backups, len(self.envs), host, port)
+            if self._server:
+                self.address = (host, _LIB.SocketServerPort(self._server))
+        if not self._server:
+            raise OSError('failed to listen on {}'.format(address))
+
+    def close(self):
+        """Stop the server and close its socket."""
+        if self._server is None:
+            raise ValueError('server has already been closed.')
+        _LIB.CloseSocketServer(self._server)
+        self._server = None
+
+
+class RemoteEnvBatch(object):
+    """A client of a batch of NES environments on a socket server."""
+
+    def __init__(self, address):
+        """
+        Connect to a server.
+
+        Args:
+            address (tuple or str): the (host, port) of a TCP server or the
+              path of a Unix socket
+
+        Returns:
+            None
+
+        """
+        if isinstance(address, str):
+            self._socket = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        else:
+            self._socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            self._socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._socket.connect(address)
+        # the id of the next request and the requests without a response
+        self._next_id = 0
+        self._pending = collections.deque()
+        self.send_info()
+        info = self.receive()
+        self.num_envs, self.width, self.height, self.state_size, _ = info
+
+    def _send(self, opcode, payload=b'', outputs=0):
+        """
+        Send a request without waiting for its response.
+
+        Args:
+            opcode (int): the opcode of the request
+            payload (bytes): the payload of the request
+            outputs (int): the output flags of a reset or step
+
+        Returns:
+            int: the id of the request
+
+        """
+        if self._socket is None:
+            raise ValueError('batch has already been closed.')
+        request_id = self._next_id
+        self._next_id = (self._next_id + 1) & 0xffffffff
+        header = struct.pack('<IIB', 5 + len(payload), request_id, opcode)
+        self._socket.sendall(header + bytes(payload))
+        self._pending.append((request_id, opcode, outputs))
+        return request_id
+
+    def _receive_exact(self, length):
+        """Return a buffer of exactly length bytes from the socket."""
+        buffer = bytearray(length)
+        view = memoryview(buffer)
+        while view:
+            count = self._socket.recv_into(view)
+            if count == 0:
+                raise ConnectionError('the server closed the connection')
+            view = view[count:]
+        return buffer
+
+    def receive(self):
+        """
+        Wait for the response to the oldest request without one.
+
+        Returns:
+            the output of the request:
+            - info: (num_envs, width, height, state_size, info_size)
+            - reset and step: the screens (N x height x width x 3), the RAM
+              (N x 2048) or None if not requested, and the RAM program
+              results (N, with 'reward', 'done', and 'info' fields)
+            - save: the state of the environment (for load)
+            - load and set_ram_program: None
+
+        """
+        if not self._pending:
+            raise ValueError('no request is waiting for a response')
+        request_id, opcode, outputs = self._pending.popleft()
+        length, = struct.unpack('<I', self._receive_exact(4))
+        message = self._receive_exact(length)
+        response_id, status = struct.unpack_from('<IB', message)
+        if response_id != request_id:
+            raise ConnectionError('response {} for request {}'.format(response_id, request_id))
+        if status != 0:
+            raise ValueError('the server rejected request {}'.format(request_id))
+        payload = memoryview(message)[5:]
+        if opcode == INFO:
+            return struct.unpack('<5I', payload)
+        if opcode == SAVE:
+            return np.frombuffer(payload, dtype=np.uint8)
+        if opcode in (RESET, STEP):
+            return self._outputs(payload, outputs)
+        return None
+
+    def _outputs(self, payload, outputs):
+        """Return views of the outputs in the payload of a reset or step."""
+        num_envs = self.num_envs
+        offset = num_envs * RESULT_DTYPE.itemsize
+        results = np.frombuffer(payload[:offset], dtype=RESULT_DTYPE)
+        screens = None
+        if outputs & SCREENS:
+            size = num_envs * self.height * self.width * 4
+            screens = np.frombuffer(payload[offset:offset + size], dtype=np.uint8)
+            screens = screens.reshape(num_envs, self.height, self.width, 4)
+            # convert the 32-bit pixels to RGB like the screen buffer
+            if sys.byteorder == 'little':
+                screens = screens[..., ::-1]
+            screens = screens[..., 1:]
+            offset += size
+        ram = None
+        if outputs & RAM:
+            ram = np.frombuffer(payload[offset:offset + num_envs * 0x800], dtype=np.uint8)
+            ram = ram.reshape(num_envs, 0x800)
+        return screens, ram, results
+
+    def send_info(self):
+        """Send a request for the size of the batch and its states."""
+        return self._send(INFO)
+
+    def send_reset(self, screens=True, ram=True):
+        """
+        Send a request to reset every environment and its RAM program.
+
+        Args:
+            screens (bool): whether to return the screens
+            ram (bool): whether to return the RAM
+
+        Returns:
+            int: the id of the request
+
+        """
+        outputs = (SCREENS if screens else 0) | (RAM if ram else 0)
+        return self._send(RESET, struct.pack('<B', outputs), outputs)
+
+    def send_step(self, actions, frames=1, screens=True, ram=True):
+        """
+        Send a request to step every environment.
+
+        Args:
+            actions (iterable): the controller byte for each environment
+            frames (int): the number of frames to hold the actions for
+            screens (bool): whether to return the screens
+            ram (bool): whether to return the RAM
+
+        Returns:
+            int: the id of the request
+
+        """
+        actions = np.ascontiguousarray(actions, dtype=np.uint8).ravel()
+        if len(actions) != self.num_envs:
+            raise ValueError('actions must have one value per environment')
+        outputs = (SCREENS if screens else 0) | (RAM if ram else 0)
+        payload = struct.pack('<BI', outputs, frames) + actions.tobytes()
+        return self._send(STEP, payload, outputs)
+
+    def reset(self, screens=True, ram=True):
+        """Reset every environment and return the outputs (see receive)."""
+        self.send_reset(screens=screens, ram=ram)
+        return self.receive()
+
+    def step(self, actions, frames=1, screens=True, ram=True):
+        """Step every environment and return the outputs (see receive)."""
+        self.send_step(actions, frames=frames, screens=screens, ram=ram)
+        return self.receive()
+
+    def save_state(self, index):
+        """
+        Return a snapshot of the machine state of an environment.
+
+        Args:
+            index (int): the index of the environment in the batch
+
+        Returns:
+            np.ndarray: a vector of bytes for load_state
+
+        """
+        self._send(SAVE, struct.pack('<I', index))
+        return self.receive()
+
+    def load_state(self, index, state):
+        """
+        Load a snapshot of the machine state into an environment.
+
+        Args:
+            index (int): the index of the environment in the batch
+            state (np.ndarray): a snapshot from save_state
+
+        Returns:
+            None
+
+        """
+        state = np.ascontiguousarray(state, dtype=np.uint8)
+        self._send(LOAD, struct.pack('<I', index) + state.tobytes())
+        return self.receive()
+
+    def set_ram_program(self, reward=None, done=None, info=None):
+        """
+        Set the RAM program of every environment (see NESEnv._set_ram_program).
+
+        Args:
+            reward (RAMExpression): the reward after each step
+            done (RAMExpression): the done flag after each step
+            info (dict): a map of info keys to RAMExpressions
+
+        Returns:
+            None
+
+        """
+        program = RAMProgram(reward=reward, done=done, info=info)
+        payload = struct.pack('<I', len(program.code))
+        payload += struct.pack('<{}i'.format(len(program.code)), *program.code)
+        payload += struct.pack('<I', len(program.constants))
+        payload += struct.pack('<{}d'.format(len(program.constants)), *program.constants)
+        self._send(PROGRAM, payload)
+        return self.receive()
+
+    def close(self):
+        """Close the connection to the server."""
+        if self._socket is None:
+            raise ValueError('batch has already been closed.')
+        self._socket.close()
+        self._socket = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    RemoteServer.__name__,
+    RemoteEnvBatch.__name__,
+]
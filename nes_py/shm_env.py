@@ -0,0 +1,248 @@
+"""Serve NES environments to other processes over POSIX shared memory.
+
+The emulators run in the server process; each client maps a shared memory
+segment with a ring of requests and a ring of response slots that hold the
+screen, RAM, and RAM program result after each request, so observations
+reach the client without pickling or pipes.
+
+Example:
+    >>> # in the server process
+    >>> env = NESEnv(path)
+    >>> env._set_ram_program(reward=x.delta(), done=byte(0x000e) == 0x0b)
+    >>> server = NESServer(env, '/nes-0')
+    >>> # in an actor process
+    >>> env = SharedMemoryEnv('/nes-0')
+    >>> state = env.reset()
+    >>> state, reward, done, info = env.step(128)
+
+"""
+import ctypes
+import sys
+import gym
+import numpy as np
+from ._image_viewer import ImageViewer
+from .nes_env import _LIB
+from .nes_env import NESEnv
+from .nes_env import SCREEN_HEIGHT
+from .nes_env import SCREEN_WIDTH
+from .nes_env import SCREEN_SHAPE_32_BIT
+from .ram_program import RAMProgramResult
+
+
+# the commands a client sends to a server (must match shm_channel.hpp)
+(
+    RESET,
+    STEP,
+) = range(2)
+
+
+class ShmResponse(ctypes.Structure):
+    """A response slot in the shared memory segment of a server."""
+
+    _fields_ = [
+        ('result', RAMProgramResult),
+        ('screen', ctypes.c_uint8 * int(np.prod(SCREEN_SHAPE_32_BIT))),
+        ('ram', ctypes.c_uint8 * 0x800),
+    ]
+
+
+class NESServer(object):
+    """A server that runs an NES environment for one shared memory client."""
+
+    def __init__(self, env, name, num_slots=4):
+        """
+        Serve an environment over a new shared memory segment.
+
+        Args:
+            env (NESEnv): the environment to serve, which must not be used
+              until the server is closed; the rewards, done flags, and info
+              of the client come from its native RAM program
+            name (str): the name of the segment (i.e., '/nes-0')
+            num_slots (int): the number of slots in each ring
+
+        Returns:
+            None
+
+        """
+        self.env = env
+        self.name = name
+        # a reset of the client restores the backup of the env like NESEnv
+        self._server = _LIB.CreateShmServer(env._env, name, num_slots, env._has_backup)
+        if not self._server:
+            raise OSError('failed to create shared memory segment {}'.format(name))
+
+    def close(self):
+        """Stop serving and remove the shared memory segment."""
+        if self._server is None:
+            raise ValueError('server has already been closed.')
+        _LIB.CloseShmServer(self._server)
+        self._server = None
+
+
+class SharedMemoryEnv(gym.Env):
+    """An NES environment that runs in a server over shared memory."""
+
+    # the same meta-data, reward range, and spaces as an NES environment
+    metadata = NESEnv.metadata
+    reward_range = NESEnv.reward_range
+    observation_space = NESEnv.observation_space
+    action_space = NESEnv.action_space
+
+    def __init__(self, name, info_keys=None, frame_skip=1):
+        """
+        Connect to the server of an environment.
+
+        Args:
+            name (str): the name of the segment of the server
+            info_keys (iterable): the keys of the info values of the RAM
+              program of the server, or None for an empty info
+            frame_skip (int): the number of frames to hold each action for
+
+        Returns:
+            None
+
+        """
+        self.name = name
+        self.info_keys = None if info_keys is None else list(info_keys)
+        self.frame_skip = frame_skip
+        self._client = _LIB.ShmConnect(name)
+        if not self._client:
+            raise OSError('no server at shared memory segment {}'.format(name))
+        # setup views of the screen and RAM of each response slot
+        self._slots = [self._slot_views(index) for index in range(_LIB.ShmNumSlots(self._client))]
+        self.screen, self.ram, self._result = self._slots[0]
+        self.viewer = None
+        self.done = True
+
+    def _slot_views(self, index):
+        """
+        Setup NumPy views of a response slot.
+
+        Args:
+            index (int): the index of the slot
+
+        Returns:
+            tuple: the screen (height x width x 3), the RAM (2048), and the
+            RAM program result of the slot
+
+        """
+        address = _LIB.ShmSlot(self._client, index)
+        response = ctypes.cast(address, ctypes.POINTER(ShmResponse)).contents
+        screen = np.frombuffer(response.screen, dtype=np.uint8)
+        screen = screen.reshape(SCREEN_SHAPE_32_BIT)
+        # convert the 32-bit pixels to RGB like the screen buffer
+        if sys.byteorder == 'little':
+            screen = screen[:, :, ::-1]
+        screen = screen[:, :, 1:]
+        ram = np.frombuffer(response.ram, dtype=np.uint8)
+        return screen, ram, response.result
+
+    def _request(self, command, action=0):
+        """
+        Run a request on the server and wait for its response.
+
+        Args:
+            command (int): the command to run (RESET or STEP)
+            action (int): the controller byte to hold
+
+        Returns:
+            None
+
+        """
+        if self._client is None:
+            raise ValueError('env has already been closed.')
+        if _LIB.ShmSend(self._client, command, action, self.frame_skip):
+            slot = _LIB.ShmReceive(self._client)
+            if slot >= 0:
+                self.screen, self.ram, self._result = self._slots[slot]
+                return
+        raise ConnectionError('the server of {} closed'.format(self.name))
+
+    def reset(self, seed=None, options=None, return_info=None):
+        """
+        Reset the environment in the server and return the first observation.
+
+        Args:
+            seed (int): unused (the server owns the random state)
+            options (any): unused
+            return_info (any): unused
+
+        Returns:
+            state (np.ndarray): the screen after the reset
+
+        """
+        self._request(RESET)
+        self.done = False
+        return self.screen
+
+    def step(self, action):
+        """
+        Run a step of the environment in the server.
+
+        Args:
+            action (byte): the bitmap determining which buttons to press
+
+        Returns:
+            a tuple of:
+            - state (np.ndarray): the screen after the step (a view of shared
+              memory that is valid until the next step)
+            - reward (float) : the reward of the RAM program of the server
+            - done (boolean): the done flag of the RAM program of the server
+            - info (dict): the info values of the RAM program of the server
+
+        """
+        if self.done:
+            raise ValueError('cannot step in a done environment! call `reset`')
+        self._request(STEP, action)
+        result = self._result
+        self.done = bool(result.done)
+        info = {}
+        if self.info_keys is not None:
+            info = {k: int(v) for k, v in zip(self.info_keys, result.info)}
+        return self.screen, result.reward, self.done, info
+
+    def close(self):
+        """Disconnect from the server (which keeps running)."""
+        if self._client is None:
+            raise ValueError('env has already been closed.')
+        _LIB.ShmDisconnect(self._client)
+        self._client = None
+        self._slots = None
+        if self.viewer is not None:
+            self.viewer.close()
+
+    def render(self, mode='human'):
+        """
+        Render the environment.
+
+        Args:
+            mode (str): the mode to render with:
+            - human: render to the current display
+            - rgb_array: Return an numpy.ndarray with shape (x, y, 3),
+              representing RGB values for an x-by-y pixel image
+
+        Returns:
+            a numpy array if mode is 'rgb_array', None otherwise
+
+        """
+        if mode == 'human':
+            if self.viewer is None:
+                self.viewer = ImageViewer(
+                    caption=self.name,
+                    height=SCREEN_HEIGHT,
+                    width=SCREEN_WIDTH,
+                )
+            self.viewer.show(self.screen)
+        elif mode == 'rgb_array':
+            return self.screen
+        else:
+            render_modes = [repr(x) for x in self.metadata['render.modes']]
+            msg = 'valid render modes are: {}'.format(', '.join(render_modes))
+            raise NotImplementedError(msg)
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    NESServer.__name__,
+    SharedMemoryEnv.__name__,
+]
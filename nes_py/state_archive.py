@@ -0,0 +1,175 @@
+"""Archives of machine states in memory-mapped files.
+
+An archive is a header, the states, and an index of the states. Opening an
+archive maps the file and reads nothing else, so it takes the same time for
+any number of states and only the pages of loaded states become resident.
+States can be stored as deltas from the first state of the archive, which
+is far smaller for states of the same game.
+
+Example:
+    >>> writer = StateArchiveWriter('starts.nesarc', env)
+    >>> for _ in range(1000):
+    ...     env.step(env.action_space.sample())
+    ...     writer.append()
+    >>> writer.close()
+    >>> archive = StateArchive('starts.nesarc', env)
+    >>> archive.load(123)
+
+"""
+import numpy as np
+from .nes_env import _LIB
+
+
+class StateArchive(object):
+    """A read-only archive of states for the ROM of an environment."""
+
+    def __init__(self, path, env):
+        """
+        Map an archive file.
+
+        Args:
+            path (str): the path of the archive
+            env (NESEnv): an environment of the ROM of the archive, which
+              load loads states into
+
+        Returns:
+            None
+
+        """
+        self.env = env
+        self._archive = _LIB.OpenArchive(path, env._env)
+        if not self._archive:
+            raise ValueError('{} is not an archive for this ROM'.format(path))
+
+    def __len__(self):
+        """Return the number of committed states in the archive."""
+        return _LIB.ArchiveSize(self._archive)
+
+    def __getitem__(self, index):
+        """
+        Return a copy of a state of the archive.
+
+        Args:
+            index (int): the index of the state
+
+        Returns:
+            np.ndarray: a vector of bytes for NESEnv._load_state
+
+        """
+        state = np.empty(_LIB.StateSize(self.env._env), dtype=np.uint8)
+        if not _LIB.ArchiveRead(self._archive, self._index(index), state.ctypes.data):
+            raise ValueError('state {} of the archive is corrupt'.format(index))
+        return state
+
+    def _index(self, index):
+        """Return an index in [0, len) or raise an IndexError."""
+        length = len(self)
+        if index < 0:
+            index += length
+        if not 0 <= index < length:
+            raise IndexError('archive index out of range')
+        return index
+
+    def load(self, index):
+        """
+        Load a state of the archive into the environment.
+
+        Args:
+            index (int): the index of the state
+
+        Returns:
+            None
+
+        """
+        if not _LIB.ArchiveLoad(self._archive, self.env._env, self._index(index)):
+            raise ValueError('state {} of the archive is corrupt'.format(index))
+
+    def verify(self):
+        """
+        Check the stored bytes of every state against their hashes.
+
+        Returns:
+            list: the indexes of the corrupt states
+
+        """
+        return [index for index in range(len(self)) if not _LIB.ArchiveVerify(self._archive, index)]
+
+    def close(self):
+        """Unmap the archive."""
+        if self._archive is None:
+            raise ValueError('archive has already been closed.')
+        _LIB.CloseArchive(self._archive)
+        self._archive = None
+
+
+class StateArchiveWriter(object):
+    """A writer that appends states to an archive."""
+
+    def __init__(self, path, env, compress=True):
+        """
+        Create an archive, or open an archive to append to.
+
+        Args:
+            path (str): the path of the archive
+            env (NESEnv): an environment of the ROM of the archive
+            compress (bool): whether to store states as deltas from the first
+              state of the archive (where that is smaller)
+
+        Returns:
+            None
+
+        """
+        self.env = env
+        self._writer = _LIB.CreateArchiveWriter(path, env._env, compress)
+        if not self._writer:
+            raise ValueError('{} is not an archive for this ROM or is being written'.format(path))
+
+    def __len__(self):
+        """Return the number of states in the archive, committed or not."""
+        return _LIB.ArchiveWriterSize(self._writer)
+
+    def append(self, state=None):
+        """
+        Append a state to the archive, readable after the next commit.
+
+        Args:
+            state (np.ndarray): a snapshot from NESEnv._save_state, or None
+              for the current state of the environment
+
+        Returns:
+            int: the index of the state in the archive
+
+        """
+        if self._writer is None:
+            raise ValueError('writer has already been closed.')
+        if state is None:
+            state = self.env._save_state()
+        state = np.ascontiguousarray(state, dtype=np.uint8)
+        if state.size != _LIB.StateSize(self.env._env):
+            raise ValueError('state must have {} bytes'.format(_LIB.StateSize(self.env._env)))
+        if not _LIB.ArchiveAppend(self._writer, state.ctypes.data):
+            raise OSError('failed to append to the archive')
+        return len(self) - 1
+
+    def commit(self):
+        """Write the index and make the appended states durable."""
+        if self._writer is None:
+            raise ValueError('writer has already been closed.')
+        if not _LIB.ArchiveCommit(self._writer):
+            raise OSError('failed to commit the archive')
+
+    def close(self):
+        """Commit the appended states and close the archive."""
+        if self._writer is None:
+            raise ValueError('writer has already been closed.')
+        is_committed = _LIB.CloseArchiveWriter(self._writer)
+        self._writer = None
+        if not is_committed:
+            raise OSError('failed to commit the archive')
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    StateArchive.__name__,
+    StateArchiveWriter.__name__,
+]
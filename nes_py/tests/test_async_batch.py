@@ -0,0 +1,86 @@
+"""Test cases for stepping a batch of environments in the background."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.async_batch import AsyncBatch
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import unsigned
+
+
+def create_envs(count):
+    """Return a list of new SMB1 instances after a reset."""
+    envs = [NESEnv(rom_file_abs_path('super-mario-bros-1.nes')) for _ in range(count)]
+    for env in envs:
+        env.reset()
+    return envs
+
+
+def actions(step, count):
+    """Return a different action for each environment of a step."""
+    return np.array([8 if (step + env) % 40 < 5 else 0 for env in range(count)], dtype=np.uint8)
+
+
+class ShouldRaiseValueErrorOnInvalidBatchUse(TestCase):
+    def test(self):
+        envs = create_envs(2)
+        self.assertRaises(ValueError, AsyncBatch, [])
+        self.assertRaises(ValueError, AsyncBatch, [envs[0], envs[1], envs[0]])
+        batch = AsyncBatch(envs)
+        self.assertTrue(batch.poll())
+        self.assertRaises(ValueError, batch.wait)
+        self.assertRaises(ValueError, batch.step_async, [0])
+        batch.step_async([0, 0], frames=20)
+        self.assertRaises(ValueError, batch.step_async, [0, 0])
+        batch.wait()
+        self.assertTrue(batch.poll())
+        batch.close()
+        self.assertRaises(ValueError, batch.close)
+        for env in envs:
+            env.close()
+
+
+class ShouldStepBatchLikeSynchronousSteps(TestCase):
+    def test(self):
+        envs = create_envs(3)
+        references = create_envs(3)
+        x_pos = unsigned(0x86, 0x6d)
+        for env in envs + references:
+            env._set_ram_program(reward=x_pos.delta())
+        batch = AsyncBatch(envs)
+        for step in range(100):
+            batch.step_async(actions(step, 3), frames=2)
+            for env, action in zip(references, actions(step, 3)):
+                env._frame_advance(action)
+                env._frame_advance(action)
+            screens, ram, results = batch.wait()
+            for index, env in enumerate(references):
+                self.assertTrue(np.array_equal(env.screen, screens[index]))
+                self.assertTrue(np.array_equal(env.ram, ram[index]))
+                self.assertEqual(env._program_result.reward, results['reward'][index])
+            # the batch steps the environments themselves
+            for env, reference in zip(envs, references):
+                self.assertEqual(reference._state_hash(), env._state_hash())
+        batch.close()
+        for env in envs + references:
+            env.close()
+
+
+class ShouldDoubleBufferBatchOutputs(TestCase):
+    def test(self):
+        envs = create_envs(2)
+        batch = AsyncBatch(envs)
+        batch.step_async(actions(0, 2))
+        screens, ram, _ = batch.wait()
+        expected_screens = screens.copy()
+        expected_ram = ram.copy()
+        # the outputs of a step are not overwritten by the next step
+        batch.step_async(actions(1, 2))
+        next_screens, next_ram, _ = batch.wait()
+        self.assertTrue(np.array_equal(expected_screens, screens))
+        self.assertTrue(np.array_equal(expected_ram, ram))
+        self.assertFalse(np.shares_memory(screens, next_screens))
+        self.assertFalse(np.shares_memory(ram, next_ram))
+        self.assertTrue(np.array_equal(envs[0].ram, next_ram[0]))
+        batch.close()
+        for env in envs:
+            env.close()
@@ -0,0 +1,97 @@
+"""Test cases for native Go-Explore cell archives."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+
+
+def create_env():
+    """Return a new SMB1 instance at the start of the first level."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._set_ram_program(reward=unsigned(0x86, 0x6d).delta(), done=byte(0x000e) == 0x0b)
+    env.reset()
+    # wait for the title screen, press start, and wait for the level
+    for _ in range(60):
+        env.step(0)
+    for _ in range(5):
+        env.step(8)
+    for _ in range(200):
+        env.step(0)
+    return env
+
+
+class ShouldRaiseErrorsOnInvalidCells(TestCase):
+    def test(self):
+        env = create_env()
+        self.assertRaises(ValueError, env._select_cell)
+        self.assertRaises(KeyError, env._load_cell, 0)
+        self.assertEqual(0, len(env._cells()))
+        self.assertRaises(ValueError, env._set_cell_archive, frame_shape=None)
+        self.assertRaises(ValueError, env._set_cell_archive, frame_depth=0)
+        self.assertRaises(ValueError, env._set_cell_archive, ram=[0x800])
+        self.assertRaises(ValueError, env._set_cell_archive, ram=[(0x86, 0)])
+        env.close()
+
+
+class ShouldArchiveBestStateOfEachCell(TestCase):
+    def test(self):
+        env = create_env()
+        env._set_cell_archive(frame_shape=None, ram=[0x6d, (0x86, 16)])
+        # the best (highest score, then shortest) frame of each cell
+        best = {env._current_cell(): (0, 0, env._save_state(), env.screen.copy())}
+        score = 0
+        seen = 1
+        for length in range(1, 301):
+            _, reward, done, _ = env.step(0x81 if length % 40 else 0x80)
+            score += reward
+            # frames that end the episode are not archived
+            if done:
+                break
+            seen += 1
+            key = env._current_cell()
+            if key not in best or score > best[key][0]:
+                best[key] = (score, length, env._save_state(), env.screen.copy())
+        cells = env._cells()
+        self.assertEqual(len(best), len(cells))
+        self.assertGreater(len(cells), 5)
+        self.assertEqual(seen, cells['times_seen'].sum())
+        for cell in cells:
+            score, length, state, screen = best[int(cell['key'])]
+            self.assertEqual(score, cell['score'])
+            self.assertEqual(length, cell['length'])
+            env._load_cell(int(cell['key']))
+            self.assertTrue(np.array_equal(state, env._save_state()))
+            self.assertTrue(np.array_equal(screen, env.screen))
+        self.assertEqual(0, env._cells()['times_chosen'].sum())
+        env.close()
+
+
+class ShouldSelectCellsToExploreFrom(TestCase):
+    def explore(self, frame_shape, ram):
+        """Explore from seeded selections and return the selected keys."""
+        env = create_env()
+        env._set_cell_archive(frame_shape=frame_shape, ram=ram, seed=1)
+        selected = []
+        for iteration in range(10):
+            env._select_cell()
+            selected.append(env._current_cell())
+            start = env._cells()
+            for _ in range(30):
+                if env.step(0x81 if iteration % 3 else 0x82)[2]:
+                    break
+            # trajectories continue from the length of the selected cell
+            cells = env._cells()
+            found = cells[len(start):]
+            length = start[start['key'] == selected[-1]]['length'][0]
+            self.assertTrue(np.all(found['length'] > length))
+        self.assertEqual(10, env._cells()['times_chosen'].sum())
+        env.close()
+        return selected
+
+    def test(self):
+        for frame_shape, ram in [(None, [0x6d, (0x86, 16)]), ((8, 11), None)]:
+            selected = self.explore(frame_shape, ram)
+            self.assertEqual(selected, self.explore(frame_shape, ram))
+            self.assertGreater(len(set(selected)), 1)
@@ -0,0 +1,61 @@
+"""Test cases for the native latency histograms and frame rate."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import _LIB
+from nes_py.nes_env import LATENCY_KINDS
+from nes_py.nes_env import NESEnv
+
+
+def create_env():
+    """Return a new SMB1 instance with empty latency histograms."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._latency(reset=True)
+    return env
+
+
+class ShouldRecordLatencyOfOperations(TestCase):
+    def test(self):
+        env = create_env()
+        env.reset()
+        for _ in range(100):
+            env.step(0)
+        env.render(mode='rgb_array')
+        latency = env._latency()
+        self.assertEqual(100, latency['step']['count'])
+        self.assertEqual(1, latency['reset']['count'])
+        self.assertEqual(1, latency['render']['count'])
+        step = latency['step']
+        self.assertTrue(0 < step['min'] <= step['p50'] <= step['p90'] <= step['p99'] <= step['max'])
+        self.assertTrue(step['min'] <= step['mean'] <= step['max'])
+        self.assertGreater(latency['fps'], 0)
+        bounds, counts = env._latency_histogram('step')
+        self.assertEqual(100, counts.sum())
+        self.assertTrue(np.all(np.diff(bounds.astype(np.int64)) > 0))
+        self.assertRaises(ValueError, env._latency_histogram, 'load')
+        # reading with reset clears the histograms and the frame rate
+        env._latency(reset=True)
+        latency = env._latency()
+        for kind in LATENCY_KINDS:
+            self.assertEqual(0, latency[kind]['count'])
+            self.assertEqual(0, latency[kind]['p99'])
+        self.assertEqual(0, latency['fps'])
+        env.close()
+
+
+class ShouldEstimatePercentilesWithinThreePercent(TestCase):
+    def test(self):
+        env = create_env()
+        render = LATENCY_KINDS.index('render')
+        latencies = np.unique(np.logspace(1, 10, 5000).astype(np.uint64))
+        for nanoseconds in latencies:
+            _LIB.RecordLatency(env._env, render, int(nanoseconds))
+        latency = env._latency()['render']
+        self.assertEqual(len(latencies), latency['count'])
+        self.assertAlmostEqual(latencies.min() * 1e-9, latency['min'])
+        self.assertAlmostEqual(latencies.max() * 1e-9, latency['max'])
+        for key, quantile in [('p50', 0.5), ('p90', 0.9), ('p99', 0.99), ('p999', 0.999)]:
+            expected = latencies[int(np.ceil(quantile * len(latencies))) - 1] * 1e-9
+            self.assertLess(abs(latency[key] - expected) / expected, 0.03)
+        self.assertFalse(_LIB.RecordLatency(env._env, len(LATENCY_KINDS), 1))
+        env.close()
@@ -0,0 +1,123 @@
+"""Test cases for recording and seeking movies of controller input."""
+import os
+import tempfile
+import struct
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+
+
+def record_movie(env, num_frames, keyframe_interval):
+    """
+    Record a movie of random input and return the state hash after each frame.
+
+    Args:
+        env (NESEnv): the environment to record on
+        num_frames (int): the number of frames to record
+        keyframe_interval (int): the number of frames between keyframes
+
+    Returns:
+        tuple: the actions of the frames and the state hashes before each
+        frame (and after the last one)
+
+    """
+    random = np.random.RandomState(0)
+    # hold random actions for random durations like a player would
+    actions = np.repeat(random.choice([0, 8, 128, 129, 1, 64], num_frames), 8)[:num_frames]
+    env.reset()
+    env._start_recording(keyframe_interval)
+    hashes = [env._state_hash()]
+    for action in actions:
+        env._frame_advance(action)
+        hashes.append(env._state_hash())
+    env._stop_recording()
+    return actions, hashes
+
+
+class ShouldRecordAndSeekMovie(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        self.assertIsNone(env._movie_inputs())
+        self.assertRaises(ValueError, env._seek, 0)
+        actions, hashes = record_movie(env, 300, 64)
+        inputs = env._movie_inputs()
+        self.assertEqual((300, 2), inputs.shape)
+        self.assertTrue(np.array_equal(actions, inputs[:, 0]))
+        self.assertFalse(inputs[:, 1].any())
+        for frame in [0, 1, 63, 64, 65, 200, 299, 300, 17]:
+            env._seek(frame)
+            self.assertEqual(hashes[frame], env._state_hash())
+        self.assertRaises(ValueError, env._seek, 301)
+        self.assertRaises(ValueError, env._seek, -1)
+        env.close()
+
+
+class ShouldSaveAndLoadMovie(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        actions, hashes = record_movie(env, 300, 64)
+        other = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        with tempfile.TemporaryDirectory() as directory:
+            inputs_path = os.path.join(directory, 'inputs.movie')
+            full_path = os.path.join(directory, 'full.movie')
+            env._save_movie(inputs_path)
+            env._save_movie(full_path, keyframes=True)
+            # the input is run-length encoded and only one state is stored
+            self.assertLess(os.path.getsize(inputs_path), os.path.getsize(full_path))
+            for path in (inputs_path, full_path):
+                other._load_movie(path)
+                self.assertEqual(hashes[0], other._state_hash())
+                self.assertTrue(np.array_equal(env._movie_inputs(), other._movie_inputs()))
+                for frame in [299, 64, 150, 0]:
+                    other._seek(frame)
+                    self.assertEqual(hashes[frame], other._state_hash())
+            # a movie only loads on the ROM it was recorded on
+            zelda = NESEnv(rom_file_abs_path('the-legend-of-zelda.nes'))
+            self.assertRaises(ValueError, zelda._load_movie, inputs_path)
+            self.assertRaises(ValueError, other._load_movie, os.path.join(directory, 'missing'))
+            zelda.close()
+        other.close()
+        env.close()
+
+
+class ShouldRejectCorruptKeyframes(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        record_movie(env, 100, 64)
+        state_size = len(env._save_state())
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'corrupt.movie')
+            env._save_movie(path, keyframes=True)
+            # overwrite the last keyframe at the end of the file
+            with open(path, 'r+b') as movie:
+                movie.seek(-state_size, os.SEEK_END)
+                movie.write(b'\xff' * state_size)
+            other = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+            self.assertRaises(ValueError, other._load_movie, path)
+            other.close()
+        env.close()
+
+
+class ShouldRejectMalformedMovieHeaders(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        env.reset()
+        state_size = len(env._save_state())
+        headers = [
+            # more frames than a movie may hold
+            (1, 0, 2 ** 62, 0, 1),
+            (1, 0, 10 ** 11, 0, 1),
+            # more runs or keyframes than the rest of the file holds
+            (1, 0, 1, 2 ** 40, 1),
+            (1, 0, 1, 1, 2 ** 31),
+            # an interval that does not fit the movie
+            (2 ** 31, 0, 1, 1, 1),
+        ]
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'malformed.movie')
+            for interval, rom_hash, frames, runs, keyframes in headers:
+                with open(path, 'wb') as movie:
+                    movie.write(struct.pack('<8sIIQQQII', b'NESMOVIE', 1, interval, rom_hash, frames, runs, state_size, keyframes))
+                self.assertRaises(ValueError, env._load_movie, path)
+        env.close()
@@ -1,4 +1,6 @@
 """Test cases for the NESEnv class."""
+import os
+import tempfile
 from unittest import TestCase
 import gym
 import numpy as np
@@ -126,3 +128,161 @@ class ShouldStepEnvBackupRestore(TestCase):
         env._restore()
         self.assertTrue(np.array_equal(backup, env.screen))
         env.close()
+
+
+class ShouldHashStateDeterministically(TestCase):
+    def test(self):
+        env1 = create_smb1_instance()
+        env2 = create_smb1_instance()
+        env1.reset()
+        env2.reset()
+        for action in [8, 0] * 60 + [128] * 60:
+            env1.step(action)
+            env2.step(action)
+        self.assertEqual(env1._state_hash(), env2._state_hash())
+        self.assertEqual(env1._screen_hash(), env2._screen_hash())
+        env1.close()
+        env2.close()
+
+
+class ShouldChangeStateHashOnStepAndRAMWrite(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        env.step(0)
+        state_hash = env._state_hash()
+        self.assertEqual(state_hash, env._state_hash())
+        env.ram[0x0776] ^= 1
+        self.assertNotEqual(state_hash, env._state_hash())
+        env.ram[0x0776] ^= 1
+        self.assertEqual(state_hash, env._state_hash())
+        env.step(0)
+        self.assertNotEqual(state_hash, env._state_hash())
+        env.close()
+
+
+class ShouldReportStats(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        env._stats(reset=True)
+        for _ in range(10):
+            env.step(0)
+        stats = env._stats(reset=True)
+        if not stats['is_enabled']:
+            # the library was built without stats, so nothing is counted
+            self.assertEqual(0, stats['cycles'])
+            self.assertEqual(0, stats['reads']['ram'])
+        else:
+            self.assertEqual(10 * 29781, stats['cycles'])
+            self.assertEqual(10, stats['frames_rendered'] + stats['frames_skipped'])
+            self.assertLess(0, stats['instructions'])
+            self.assertLess(0, stats['reads']['prg'])
+            self.assertLessEqual(stats['nmis'], 10)
+        self.assertEqual(0, env._stats()['cycles'])
+        env.close()
+
+
+class ShouldProfileGameCode(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        self.assertRaises(ValueError, env._dump_profile, os.devnull)
+        env.reset()
+        env._set_profiler(True)
+        for _ in range(60):
+            env.step(0)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'flat.txt')
+            env._dump_profile(path)
+            with open(path) as profile:
+                lines = profile.read().splitlines()[1:]
+            # SMB1 spends most of each frame spinning at $8057
+            self.assertEqual('00:8057', lines[0].split()[0])
+            path = os.path.join(directory, 'folded.txt')
+            env._dump_profile(path, folded=True)
+            with open(path) as profile:
+                stacks = dict(line.rsplit(' ', 1) for line in profile)
+            # the NMI handler at $8082 is on the stack of every routine
+            self.assertIn('main;int_00:8082', stacks)
+        env._set_profiler(False)
+        self.assertRaises(ValueError, env._dump_profile, os.devnull)
+        env.close()
+
+
+class ShouldSaveAndLoadState(TestCase):
+    def test(self):
+        # Zelda uses the MMC1 mapper, so the state includes mapper registers
+        env = NESEnv(rom_file_abs_path('the-legend-of-zelda.nes'))
+        env.reset()
+        for _ in range(120):
+            env.step(0)
+        state = env._save_state()
+        state_hash = env._state_hash()
+        for _ in range(30):
+            env.step(8)
+        after_hash = env._state_hash()
+        after_screen = env._screen_hash()
+        env._load_state(state)
+        self.assertEqual(state_hash, env._state_hash())
+        for _ in range(30):
+            env.step(8)
+        self.assertEqual(after_hash, env._state_hash())
+        self.assertEqual(after_screen, env._screen_hash())
+        self.assertRaises(ValueError, env._load_state, state[1:])
+        env.close()
+
+
+class ShouldRejectCorruptState(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('the-legend-of-zelda.nes'))
+        env.reset()
+        for _ in range(120):
+            env.step(0)
+        state = env._save_state()
+        # the first PRG bank of the MMC1 precedes the three other banks, the
+        # character RAM, and the two controllers at the end of the state
+        corrupt = state.copy()
+        offset = len(state) - (4 + 0x2000 + 4 * 8)
+        corrupt[offset:offset + 8] = 0xff
+        self.assertRaises(ValueError, env._load_state, corrupt)
+        # the emulator stays usable after a rejection
+        for _ in range(10):
+            env.step(0)
+        # a state of random bytes puts the PPU out of its range
+        self.assertRaises(ValueError, env._load_state, np.full_like(state, 0xff))
+        env._load_state(state)
+        self.assertTrue(np.array_equal(state, env._save_state()))
+        env.close()
+
+
+class ShouldExpandActions(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(60):
+            env.step(0)
+        state = env._save_state()
+        state_hash = env._state_hash()
+        actions = [0, 8, 1, 128, 8, 0]
+        screens, ram, states = env._expand(actions, frames=5)
+        # expanding leaves the state of the environment unchanged
+        self.assertEqual(state_hash, env._state_hash())
+        self.assertEqual((len(actions), 240, 256, 3), screens.shape)
+        self.assertEqual((len(actions), 0x800), ram.shape)
+        self.assertEqual((len(actions), len(state)), states.shape)
+        # each expansion matches stepping the action from the same state
+        for index, action in enumerate(actions):
+            env._load_state(state)
+            for _ in range(5):
+                env._frame_advance(action)
+            self.assertTrue(np.array_equal(env.screen, screens[index]))
+            self.assertTrue(np.array_equal(env.ram, ram[index]))
+            self.assertTrue(np.array_equal(env._save_state(), states[index]))
+        self.assertTrue(np.array_equal(states[1], states[4]))
+        self.assertFalse(np.array_equal(states[0], states[1]))
+        # outputs that are not requested are skipped
+        screens, ram, states = env._expand(actions[:2], screens=False, states=False)
+        self.assertIsNone(screens)
+        self.assertIsNone(states)
+        self.assertEqual((2, 0x800), ram.shape)
+        env.close()
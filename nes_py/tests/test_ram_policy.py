@@ -0,0 +1,128 @@
+"""Test cases for native RAM policy rollouts."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_policy import LinearPolicy, TabularPolicy
+from nes_py.ram_program import byte, unsigned
+
+
+def create_smb1_level():
+    """Return a new SMB1 instance at the start of the first level."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env.reset()
+    # wait for the title screen, press start, and wait for the level
+    for _ in range(60):
+        env.step(0)
+    for _ in range(5):
+        env.step(8)
+    for _ in range(200):
+        env.step(0)
+    return env
+
+
+def act(policy, ram):
+    """Return the action a policy selects for a RAM (reference in Python)."""
+    features = ram[policy.addresses].astype(np.float64)
+    if isinstance(policy, LinearPolicy):
+        rows = policy.weights.reshape(len(policy.actions), -1)
+        scores = rows[:, :-1].dot(features / 255.0) + rows[:, -1]
+    else:
+        index = 0
+        for feature, shift in zip(ram[policy.addresses], policy.shifts):
+            index = (index << (8 - shift)) | (int(feature) >> shift)
+        scores = policy.weights.reshape(-1, len(policy.actions))[index]
+    return policy.actions[int(np.argmax(scores))]
+
+
+def rollout(env, policy, x_pos, max_steps, frame_skip):
+    """Run an episode with a policy from Python (reference for _rollout)."""
+    x_start = int(env.ram[0x86]) + 256 * int(env.ram[0x6d])
+    steps = 0
+    while steps < max_steps:
+        action = act(policy, env.ram)
+        steps += 1
+        for _ in range(frame_skip):
+            env._frame_advance(action)
+            if env.ram[0x000e] == 0x0b:
+                return int(env.ram[0x86]) + 256 * int(env.ram[0x6d]) - x_start, steps
+    return int(env.ram[0x86]) + 256 * int(env.ram[0x6d]) - x_start, steps
+
+
+class ShouldRaiseValueErrorOnInvalidPolicy(TestCase):
+    def test(self):
+        self.assertRaises(ValueError, LinearPolicy, [0x800], [0])
+        self.assertRaises(ValueError, LinearPolicy, [0], [])
+        self.assertRaises(ValueError, LinearPolicy, [0], [0x100])
+        self.assertRaises(ValueError, LinearPolicy, [0], [0], weights=np.zeros(3))
+        self.assertRaises(ValueError, TabularPolicy, [0, 1, 2], [0])
+        self.assertRaises(ValueError, TabularPolicy, [0], [0], shifts=[9])
+        self.assertEqual(6, LinearPolicy([0, 1], [0, 1]).num_weights)
+        self.assertEqual(8, TabularPolicy([0], [0, 1], shifts=[6]).num_weights)
+
+
+class ShouldRolloutLinearPolicy(TestCase):
+    def test(self):
+        env = create_smb1_level()
+        x_pos = unsigned(0x86, 0x6d)
+        random = np.random.RandomState(1)
+        policy = LinearPolicy([0x0009, 0x0057, 0x001d], [128, 129, 130, 0])
+        policy.weights = random.randn(policy.num_weights)
+        state = env._save_state()
+        total, steps = env._rollout(policy,
+            reward=x_pos.delta(),
+            done=byte(0x000e) == 0x0b,
+            max_steps=100,
+            frame_skip=4,
+        )
+        state_hash = env._state_hash()
+        env._load_state(state)
+        self.assertEqual(rollout(env, policy, x_pos, 100, 4), (total, steps))
+        self.assertEqual(state_hash, env._state_hash())
+        env.close()
+
+
+class ShouldRolloutTabularPolicy(TestCase):
+    def test(self):
+        env = create_smb1_level()
+        x_pos = unsigned(0x86, 0x6d)
+        random = np.random.RandomState(2)
+        policy = TabularPolicy([0x0009, 0x001d], [128, 129, 0], shifts=[5, 4])
+        policy.weights = random.randn(policy.num_weights)
+        state = env._save_state()
+        total, steps = env._rollout(policy, reward=x_pos.delta(), max_steps=200)
+        env._load_state(state)
+        self.assertEqual(rollout(env, policy, x_pos, 200, 1), (total, steps))
+        env.close()
+
+
+class ShouldRolloutPopulationInParallel(TestCase):
+    def test(self):
+        env = create_smb1_level()
+        x_pos = unsigned(0x86, 0x6d)
+        random = np.random.RandomState(3)
+        policy = LinearPolicy([0x0009, 0x0057, 0x001d], [128, 129, 130, 0])
+        weights = random.randn(6, policy.num_weights)
+        state_hash = env._state_hash()
+        returns, steps = env._rollout_batch(policy, weights,
+            reward=x_pos.delta(),
+            done=byte(0x000e) == 0x0b,
+            max_steps=50,
+            frame_skip=4,
+        )
+        # the batch leaves the state of the environment unchanged
+        self.assertEqual(state_hash, env._state_hash())
+        state = env._save_state()
+        for member in range(len(weights)):
+            policy.weights = weights[member]
+            env._load_state(state)
+            total, length = env._rollout(policy,
+                reward=x_pos.delta(),
+                done=byte(0x000e) == 0x0b,
+                max_steps=50,
+                frame_skip=4,
+            )
+            self.assertEqual(total, returns[member])
+            self.assertEqual(length, steps[member])
+        self.assertLess(1, len(set(returns)))
+        env.close()
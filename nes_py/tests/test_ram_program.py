@@ -0,0 +1,149 @@
+"""Test cases for native RAM programs."""
+from unittest import TestCase
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte, unsigned, digits
+
+
+def create_smb1_instance():
+    """Return a new SMB1 instance."""
+    return NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+
+
+class ShouldRaiseValueErrorOnInvalidAddress(TestCase):
+    def test(self):
+        self.assertRaises(ValueError, byte, 0x800)
+        self.assertRaises(ValueError, unsigned)
+        self.assertRaises(ValueError, digits, *range(9))
+
+
+class ShouldRaiseTypeErrorOnTruthValue(TestCase):
+    def test(self):
+        self.assertRaises(TypeError, bool, byte(0) == 1)
+
+
+class ShouldEvaluateRAMProgramAfterStep(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        x_pos = unsigned(0x86, 0x6d)
+        score = digits(*range(0x07dd, 0x07e3))
+        env._set_ram_program(
+            reward=x_pos.delta().clip(-5, 5),
+            done=byte(0x075a) == 0xff,
+            info={
+                'x_pos': x_pos,
+                'score': score,
+            },
+        )
+        env.reset()
+        x_last = int(env.ram[0x86]) + 256 * int(env.ram[0x6d])
+        for step in range(500):
+            _, reward, done, info = env.step(8 if step % 2 else 128)
+            x = int(env.ram[0x86]) + 256 * int(env.ram[0x6d])
+            self.assertEqual(max(-5, min(5, x - x_last)), reward)
+            self.assertEqual(env.ram[0x075a] == 0xff, done)
+            self.assertEqual(x, info['x_pos'])
+            self.assertEqual(int(''.join(map(str, env.ram[0x07dd:0x07e3]))), info['score'])
+            x_last = x
+            if done:
+                break
+        env.close()
+
+
+class ShouldFallBackToPythonCallbacks(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env._set_ram_program(reward=byte(0x0776) + 1)
+        env.reset()
+        _, reward, done, info = env.step(0)
+        self.assertEqual(float(env.ram[0x0776]) + 1, reward)
+        self.assertFalse(done)
+        self.assertEqual({}, info)
+        env.close()
+
+
+class ShouldRunUntilRAMCondition(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        # wait for the title screen, press start, and wait for the level
+        for _ in range(60):
+            env.step(0)
+        for _ in range(5):
+            env.step(8)
+        for _ in range(200):
+            env.step(0)
+        x_pos = unsigned(0x86, 0x6d)
+        frames, is_triggered = env._run_until(x_pos > 200, max_frames=1000, action=128)
+        self.assertTrue(is_triggered)
+        self.assertLess(0, frames)
+        self.assertLess(200, int(env.ram[0x86]) + 256 * int(env.ram[0x6d]))
+        env.close()
+
+
+class ShouldRunUntilProgramCounter(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        for _ in range(10):
+            env.step(0)
+        # the NMI handler of SMB1 runs once per frame
+        self.assertEqual((1, True), env._run_until(pc=0x8082, max_frames=10))
+        # the breakpoint is cleared after the run
+        self.assertEqual((10, False), env._run_until(max_frames=10))
+        env.close()
+
+
+class ShouldEvaluateSequencesThroughPrefixTrie(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        # wait for the title screen, press start, and wait for the level
+        for _ in range(60):
+            env.step(0)
+        for _ in range(5):
+            env.step(8)
+        for _ in range(200):
+            env.step(0)
+        x_pos = unsigned(0x86, 0x6d)
+        x_start = int(env.ram[0x86]) + 256 * int(env.ram[0x6d])
+        # sequences that share a 20 frame prefix and then branch twice
+        prefix = [128] * 20
+        sequences = [
+            prefix + [128] * 10 + [129] * 10,
+            prefix + [128] * 10 + [0] * 10,
+            prefix + [0] * 20,
+            prefix + [0] * 10,
+            prefix,
+            [],
+        ]
+        state_hash = env._state_hash()
+        results = env._evaluate_sequences(sequences,
+            reward=x_pos.delta(),
+            done=x_pos > x_start + 40,
+            info={'x_pos': x_pos},
+            ram=True,
+        )
+        # the evaluation leaves the state of the environment unchanged
+        self.assertEqual(state_hash, env._state_hash())
+        # the trie has 20 + 10 + 10 + 10 + 20 distinct edges and the done
+        # condition stops the branches that run right
+        self.assertLess(results['emulated_frames'], 70)
+        self.assertTrue(results['done'][0])
+        self.assertFalse(results['done'][3])
+        state = env._save_state()
+        for index, sequence in enumerate(sequences):
+            env._load_state(state)
+            frames = 0
+            for action in sequence:
+                env._frame_advance(action)
+                frames += 1
+                if int(env.ram[0x86]) + 256 * int(env.ram[0x6d]) > x_start + 40:
+                    break
+            x = int(env.ram[0x86]) + 256 * int(env.ram[0x6d])
+            self.assertEqual(frames, results['frames'][index])
+            self.assertEqual(x > x_start + 40, results['done'][index])
+            self.assertEqual(x - x_start, results['reward'][index])
+            self.assertEqual(x, results['info']['x_pos'][index])
+            self.assertTrue((env.ram == results['ram'][index]).all())
+        env.close()
@@ -0,0 +1,146 @@
+"""Test cases for batches of environments served over sockets."""
+import os
+import tempfile
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+from nes_py.remote_env import RemoteEnvBatch
+from nes_py.remote_env import RemoteServer
+
+
+def create_envs(count):
+    """Return a list of new SMB1 instances."""
+    return [NESEnv(rom_file_abs_path('super-mario-bros-1.nes')) for _ in range(count)]
+
+
+def actions(step, count):
+    """Return a different action for each environment of a step."""
+    return np.array([8 if (step + 3 * env) % 40 < 5 else 0 for env in range(count)], dtype=np.uint8)
+
+
+def program():
+    """Return the keyword arguments of the RAM program of the tests."""
+    return dict(
+        reward=unsigned(0x86, 0x6d).delta(),
+        done=byte(0x000e) == 0x0b,
+        info={'x': unsigned(0x86, 0x6d)},
+    )
+
+
+class ShouldRaiseErrorsOnInvalidRequests(TestCase):
+    def test(self):
+        envs = create_envs(2)
+        server = RemoteServer(envs)
+        self.assertRaises(OSError, RemoteServer, envs, server.address)
+        batch = RemoteEnvBatch(server.address)
+        self.assertEqual(2, batch.num_envs)
+        self.assertEqual((240, 256), (batch.height, batch.width))
+        self.assertRaises(ValueError, batch.receive)
+        self.assertRaises(ValueError, batch.step, [0])
+        self.assertRaises(ValueError, batch.save_state, 2)
+        self.assertRaises(ValueError, batch.load_state, 0, np.zeros(3))
+        # a state with fields out of range is rejected by the server
+        corrupt = np.full(batch.state_size, 0xff, dtype=np.uint8)
+        self.assertRaises(ValueError, batch.load_state, 0, corrupt)
+        # the connection survives rejected requests
+        self.assertEqual(batch.state_size, len(batch.save_state(1)))
+        batch.close()
+        self.assertRaises(ValueError, batch.close)
+        server.close()
+        self.assertRaises(ValueError, server.close)
+        for env in envs:
+            env.close()
+
+
+class ShouldStepRemoteBatchLikeLocalEnvs(TestCase):
+    def test(self):
+        envs = create_envs(3)
+        server = RemoteServer(envs)
+        batch = RemoteEnvBatch(server.address)
+        batch.set_ram_program(**program())
+        references = create_envs(3)
+        for env in references:
+            env._set_ram_program(**program())
+            env.reset()
+        _, ram, _ = batch.reset()
+        for index, env in enumerate(references):
+            self.assertTrue(np.array_equal(env.ram, ram[index]))
+        for step in range(200):
+            screens, ram, results = batch.step(actions(step, 3), frames=2)
+            for index, env in enumerate(references):
+                env._frame_advance(actions(step, 3)[index])
+                state, reward, done, info = env.step(actions(step, 3)[index])
+                self.assertTrue(np.array_equal(state, screens[index]))
+                self.assertTrue(np.array_equal(env.ram, ram[index]))
+                self.assertEqual(reward, results['reward'][index])
+                self.assertEqual(done, results['done'][index] != 0)
+                self.assertEqual(info['x'], results['info'][index][0])
+        batch.close()
+        server.close()
+        for env in envs + references:
+            env.close()
+
+
+class ShouldResetRemoteEnvsToTheirBackup(TestCase):
+    def test(self):
+        envs = create_envs(2)
+        # back up the first env partway through the title screen
+        envs[0].reset()
+        for _ in range(40):
+            envs[0].step(0)
+        envs[0]._backup()
+        expected = envs[0].ram.copy()
+        envs[1].reset()
+        server = RemoteServer(envs)
+        batch = RemoteEnvBatch(server.address)
+        for _ in range(2):
+            _, ram, _ = batch.reset()
+            self.assertTrue(np.array_equal(expected, ram[0]))
+            self.assertFalse(np.array_equal(expected, ram[1]))
+            batch.step([0, 0], frames=10)
+        batch.close()
+        server.close()
+        for env in envs:
+            env.close()
+
+
+class ShouldPipelineRemoteRequests(TestCase):
+    def test(self):
+        envs = create_envs(2)
+        server = RemoteServer(envs)
+        batch = RemoteEnvBatch(server.address)
+        batch.reset()
+        state = batch.save_state(0)
+        expected = [batch.step(actions(step, 2), ram=True, screens=False)[1].copy() for step in range(50)]
+        batch.load_state(0, state)
+        batch.load_state(1, state)
+        # send every step before reading any response
+        for step in range(50):
+            batch.send_step(actions(step, 2), ram=True, screens=False)
+        for step in range(50):
+            screens, ram, _ = batch.receive()
+            self.assertIsNone(screens)
+            self.assertTrue(np.array_equal(expected[step][0], ram[0]))
+        batch.close()
+        server.close()
+        for env in envs:
+            env.close()
+
+
+class ShouldServeOverUnixSocket(TestCase):
+    def test(self):
+        envs = create_envs(1)
+        path = os.path.join(tempfile.mkdtemp(), 'nes.sock')
+        server = RemoteServer(envs, path)
+        batch = RemoteEnvBatch(path)
+        batch.reset(screens=False, ram=False)
+        for _ in range(10):
+            _, ram, _ = batch.step([0], screens=False)
+        self.assertTrue(np.array_equal(envs[0].ram, ram[0]))
+        batch.close()
+        server.close()
+        self.assertFalse(os.path.exists(path))
+        envs[0].close()
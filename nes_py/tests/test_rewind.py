@@ -0,0 +1,78 @@
+"""Test cases for the rewind ring buffer of recent states."""
+from unittest import TestCase
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+
+
+def create_smb1_instance():
+    """Return a new SMB1 instance."""
+    return NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+
+
+class ShouldRaiseValueErrorOnRewindWhenDisabled(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        self.assertRaises(ValueError, env._rewind, 1)
+        self.assertEqual({'states': 0, 'bytes': 0}, env._rewind_stats())
+        self.assertRaises(ValueError, env._set_rewind, interval=-1)
+        self.assertRaises(ValueError, env._set_rewind, max_bytes=-1)
+        self.assertRaises(ValueError, env._rewind, 1)
+        env.close()
+
+
+class ShouldRewindToCapturedStates(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        env._set_rewind(interval=1)
+        hashes = [env._state_hash()]
+        for frame in range(300):
+            env._frame_advance(128 if frame > 100 else (8 if frame % 30 < 5 else 0))
+            hashes.append(env._state_hash())
+        stats = env._rewind_stats()
+        self.assertEqual(301, stats['states'])
+        # the deltas are much smaller than full states
+        self.assertLess(stats['bytes'], 300 * len(env._save_state()) // 4)
+        self.assertEqual(0, env._rewind(0))
+        self.assertEqual(hashes[300], env._state_hash())
+        self.assertEqual(10, env._rewind(10))
+        self.assertEqual(hashes[290], env._state_hash())
+        self.assertEqual(100, env._rewind(100))
+        self.assertEqual(hashes[190], env._state_hash())
+        # the states after the rewound state are discarded, so stepping and
+        # rewinding again goes back to the same state
+        for _ in range(5):
+            env._frame_advance(0)
+        self.assertEqual(5, env._rewind(5))
+        self.assertEqual(hashes[190], env._state_hash())
+        # the buffer does not reach back further than the first capture
+        self.assertEqual(190, env._rewind(1000))
+        self.assertEqual(hashes[0], env._state_hash())
+        self.assertEqual(1, env._rewind_stats()['states'])
+        env._set_rewind(interval=0)
+        self.assertRaises(ValueError, env._rewind, 1)
+        env.close()
+
+
+class ShouldRewindWithIntervalAndBoundedMemory(TestCase):
+    def test(self):
+        env = create_smb1_instance()
+        env.reset()
+        env._set_rewind(interval=4, max_bytes=4096)
+        hashes = [env._state_hash()]
+        for frame in range(400):
+            env._frame_advance(8 if frame % 40 < 5 else 0)
+            hashes.append(env._state_hash())
+        stats = env._rewind_stats()
+        self.assertLessEqual(stats['bytes'], 4096)
+        self.assertLess(stats['states'], 101)
+        # a rewind goes back to a captured frame at least as old as requested
+        self.assertEqual(4, env._rewind(3))
+        self.assertEqual(hashes[396], env._state_hash())
+        # the oldest states were dropped from the full pool
+        rewound = env._rewind(400)
+        self.assertLess(rewound, 396)
+        self.assertEqual(0, rewound % 4)
+        self.assertEqual(hashes[396 - rewound], env._state_hash())
+        env.close()
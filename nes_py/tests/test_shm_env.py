@@ -0,0 +1,116 @@
+"""Test cases for serving environments over shared memory."""
+from multiprocessing import Process
+from multiprocessing import Queue
+import os
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+from nes_py.shm_env import NESServer
+from nes_py.shm_env import SharedMemoryEnv
+
+
+def create_smb1_instance():
+    """Return a new SMB1 instance with a native reward, done flag, and info."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._set_ram_program(
+        reward=unsigned(0x86, 0x6d).delta(),
+        done=byte(0x000e) == 0x0b,
+        info={'x': unsigned(0x86, 0x6d)},
+    )
+    return env
+
+
+def segment_name(test):
+    """Return a shared memory segment name unique to a test and process."""
+    return '/nes-py-test-{}-{}'.format(test, os.getpid())
+
+
+def action(step):
+    """Return the action for a step of the tests."""
+    return 8 if step % 40 < 5 else (128 if step > 200 else 0)
+
+
+def play(name, steps, queue):
+    """Step a shared memory client and put its RAM after each step."""
+    env = SharedMemoryEnv(name, info_keys=['x'])
+    env.reset()
+    for step in range(steps):
+        _, reward, _, info = env.step(action(step))
+        queue.put((env.ram.tobytes(), reward, info['x']))
+    env.close()
+
+
+class ShouldRaiseOSErrorWithoutSegment(TestCase):
+    def test(self):
+        name = segment_name('missing')
+        self.assertRaises(OSError, SharedMemoryEnv, name)
+        env = create_smb1_instance()
+        server = NESServer(env, name)
+        self.assertRaises(OSError, NESServer, env, name)
+        server.close()
+        self.assertRaises(ValueError, server.close)
+        self.assertRaises(OSError, SharedMemoryEnv, name)
+        env.close()
+
+
+class ShouldStepOverSharedMemory(TestCase):
+    def test(self):
+        name = segment_name('step')
+        env = create_smb1_instance()
+        server = NESServer(env, name)
+        client = SharedMemoryEnv(name, info_keys=['x'])
+        self.assertRaises(ValueError, client.step, 0)
+        reference = create_smb1_instance()
+        reference.reset()
+        client.reset()
+        self.assertTrue(np.array_equal(reference.ram, client.ram))
+        for step in range(300):
+            state, reward, done, info = client.step(action(step))
+            expected = reference.step(action(step))
+            self.assertTrue(np.array_equal(expected[0], state))
+            self.assertTrue(np.array_equal(reference.ram, client.ram))
+            self.assertEqual(expected[1:], (reward, done, info))
+        self.assertTrue(np.array_equal(state, client.render('rgb_array')))
+        client.close()
+        server.close()
+        env.close()
+        reference.close()
+
+
+class ShouldServeClientInAnotherProcess(TestCase):
+    def test(self):
+        name = segment_name('process')
+        env = create_smb1_instance()
+        server = NESServer(env, name)
+        queue = Queue()
+        process = Process(target=play, args=(name, 100, queue))
+        process.start()
+        reference = create_smb1_instance()
+        reference.reset()
+        for step in range(100):
+            ram, reward, x = queue.get(timeout=60)
+            _, expected_reward, _, info = reference.step(action(step))
+            self.assertEqual(reference.ram.tobytes(), ram)
+            self.assertEqual((expected_reward, info['x']), (reward, x))
+        process.join()
+        self.assertEqual(0, process.exitcode)
+        server.close()
+        env.close()
+        reference.close()
+
+
+class ShouldRaiseConnectionErrorWhenServerCloses(TestCase):
+    def test(self):
+        name = segment_name('closed')
+        env = create_smb1_instance()
+        server = NESServer(env, name)
+        client = SharedMemoryEnv(name)
+        client.reset()
+        client.step(0)
+        server.close()
+        self.assertRaises(ConnectionError, client.step, 0)
+        client.close()
+        env.close()
@@ -0,0 +1,98 @@
+"""Test cases for speculative steps of likely next actions."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+
+
+def create_env():
+    """Return a new SMB1 environment with a native RAM program."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._set_ram_program(
+        reward=unsigned(0x86, 0x6d).delta(),
+        done=byte(0x000e) == 0x0b,
+        info={'x': unsigned(0x86, 0x6d)},
+    )
+    return env
+
+
+def action(step):
+    """Return the action of a step of the tests (mostly repeated)."""
+    return 8 if step % 40 < 5 else (0x81 if step % 7 else 0x80)
+
+
+class ShouldCommitSpeculativeStepsLikeRealSteps(TestCase):
+    def test(self):
+        env = create_env()
+        reference = create_env()
+        env.reset()
+        reference.reset()
+        env._set_speculation(repeat=True)
+        for step in range(300):
+            state, reward, done, info = env.step(action(step))
+            expected = reference.step(action(step))
+            self.assertTrue(np.array_equal(expected[0], state))
+            self.assertEqual(expected[1:], (reward, done, info))
+            self.assertTrue(np.array_equal(reference.ram, env.ram))
+        stats = env._speculation_stats()
+        # the first step has no speculation to join
+        self.assertEqual(299, stats['hits'] + stats['misses'])
+        self.assertGreater(stats['hits'], 200)
+        env._set_speculation(False)
+        self.assertEqual({'hits': 0, 'misses': 0}, env._speculation_stats())
+        env.close()
+        reference.close()
+
+
+class ShouldSpeculateOnMostLikelyActions(TestCase):
+    def test(self):
+        env = create_env()
+        reference = create_env()
+        env.reset()
+        reference.reset()
+        env._set_speculation(repeat=False)
+        for step in range(100):
+            # the real action is the second most likely one
+            probabilities = np.full(4, 0.1)
+            probabilities[step % 4] = 0.4
+            probabilities[(step + 1) % 4] = 0.5
+            env._speculate(actions=[0, 1, 0x80, 0x81], probabilities=probabilities, k=2)
+            env._frame_advance([0, 1, 0x80, 0x81][step % 4])
+            reference._frame_advance([0, 1, 0x80, 0x81][step % 4])
+            self.assertTrue(np.array_equal(reference.ram, env.ram))
+        self.assertEqual({'hits': 100, 'misses': 0}, env._speculation_stats())
+        self.assertTrue(np.array_equal(reference.screen, env.screen))
+        env.close()
+        reference.close()
+
+
+class ShouldMissAfterStateChanges(TestCase):
+    def test(self):
+        env = create_env()
+        env.reset()
+        env._backup()
+        reference = create_env()
+        reference.reset()
+        env._set_speculation(repeat=False)
+        # steps without a speculation are neither hits nor misses
+        for _ in range(20):
+            env.step(0)
+        self.assertEqual({'hits': 0, 'misses': 0}, env._speculation_stats())
+        # a speculation from a state that was since loaded is discarded
+        env._speculate(actions=[0])
+        env.reset()
+        reference.reset()
+        env._speculate(actions=[1], frames=2)
+        # a speculation for another number of frames is discarded
+        env.step(1)
+        reference.step(1)
+        # a speculation on other actions is discarded
+        env._speculate(actions=[2, 3])
+        env.step(1)
+        reference.step(1)
+        self.assertTrue(np.array_equal(reference.ram, env.ram))
+        self.assertEqual({'hits': 0, 'misses': 2}, env._speculation_stats())
+        env.close()
+        reference.close()
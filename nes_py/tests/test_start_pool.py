@@ -0,0 +1,155 @@
+"""Test cases for native start pools and autoreset."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+
+
+def create_env():
+    """Return a new SMB1 environment with a native RAM program."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    # the frame counter of SMB1 ends an episode every 256 frames
+    env._set_ram_program(
+        reward=unsigned(0x86, 0x6d).delta(),
+        done=byte(0x0009) == 0,
+        info={'x': unsigned(0x86, 0x6d)},
+    )
+    env.reset()
+    return env
+
+
+def add_starts(env, count):
+    """Add a start every 30 frames and return their states and screens."""
+    starts = []
+    for _ in range(count):
+        for _ in range(30):
+            env._frame_advance(0x81)
+        starts.append((env._save_state(), env.screen.copy()))
+        env._add_start_state()
+    return starts
+
+
+class ShouldResetToRandomStartsWithNoops(TestCase):
+    def test(self):
+        env = create_env()
+        reference = create_env()
+        env._set_start_pool(max_noops=4, seed=1)
+        starts = add_starts(env, 3)
+        # the expected screen of each start after each number of no-ops
+        expected = {}
+        for start, screen in starts:
+            reference._load_state(start)
+            expected[reference._state_hash()] = screen
+            for _ in range(4):
+                reference._frame_advance(0)
+                expected[reference._state_hash()] = reference.screen.copy()
+        hashes = []
+        for _ in range(50):
+            env.reset()
+            hashes.append(env._state_hash())
+            self.assertIn(hashes[-1], expected)
+            self.assertTrue(np.array_equal(expected[hashes[-1]], env.screen))
+        self.assertGreater(len(set(hashes)), 5)
+        # the same seed resets to the same starts
+        sequences = []
+        for _ in range(2):
+            env.seed(7)
+            sequences.append([])
+            for _ in range(10):
+                env.reset()
+                sequences[-1].append(env._state_hash())
+        self.assertEqual(sequences[0], sequences[1])
+        env._clear_start_pool()
+        self.assertRaises(ValueError, env._add_start_state)
+        env.close()
+        reference.close()
+
+
+class ShouldAutoresetInStep(TestCase):
+    def test(self):
+        env = create_env()
+        self.assertRaises(ValueError, env._set_autoreset)
+        env._set_start_pool()
+        self.assertRaises(ValueError, env.reset)
+        start, _ = add_starts(env, 1)[0]
+        env._set_autoreset()
+        env._set_cell_archive(frame_shape=None, ram=[(0x86, 16)])
+        env.reset()
+        total, length, episodes = 0, 0, 0
+        for step in range(700):
+            _, reward, done, info = env.step(0x81 if step % 50 else 0x80)
+            total += reward
+            length += 1
+            if done:
+                self.assertEqual({'r': total, 'l': length}, info['episode'])
+                # the episode restarts from the start of the pool
+                reference = create_env()
+                reference._load_state(start)
+                self.assertEqual(reference._state_hash(), env._state_hash())
+                reference.close()
+                total, length = 0, 0
+                episodes += 1
+            else:
+                self.assertNotIn('episode', info)
+        self.assertGreater(episodes, 1)
+        stats = env._episode_stats()
+        self.assertEqual(episodes, stats['episodes'])
+        self.assertEqual(length, stats['length'])
+        self.assertAlmostEqual(total, stats['return'])
+        # each episode begins a new trajectory of the cell archive
+        self.assertLessEqual(env._cells()['length'].max(), 256)
+        env.close()
+
+
+class ShouldRejectAutoresetThatSkipsPythonCode(TestCase):
+    def test(self):
+        env = create_env()
+        env._set_start_pool()
+        add_starts(env, 1)
+        # the reward and info must be native
+        env._set_ram_program(done=byte(0x0009) == 0, info={})
+        self.assertRaises(ValueError, env._set_autoreset)
+        env._set_ram_program(reward=unsigned(0x86, 0x6d).delta(), done=byte(0x0009) == 0)
+        self.assertRaises(ValueError, env._set_autoreset)
+        env._set_ram_program(reward=unsigned(0x86, 0x6d).delta(), done=byte(0x0009) == 0, info={})
+        env._set_autoreset()
+        self.assertRaises(ValueError, env._set_ram_program, done=byte(0x0009) == 0, info={})
+        # speculation and autoreset exclude each other
+        self.assertRaises(ValueError, env._set_speculation)
+        env._set_autoreset(False)
+        env._set_speculation()
+        self.assertRaises(ValueError, env._set_autoreset)
+        env.close()
+        # the reset and step callbacks would see the next episode
+        for name in ('_will_reset', '_did_reset', '_did_step'):
+            env = type('CallbackEnv', (NESEnv,), {name: lambda self, *args: None})(
+                rom_file_abs_path('super-mario-bros-1.nes'))
+            env._set_ram_program(reward=unsigned(0x86, 0x6d).delta(), done=byte(0x0009) == 0, info={})
+            env.reset()
+            env._set_start_pool()
+            env._add_start_state()
+            self.assertRaises(ValueError, env._set_autoreset)
+            env.close()
+
+
+class ShouldRestoreScreenOfSnapshotStart(TestCase):
+    def test(self):
+        env = create_env()
+        env._set_start_pool(max_noops=0)
+        for _ in range(120):
+            env._frame_advance(0x81)
+        state = env._save_state()
+        screen = env.screen.copy()
+        for _ in range(60):
+            env._frame_advance(0x81)
+        self.assertFalse(np.array_equal(screen, env.screen))
+        # a snapshot needs the screen it was saved with
+        self.assertRaises(ValueError, env._add_start_state, state)
+        self.assertRaises(ValueError, env._add_start_state, state, screen[1:])
+        self.assertEqual(1, env._add_start_state(state, screen))
+        env.reset()
+        self.assertTrue(np.array_equal(state, env._save_state()))
+        self.assertTrue(np.array_equal(screen, env.screen))
+        env.close()
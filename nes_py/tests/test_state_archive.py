@@ -0,0 +1,135 @@
+"""Test cases for archives of machine states."""
+import os
+import struct
+import tempfile
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.state_archive import StateArchive
+from nes_py.state_archive import StateArchiveWriter
+
+
+def create_env(name='super-mario-bros-1.nes'):
+    """Return a new reset environment of a ROM."""
+    env = NESEnv(rom_file_abs_path(name))
+    env.reset()
+    return env
+
+
+def record(env, writer, count):
+    """Append a state every 10 frames and return the states."""
+    states = []
+    for step in range(count):
+        for _ in range(10):
+            env._frame_advance(0x81 if step % 5 else 0x80)
+        states.append(env._save_state())
+        writer.append()
+    return states
+
+
+class ShouldReadBackAppendedStates(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'states.nesarc')
+        env = create_env()
+        for compress in [True, False]:
+            writer = StateArchiveWriter(path + str(compress), env, compress=compress)
+            states = record(env, writer, 50)
+            writer.close()
+            archive = StateArchive(path + str(compress), env)
+            self.assertEqual(50, len(archive))
+            self.assertEqual([], archive.verify())
+            for index in [0, 17, -1]:
+                self.assertTrue(np.array_equal(states[index], archive[index]))
+                archive.load(index)
+                self.assertTrue(np.array_equal(states[index], env._save_state()))
+            self.assertRaises(IndexError, archive.load, 50)
+            archive.close()
+        # deltas from the first state are much smaller than states
+        compressed = os.path.getsize(path + 'True')
+        self.assertLess(compressed, os.path.getsize(path + 'False') / 3)
+        env.close()
+
+
+class ShouldAppendToArchive(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'states.nesarc')
+        env = create_env()
+        writer = StateArchiveWriter(path, env)
+        states = record(env, writer, 5)
+        writer.commit()
+        # only one writer may append to a file
+        self.assertRaises(ValueError, StateArchiveWriter, path, env)
+        # readers see the committed states only
+        states += record(env, writer, 5)
+        archive = StateArchive(path, env)
+        self.assertEqual(5, len(archive))
+        archive.close()
+        writer.close()
+        writer = StateArchiveWriter(path, env)
+        self.assertEqual(10, len(writer))
+        states += record(env, writer, 5)
+        writer.close()
+        archive = StateArchive(path, env)
+        self.assertEqual(15, len(archive))
+        for index, state in enumerate(states):
+            self.assertTrue(np.array_equal(state, archive[index]))
+        archive.close()
+        # an archive is only valid for its own ROM
+        other = create_env('excitebike.nes')
+        self.assertRaises(ValueError, StateArchive, path, other)
+        self.assertRaises(ValueError, StateArchiveWriter, path, other)
+        other.close()
+        env.close()
+
+
+class ShouldRejectCorruptStateOnLoad(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'states.nesarc')
+        env = create_env()
+        writer = StateArchiveWriter(path, env, compress=False)
+        state = env._save_state()
+        writer.append(state)
+        # the bytes are intact, but the state puts the PPU out of its range
+        writer.append(np.full_like(state, 0xff))
+        writer.close()
+        archive = StateArchive(path, env)
+        self.assertEqual([], archive.verify())
+        self.assertRaises(ValueError, archive.load, 1)
+        archive.load(0)
+        self.assertTrue(np.array_equal(state, env._save_state()))
+        archive.close()
+        env.close()
+
+
+class ShouldKeepLastCommitAfterCrash(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'states.nesarc')
+        env = create_env()
+        writer = StateArchiveWriter(path, env)
+        states = record(env, writer, 5)
+        writer.commit()
+        record(env, writer, 5)
+        writer.commit()
+        writer.close()
+        # tear the latest commit in the header (commit 2 is in slot 0) as if
+        # the process died while writing it
+        offset = 8 + 4 + 4 + 8
+        with open(path, 'r+b') as archive_file:
+            archive_file.seek(offset + 8)
+            archive_file.write(struct.pack('<Q', 12345))
+        archive = StateArchive(path, env)
+        self.assertEqual(5, len(archive))
+        for index, state in enumerate(states):
+            self.assertTrue(np.array_equal(state, archive[index]))
+        archive.close()
+        # appending continues from the intact commit
+        writer = StateArchiveWriter(path, env)
+        self.assertEqual(5, len(writer))
+        states += record(env, writer, 2)
+        writer.close()
+        archive = StateArchive(path, env)
+        self.assertEqual(7, len(archive))
+        self.assertTrue(np.array_equal(states[-1], archive[6]))
+        archive.close()
+        env.close()
@@ -0,0 +1,125 @@
+"""Test cases for decoding instruction traces."""
+import os
+import tempfile
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py import trace
+
+
+def write_trace(path, records, num_dropped=0):
+    """Write a trace file with the given records."""
+    header = np.zeros(1, dtype=trace.HEADER)
+    header['magic'] = trace.MAGIC
+    header['version'] = trace.VERSION
+    header['record_size'] = trace.RECORD.itemsize
+    header['num_records'] = len(records)
+    header['num_dropped'] = num_dropped
+    with open(path, 'wb') as trace_file:
+        trace_file.write(header.tobytes() + records.tobytes())
+
+
+def is_monotonic_between_loads(records):
+    """Return true if the cycles only increase between LOAD records."""
+    is_decrease = np.diff(records['cycle']) < 0
+    return not np.any(is_decrease & (records['kind'][1:] != trace.LOAD))
+
+
+class ShouldDecodeTraceFile(TestCase):
+    def test(self):
+        records = np.zeros(3, dtype=trace.RECORD)
+        records['cycle'] = [2**32 - 2, 2**32 - 2, 5]
+        records['kind'] = [trace.INSTRUCTION, trace.READ, trace.INSTRUCTION]
+        records['address'] = [0x8000, 0x0010, 0x8002]
+        records['value'] = [0xa5, 0x42, 0xea]
+        records['A'] = [0, 0, 0x42]
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.bin')
+            write_trace(path, records, num_dropped=7)
+            num_dropped, decoded = trace.read_trace(path)
+        self.assertEqual(7, num_dropped)
+        # the 32-bit cycle counter is unwrapped
+        self.assertEqual([2**32 - 2, 2**32 - 2, 2**32 + 5], list(decoded['cycle']))
+        self.assertIn('R 0010 = 42', trace.format_record(decoded[1]))
+        self.assertIn('8002  EA  A:42', trace.format_record(decoded[2]))
+
+
+class ShouldStartUnwrappingOverAtLoad(TestCase):
+    def test(self):
+        records = np.zeros(5, dtype=trace.RECORD)
+        records['cycle'] = [2**32 - 2, 5, 100, 90, 2]
+        records['kind'] = [
+            trace.INSTRUCTION,
+            trace.INSTRUCTION,
+            trace.LOAD,
+            trace.INSTRUCTION,
+            trace.INSTRUCTION,
+        ]
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.bin')
+            write_trace(path, records)
+            _, decoded = trace.read_trace(path)
+        # the load is not a wrap, and the wraps before it do not carry over
+        self.assertEqual(
+            [2**32 - 2, 2**32 + 5, 100, 2**32 + 90, 2**33 + 2],
+            list(decoded['cycle'])
+        )
+        self.assertIn('state loaded', trace.format_record(decoded[2]))
+
+
+class ShouldRaiseValueErrorOnInvalidTraceFile(TestCase):
+    def test(self):
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.bin')
+            with open(path, 'wb') as trace_file:
+                trace_file.write(b'not a trace file at all, really not')
+            self.assertRaises(ValueError, trace.read_trace, path)
+
+
+class ShouldDumpTraceFromEnv(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        env.reset()
+        env.step(0)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.bin')
+            try:
+                env._dump_trace(path)
+            except ValueError:
+                # the library was built without trace
+                env.close()
+                return
+            _, records = trace.read_trace(path)
+        self.assertLess(0, len(records))
+        self.assertTrue(is_monotonic_between_loads(records))
+        env.close()
+
+
+class ShouldTraceAcrossRestore(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        env.reset()
+        env._backup()
+        for _ in range(5):
+            env.step(0)
+        env._restore()
+        for _ in range(2):
+            env.step(0)
+        with tempfile.TemporaryDirectory() as directory:
+            path = os.path.join(directory, 'trace.bin')
+            try:
+                env._dump_trace(path)
+            except ValueError:
+                # the library was built without trace
+                env.close()
+                return
+            _, records = trace.read_trace(path)
+        env.close()
+        loads = np.flatnonzero(records['kind'] == trace.LOAD)
+        self.assertLess(0, len(loads))
+        # the restore goes back to the cycle of the backup without a wrap
+        last = loads[-1]
+        self.assertLess(records['cycle'][last], records['cycle'][last - 1])
+        self.assertLess(records['cycle'][-1], 2**32)
+        self.assertTrue(is_monotonic_between_loads(records))
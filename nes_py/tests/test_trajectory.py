@@ -0,0 +1,98 @@
+"""Test cases for trajectories of recorded frames."""
+import os
+import struct
+import tempfile
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+from nes_py.trajectory import TrajectoryReader
+
+
+def create_env():
+    """Return a new reset SMB1 instance with a RAM program."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._set_ram_program(reward=unsigned(0x86, 0x6d).delta(), done=byte(0x000e) == 0x0b)
+    env.reset()
+    return env
+
+
+def record(env, path, count, chunk_steps=16):
+    """Record frames to a trajectory and return the expected steps."""
+    env._start_trajectory(path, chunk_steps=chunk_steps)
+    expected = []
+    for step in range(count):
+        action = 0x81 if step % 7 else 0x80
+        _, reward, done, _ = env.step(action)
+        expected.append((action, reward, done, env.ram.copy(), env.screen.copy()))
+    return expected
+
+
+class ShouldReadBackRecordedFrames(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'run.nestraj')
+        env = create_env()
+        expected = record(env, path, 100)
+        self.assertEqual(100, env._stop_trajectory())
+        trajectory = TrajectoryReader(path)
+        self.assertEqual(100, len(trajectory))
+        # sequential, backward, and random access across chunks
+        for index in list(range(100)) + [99, 3, 50, 17, 16, 15, -1]:
+            action, reward, done, ram, screen = expected[index]
+            step = trajectory[index]
+            self.assertEqual(action, step['action'])
+            self.assertEqual(reward, step['reward'])
+            self.assertEqual(done, step['done'])
+            self.assertTrue(np.array_equal(ram, step['ram']))
+            self.assertTrue(np.array_equal(screen, step['frame']))
+        self.assertRaises(IndexError, trajectory.__getitem__, 100)
+        trajectory.close()
+        self.assertRaises(OSError, env._stop_trajectory)
+        env.close()
+
+
+class ShouldCompressFrames(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'run.nestraj')
+        env = create_env()
+        record(env, path, 300, chunk_steps=128)
+        env._stop_trajectory()
+        # a raw frame alone is 240 * 256 * 3 bytes
+        self.assertLess(os.path.getsize(path), 300 * 240 * 256 * 3 / 100)
+        env.close()
+
+
+class ShouldIgnoreTornChunk(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'run.nestraj')
+        env = create_env()
+        expected = record(env, path, 40)
+        env._stop_trajectory()
+        # cut the last chunk (frames 32 to 39) short like a crashed recorder
+        with open(path, 'r+b') as trajectory:
+            trajectory.truncate(os.path.getsize(path) - 10)
+        trajectory = TrajectoryReader(path)
+        self.assertEqual(32, len(trajectory))
+        self.assertTrue(np.array_equal(expected[31][3], trajectory[31]['ram']))
+        trajectory.close()
+        self.assertRaises(ValueError, TrajectoryReader, __file__)
+        env.close()
+
+
+class ShouldRejectCorruptHeader(TestCase):
+    def test(self):
+        path = os.path.join(tempfile.mkdtemp(), 'run.nestraj')
+        env = create_env()
+        record(env, path, 4)
+        env._stop_trajectory()
+        with open(path, 'rb') as trajectory:
+            data = trajectory.read()
+        # a huge width, height, or RAM size (at offsets 16, 20, and 24)
+        for offset in (16, 20, 24):
+            corrupt = data[:offset] + struct.pack('<I', 0xffffffff) + data[offset + 4:]
+            with open(path, 'wb') as trajectory:
+                trajectory.write(corrupt)
+            self.assertRaises(ValueError, TrajectoryReader, path)
+        env.close()
@@ -0,0 +1,109 @@
+"""Test cases for the cache of the outcomes of frames."""
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import NESEnv
+from nes_py.ram_program import byte
+from nes_py.ram_program import unsigned
+
+
+def create_env():
+    """Return a new SMB1 environment with a native RAM program."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env._set_ram_program(
+        reward=unsigned(0x86, 0x6d).delta(),
+        done=byte(0x000e) == 0x0b,
+        info={'x': unsigned(0x86, 0x6d)},
+    )
+    return env
+
+
+def action(step):
+    """Return the action of a step of the tests."""
+    return 8 if step % 40 < 5 else (0x81 if step % 7 else 0x80)
+
+
+class ShouldReplayCachedFramesExactly(TestCase):
+    def test(self):
+        env = create_env()
+        reference = create_env()
+        self.assertIsNone(env._transition_cache_stats())
+        env._set_transition_cache()
+        # episodes start from the same state (a reset keeps the RAM and a
+        # backup does not restore the controllers)
+        for each in [env, reference]:
+            each.reset()
+            each._backup()
+        start = env._save_state()
+        for _ in range(2):
+            for each in [env, reference]:
+                each.reset()
+                each._load_state(start)
+            for step in range(200):
+                state, reward, done, info = env.step(action(step))
+                expected = reference.step(action(step))
+                self.assertTrue(np.array_equal(expected[0], state))
+                self.assertEqual(expected[1:], (reward, done, info))
+                self.assertTrue(np.array_equal(reference.ram, env.ram))
+                self.assertEqual(reference._state_hash(), env._state_hash())
+        stats = env._transition_cache_stats()
+        # the second episode replays the first one from the cache
+        self.assertEqual(200, stats['misses'])
+        self.assertEqual(200, stats['hits'])
+        self.assertEqual(200, stats['entries'])
+        self.assertEqual(0, stats['evictions'])
+        env._set_transition_cache(0)
+        self.assertIsNone(env._transition_cache_stats())
+        env.close()
+        reference.close()
+
+
+class ShouldEvictWithinMemoryCap(TestCase):
+    def test(self):
+        env = create_env()
+        env._set_transition_cache(1 << 20, screens=False)
+        env.reset()
+        for step in range(1000):
+            env.step(action(step))
+        stats = env._transition_cache_stats()
+        self.assertLessEqual(stats['bytes'], 1 << 20)
+        self.assertGreater(stats['evictions'], 0)
+        self.assertEqual(1000, stats['entries'] + stats['evictions'])
+        env.close()
+
+
+class ShouldShareCacheBetweenEnvs(TestCase):
+    def test(self):
+        env = create_env()
+        other = create_env()
+        env._set_transition_cache()
+        other._share_transition_cache(env)
+        for each in [env, other]:
+            each.reset()
+            for step in range(50):
+                each.step(action(step))
+        self.assertTrue(np.array_equal(env.ram, other.ram))
+        stats = other._transition_cache_stats()
+        self.assertEqual({'hits': 50, 'misses': 50}, {k: stats[k] for k in ['hits', 'misses']})
+        env.close()
+        other.close()
+
+
+class ShouldNotShareCacheBetweenROMs(TestCase):
+    def test(self):
+        env = create_env()
+        other = NESEnv(rom_file_abs_path('super-mario-bros-lost-levels.nes'))
+        reference = NESEnv(rom_file_abs_path('super-mario-bros-lost-levels.nes'))
+        env._set_transition_cache()
+        # both ROMs are NROM with the same reset vector
+        self.assertRaises(ValueError, other._share_transition_cache, env)
+        other._set_transition_cache()
+        for each in [env, other, reference]:
+            each.reset()
+            for step in range(50):
+                each.step(action(step))
+        self.assertTrue(np.array_equal(reference.ram, other.ram))
+        self.assertEqual(50, other._transition_cache_stats()['misses'])
+        env.close()
+        other.close()
+        reference.close()
@@ -0,0 +1,96 @@
+"""Test cases for native counts of visited RAM values."""
+import collections
+from unittest import TestCase
+import numpy as np
+from .rom_file_abs_path import rom_file_abs_path
+from nes_py.nes_env import _LIB
+from nes_py.nes_env import NESEnv
+
+
+# the addresses and tuples of the counts of the tests
+ADDRESSES = [0x0009, 0x001d, 0x0086]
+TUPLES = [(0x006d, 0x0086), (0x0009, 0x001d, 0x00ce)]
+
+
+def create_env():
+    """Return a new reset SMB1 instance with visit counts."""
+    env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+    env.reset()
+    env._set_visit_counts(ADDRESSES, TUPLES, table_bits=20, scale=0.5)
+    return env
+
+
+class ShouldRaiseErrorsOnInvalidCounts(TestCase):
+    def test(self):
+        env = NESEnv(rom_file_abs_path('super-mario-bros-1.nes'))
+        env.reset()
+        self.assertRaises(ValueError, env._set_visit_counts)
+        self.assertRaises(ValueError, env._set_visit_counts, [0x800])
+        self.assertRaises(ValueError, env._set_visit_counts, tuples=[()])
+        self.assertRaises(ValueError, env._set_visit_counts, [0], table_bits=0)
+        self.assertRaises(ValueError, env._set_visit_counts, [0], table_bits=25)
+        self.assertRaises(ValueError, env._visit_counts)
+        self.assertNotIn('intrinsic', env.step(0)[3])
+        env._set_visit_counts([0])
+        self.assertRaises(ValueError, env._visit_histogram, 1)
+        self.assertRaises(ValueError, env._decay_visit_counts, 2)
+        # the native call rejects invalid indices on its own
+        histogram = np.zeros(256)
+        self.assertFalse(_LIB.VisitHistogram(env._env, 1, histogram.ctypes.data))
+        self.assertFalse(_LIB.VisitHistogram(env._env, -1, histogram.ctypes.data))
+        env._remove_visit_counts()
+        self.assertFalse(_LIB.VisitHistogram(env._env, 0, histogram.ctypes.data))
+        self.assertNotIn('intrinsic', env.step(0)[3])
+        env.close()
+
+
+class ShouldCountVisitsLikeReference(TestCase):
+    def test(self):
+        env = create_env()
+        counts = collections.Counter()
+
+        def count():
+            """Count the RAM of a frame in the reference and return its bonus."""
+            keys = [(address, env.ram[address]) for address in ADDRESSES]
+            keys += [(group, tuple(env.ram[list(group)])) for group in TUPLES]
+            bonus = 0
+            for key in keys:
+                counts[key] += 1
+                bonus += 1 / np.sqrt(counts[key])
+            return 0.5 * bonus
+
+        for step in range(300):
+            # frames advanced between steps add to the bonus of the step
+            expected = 0
+            if step % 10 == 0:
+                env._frame_advance(8)
+                expected += count()
+            _, _, _, info = env.step(8 if step % 40 < 5 else 0x81)
+            expected += count()
+            self.assertAlmostEqual(expected, info['intrinsic'])
+        keys = [(address, env.ram[address]) for address in ADDRESSES]
+        keys += [(group, tuple(env.ram[list(group)])) for group in TUPLES]
+        self.assertEqual([counts[key] for key in keys], list(env._visit_counts()))
+        for address in ADDRESSES:
+            histogram = [counts[(address, value)] for value in range(256)]
+            self.assertEqual(histogram, list(env._visit_histogram(address)))
+        env.close()
+
+
+class ShouldDecayAndResetCounts(TestCase):
+    def test(self):
+        env = create_env()
+        for _ in range(100):
+            env.step(0)
+        histogram = env._visit_histogram(0x0009)
+        counts = env._visit_counts()
+        env._decay_visit_counts(0.5)
+        self.assertTrue(np.allclose(histogram / 2, env._visit_histogram(0x0009)))
+        self.assertTrue(np.allclose(counts / 2, env._visit_counts()))
+        env._decay_visit_counts(0)
+        self.assertEqual(0, env._visit_histogram(0x0009).sum())
+        # every value is new after a reset of the counts
+        env.reset()
+        _, _, _, info = env.step(0)
+        self.assertAlmostEqual(0.5 * (len(ADDRESSES) + len(TUPLES)), info['intrinsic'])
+        env.close()
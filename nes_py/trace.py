@@ -0,0 +1,169 @@
+"""Decode instruction traces written by NESEnv._dump_trace.
+
+The emulator records traces only when the library is built with trace
+support (`scons trace=1` or `NES_PY_TRACE=1 python setup.py ...`).
+
+Usage:
+    python -m nes_py.trace <trace file> [--tail N]
+
+"""
+import argparse
+import numpy as np
+
+
+# the magic string at the start of a trace file
+MAGIC = b'NESTRACE'
+# the version of the trace format this module decodes
+VERSION = 2
+
+
+# the kinds of records in a trace (must match trace.hpp)
+(
+    INSTRUCTION,
+    IDLE,
+    READ,
+    WRITE,
+    INTERRUPT,
+    LOAD,
+) = range(6)
+
+
+# the layout of the header of a trace file
+HEADER = np.dtype([
+    ('magic', 'S8'),
+    ('version', '<u4'),
+    ('record_size', '<u4'),
+    ('num_records', '<u8'),
+    ('num_dropped', '<u8'),
+])
+
+
+# the layout of a record in a trace file
+RECORD = np.dtype([
+    ('cycle', '<u4'),
+    ('address', '<u2'),
+    ('kind', 'u1'),
+    ('value', 'u1'),
+    ('A', 'u1'),
+    ('X', 'u1'),
+    ('Y', 'u1'),
+    ('SP', 'u1'),
+    ('P', 'u1'),
+    ('padding', 'u1', 3),
+])
+
+
+# the names of the interrupt types of the CPU
+INTERRUPTS = ['IRQ', 'NMI', 'BRK']
+
+
+def read_trace(path):
+    """
+    Read a trace file.
+
+    Args:
+        path (str): the path of the trace file to read
+
+    Returns:
+        tuple: the number of records dropped from the ring buffer before the
+        first record in the file, and a structured array of the records with
+        the 32-bit cycle counters unwrapped to 64 bits. The unwrapping starts
+        over at each LOAD record, where the emulator reset or loaded a state
+
+    """
+    with open(path, 'rb') as trace_file:
+        data = trace_file.read()
+    if len(data) < HEADER.itemsize:
+        raise ValueError('{} is not a trace file'.format(path))
+    header = np.frombuffer(data, dtype=HEADER, count=1)[0]
+    if header['magic'] != MAGIC:
+        raise ValueError('{} is not a trace file'.format(path))
+    if header['version'] != VERSION or header['record_size'] != RECORD.itemsize:
+        raise ValueError('unsupported trace version {}'.format(header['version']))
+    records = np.frombuffer(data,
+        dtype=RECORD,
+        count=int(header['num_records']),
+        offset=HEADER.itemsize,
+    )
+    # between loads the cycle counter only ever increases, so each decrease
+    # is a wrap. a load sets the counter to that of the loaded state, so the
+    # count of wraps starts over at each load
+    cycles = records['cycle'].astype(np.int64)
+    is_load = records['kind'] == LOAD
+    is_wrap = (np.diff(cycles, prepend=cycles[:1]) < 0) & ~is_load
+    total = np.cumsum(is_wrap)
+    wraps = total - np.maximum.accumulate(np.where(is_load, total, 0))
+    cycles += wraps.astype(np.int64) << 32
+    decoded = np.empty(len(records), dtype=[('cycle', '<i8')] + [
+        (name, RECORD.fields[name][0]) for name in RECORD.names[1:]
+    ])
+    for name in RECORD.names[1:]:
+        decoded[name] = records[name]
+    decoded['cycle'] = cycles
+    return int(header['num_dropped']), decoded
+
+
+def format_record(record):
+    """
+    Return a human readable line for a record.
+
+    Args:
+        record (np.void): a record from read_trace
+
+    Returns:
+        str: the line for the record
+
+    """
+    kind = int(record['kind'])
+    if kind in (INSTRUCTION, IDLE):
+        return '{:>12} {:04X}  {}  A:{:02X} X:{:02X} Y:{:02X} P:{:02X} SP:{:02X}'.format(
+            record['cycle'],
+            record['address'],
+            '{:02X}'.format(record['value']) if kind == INSTRUCTION else '..',
+            record['A'],
+            record['X'],
+            record['Y'],
+            record['P'],
+            record['SP'],
+        )
+    if kind == LOAD:
+        return '{:>12}       state loaded'.format(record['cycle'])
+    if kind == INTERRUPT:
+        return '{:>12} {:04X}  {}'.format(
+            record['cycle'],
+            record['address'],
+            INTERRUPTS[record['value']] if record['value'] < 3 else '???',
+        )
+    return '{:>12}       {} {:04X} = {:02X}'.format(
+        record['cycle'],
+        'R' if kind == READ else 'W',
+        record['address'],
+        record['value'],
+    )
+
+
+def main():
+    """Print a trace file as text."""
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('path', help='the trace file to decode')
+    parser.add_argument('--tail', type=int, default=None,
+        help='the number of most recent records to print',
+    )
+    args = parser.parse_args()
+    num_dropped, records = read_trace(args.path)
+    if args.tail is not None:
+        start = max(0, len(records) - args.tail)
+        num_dropped += start
+        records = records[start:]
+    if num_dropped:
+        print('... {} earlier records'.format(num_dropped))
+    for record in records:
+        print(format_record(record))
+
+
+# explicitly define the outward facing API of this module
+__all__ = [read_trace.__name__, format_record.__name__]
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,120 @@
+"""Trajectories of recorded frames for offline learning.
+
+NESEnv._start_trajectory streams every frame (the controllers, the RAM, the
+screen, and the reward and done flag of the RAM program) to a file. Frames
+are stored as palette indices that are XORed with the last frame and run
+length encoded, and RAM as a delta from the last frame, in self-contained
+chunks. A reader maps the file and decodes any frame from the start of its
+chunk (or from the last read frame, so sequential reads decode one frame
+each). A file that is still being written (or whose recorder crashed) can be
+read up to its last whole chunk.
+
+Example:
+    >>> env._start_trajectory('run.nestraj')
+    >>> for _ in range(1000):
+    ...     env.step(env.action_space.sample())
+    >>> env._stop_trajectory()
+    >>> trajectory = TrajectoryReader('run.nestraj')
+    >>> step = trajectory[123]
+    >>> step['action'], step['reward'], step['frame'].shape
+
+"""
+import ctypes
+import numpy as np
+from .nes_env import _LIB
+from .nes_env import SCREEN_HEIGHT
+from .nes_env import SCREEN_WIDTH
+
+
+class TrajectoryStep(ctypes.Structure):
+    """The inputs and outputs of a recorded frame (must match trajectory.hpp)."""
+
+    _fields_ = [
+        ('action', ctypes.c_uint8),
+        ('second_action', ctypes.c_uint8),
+        ('done', ctypes.c_bool),
+        ('reward', ctypes.c_double),
+    ]
+
+
+def _palette():
+    """Return the RGB color of each palette index as a 64 x 3 array."""
+    colors = np.ctypeslib.as_array(_LIB.Palette(), shape=(64,)).astype(np.uint32)
+    shifts = np.array([16, 8, 0], dtype=np.uint32)
+    return ((colors[:, None] >> shifts) & 0xff).astype(np.uint8)
+
+
+# the RGB color of each palette index of a recorded frame
+PALETTE = _palette()
+
+
+class TrajectoryReader(object):
+    """A read-only trajectory file with random access to its frames."""
+
+    def __init__(self, path):
+        """
+        Map a trajectory file.
+
+        Args:
+            path (str): the path of the trajectory
+
+        Returns:
+            None
+
+        """
+        self._reader = _LIB.OpenTrajectory(path)
+        if not self._reader:
+            raise ValueError('{} is not a trajectory'.format(path))
+        # the hash of the ROM the trajectory was recorded on
+        self.rom_hash = _LIB.TrajectoryROMHash(self._reader)
+
+    def __len__(self):
+        """Return the number of frames in the whole chunks of the file."""
+        return _LIB.TrajectorySize(self._reader)
+
+    def __getitem__(self, index):
+        """
+        Return a recorded frame.
+
+        Args:
+            index (int): the index of the frame
+
+        Returns:
+            dict: the 'action' and 'second_action' controller bytes, the
+            'reward' and 'done' flag of the RAM program, the 'ram' (2048
+            bytes), the 'indices' of the palette color of each pixel, and
+            the 'frame' as RGB (240 x 256 x 3)
+
+        """
+        length = len(self)
+        if index < 0:
+            index += length
+        if not 0 <= index < length:
+            raise IndexError('trajectory index out of range')
+        step = TrajectoryStep()
+        ram = np.empty(0x800, dtype=np.uint8)
+        indices = np.empty((SCREEN_HEIGHT, SCREEN_WIDTH), dtype=np.uint8)
+        if not _LIB.TrajectoryRead(self._reader, index, ctypes.byref(step), ram.ctypes.data, indices.ctypes.data):
+            raise ValueError('frame {} of the trajectory is corrupt'.format(index))
+        return {
+            'action': step.action,
+            'second_action': step.second_action,
+            'reward': step.reward,
+            'done': step.done,
+            'ram': ram,
+            'indices': indices,
+            'frame': PALETTE[indices],
+        }
+
+    def close(self):
+        """Unmap the trajectory."""
+        if self._reader is None:
+            raise ValueError('trajectory has already been closed.')
+        _LIB.CloseTrajectory(self._reader)
+        self._reader = None
+
+
+# explicitly define the outward facing API of this module
+__all__ = [
+    TrajectoryReader.__name__,
+]
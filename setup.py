@@ -1,5 +1,6 @@
 """The setup script for installing and distributing the nes-py package."""
 import os
+import sys
 from glob import glob
 from setuptools import setup, find_packages, Extension
 
@@ -26,12 +27,26 @@ SOURCES = glob('nes_py/nes/src/*.cpp') + glob('nes_py/nes/src/mappers/*.cpp')
 # headers with sdist
 INCLUDE_DIRS = ['nes_py/nes/include']
 # Build arguments to pass to the compiler
-EXTRA_COMPILE_ARGS = ['-std=c++1y', '-pipe', '-O3']
+EXTRA_COMPILE_ARGS = ['-std=c++1y', '-pipe', '-O3', '-pthread']
+# Link arguments to pass to the linker (the emulator uses worker threads)
+EXTRA_LINK_ARGS = ['-pthread']
+# Libraries to link, shm_open is in librt before glibc 2.34
+LIBRARIES = ['rt'] if sys.platform.startswith('linux') else []
+# Preprocessor definitions, set NES_PY_STATS=1 to build with the native
+# instrumentation counters and NES_PY_TRACE=1 to build with the instruction
+# trace ring buffer
+DEFINE_MACROS = [
+    ('NES_STATS', os.environ.get('NES_PY_STATS', '0')),
+    ('NES_TRACE', os.environ.get('NES_PY_TRACE', '0')),
+]
 # The official extension using the name, source, headers, and build args
 LIB_NES_ENV = Extension(LIB_NAME,
     sources=SOURCES,
     include_dirs=INCLUDE_DIRS,
     extra_compile_args=EXTRA_COMPILE_ARGS,
+    extra_link_args=EXTRA_LINK_ARGS,
+    libraries=LIBRARIES,
+    define_macros=DEFINE_MACROS,
 )
 
 